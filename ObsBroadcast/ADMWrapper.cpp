@@ -17,6 +17,8 @@
 
 #include "ADMWrapper.h"
 
+#include "api/units/time_delta.h"
+#include "rtc_base/location.h"
 #include "rtc_base/ref_counted_object.h"
 
 static const size_t sampleRate = 48000;
@@ -32,17 +34,30 @@ static const size_t buffersPerSecond = 1000 / bufferDurationMs;  // 100
 static const size_t framesPer10msBuffer = sampleRate / buffersPerSecond;  // 480
 static const size_t bytesPer10msBuffer = nBytesPerFrame * framesPer10msBuffer;  // 1920
 
+static const size_t ringDurationMs = 320;
+static const size_t bytesPerRing = bytesPer10msBuffer * (ringDurationMs / bufferDurationMs);  // 61440
+
+// Chunks buffered before the pump starts delivering (covers one 1024-frame OBS packet + jitter).
+static const size_t primeChunks = 3;
+// Backlog (in chunks) above which the pump delivers two chunks per tick to catch up.
+static const size_t catchUpChunks = 8;
+
 
 ADMWrapper::ADMWrapper()
     : audio_transport_(nullptr)
+    , ring_(bytesPerRing)
     , buffer_(bytesPer10msBuffer)
-    , buffer_idx_(0)
+    , primed_(false)
+    , chunks_delivered_(0)
+    , overruns_(0)
+    , underruns_(0)
     , initialized_(false)
 {}
 
 
 ADMWrapper::~ADMWrapper()
 {
+    StopPump();
     audio_transport_ = nullptr;
 }
 
@@ -58,39 +73,100 @@ rtc::scoped_refptr<ADMWrapper> ADMWrapper::Create()
 
 void ADMWrapper::onIncomingData(uint8_t* data, size_t samplesPerChannel)
 {
-    mutex_.Lock();
-    if (!audio_transport_)
+    // Runs on the OBS audio thread: no locks and no cross-thread calls. If the
+    // pump has fallen behind far enough to fill the ring, drop the packet.
+    if (!ring_.Write(data, samplesPerChannel * nBytesPerFrame))
+        ++overruns_;
+}
+
+
+ADMWrapper::Stats ADMWrapper::GetStats() const
+{
+    Stats stats;
+    stats.chunksDelivered   = chunks_delivered_.load();
+    stats.overruns          = overruns_.load();
+    stats.underruns         = underruns_.load();
+    stats.bufferedMs        = ring_.available() / nBytesPerFrame * 1000 / sampleRate;
+    return stats;
+}
+
+
+void ADMWrapper::StartPump()
+{
+    if (pump_thread_)
+        return;
+
+    // Nothing is consuming while the pump is down, so it is safe to clear here.
+    ring_.Clear();
+    primed_ = false;
+
+    pump_thread_ = rtc::Thread::Create();
+    pump_thread_->SetName("ADMWrapper_Pump", nullptr);
+    pump_thread_->Start();
+    pump_thread_->Invoke<void>(RTC_FROM_HERE, [this]()
+    {
+        pump_task_ = webrtc::RepeatingTaskHandle::Start(pump_thread_.get(), [this]() { return Pump(); });
+    });
+}
+
+
+void ADMWrapper::StopPump()
+{
+    if (!pump_thread_)
         return;
-    mutex_.Unlock();
 
-    size_t remainingData = samplesPerChannel * nBytesPerSample * nChannels;
-    size_t remainingBuffer = buffer_.size() - buffer_idx_;
-    size_t bytesToCopy = std::min(remainingData, remainingBuffer);
+    // RepeatingTaskHandle must be stopped on the queue it runs on.
+    pump_thread_->Invoke<void>(RTC_FROM_HERE, [this]() { pump_task_.Stop(); });
+    pump_thread_->Stop();
+    pump_thread_ = nullptr;
+}
+
+
+// Runs every 10 ms on |pump_thread_|. RepeatingTaskHandle schedules against the
+// ideal start time, so late ticks are followed by shorter waits and the pump
+// keeps its own 100 Hz clock regardless of how OBS batches audio packets.
+webrtc::TimeDelta ADMWrapper::Pump()
+{
+    MutexLock lock(&mutex_);
+
+    const size_t chunks = ring_.available() / bytesPer10msBuffer;
 
-    while (bytesToCopy)
+    // (Re)fill a small jitter buffer before delivering, since OBS hands over
+    // ~21 ms packets while we consume 10 ms at a time.
+    if (!primed_)
     {
-        memcpy(&buffer_[buffer_idx_], data, bytesToCopy);
-
-        data            += bytesToCopy;
-        buffer_idx_     += bytesToCopy;
-        remainingData   -= bytesToCopy;
-        remainingBuffer -= bytesToCopy;
-
-        if (remainingBuffer == 0)
-        {
-            uint32_t micLevel;
-            audio_transport_->RecordedDataIsAvailable(&buffer_[0],
-                                                      framesPer10msBuffer,
-                                                      nBytesPerSample * nChannels,
-                                                      nChannels,
-                                                      sampleRate,
-                                                      0, 0, 0, false, micLevel);
-            buffer_idx_ = 0;
-            remainingBuffer = buffer_.size();
-        }
-
-        bytesToCopy = std::min(remainingData, remainingBuffer);
+        if (chunks < primeChunks)
+            return webrtc::TimeDelta::Millis(bufferDurationMs);
+        primed_ = true;
     }
+
+    if (chunks == 0)
+    {
+        ++underruns_;
+        primed_ = false;
+        return webrtc::TimeDelta::Millis(bufferDurationMs);
+    }
+
+    // Deliver one chunk per tick, or two while draining a backlog caused by
+    // clock drift between OBS and this thread.
+    size_t toDeliver = chunks > catchUpChunks ? 2 : 1;
+    while (toDeliver-- && ring_.Read(&buffer_[0], buffer_.size()))
+    {
+        // Without a transport the audio is simply discarded.
+        if (!audio_transport_)
+            continue;
+
+        uint32_t micLevel;
+        audio_transport_->RecordedDataIsAvailable(&buffer_[0],
+                                                  framesPer10msBuffer,
+                                                  nBytesPerSample * nChannels,
+                                                  nChannels,
+                                                  sampleRate,
+                                                  0, 0, 0, false, micLevel);
+        ++chunks_delivered_;
+    }
+
+    return webrtc::TimeDelta::Millis(bufferDurationMs);
 }
 
 
@@ -99,6 +175,7 @@ int32_t ADMWrapper::Init()
     if (initialized_)
         return 0;
 
+    StartPump();
     initialized_ = true;
     return 0;
 }
@@ -109,6 +186,7 @@ int32_t ADMWrapper::Terminate()
     if (!initialized_)
         return 0;
 
+    StopPump();
     initialized_ = false;
     return 0;
 }
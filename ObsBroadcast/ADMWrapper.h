@@ -20,11 +20,17 @@
 #ifndef ADM_WRAPPER_H_
 #define ADM_WRAPPER_H_
 
+#include "AudioRingBuffer.h"
+
 #include "api/scoped_refptr.h"
 #include "modules/audio_device/include/audio_device.h"
 #include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/task_utils/repeating_task.h"
+#include "rtc_base/thread.h"
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 using webrtc::AudioDeviceModule;
@@ -39,10 +45,23 @@ public:
     ADMWrapper();
     ~ADMWrapper() override;
 
+    /// Audio hand-off counters, safe to read from any thread.
+    struct Stats
+    {
+        uint64_t chunksDelivered;   // 10 ms chunks passed to the AudioTransport
+        uint64_t overruns;          // OBS packets dropped because the ring was full
+        uint64_t underruns;         // pump ticks that found less than 10 ms buffered
+        size_t   bufferedMs;        // audio currently waiting in the ring
+    };
+
     static rtc::scoped_refptr<ADMWrapper> Create();
 
+    /// Called on the OBS audio thread. Never blocks: the samples are copied into
+    /// a lock-free ring and delivered to WebRTC by the 10 ms pump thread.
     virtual void onIncomingData(uint8_t* data, size_t samplesPerChannel);
 
+    Stats GetStats() const;
+
     // Main initialization and termination
     int32_t Init() override;
     int32_t Terminate() override;
@@ -186,12 +205,24 @@ public:
     int32_t EnableBuiltInNS(bool enable) override { return -1; }
 
 private:
+    void StartPump();
+    void StopPump();
+    webrtc::TimeDelta Pump();
+
     AudioTransport*         audio_transport_;
 
     Mutex                   mutex_;
 
+    AudioRingBuffer         ring_;
     std::vector<uint8_t>    buffer_;
-    size_t                  buffer_idx_;
+    bool                    primed_;
+
+    std::unique_ptr<rtc::Thread>    pump_thread_;
+    webrtc::RepeatingTaskHandle     pump_task_;
+
+    std::atomic<uint64_t>   chunks_delivered_;
+    std::atomic<uint64_t>   overruns_;
+    std::atomic<uint64_t>   underruns_;
 
     bool                    initialized_;
 };
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "AudioRingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+AudioRingBuffer::AudioRingBuffer(size_t capacity)
+    : buffer_(capacity)
+    , write_pos_(0)
+    , read_pos_(0)
+{}
+
+
+bool AudioRingBuffer::Write(const uint8_t* data, size_t size)
+{
+    const size_t writePos = write_pos_.load(std::memory_order_relaxed);
+    const size_t readPos = read_pos_.load(std::memory_order_acquire);
+
+    if (size > buffer_.size() - (writePos - readPos))
+        return false;
+
+    const size_t idx = writePos % buffer_.size();
+    const size_t first = std::min(size, buffer_.size() - idx);
+    memcpy(&buffer_[idx], data, first);
+    if (size > first)
+        memcpy(&buffer_[0], data + first, size - first);
+
+    write_pos_.store(writePos + size, std::memory_order_release);
+    return true;
+}
+
+
+bool AudioRingBuffer::Read(uint8_t* data, size_t size)
+{
+    const size_t readPos = read_pos_.load(std::memory_order_relaxed);
+    const size_t writePos = write_pos_.load(std::memory_order_acquire);
+
+    if (writePos - readPos < size)
+        return false;
+
+    const size_t idx = readPos % buffer_.size();
+    const size_t first = std::min(size, buffer_.size() - idx);
+    memcpy(data, &buffer_[idx], first);
+    if (size > first)
+        memcpy(data + first, &buffer_[0], size - first);
+
+    read_pos_.store(readPos + size, std::memory_order_release);
+    return true;
+}
+
+
+void AudioRingBuffer::Clear()
+{
+    read_pos_.store(write_pos_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+
+size_t AudioRingBuffer::available() const
+{
+    return write_pos_.load(std::memory_order_acquire) - read_pos_.load(std::memory_order_acquire);
+}
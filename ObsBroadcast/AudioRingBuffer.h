@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef AUDIO_RING_BUFFER_H_
+#define AUDIO_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/// Single-producer/single-consumer lock-free byte ring.
+///
+/// Write() may only be called from one thread (the OBS audio thread) and
+/// Read() from one other thread (the ADM pump). Neither side ever blocks.
+/// Positions are free-running byte counters, so full/empty is never ambiguous.
+class AudioRingBuffer
+{
+public:
+    explicit AudioRingBuffer(size_t capacity);
+    ~AudioRingBuffer() = default;
+
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+    /// Producer: copy |size| bytes in. Returns false, copying nothing, when
+    /// there is not enough free space for all of |data|.
+    bool Write(const uint8_t* data, size_t size);
+
+    /// Consumer: copy exactly |size| bytes out. Returns false, copying
+    /// nothing, when fewer than |size| bytes are buffered.
+    bool Read(uint8_t* data, size_t size);
+
+    /// Consumer: discard everything currently buffered.
+    void Clear();
+
+    size_t available() const;
+    size_t capacity() const { return buffer_.size(); }
+
+private:
+    std::vector<uint8_t>    buffer_;
+
+    // Written by the producer only.
+    alignas(64) std::atomic<size_t> write_pos_;
+    // Written by the consumer only.
+    alignas(64) std::atomic<size_t> read_pos_;
+};
+
+#endif  // AUDIO_RING_BUFFER_H_
@@ -90,6 +90,7 @@
 extern CBroadcastCtx g_ctx;  // part of MFCLibPlugins.lib::MfcPluginAPI.obj
 extern char g_dummyCharVal;  // Part of MfcLog.cpp in MFClibfcs.lib
 extern "C" struct obs_output_info wowza_output_info;
+extern "C" void wowza_stream_unload();
 
 CHttpThread g_thread;
 SidekickPropertiesUI* sidekick_prop = nullptr;
@@ -1054,6 +1055,7 @@ void obs_module_unload()
 {
     _TRACE("obs_module_unload called, stopping thread");
     g_thread.Stop(-1);
+    wowza_stream_unload();
     _TRACE("%s OBS Plugin has been Unloaded", __progname);
 
     CObsUtil::TerminateMFCLogin();
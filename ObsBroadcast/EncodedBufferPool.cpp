@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "EncodedBufferPool.h"
+
+#include "rtc_base/checks.h"
+
+using rtc::scoped_refptr;
+
+
+void EncodedBufferPool::Buffer::set_size(size_t size)
+{
+    RTC_DCHECK(external_ || size <= storage_.size());
+    size_ = size;
+}
+
+
+EncodedBufferPool::EncodedBufferPool(size_t maxBuffers)
+    : maxBuffers_(maxBuffers)
+{}
+
+
+scoped_refptr<EncodedBufferPool::PooledBuffer> EncodedBufferPool::GetFree()
+{
+    for (const auto& buffer : buffers_)
+    {
+        // In use while an EncodedImage (or a copy of one) still references it.
+        if (buffer->HasOneRef())
+            return buffer;
+    }
+
+    scoped_refptr<PooledBuffer> buffer(new PooledBuffer());
+    // Past |maxBuffers_| hand out a one-off buffer rather than fail the frame.
+    if (buffers_.size() < maxBuffers_)
+        buffers_.push_back(buffer);
+    return buffer;
+}
+
+
+scoped_refptr<EncodedBufferPool::Buffer> EncodedBufferPool::Get(size_t capacity)
+{
+    auto buffer = GetFree();
+    buffer->external_ = nullptr;
+    if (buffer->storage_.size() < capacity)
+        buffer->storage_.resize(capacity);
+    buffer->size_ = capacity;
+    return buffer;
+}
+
+
+scoped_refptr<EncodedBufferPool::Buffer> EncodedBufferPool::Wrap(uint8_t* data, size_t size)
+{
+    auto buffer = GetFree();
+    buffer->external_ = data;
+    buffer->size_ = size;
+    return buffer;
+}
+
+
+void EncodedBufferPool::Release()
+{
+    buffers_.remove_if([](const scoped_refptr<PooledBuffer>& buffer) { return buffer->HasOneRef(); });
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef ENCODED_BUFFER_POOL_H_
+#define ENCODED_BUFFER_POOL_H_
+
+#include "api/scoped_refptr.h"
+#include "api/video/encoded_image.h"
+#include "rtc_base/ref_counted_object.h"
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+
+/// Pool of EncodedImage buffers whose capacity is kept across frames.
+///
+/// A buffer is either backed by its own storage, which only grows, or wraps
+/// memory owned by someone else (x264's NAL buffer) without copying. A wrapped
+/// buffer is only valid until the owner reuses that memory, i.e. for the
+/// duration of the encode complete callback.
+///
+/// Not thread safe: Get()/Wrap() must be called from one thread. Buffers may be
+/// released on any thread.
+class EncodedBufferPool
+{
+public:
+    class Buffer : public webrtc::EncodedImageBufferInterface
+    {
+    public:
+        const uint8_t* data() const override { return external_ ? external_ : storage_.data(); }
+        uint8_t* data() override { return external_ ? external_ : storage_.data(); }
+        size_t size() const override { return size_; }
+
+        /// Sets the logical size; must not exceed the size passed to Get().
+        void set_size(size_t size);
+
+    private:
+        friend class EncodedBufferPool;
+
+        std::vector<uint8_t>    storage_;
+        uint8_t*                external_ = nullptr;
+        size_t                  size_ = 0;
+    };
+
+    explicit EncodedBufferPool(size_t maxBuffers = kDefaultMaxBuffers);
+    ~EncodedBufferPool() = default;
+
+    EncodedBufferPool(const EncodedBufferPool&) = delete;
+    EncodedBufferPool& operator=(const EncodedBufferPool&) = delete;
+
+    /// Returns an owned buffer with room for at least |capacity| bytes.
+    rtc::scoped_refptr<Buffer> Get(size_t capacity);
+
+    /// Returns a buffer that points at |size| bytes of |data| without copying.
+    rtc::scoped_refptr<Buffer> Wrap(uint8_t* data, size_t size);
+
+    /// Drops all buffers not currently referenced by an EncodedImage.
+    void Release();
+
+    static const size_t kDefaultMaxBuffers = 4;
+
+private:
+    using PooledBuffer = rtc::RefCountedObject<Buffer>;
+
+    rtc::scoped_refptr<PooledBuffer> GetFree();
+
+    std::list<rtc::scoped_refptr<PooledBuffer>> buffers_;
+    const size_t maxBuffers_;
+};
+
+#endif  // ENCODED_BUFFER_POOL_H_
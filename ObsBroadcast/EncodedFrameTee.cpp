@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "EncodedFrameTee.h"
+
+#include "rtc_base/location.h"
+#include "rtc_base/logging.h"
+
+#include <utility>
+
+constexpr const char* EncodedFrameTee::kIndexHeader;
+
+
+EncodedFrameTee::EncodedFrameTee(const std::string& basePath)
+    : basePath_(basePath)
+    , pending_(0)
+    , sequence_(0)
+    , written_(0)
+    , dropped_(0)
+    , index_(nullptr)
+{
+    index_ = fopen(IndexPath(basePath_).c_str(), "w");
+    if (!index_)
+    {
+        RTC_LOG(LS_WARNING) << "EncodedFrameTee: can't open " << IndexPath(basePath_);
+        return;
+    }
+    fprintf(index_, "%s\n", kIndexHeader);
+
+    thread_ = rtc::Thread::Create();
+    thread_->SetName("EncodedFrameTee", nullptr);
+    thread_->Start();
+    RTC_LOG(LS_INFO) << "EncodedFrameTee: writing to " << basePath_;
+}
+
+
+EncodedFrameTee::~EncodedFrameTee()
+{
+    // Tasks run in order, so an empty Invoke() returns once pending frames
+    // are written; Stop() alone would discard them.
+    if (thread_)
+    {
+        thread_->Invoke<void>(RTC_FROM_HERE, [] {});
+        thread_->Stop();
+        thread_.reset();
+    }
+
+    for (auto& layer : layers_)
+        fclose(layer.second);
+    layers_.clear();
+    if (index_)
+    {
+        fclose(index_);
+        index_ = nullptr;
+    }
+
+    RTC_LOG(LS_INFO) << "EncodedFrameTee: " << written() << " frames written, "
+                     << dropped() << " dropped";
+}
+
+
+bool EncodedFrameTee::Write(Frame frame)
+{
+    if (!thread_)
+        return false;
+
+    const uint64_t sequence = sequence_++;
+    if (pending_.fetch_add(1, std::memory_order_relaxed) >= kMaxPendingFrames)
+    {
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto shared = std::make_shared<Frame>(std::move(frame));
+    thread_->PostTask(RTC_FROM_HERE, [this, shared, sequence]() {
+        WriteFrame(*shared, sequence);
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+    });
+    return true;
+}
+
+
+void EncodedFrameTee::WriteFrame(const Frame& frame, uint64_t sequence)
+{
+    FILE*& file = layers_[frame.layer];
+    if (!file)
+    {
+        const auto path = LayerPath(basePath_, frame.layer);
+        file = fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            RTC_LOG(LS_WARNING) << "EncodedFrameTee: can't open " << path;
+            layers_.erase(frame.layer);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    uint64_t& offset = offsets_[frame.layer];
+    if (fwrite(frame.data.data(), 1, frame.data.size(), file) != frame.data.size())
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    fprintf(index_, "%llu,%u,%u,%lld,%lld,%lld,%llu,%zu,%d,%u,%u,%d\n",
+            (unsigned long long)sequence, frame.layer, frame.rtpTimestamp,
+            (long long)frame.captureTimeMs, (long long)frame.encodeStartMs, (long long)frame.encodeFinishMs,
+            (unsigned long long)offset, frame.data.size(), frame.key ? 1 : 0,
+            frame.width, frame.height, frame.qp);
+
+    offset += frame.data.size();
+    written_.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+// static
+std::string EncodedFrameTee::LayerPath(const std::string& basePath, uint32_t layer)
+{
+    return basePath + ".L" + std::to_string(layer) + ".h264";
+}
+
+
+// static
+std::string EncodedFrameTee::IndexPath(const std::string& basePath)
+{
+    return basePath + ".csv";
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#ifndef ENCODED_FRAME_TEE_H_
+#define ENCODED_FRAME_TEE_H_
+
+#include "rtc_base/thread.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/// Copies encoded frames to local files for QA and offline replay.
+///
+/// Each simulcast layer is written as a raw Annex-B stream to
+/// "<base>.L<layer>.h264", and every frame gets a line in "<base>.csv" with
+/// its timestamps and byte range in that stream (see kIndexHeader).
+///
+/// Write() copies the frame and hands it to a writer thread, so the encoder
+/// never waits on disk. At most |kMaxPendingFrames| frames may be waiting;
+/// beyond that frames are dropped and counted, leaving a gap in the index's
+/// frame column.
+class EncodedFrameTee
+{
+public:
+    struct Frame
+    {
+        uint32_t    layer;
+        uint32_t    rtpTimestamp;
+        int64_t     captureTimeMs;      // VideoFrame::render_time_ms()
+        int64_t     encodeStartMs;
+        int64_t     encodeFinishMs;
+        uint32_t    width;
+        uint32_t    height;
+        bool        key;
+        int         qp;
+        std::vector<uint8_t> data;      // Annex-B NAL units
+    };
+
+    static constexpr const char* kIndexHeader =
+        "frame,layer,rtp_timestamp,capture_ms,encode_start_ms,encode_finish_ms,offset,size,key,width,height,qp";
+
+    static const size_t kMaxPendingFrames = 90;  // ~1.5 s at 60 fps
+
+    explicit EncodedFrameTee(const std::string& basePath);
+    /// Writes out pending frames and closes the files.
+    ~EncodedFrameTee();
+
+    EncodedFrameTee(const EncodedFrameTee&) = delete;
+    EncodedFrameTee& operator=(const EncodedFrameTee&) = delete;
+
+    bool IsOpen() const { return index_ != nullptr; }
+
+    /// Returns false if the frame was dropped because the writer is behind.
+    bool Write(Frame frame);
+
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    static std::string LayerPath(const std::string& basePath, uint32_t layer);
+    static std::string IndexPath(const std::string& basePath);
+
+private:
+    // Writer thread only.
+    void WriteFrame(const Frame& frame, uint64_t sequence);
+
+    const std::string           basePath_;
+    std::unique_ptr<rtc::Thread> thread_;
+    std::atomic<size_t>         pending_;
+    uint64_t                    sequence_;      // Write() caller only
+    std::atomic<uint64_t>       written_;
+    std::atomic<uint64_t>       dropped_;
+
+    // Owned by the writer thread once it is started.
+    FILE*                       index_;
+    std::map<uint32_t, FILE*>   layers_;
+    std::map<uint32_t, uint64_t> offsets_;
+};
+
+#endif  // ENCODED_FRAME_TEE_H_
@@ -45,9 +45,20 @@ unique_ptr<VideoEncoder> EncoderFactory::CreateVideoEncoder(const SdpVideoFormat
 vector<SdpVideoFormat> EncoderFactory::GetSupportedFormats() const
 {
     const string name = cricket::kH264CodecName;
-    const SdpVideoFormat::Parameters parameters = map<string, string>{ {"profile-level-id", "42e01f"} };
 
-    return {SdpVideoFormat(name, parameters)};
+    // Constrained baseline 3.1 in both packetization modes, non-interleaved
+    // (FU-A) first so it is preferred.
+    vector<SdpVideoFormat> formats;
+    for (const char* mode : {"1", "0"})
+    {
+        const SdpVideoFormat::Parameters parameters = map<string, string>{
+            {cricket::kH264FmtpProfileLevelId, "42e01f"},
+            {cricket::kH264FmtpLevelAsymmetryAllowed, "1"},
+            {cricket::kH264FmtpPacketizationMode, mode},
+        };
+        formats.push_back(SdpVideoFormat(name, parameters));
+    }
+    return formats;
 }
 
 
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "EncoderTelemetry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+constexpr std::array<int, 10> EncoderTelemetry::kEncodeMsBounds;
+constexpr std::array<int, 9>  EncoderTelemetry::kQueueMsBounds;
+constexpr std::array<int, 9>  EncoderTelemetry::kSizeKbBounds;
+
+
+EncoderTelemetry::EncoderTelemetry()
+    : written_(0)
+    , begin_(0)
+    , keyFrames_(0)
+    , deltaFrames_(0)
+    , droppedFrames_(0)
+    , keyBytes_(0)
+    , deltaBytes_(0)
+    , maxEncodeMs_(0)
+{
+    for (auto& slot : ring_)
+    {
+        for (auto& word : slot.words)
+            word.store(0, std::memory_order_relaxed);
+    }
+    for (auto& c : encodeMs_) c.store(0, std::memory_order_relaxed);
+    for (auto& c : queueMs_)  c.store(0, std::memory_order_relaxed);
+    for (auto& c : sizeKb_)   c.store(0, std::memory_order_relaxed);
+    for (auto& c : qp_)       c.store(0, std::memory_order_relaxed);
+}
+
+
+template<size_t N>
+size_t EncoderTelemetry::Bucket(const std::array<int, N>& bounds, int value)
+{
+    return std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+}
+
+
+void EncoderTelemetry::Record(const Frame& frame)
+{
+    // Ring.
+    const uint64_t n = written_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = ring_[n % kRingSize];
+
+    uint64_t words[kSlotWords] = {};
+    memcpy(words, &frame, sizeof(Frame));
+
+    // Another writer only holds this slot if the ring wrapped while it was
+    // writing; wait for it rather than interleaving words.
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (seq & 1)
+            seq = slot.seq.load(std::memory_order_relaxed);
+        else if (slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed))
+            break;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kSlotWords; ++i)
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    slot.index.store(n + 1, std::memory_order_relaxed);
+    slot.seq.store(seq + 2, std::memory_order_release);
+
+    // Histograms.
+    if (frame.kind == kDropped)
+    {
+        droppedFrames_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (frame.kind == kKey)
+    {
+        keyFrames_.fetch_add(1, std::memory_order_relaxed);
+        keyBytes_.fetch_add(frame.sizeBytes, std::memory_order_relaxed);
+    }
+    else
+    {
+        deltaFrames_.fetch_add(1, std::memory_order_relaxed);
+        deltaBytes_.fetch_add(frame.sizeBytes, std::memory_order_relaxed);
+    }
+
+    encodeMs_[Bucket(kEncodeMsBounds, frame.encodeMs)].fetch_add(1, std::memory_order_relaxed);
+    queueMs_[Bucket(kQueueMsBounds, frame.queueMs)].fetch_add(1, std::memory_order_relaxed);
+    sizeKb_[Bucket(kSizeKbBounds, (int)((frame.sizeBytes + 1023) / 1024))].fetch_add(1, std::memory_order_relaxed);
+    qp_[std::min<int>(frame.qp / kQpBucketWidth, kQpBuckets - 1)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t maxMs = maxEncodeMs_.load(std::memory_order_relaxed);
+    while (frame.encodeMs > maxMs && !maxEncodeMs_.compare_exchange_weak(maxMs, frame.encodeMs, std::memory_order_relaxed)) {}
+}
+
+
+EncoderTelemetry::Histograms EncoderTelemetry::TakeHistograms()
+{
+    Histograms h;
+    for (size_t i = 0; i < encodeMs_.size(); ++i)
+        h.encodeMs[i] = encodeMs_[i].exchange(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < queueMs_.size(); ++i)
+        h.queueMs[i] = queueMs_[i].exchange(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < sizeKb_.size(); ++i)
+        h.sizeKb[i] = sizeKb_[i].exchange(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < qp_.size(); ++i)
+        h.qp[i] = qp_[i].exchange(0, std::memory_order_relaxed);
+    h.keyFrames     = keyFrames_.exchange(0, std::memory_order_relaxed);
+    h.deltaFrames   = deltaFrames_.exchange(0, std::memory_order_relaxed);
+    h.droppedFrames = droppedFrames_.exchange(0, std::memory_order_relaxed);
+    h.keyBytes      = keyBytes_.exchange(0, std::memory_order_relaxed);
+    h.deltaBytes    = deltaBytes_.exchange(0, std::memory_order_relaxed);
+    h.maxEncodeMs   = maxEncodeMs_.exchange(0, std::memory_order_relaxed);
+    return h;
+}
+
+
+bool EncoderTelemetry::ReadSlot(uint64_t n, Frame* frame) const
+{
+    const Slot& slot = ring_[n % kRingSize];
+    uint64_t words[kSlotWords];
+
+    const uint32_t before = slot.seq.load(std::memory_order_acquire);
+    if (before & 1)
+        return false;
+    const uint64_t index = slot.index.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kSlotWords; ++i)
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != before || index != n + 1)
+        return false;
+
+    memcpy(frame, words, sizeof(Frame));
+    return true;
+}
+
+
+bool EncoderTelemetry::DumpToFile(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "time_ms,rtp_timestamp,layer,type,qp,size_bytes,encode_ms,queue_ms,crf_avg\n");
+
+    static const char* kKindNames[] = {"delta", "key", "dropped"};
+    const uint64_t written = written_.load(std::memory_order_acquire);
+    const uint64_t first = std::max(written > kRingSize ? written - kRingSize : 0,
+                                    begin_.load(std::memory_order_relaxed));
+    for (uint64_t n = first; n < written; ++n)
+    {
+        Frame frame;
+        if (!ReadSlot(n, &frame))
+            continue;
+        fprintf(file, "%lld,%u,%u,%s,%u,%u,%u,%u,%.2f\n",
+                (long long)frame.timeMs, frame.rtpTimestamp, frame.layer,
+                kKindNames[std::min<int>(frame.kind, kDropped)], frame.qp, frame.sizeBytes,
+                frame.encodeMs, frame.queueMs, frame.crfAvg);
+    }
+
+    fclose(file);
+    return true;
+}
+
+
+void EncoderTelemetry::Reset()
+{
+    begin_.store(written_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    TakeHistograms();
+}
+
+
+template<size_t N, size_t M>
+static void AppendHistogram(std::string& out, const char* name,
+                            const std::array<int, N>& bounds, const std::array<uint64_t, M>& counts)
+{
+    char buf[32];
+    out += name;
+    for (size_t i = 0; i < M; ++i)
+    {
+        if (i < N)
+            snprintf(buf, sizeof(buf), " <=%d:%llu", bounds[i], (unsigned long long)counts[i]);
+        else
+            snprintf(buf, sizeof(buf), " >%d:%llu", bounds[N - 1], (unsigned long long)counts[i]);
+        out += buf;
+    }
+    out += "\n";
+}
+
+
+std::string EncoderTelemetry::Histograms::ToString() const
+{
+    std::string out;
+    AppendHistogram(out, "encode ms: ", kEncodeMsBounds, encodeMs);
+    AppendHistogram(out, "queue ms:  ", kQueueMsBounds, queueMs);
+    AppendHistogram(out, "size KB:   ", kSizeKbBounds, sizeKb);
+
+    char buf[32];
+    out += "qp:        ";
+    for (int i = 0; i < kQpBuckets; ++i)
+    {
+        snprintf(buf, sizeof(buf), " %d-%d:%llu", i * kQpBucketWidth, i * kQpBucketWidth + kQpBucketWidth - 1,
+                 (unsigned long long)qp[i]);
+        out += buf;
+    }
+    return out;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef ENCODER_TELEMETRY_H_
+#define ENCODER_TELEMETRY_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+/// Always-on per-frame encoder telemetry.
+///
+/// Record() is called once per encoded (or dropped) layer frame by whichever
+/// thread ran x264 for it; simulcast layer threads and every X264Encoder
+/// instance share one EncoderTelemetry. It stores the frame in a fixed ring of
+/// the last |kRingSize| frames and adds it to fixed-bucket histograms. Neither
+/// takes a lock.
+///
+/// TakeHistograms() returns and clears the histograms, e.g. once per stats
+/// interval; DumpToFile() writes the ring as CSV. Both may run on any thread.
+/// Reset() starts a new session: it clears the histograms and hides the frames
+/// recorded so far from DumpToFile().
+/// Writers claim ring slots with a shared counter, and each slot is guarded by
+/// a sequence number (seqlock) so a dump never reports a half-written frame; a
+/// slot being rewritten, or not yet holding the frame it was claimed for, is
+/// skipped.
+class EncoderTelemetry
+{
+public:
+    enum FrameKind : uint8_t
+    {
+        kDelta      = 0,
+        kKey        = 1,
+        kDropped    = 2,
+    };
+
+    struct Frame
+    {
+        int64_t     timeMs;         // rtc::TimeMillis() at delivery
+        uint32_t    rtpTimestamp;
+        uint32_t    sizeBytes;
+        float       crfAvg;
+        uint16_t    encodeMs;
+        uint16_t    queueMs;        // time spent in the async encode queue
+        uint8_t     layer;          // simulcast index
+        uint8_t     kind;           // FrameKind
+        uint8_t     qp;             // last slice QP, 0 if unknown
+    };
+
+    // Upper bucket bounds; the last bucket counts everything above the last bound.
+    static constexpr std::array<int, 10> kEncodeMsBounds    = {2, 5, 10, 15, 20, 25, 33, 50, 66, 100};
+    static constexpr std::array<int, 9>  kQueueMsBounds     = {0, 1, 2, 5, 10, 20, 33, 66, 100};
+    static constexpr std::array<int, 9>  kSizeKbBounds      = {1, 2, 5, 10, 20, 50, 100, 200, 500};
+    static constexpr int kQpBucketWidth = 4;
+    static constexpr int kQpBuckets     = 52 / kQpBucketWidth;
+
+    struct Histograms
+    {
+        std::array<uint64_t, kEncodeMsBounds.size() + 1>   encodeMs;
+        std::array<uint64_t, kQueueMsBounds.size() + 1>    queueMs;
+        std::array<uint64_t, kSizeKbBounds.size() + 1>     sizeKb;
+        std::array<uint64_t, kQpBuckets>                   qp;
+        uint64_t    keyFrames;
+        uint64_t    deltaFrames;
+        uint64_t    droppedFrames;
+        uint64_t    keyBytes;
+        uint64_t    deltaBytes;
+        uint64_t    maxEncodeMs;
+
+        /// One line per histogram, e.g. "encode ms  <=2:10 <=5:3 ... >100:0".
+        std::string ToString() const;
+    };
+
+    EncoderTelemetry();
+
+    EncoderTelemetry(const EncoderTelemetry&) = delete;
+    EncoderTelemetry& operator=(const EncoderTelemetry&) = delete;
+
+    /// Safe to call from several threads at once.
+    void Record(const Frame& frame);
+
+    Histograms TakeHistograms();
+    bool DumpToFile(const std::string& path) const;
+    void Reset();
+
+    static const size_t kRingSize = 1024;  // ~30 s at 30 fps
+
+private:
+    template<size_t N>
+    static size_t Bucket(const std::array<int, N>& bounds, int value);
+
+    // A Frame stored as relaxed atomic words, so a reader racing the writer
+    // sees stale or mixed words (caught by |seq|) rather than a data race.
+    static constexpr size_t kSlotWords = (sizeof(Frame) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    struct Slot
+    {
+        std::atomic<uint32_t>   seq{0};  // odd while being written
+        std::atomic<uint64_t>   index{0};  // 1 + number of the frame held, 0 if none
+        std::atomic<uint64_t>   words[kSlotWords];
+    };
+
+    bool ReadSlot(uint64_t n, Frame* frame) const;
+
+    Slot                    ring_[kRingSize];
+    std::atomic<uint64_t>   written_;  // frames claimed by Record()
+    std::atomic<uint64_t>   begin_;    // first frame of the session
+
+    std::array<std::atomic<uint64_t>, kEncodeMsBounds.size() + 1>   encodeMs_;
+    std::array<std::atomic<uint64_t>, kQueueMsBounds.size() + 1>    queueMs_;
+    std::array<std::atomic<uint64_t>, kSizeKbBounds.size() + 1>     sizeKb_;
+    std::array<std::atomic<uint64_t>, kQpBuckets>                   qp_;
+    std::atomic<uint64_t>   keyFrames_;
+    std::atomic<uint64_t>   deltaFrames_;
+    std::atomic<uint64_t>   droppedFrames_;
+    std::atomic<uint64_t>   keyBytes_;
+    std::atomic<uint64_t>   deltaBytes_;
+    std::atomic<uint64_t>   maxEncodeMs_;
+};
+
+#endif  // ENCODER_TELEMETRY_H_
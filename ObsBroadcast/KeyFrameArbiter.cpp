@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "KeyFrameArbiter.h"
+
+
+void KeyFrameArbiter::Reset(const Config& config)
+{
+    config_     = config;
+    pending_    = false;
+    hasIdr_     = false;
+    lastIdrMs_  = 0;
+}
+
+
+KeyFrameArbiter::Decision KeyFrameArbiter::OnRequest(int64_t nowMs)
+{
+    if (pending_)
+        return Decision::kMerged;
+
+    if (hasIdr_)
+    {
+        const int64_t sinceIdrMs = nowMs - lastIdrMs_;
+        if (sinceIdrMs < config_.coalesceWindowMs)
+            return Decision::kMerged;
+        if (sinceIdrMs < config_.minIdrSpacingMs)
+            return Decision::kIgnored;
+    }
+
+    pending_ = true;
+    return Decision::kHonored;
+}
+
+
+void KeyFrameArbiter::OnIdr(int64_t nowMs)
+{
+    pending_    = false;
+    hasIdr_     = true;
+    lastIdrMs_  = nowMs;
+}
+
+
+// static
+const char* KeyFrameArbiter::DecisionName(Decision decision)
+{
+    switch (decision)
+    {
+    case Decision::kHonored:    return "honored";
+    case Decision::kMerged:     return "merged";
+    case Decision::kIgnored:
+    default:                    return "ignored";
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef KEY_FRAME_ARBITER_H_
+#define KEY_FRAME_ARBITER_H_
+
+#include <cstdint>
+
+
+/// Decides which key frame requests (FIR/PLI) get an IDR.
+///
+/// WebRTC delivers both FIR and PLI as a key frame request on the next frame,
+/// and receivers repeat a request until they see a key frame. So a request:
+///  - arriving while an IDR is already pending, or within |coalesceWindowMs|
+///    of the last IDR, is merged: that IDR answers it (e.g. many viewers
+///    joining at once);
+///  - arriving later but within |minIdrSpacingMs| of the last IDR is ignored;
+///    if the receiver still needs one it will ask again;
+///  - otherwise is honored with an IDR.
+///
+/// Not thread safe; used by the thread that encodes the layer.
+class KeyFrameArbiter
+{
+public:
+    enum class Decision
+    {
+        kHonored,
+        kMerged,
+        kIgnored,
+    };
+
+    struct Config
+    {
+        int64_t coalesceWindowMs    = 500;
+        int64_t minIdrSpacingMs     = 2000;
+    };
+
+    KeyFrameArbiter() = default;
+
+    void Reset(const Config& config);
+
+    Decision OnRequest(int64_t nowMs);
+    /// An IDR was encoded, requested or not (GOP boundary, resume, resize).
+    void OnIdr(int64_t nowMs);
+
+    const Config& config() const { return config_; }
+
+    static const char* DecisionName(Decision decision);
+
+private:
+    Config  config_;
+    bool    pending_        = false;
+    bool    hasIdr_         = false;
+    int64_t lastIdrMs_      = 0;
+};
+
+#endif  // KEY_FRAME_ARBITER_H_
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ * Copyright (c) 2020 The WebRTC project authors. All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "NV12FramePool.h"
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define NV12POOL_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define NV12POOL_HAS_SSE2 0
+#endif
+
+using rtc::scoped_refptr;
+using webrtc::NV12Buffer;
+
+// Row alignment of pooled buffers; keeps every destination row on a cache line
+// so the streaming stores below never straddle one.
+static const int kRowAlignment = 64;
+
+
+/// Round |num| to a multiple of |multiple|.
+template<typename T>
+inline T roundUp(T num, T multiple)
+{
+    return ((num + multiple - 1) / multiple) * multiple;
+}
+
+
+/// Copy |rows| rows of |rowBytes| bytes with non-temporal stores. The frame is
+/// consumed later by another thread, so bypassing the cache avoids evicting the
+/// OBS working set for data this thread will never read again.
+static void StreamCopyPlane(uint8_t* dst, int dstStride, const uint8_t* src, int srcStride,
+                            int rowBytes, int rows)
+{
+#if NV12POOL_HAS_SSE2
+    const int simdBytes = rowBytes & ~63;
+    for (int y = 0; y < rows; ++y)
+    {
+        RTC_DCHECK_EQ(reinterpret_cast<uintptr_t>(dst) % kRowAlignment, 0);
+        for (int x = 0; x < simdBytes; x += 64)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 32));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 48));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + x), a);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + x + 16), b);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + x + 32), c);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + x + 48), d);
+        }
+        if (rowBytes > simdBytes)
+            memcpy(dst + simdBytes, src + simdBytes, rowBytes - simdBytes);
+        dst += dstStride;
+        src += srcStride;
+    }
+    // Make the streamed data visible before the buffer is handed to another thread.
+    _mm_sfence();
+#else
+    for (int y = 0; y < rows; ++y)
+    {
+        memcpy(dst, src, rowBytes);
+        dst += dstStride;
+        src += srcStride;
+    }
+#endif
+}
+
+
+NV12FramePool::NV12FramePool(size_t maxBuffers)
+    : maxBuffers_(maxBuffers)
+    , hits_(0)
+    , misses_(0)
+    , exhausted_(0)
+    , allocated_(0)
+{}
+
+
+scoped_refptr<NV12Buffer> NV12FramePool::CreateBuffer(int width, int height)
+{
+    RTC_DCHECK_GT(width, 0);
+    RTC_DCHECK_GT(height, 0);
+
+    const int strideY = roundUp(width, kRowAlignment);
+    const int strideUV = roundUp(width + width % 2, kRowAlignment);
+
+    // Discard buffers of a different size; the output resolution changed.
+    buffers_.remove_if([=](const scoped_refptr<PooledNV12Buffer>& buffer)
+    {
+        return buffer->HasOneRef()
+               && (buffer->width() != width || buffer->height() != height);
+    });
+    allocated_ = buffers_.size();
+
+    for (const auto& buffer : buffers_)
+    {
+        // If the buffer is in use, the ref count will be >= 2: one from the pool
+        // list and one from each frame still holding it.
+        if (buffer->HasOneRef() && buffer->width() == width && buffer->height() == height)
+        {
+            ++hits_;
+            return buffer;
+        }
+    }
+
+    if (buffers_.size() >= maxBuffers_)
+    {
+        ++exhausted_;
+        RTC_LOG(LS_VERBOSE) << "NV12FramePool exhausted, " << buffers_.size() << " buffers in use";
+        return nullptr;
+    }
+
+    ++misses_;
+    scoped_refptr<PooledNV12Buffer> buffer(new PooledNV12Buffer(width, height, strideY, strideUV));
+    buffers_.push_back(buffer);
+    allocated_ = buffers_.size();
+    return buffer;
+}
+
+
+scoped_refptr<NV12Buffer> NV12FramePool::CopyFrame(const uint8_t* dataY, int strideY,
+                                                   const uint8_t* dataUV, int strideUV,
+                                                   int width, int height)
+{
+    RTC_CHECK(dataY != nullptr);
+    RTC_CHECK(dataUV != nullptr);
+
+    auto buffer = CreateBuffer(width, height);
+    if (!buffer)
+        return nullptr;
+
+    StreamCopyPlane(buffer->MutableDataY(), buffer->StrideY(), dataY, strideY,
+                    width, height);
+    StreamCopyPlane(buffer->MutableDataUV(), buffer->StrideUV(), dataUV, strideUV,
+                    width + width % 2, (height + 1) / 2);
+    return buffer;
+}
+
+
+void NV12FramePool::Release()
+{
+    buffers_.remove_if([](const scoped_refptr<PooledNV12Buffer>& buffer) { return buffer->HasOneRef(); });
+    allocated_ = buffers_.size();
+}
+
+
+NV12FramePool::Stats NV12FramePool::GetStats() const
+{
+    Stats stats;
+    stats.hits      = hits_.load(std::memory_order_relaxed);
+    stats.misses    = misses_.load(std::memory_order_relaxed);
+    stats.exhausted = exhausted_.load(std::memory_order_relaxed);
+    stats.allocated = allocated_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ * Copyright (c) 2020 The WebRTC project authors. All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef NV12_FRAME_POOL_H_
+#define NV12_FRAME_POOL_H_
+
+#include "api/scoped_refptr.h"
+#include "api/video/nv12_buffer.h"
+#include "rtc_base/ref_counted_object.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+
+
+/// Pool of owned, 64-byte aligned NV12 buffers.
+///
+/// OBS only guarantees its |video_data| planes for the duration of the raw_video
+/// callback, while WebRTC sinks (the encoder in particular) consume frames
+/// asynchronously. CopyFrame() copies the OBS planes into a recycled buffer so
+/// the frame owns its pixels. A buffer is free again once every scoped_refptr
+/// handed out for it has been dropped (only the pool's own reference remains).
+///
+/// Not thread safe: CreateBuffer()/CopyFrame() must be called from one thread
+/// (the OBS video thread). Buffers may be released on any thread.
+class NV12FramePool
+{
+public:
+    struct Stats
+    {
+        uint64_t hits;          // frames served from a recycled buffer
+        uint64_t misses;        // frames that required a new allocation
+        uint64_t exhausted;     // frames dropped because all |maxBuffers| were in use
+        size_t   allocated;     // buffers currently owned by the pool
+    };
+
+    explicit NV12FramePool(size_t maxBuffers = kDefaultMaxBuffers);
+    ~NV12FramePool() = default;
+
+    NV12FramePool(const NV12FramePool&) = delete;
+    NV12FramePool& operator=(const NV12FramePool&) = delete;
+
+    /// Returns a free |width| x |height| buffer, or nullptr if the pool is exhausted.
+    rtc::scoped_refptr<webrtc::NV12Buffer> CreateBuffer(int width, int height);
+
+    /// Copies the given NV12 planes into a pooled buffer using non-temporal stores.
+    rtc::scoped_refptr<webrtc::NV12Buffer> CopyFrame(const uint8_t* dataY, int strideY,
+                                                     const uint8_t* dataUV, int strideUV,
+                                                     int width, int height);
+
+    /// Drops all buffers not currently referenced by a frame.
+    void Release();
+
+    Stats GetStats() const;
+
+    static const size_t kDefaultMaxBuffers = 8;
+
+private:
+    using PooledNV12Buffer = rtc::RefCountedObject<webrtc::NV12Buffer>;
+
+    std::list<rtc::scoped_refptr<PooledNV12Buffer>> buffers_;
+    const size_t maxBuffers_;
+
+    // Written on the OBS video thread, read by the stats logger.
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> exhausted_;
+    std::atomic<size_t>   allocated_;
+};
+
+#endif  // NV12_FRAME_POOL_H_
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "PresetController.h"
+
+#include <cstring>
+
+// Slowest (best quality) first. The encoder opens at "veryfast"; "faster" is
+// only reached when encodes leave plenty of headroom.
+//
+// An open encoder keeps its entropy coder and x264_encoder_reconfig() never
+// moves subme to or from 0, so the bottom rung is ultrafast's analysis with
+// subme 1 and the CABAC setting the stream was opened with, not ultrafast.
+// With subme 0 the higher rungs could never get their subpel search back.
+static const PresetLevel kLadder[] = {
+    {"faster",      0, 0},
+    {"veryfast",    0, 0},
+    {"veryfast",    1, 1},  // veryfast with the cheapest subpel search
+    {"superfast",   0, 0},
+    {"ultrafast",   1, 1},
+};
+static const size_t kLadderSize = sizeof(kLadder) / sizeof(kLadder[0]);
+
+static const double kOverloadRatio  = 0.85;
+static const double kUnderloadRatio = 0.50;
+static const int    kRaiseWindows   = 3;
+static const int    kHoldWindows    = 2;
+
+
+PresetController::PresetController()
+    : enabled_(false)
+    , level_(1)
+    , fps_(30)
+    , windowSumMs_(0)
+    , windowFrames_(0)
+    , slackWindows_(0)
+    , holdWindows_(0)
+{}
+
+
+// static
+const PresetLevel* PresetController::Ladder(size_t* size)
+{
+    *size = kLadderSize;
+    return kLadder;
+}
+
+
+bool PresetController::Reset(const std::string& preset, uint32_t fps)
+{
+    enabled_ = false;
+    for (size_t i = 0; i < kLadderSize; ++i)
+    {
+        if (preset == kLadder[i].preset && kLadder[i].subme == 0)
+        {
+            enabled_ = true;
+            level_ = i;
+            break;
+        }
+    }
+
+    SetFps(fps);
+    windowSumMs_ = 0;
+    windowFrames_ = 0;
+    slackWindows_ = 0;
+    holdWindows_ = 0;
+    return enabled_;
+}
+
+
+void PresetController::SetFps(uint32_t fps)
+{
+    fps_ = fps > 0 ? fps : 30;
+}
+
+
+const PresetLevel& PresetController::current() const
+{
+    return kLadder[level_];
+}
+
+
+bool PresetController::OnFrameEncoded(int64_t encodeMs)
+{
+    if (!enabled_)
+        return false;
+
+    windowSumMs_ += encodeMs;
+    if (++windowFrames_ < fps_)
+        return false;
+
+    const double avgMs = (double)windowSumMs_ / windowFrames_;
+    const double budgetMs = 1000.0 / fps_;
+    windowSumMs_ = 0;
+    windowFrames_ = 0;
+
+    if (holdWindows_ > 0)
+    {
+        --holdWindows_;
+        return false;
+    }
+
+    if (avgMs > budgetMs * kOverloadRatio)
+    {
+        slackWindows_ = 0;
+        if (level_ + 1 < kLadderSize)
+        {
+            ++level_;
+            holdWindows_ = kHoldWindows;
+            return true;
+        }
+        return false;
+    }
+
+    if (avgMs < budgetMs * kUnderloadRatio)
+    {
+        // Slower levels may step past the preset the encoder was opened with;
+        // ReconfigurePreset() caps their reference frames at what it allocated.
+        if (++slackWindows_ >= kRaiseWindows && level_ > 0)
+        {
+            --level_;
+            slackWindows_ = 0;
+            holdWindows_ = kHoldWindows;
+            return true;
+        }
+        return false;
+    }
+
+    slackWindows_ = 0;
+    return false;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef PRESET_CONTROLLER_H_
+#define PRESET_CONTROLLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+/// One step of the x264 speed ladder. |subme| / |ref| of 0 keep the preset's value.
+struct PresetLevel
+{
+    const char* preset;
+    int         subme;
+    int         ref;
+};
+
+
+/// Chooses an x264 speed level from measured encode times.
+///
+/// Encode times are averaged over windows of one second of frames and compared
+/// against the frame budget (1000 / fps ms). A window averaging above
+/// |kOverloadRatio| of the budget steps one level faster; |kRaiseWindows|
+/// consecutive windows below |kUnderloadRatio| step one level slower. After any
+/// change the next |kHoldWindows| windows are ignored so the new level can settle.
+class PresetController
+{
+public:
+    PresetController();
+
+    /// Starts at the ladder level for |preset|; returns false, disabling the
+    /// controller, if |preset| is not on the ladder.
+    bool Reset(const std::string& preset, uint32_t fps);
+    void SetFps(uint32_t fps);
+
+    /// Feeds one frame's encode time. Returns true when level() changed.
+    bool OnFrameEncoded(int64_t encodeMs);
+
+    bool enabled() const { return enabled_; }
+    size_t level() const { return level_; }
+    const PresetLevel& current() const;
+
+    static const PresetLevel* Ladder(size_t* size);
+
+private:
+    bool        enabled_;
+    size_t      level_;
+    uint32_t    fps_;
+
+    int64_t     windowSumMs_;
+    uint32_t    windowFrames_;
+    int         slackWindows_;
+    int         holdWindows_;
+};
+
+#endif  // PRESET_CONTROLLER_H_
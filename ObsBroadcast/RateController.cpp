@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "RateController.h"
+
+#include <algorithm>
+
+using webrtc::MutexLock;
+
+static const float   kHighLossRate          = 0.10f;
+static const float   kLowLossRate           = 0.02f;
+// Loss rate assumed for a loss notification (undecodable frame).
+static const float   kUndecodableLossRate   = 0.10f;
+static const float   kLossSmoothing         = 0.3f;   // weight of a new loss sample
+static const double  kRttSmoothing          = 0.125;  // weight of a new RTT sample (RFC 6298)
+static const double  kRttBackoffFactor      = 0.85;
+static const int64_t kRttRiseMinMs          = 50;
+static const int64_t kMinBackoffIntervalMs  = 300;
+static const int64_t kRampDelayMs           = 1000;
+static const double  kRampPerSec            = 0.05;
+// The RTT baseline is re-taken periodically so a route change can't pin it.
+static const int64_t kMinRttWindowMs        = 10000;
+
+
+RateController::RateController()
+{
+    Reset();
+}
+
+
+void RateController::Reset()
+{
+    MutexLock lock(&mutex_);
+    scale_          = 1.0;
+    lossRate_       = 0.0f;
+    rttMs_          = 0;
+    minRttMs_       = 0;
+    minRttResetMs_  = 0;
+    lastBackoffMs_  = 0;
+    lastUpdateMs_   = 0;
+    backoffs_       = 0;
+    state_          = State::kHold;
+}
+
+
+void RateController::OnPacketLoss(float lossRate, int64_t nowMs)
+{
+    MutexLock lock(&mutex_);
+    lossRate_ += kLossSmoothing * (std::min(std::max(lossRate, 0.0f), 1.0f) - lossRate_);
+}
+
+
+void RateController::OnRtt(int64_t rttMs, int64_t nowMs)
+{
+    if (rttMs <= 0)
+        return;
+
+    MutexLock lock(&mutex_);
+    rttMs_ = rttMs_ == 0 ? rttMs : (int64_t)(rttMs_ + kRttSmoothing * (rttMs - rttMs_));
+
+    if (minRttMs_ == 0 || rttMs < minRttMs_ || nowMs - minRttResetMs_ > kMinRttWindowMs)
+    {
+        minRttMs_ = rttMs;
+        minRttResetMs_ = nowMs;
+    }
+}
+
+
+void RateController::OnUndecodable(int64_t nowMs)
+{
+    MutexLock lock(&mutex_);
+    lossRate_ = std::max(lossRate_, kUndecodableLossRate + 0.01f);
+}
+
+
+bool RateController::RttRising() const
+{
+    if (minRttMs_ == 0)
+        return false;
+    return rttMs_ > minRttMs_ + std::max(kRttRiseMinMs, minRttMs_ / 2);
+}
+
+
+double RateController::Update(int64_t nowMs)
+{
+    MutexLock lock(&mutex_);
+
+    const int64_t elapsedMs = lastUpdateMs_ ? nowMs - lastUpdateMs_ : 0;
+    lastUpdateMs_ = nowMs;
+
+    const bool highLoss = lossRate_ > kHighLossRate;
+    if (highLoss || RttRising())
+    {
+        state_ = State::kDecrease;
+        if (nowMs - lastBackoffMs_ >= std::max(kMinBackoffIntervalMs, rttMs_))
+        {
+            // Loss-based back-off in the style of GCC: the more loss, the larger the cut.
+            scale_ *= highLoss ? (1.0 - 0.5 * lossRate_) : kRttBackoffFactor;
+            scale_ = std::max(scale_, kMinScale);
+            lastBackoffMs_ = nowMs;
+            ++backoffs_;
+        }
+    }
+    else if (lossRate_ < kLowLossRate && scale_ < 1.0 && nowMs - lastBackoffMs_ >= kRampDelayMs)
+    {
+        state_ = State::kIncrease;
+        scale_ = std::min(1.0, scale_ + kRampPerSec * elapsedMs / 1000.0);
+    }
+    else
+    {
+        state_ = State::kHold;
+    }
+
+    return scale_;
+}
+
+
+RateController::Stats RateController::GetStats() const
+{
+    MutexLock lock(&mutex_);
+    Stats stats;
+    stats.scale     = scale_;
+    stats.lossRate  = lossRate_;
+    stats.rttMs     = rttMs_;
+    stats.minRttMs  = minRttMs_;
+    stats.backoffs  = backoffs_;
+    stats.state     = state_;
+    return stats;
+}
+
+
+// static
+const char* RateController::StateName(State state)
+{
+    switch (state)
+    {
+    case State::kDecrease:  return "decrease";
+    case State::kIncrease:  return "increase";
+    case State::kHold:
+    default:                return "hold";
+    }
+}
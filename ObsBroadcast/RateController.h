@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef RATE_CONTROLLER_H_
+#define RATE_CONTROLLER_H_
+
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread_annotations.h"
+
+#include <cstdint>
+
+
+/// Scales the SetRates() target down on congestion and back up when it clears.
+///
+/// Fed by the encoder's RTCP callbacks (packet loss, RTT, loss notifications).
+/// Update() returns a factor in [kMinScale, 1] applied to every layer's target:
+///  - loss above 10%, or RTT well above its recent minimum, multiplies the
+///    factor down at most once per max(RTT, 300 ms) (fast back-off);
+///  - loss below 2% with a flat RTT raises it linearly by 5% of the target
+///    per second, starting one second after the last back-off (slow ramp-up);
+///  - anything in between holds.
+///
+/// Thread safe: the RTCP callbacks and Update() may run on different threads.
+class RateController
+{
+public:
+    enum class State
+    {
+        kHold,
+        kDecrease,
+        kIncrease,
+    };
+
+    struct Stats
+    {
+        double      scale;          // factor applied to the SetRates() target
+        float       lossRate;       // smoothed packet loss, 0..1
+        int64_t     rttMs;          // smoothed RTT
+        int64_t     minRttMs;       // RTT baseline
+        uint64_t    backoffs;       // number of back-off steps taken
+        State       state;
+    };
+
+    RateController();
+
+    void Reset();
+
+    void OnPacketLoss(float lossRate, int64_t nowMs);
+    void OnRtt(int64_t rttMs, int64_t nowMs);
+    /// A receiver reported an undecodable frame; treated as a loss event.
+    void OnUndecodable(int64_t nowMs);
+
+    /// Advances the controller and returns the current scale factor.
+    double Update(int64_t nowMs);
+
+    Stats GetStats() const;
+
+    static const char* StateName(State state);
+
+    static constexpr double kMinScale = 0.3;
+
+private:
+    bool RttRising() const RTC_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+    mutable webrtc::Mutex mutex_;
+
+    double      scale_          RTC_GUARDED_BY(mutex_);
+    float       lossRate_       RTC_GUARDED_BY(mutex_);
+    int64_t     rttMs_          RTC_GUARDED_BY(mutex_);
+    int64_t     minRttMs_       RTC_GUARDED_BY(mutex_);
+    int64_t     minRttResetMs_  RTC_GUARDED_BY(mutex_);
+    int64_t     lastBackoffMs_  RTC_GUARDED_BY(mutex_);
+    int64_t     lastUpdateMs_   RTC_GUARDED_BY(mutex_);
+    uint64_t    backoffs_       RTC_GUARDED_BY(mutex_);
+    State       state_          RTC_GUARDED_BY(mutex_);
+};
+
+#endif  // RATE_CONTROLLER_H_
@@ -0,0 +1,664 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "SDPModel.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using std::string;
+using std::vector;
+
+static const char kMediaProto[] = "UDP/TLS/RTP/SAVPF";
+
+
+static bool StartsWith(const string& s, const char* prefix)
+{
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+
+static bool CaseInsEqual(const char* a, size_t aLen, const char* b, size_t bLen)
+{
+    if (aLen != bLen)
+        return false;
+    for (size_t i = 0; i < aLen; ++i)
+    {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+            return false;
+    }
+    return true;
+}
+
+
+static bool CaseInsEqual(const string& a, const string& b)
+{
+    return CaseInsEqual(a.data(), a.size(), b.data(), b.size());
+}
+
+
+/// Retransmission and FEC encodings, whose fmtp parameters describe the
+/// protected payload rather than a video format.
+static bool IsRepairCodec(const string& name)
+{
+    return CaseInsEqual(name, "rtx") || CaseInsEqual(name, "red") ||
+           CaseInsEqual(name, "ulpfec") || CaseInsEqual(name, "flexfec-03");
+}
+
+
+/// Parses "<payload> <value>" following an "a=xxx:" prefix of length |offset|.
+/// A '*' payload is returned as -1 if |allowWildcard|.
+static bool ParsePayloadLine(const string& line, size_t offset, bool allowWildcard,
+                             int* payload, string* value)
+{
+    size_t pos = offset;
+    if (allowWildcard && pos < line.size() && line[pos] == '*')
+    {
+        *payload = -1;
+        ++pos;
+    }
+    else
+    {
+        int pt = 0;
+        const size_t digits = pos;
+        while (pos < line.size() && isdigit((unsigned char)line[pos]))
+            pt = pt * 10 + (line[pos++] - '0');
+        if (pos == digits || pt > 127)
+            return false;
+        *payload = pt;
+    }
+
+    if (pos < line.size() && line[pos] != ' ' && line[pos] != '\t')
+        return false;
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t'))
+        ++pos;
+    value->assign(line, pos, string::npos);
+    return true;
+}
+
+
+static SDPModel::Line ParseLine(string&& line)
+{
+    SDPModel::Line out;
+    if (StartsWith(line, "b="))
+    {
+        const size_t colon = line.find(':', 2);
+        if (colon != string::npos)
+        {
+            out.type = SDPModel::Line::kBandwidth;
+            out.name.assign(line, 2, colon - 2);
+            out.value.assign(line, colon + 1, string::npos);
+            return out;
+        }
+    }
+    else if (StartsWith(line, "a=rtpmap:"))
+    {
+        if (ParsePayloadLine(line, 9, false, &out.payload, &out.value))
+        {
+            out.type = SDPModel::Line::kRtpmap;
+            out.name.assign(out.value, 0, out.value.find('/'));
+            return out;
+        }
+    }
+    else if (StartsWith(line, "a=fmtp:"))
+    {
+        if (ParsePayloadLine(line, 7, false, &out.payload, &out.value))
+        {
+            out.type = SDPModel::Line::kFmtp;
+            return out;
+        }
+    }
+    else if (StartsWith(line, "a=rtcp-fb:"))
+    {
+        if (ParsePayloadLine(line, 10, true, &out.payload, &out.value))
+        {
+            out.type = SDPModel::Line::kRtcpFb;
+            return out;
+        }
+    }
+
+    out.type = SDPModel::Line::kOther;
+    out.payload = -1;
+    out.name.clear();
+    out.value = std::move(line);
+    return out;
+}
+
+
+void SDPModel::Line::AppendTo(string& out) const
+{
+    switch (type)
+    {
+    case kBandwidth:
+        out += "b=";
+        out += name;
+        out += ':';
+        out += value;
+        return;
+    case kRtpmap:
+        out += "a=rtpmap:";
+        break;
+    case kFmtp:
+        out += "a=fmtp:";
+        break;
+    case kRtcpFb:
+        out += "a=rtcp-fb:";
+        break;
+    case kOther:
+    default:
+        out += value;
+        return;
+    }
+
+    if (payload < 0)
+        out += '*';
+    else
+        out += std::to_string(payload);
+    if (!value.empty())
+    {
+        out += ' ';
+        out += value;
+    }
+}
+
+
+void SDPModel::Parse(const string& sdp)
+{
+    session_.clear();
+    sections_.clear();
+    sizeHint_ = sdp.size();
+
+    size_t start = 0;
+    while (start < sdp.size())
+    {
+        size_t end = sdp.find('\n', start);
+        if (end == string::npos)
+            end = sdp.size();
+        size_t len = end - start;
+        if (len > 0 && sdp[start + len - 1] == '\r')
+            --len;
+
+        if (len > 0)
+        {
+            string line(sdp, start, len);
+            if (StartsWith(line, "m="))
+            {
+                // m=<media> <port> <proto> <fmt> ...
+                sections_.emplace_back();
+                MediaSection& section = sections_.back();
+                size_t pos = 2;
+                int field = 0;
+                while (pos < line.size())
+                {
+                    size_t next = line.find(' ', pos);
+                    if (next == string::npos)
+                        next = line.size();
+                    if (next > pos)
+                    {
+                        string token(line, pos, next - pos);
+                        switch (field++)
+                        {
+                        case 0:  section.media = std::move(token); break;
+                        case 1:  section.port = std::move(token); break;
+                        case 2:  section.proto = std::move(token); break;
+                        default: section.formats.push_back(std::move(token)); break;
+                        }
+                    }
+                    pos = next + 1;
+                }
+            }
+            else if (sections_.empty())
+            {
+                session_.push_back(ParseLine(std::move(line)));
+            }
+            else
+            {
+                sections_.back().lines.push_back(ParseLine(std::move(line)));
+            }
+        }
+        start = end + 1;
+    }
+}
+
+
+string SDPModel::ToString() const
+{
+    string out;
+    out.reserve(sizeHint_ + 256);
+
+    for (const auto& line : session_)
+    {
+        line.AppendTo(out);
+        out += "\r\n";
+    }
+    for (const auto& section : sections_)
+    {
+        out += "m=";
+        out += section.media;
+        out += ' ';
+        out += section.port;
+        out += ' ';
+        out += section.proto;
+        for (const auto& format : section.formats)
+        {
+            out += ' ';
+            out += format;
+        }
+        out += "\r\n";
+
+        for (const auto& line : section.lines)
+        {
+            line.AppendTo(out);
+            out += "\r\n";
+        }
+    }
+    return out;
+}
+
+
+SDPModel::MediaSection* SDPModel::FindSection(const string& media)
+{
+    for (auto& section : sections_)
+    {
+        if (section.media == media)
+            return &section;
+    }
+    return nullptr;
+}
+
+
+SDPModel::Line* SDPModel::MediaSection::FindRtpmap(const string& codec)
+{
+    for (auto& line : lines)
+    {
+        if (line.type == Line::kRtpmap && CaseInsEqual(line.name, codec))
+            return &line;
+    }
+    return nullptr;
+}
+
+
+SDPModel::Line* SDPModel::MediaSection::FindFmtp(int payload)
+{
+    for (auto& line : lines)
+    {
+        if (line.type == Line::kFmtp && line.payload == payload)
+            return &line;
+    }
+    return nullptr;
+}
+
+
+int SDPModel::MediaSection::FindRtx(int payload) const
+{
+    const string apt = std::to_string(payload);
+    string value;
+    for (const auto& line : lines)
+    {
+        if (line.type == Line::kFmtp && GetParam(line.value, "apt", &value) && value == apt)
+            return line.payload;
+    }
+    return -1;
+}
+
+
+void SDPModel::MediaSection::SetBandwidth(int bitrateKbps)
+{
+    const string kbps = std::to_string(bitrateKbps);
+    const std::pair<const char*, string> values[] = {
+        {"AS",   kbps},
+        {"CT",   kbps},
+        {"TIAS", std::to_string(bitrateKbps * 1000)},
+    };
+
+    // New lines follow the last b= line, or the c= line, or the m-line.
+    size_t insertAt = !lines.empty() && StartsWith(lines[0].value, "c=") ? 1 : 0;
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        if (lines[i].type == Line::kBandwidth)
+            insertAt = i + 1;
+    }
+
+    for (const auto& value : values)
+    {
+        auto it = std::find_if(lines.begin(), lines.end(), [&](const Line& line) {
+            return line.type == Line::kBandwidth && line.name == value.first;
+        });
+        if (it != lines.end())
+        {
+            it->value = value.second;
+            continue;
+        }
+
+        Line line;
+        line.type = Line::kBandwidth;
+        line.name = value.first;
+        line.value = value.second;
+        lines.insert(lines.begin() + insertAt++, std::move(line));
+    }
+}
+
+
+void SDPModel::MediaSection::SetAttribute(const string& prefix, const string& text)
+{
+    size_t insertAt = !lines.empty() && StartsWith(lines[0].value, "c=") ? 1 : 0;
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        if (lines[i].type == Line::kOther && StartsWith(lines[i].value, prefix.c_str()))
+        {
+            lines[i].value = text;
+            return;
+        }
+        if (lines[i].type == Line::kBandwidth)
+            insertAt = i + 1;
+    }
+
+    Line line;
+    line.value = text;
+    lines.insert(lines.begin() + insertAt, std::move(line));
+}
+
+
+void SDPModel::MediaSection::RemovePayload(int payload)
+{
+    lines.erase(std::remove_if(lines.begin(), lines.end(), [payload](const Line& line) {
+        return line.type != Line::kOther && line.type != Line::kBandwidth && line.payload == payload;
+    }), lines.end());
+}
+
+
+void SDPModel::FilterPayloads(MediaSection& section,
+                              vector<int>& payloadNumbers,
+                              const string& codec,
+                              int h264PacketizationMode,
+                              const string& h264ProfileLevelId,
+                              int vp9ProfileId)
+{
+    const bool all = codec.empty();
+    vector<int> keep;
+    string param;
+
+    for (const auto& line : section.lines)
+    {
+        if (line.type != Line::kRtpmap)
+            continue;
+        if (all)
+        {
+            keep.push_back(line.payload);
+            payloadNumbers.push_back(line.payload);
+            continue;
+        }
+        if (!CaseInsEqual(line.name, codec))
+            continue;
+
+        // Defaults per RFC 6184 and the VP9 RTP payload format.
+        const Line* fmtp = section.FindFmtp(line.payload);
+        if (fmtp && CaseInsEqual(codec, "h264"))
+        {
+            const int mode = GetParam(fmtp->value, "packetization-mode", &param) ? atoi(param.c_str()) : 0;
+            if (mode != h264PacketizationMode)
+                continue;
+            if (!GetParam(fmtp->value, "profile-level-id", &param))
+                param = "42000a";
+            if (!CaseInsEqual(param, h264ProfileLevelId))
+                continue;
+        }
+        else if (fmtp && CaseInsEqual(codec, "vp9"))
+        {
+            const int profile = GetParam(fmtp->value, "profile-id", &param) ? atoi(param.c_str()) : 0;
+            if (profile != vp9ProfileId)
+                continue;
+        }
+
+        keep.push_back(line.payload);
+        payloadNumbers.push_back(line.payload);
+        const int rtx = section.FindRtx(line.payload);
+        if (rtx >= 0)
+            keep.push_back(rtx);
+    }
+
+    // Drop everything else, then rewrite the m-line with what's left.
+    section.lines.erase(std::remove_if(section.lines.begin(), section.lines.end(), [&](const Line& line) {
+        return line.type != Line::kOther && line.type != Line::kBandwidth && line.payload >= 0
+               && std::find(keep.begin(), keep.end(), line.payload) == keep.end();
+    }), section.lines.end());
+
+    section.port = "9";
+    section.proto = kMediaProto;
+    section.formats.clear();
+    for (int payload : keep)
+        section.formats.push_back(std::to_string(payload));
+}
+
+
+void SDPModel::ForcePayload(vector<int>& audioPayloads,
+                            vector<int>& videoPayloads,
+                            const string& audioCodec,
+                            const string& videoCodec,
+                            int h264PacketizationMode,
+                            const string& h264ProfileLevelId,
+                            int vp9ProfileId)
+{
+    for (auto& section : sections_)
+    {
+        if (section.media == "audio")
+            FilterPayloads(section, audioPayloads, audioCodec, h264PacketizationMode, h264ProfileLevelId, vp9ProfileId);
+        else if (section.media == "video")
+            FilterPayloads(section, videoPayloads, videoCodec, h264PacketizationMode, h264ProfileLevelId, vp9ProfileId);
+    }
+}
+
+
+void SDPModel::ConstrainAudioBitrate(int bitrateKbps, bool addGoogleConstraints)
+{
+    const string kbps = std::to_string(bitrateKbps);
+    for (auto& section : sections_)
+    {
+        if (section.media != "audio")
+            continue;
+        const Line* rtpmap = section.FindRtpmap("opus");
+        if (!rtpmap)
+            continue;
+
+        const int payload = rtpmap->payload;
+        Line* fmtp = section.FindFmtp(payload);
+        if (!fmtp)
+        {
+            Line line;
+            line.type = Line::kFmtp;
+            line.payload = payload;
+            auto it = section.lines.begin() + (rtpmap - section.lines.data());
+            fmtp = &*section.lines.insert(it + 1, std::move(line));
+        }
+
+        SetParam(fmtp->value, "maxaveragebitrate", std::to_string(bitrateKbps * 1000));
+        if (addGoogleConstraints)
+        {
+            SetParam(fmtp->value, "x-google-min-bitrate", kbps);
+            SetParam(fmtp->value, "x-google-max-bitrate", kbps);
+        }
+    }
+}
+
+
+void SDPModel::ConstrainAudioBitrateAS(int bitrateKbps, bool addGoogleConstraints)
+{
+    for (auto& section : sections_)
+    {
+        if (section.media == "audio")
+            section.SetBandwidth(bitrateKbps);
+    }
+    ConstrainAudioBitrate(bitrateKbps, addGoogleConstraints);
+}
+
+
+void SDPModel::ConstrainVideoBitrate(int bitrateKbps, int framerate)
+{
+    for (auto& section : sections_)
+    {
+        if (section.media != "video")
+            continue;
+        section.SetBandwidth(bitrateKbps);
+        if (framerate > 0)
+            section.SetAttribute("a=framerate:", "a=framerate:" + std::to_string(framerate));
+    }
+
+    if (framerate > 0)
+        SetVideoMaxFramerate(framerate);
+}
+
+
+void SDPModel::SetVideoMaxFramerate(int framerate)
+{
+    const string fps = std::to_string(framerate);
+    for (auto& section : sections_)
+    {
+        if (section.media != "video")
+            continue;
+
+        std::vector<int> repairPayloads;
+        for (const auto& line : section.lines)
+        {
+            if (line.type == Line::kRtpmap && IsRepairCodec(line.name))
+                repairPayloads.push_back(line.payload);
+        }
+
+        for (auto& line : section.lines)
+        {
+            if (line.type != Line::kFmtp ||
+                std::find(repairPayloads.begin(), repairPayloads.end(), line.payload) != repairPayloads.end())
+                continue;
+            SetParam(line.value, "max-fr", fps);
+        }
+    }
+}
+
+
+void SDPModel::EnableStereo()
+{
+    for (auto& section : sections_)
+    {
+        if (section.media != "audio")
+            continue;
+        const Line* rtpmap = section.FindRtpmap("opus");
+        if (!rtpmap)
+            continue;
+
+        Line* fmtp = section.FindFmtp(rtpmap->payload);
+        if (!fmtp)
+        {
+            Line line;
+            line.type = Line::kFmtp;
+            line.payload = rtpmap->payload;
+            line.value = "minptime=10;useinbandfec=1";
+            auto it = section.lines.begin() + (rtpmap - section.lines.data());
+            fmtp = &*section.lines.insert(it + 1, std::move(line));
+        }
+
+        SetParam(fmtp->value, "stereo", "1");
+        SetParam(fmtp->value, "sprop-stereo", "1");
+        SetParam(fmtp->value, "maxplaybackrate", "48000");
+        SetParam(fmtp->value, "sprop-maxcapturerate", "48000");
+    }
+}
+
+
+void SDPModel::RemoveRtcpFb(const string& rtcpFbVal)
+{
+    for (auto& section : sections_)
+    {
+        section.lines.erase(std::remove_if(section.lines.begin(), section.lines.end(), [&](const Line& line) {
+            if (line.type != Line::kRtcpFb || line.value.size() < rtcpFbVal.size())
+                return false;
+            if (line.value.size() > rtcpFbVal.size() && line.value[rtcpFbVal.size()] != ' ')
+                return false;
+            return CaseInsEqual(line.value.data(), rtcpFbVal.size(), rtcpFbVal.data(), rtcpFbVal.size());
+        }), section.lines.end());
+    }
+}
+
+
+void SDPModel::RemoveLinesContaining(const string& str)
+{
+    string text;
+    auto contains = [&](const Line& line) {
+        if (line.type == Line::kOther)
+            return line.value.find(str) != string::npos;
+        text.clear();
+        line.AppendTo(text);
+        return text.find(str) != string::npos;
+    };
+
+    session_.erase(std::remove_if(session_.begin(), session_.end(), contains), session_.end());
+    for (auto& section : sections_)
+        section.lines.erase(std::remove_if(section.lines.begin(), section.lines.end(), contains), section.lines.end());
+}
+
+
+// static
+bool SDPModel::GetParam(const string& params, const string& key, string* value)
+{
+    size_t pos = 0;
+    while (pos < params.size())
+    {
+        size_t end = params.find(';', pos);
+        if (end == string::npos)
+            end = params.size();
+        while (pos < end && params[pos] == ' ')
+            ++pos;
+
+        const size_t eq = params.find('=', pos);
+        if (eq < end && CaseInsEqual(params.data() + pos, eq - pos, key.data(), key.size()))
+        {
+            value->assign(params, eq + 1, end - eq - 1);
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+
+// static
+void SDPModel::SetParam(string& params, const string& key, const string& value)
+{
+    size_t pos = 0;
+    while (pos < params.size())
+    {
+        size_t end = params.find(';', pos);
+        if (end == string::npos)
+            end = params.size();
+        while (pos < end && params[pos] == ' ')
+            ++pos;
+
+        const size_t eq = params.find('=', pos);
+        if (eq < end && CaseInsEqual(params.data() + pos, eq - pos, key.data(), key.size()))
+        {
+            params.replace(eq + 1, end - eq - 1, value);
+            return;
+        }
+        pos = end + 1;
+    }
+
+    if (!params.empty())
+        params += ';';
+    params += key;
+    params += '=';
+    params += value;
+}
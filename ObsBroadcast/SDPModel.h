@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#ifndef SDP_MODEL_H_
+#define SDP_MODEL_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/// Parsed SDP with typed media sections, built in one linear pass.
+///
+/// Lines keep their original order and are only re-serialized by ToString().
+/// The rtpmap, fmtp, rtcp-fb and b= lines are split into fields so the
+/// munging methods below can edit them without regexes or re-parsing. Every
+/// other line is kept verbatim.
+///
+/// The munging methods do what the SDPUtil functions of the same name do to
+/// an offer from libwebrtc, but apply to every audio or video section rather
+/// than the first one.
+class SDPModel
+{
+public:
+    struct Line
+    {
+        enum Type : uint8_t
+        {
+            kOther      = 0,    // |value| is the whole line
+            kBandwidth  = 1,    // b=<name>:<value>
+            kRtpmap     = 2,    // a=rtpmap:<payload> <value>, |name| is the encoding name
+            kFmtp       = 3,    // a=fmtp:<payload> <value>
+            kRtcpFb     = 4,    // a=rtcp-fb:<payload> <value>, payload -1 is '*'
+        };
+
+        Type        type = kOther;
+        int         payload = -1;
+        std::string name;
+        std::string value;
+
+        void AppendTo(std::string& out) const;
+    };
+
+    struct MediaSection
+    {
+        // m=<media> <port> <proto> <formats...>
+        std::string                 media;
+        std::string                 port;
+        std::string                 proto;
+        std::vector<std::string>    formats;
+        std::vector<Line>           lines;
+
+        /// Returns the first rtpmap line with encoding name |codec| (any case), or nullptr.
+        Line* FindRtpmap(const std::string& codec);
+        Line* FindFmtp(int payload);
+        /// Returns the rtx payload whose fmtp has apt=|payload|, or -1.
+        int FindRtx(int payload) const;
+
+        /// Sets b=AS, b=CT (kbps) and b=TIAS (bps), replacing existing ones.
+        /// New lines go after the section's c= line, as libwebrtc orders them.
+        void SetBandwidth(int bitrateKbps);
+        /// Replaces the first line starting with |prefix|, or inserts |line| after the b= lines.
+        void SetAttribute(const std::string& prefix, const std::string& line);
+        /// Removes the rtpmap, fmtp and rtcp-fb lines of |payload|.
+        void RemovePayload(int payload);
+    };
+
+    SDPModel() = default;
+    explicit SDPModel(const std::string& sdp) { Parse(sdp); }
+
+    void Parse(const std::string& sdp);
+    /// Serializes with CRLF line endings.
+    std::string ToString() const;
+
+    std::vector<Line>&          session() { return session_; }
+    std::vector<MediaSection>&  sections() { return sections_; }
+    MediaSection*               FindSection(const std::string& media);
+
+    /// Keeps only |audioCodec| and |videoCodec| (all payloads if empty) and
+    /// their rtx payloads, and rewrites the m-lines. H.264 payloads must also
+    /// match |h264PacketizationMode| and |h264ProfileLevelId|, VP9 payloads
+    /// |vp9ProfileId|; a payload without an fmtp line is kept. The kept
+    /// primary payload types are returned in |audioPayloads| and |videoPayloads|.
+    void ForcePayload(std::vector<int>& audioPayloads,
+                      std::vector<int>& videoPayloads,
+                      const std::string& audioCodec,
+                      const std::string& videoCodec,
+                      int h264PacketizationMode,
+                      const std::string& h264ProfileLevelId,
+                      int vp9ProfileId);
+
+    /// Sets Opus maxaveragebitrate (and optionally x-google-min/max-bitrate).
+    void ConstrainAudioBitrate(int bitrateKbps, bool addGoogleConstraints);
+    /// ConstrainAudioBitrate() plus b=AS/CT/TIAS on the audio sections.
+    void ConstrainAudioBitrateAS(int bitrateKbps, bool addGoogleConstraints);
+    /// Sets b=AS/CT/TIAS on the video sections. Also sets a=framerate and
+    /// max-fr (see SetVideoMaxFramerate) if |framerate| > 0.
+    void ConstrainVideoBitrate(int bitrateKbps, int framerate);
+    /// Sets max-fr=|framerate| on every video fmtp line except rtx/red/ulpfec ones.
+    void SetVideoMaxFramerate(int framerate);
+    /// Adds stereo=1;sprop-stereo=1 and 48 kHz capture/playback to the Opus fmtp.
+    void EnableStereo();
+
+    /// Removes rtcp-fb lines of the feedback type |rtcpFbVal|, e.g. "transport-cc".
+    void RemoveRtcpFb(const std::string& rtcpFbVal);
+    /// Removes all session and media lines (not m-lines) containing |str|.
+    void RemoveLinesContaining(const std::string& str);
+
+    /// Looks up |key| in a "k1=v1;k2=v2" fmtp parameter list.
+    static bool GetParam(const std::string& params, const std::string& key, std::string* value);
+    /// Replaces |key|'s value in |params|, or appends key=value.
+    static void SetParam(std::string& params, const std::string& key, const std::string& value);
+
+private:
+    void FilterPayloads(MediaSection& section,
+                        std::vector<int>& payloadNumbers,
+                        const std::string& codec,
+                        int h264PacketizationMode,
+                        const std::string& h264ProfileLevelId,
+                        int vp9ProfileId);
+
+    std::vector<Line>           session_;
+    std::vector<MediaSection>   sections_;
+    size_t                      sizeHint_ = 0;
+};
+
+#endif  // SDP_MODEL_H_
@@ -40,7 +40,7 @@ public:
         if (rtpmap == -1)
             return;
         std::smatch match;
-        std::regex re(opusRe, std::regex::flag_type::icase);
+        std::regex re(opusRe, std::regex::icase);
         if (!std::regex_search(sdpLines[rtpmap], match, re))
             return;
         std::string payloadNumber = match[1].str();
@@ -79,7 +79,7 @@ public:
         if (rtpmap == -1)
             return;
         std::smatch match;
-        std::regex re(opusRe, std::regex::flag_type::icase);
+        std::regex re(opusRe, std::regex::icase);
         if (!std::regex_search(sdpLines[rtpmap], match, re))
             return;
         std::string payloadNumber = match[1].str();
@@ -211,7 +211,7 @@ public:
         std::string maxAvgBitrate = std::to_string(bitrateKbps * 1000);
         std::smatch match;
         std::string opusRe = "a=rtpmap:(\\d+)\\s+opus";
-        std::regex re(opusRe, std::regex::flag_type::icase);
+        std::regex re(opusRe, std::regex::icase);
         int rtpmap = FindLineRegEx(sdpLines, opusRe);
         if (!std::regex_search(sdpLines[rtpmap], match, re))
             return;
@@ -225,7 +225,7 @@ public:
             {
                 std::smatch matchBitrate;
                 std::string regExStr = "(a=fmtp:\\d+\\s+\\S*)(?:maxaveragebitrate=\\d+)(\\S*)";
-                std::regex reBitrate(regExStr, std::regex::flag_type::icase);
+                std::regex reBitrate(regExStr, std::regex::icase);
                 // fmtp line contains maxaveragebitrate. Replace ftmp line with new constraint.
                 if (std::regex_search(sdpLines[i], matchBitrate, reBitrate))
                 {
@@ -284,7 +284,7 @@ public:
         std::string maxAvgBitrate = std::to_string(bitrateKbps * 1000);
         std::smatch match;
         std::string opusRe = "a=rtpmap:(\\d+)\\s+opus";
-        std::regex re(opusRe, std::regex::flag_type::icase);
+        std::regex re(opusRe, std::regex::icase);
         int rtpmap = FindLineRegEx(sdpLines, opusRe);
         if (!std::regex_search(sdpLines[rtpmap], match, re))
             return;
@@ -298,7 +298,7 @@ public:
             {
                 std::smatch matchBitrate;
                 std::string regExStr = "(a=fmtp:[0-9]+\\s+\\S*)(?:maxaveragebitrate=[0-9]+)(\\S*)";
-                std::regex reBitrate(regExStr, std::regex::flag_type::icase);
+                std::regex reBitrate(regExStr, std::regex::icase);
                 // fmtp line contains maxaveragebitrate. Replace ftmp line with new constraint.
                 if (std::regex_search(sdpLines[i], matchBitrate, reBitrate))
                 {
@@ -358,7 +358,8 @@ public:
     }
 
 
-    /// Sets video bitrate constraint (b=AS,CT,TIAS). Also adds a=framerate if |framerate| > 0.
+    /// Sets video bitrate constraint (b=AS,CT,TIAS). Also adds a=framerate and
+    /// max-fr (see SetVideoMaxFramerate) if |framerate| > 0.
     static void ConstrainVideoBitrate(std::string& sdp, int bitrateKbps, int framerate)
     {
         std::vector<std::string> sdpLines;
@@ -458,6 +459,51 @@ public:
             }
         }
         sdp = Join(sdpLines, "\r\n");
+
+        if (framerate > 0)
+            SetVideoMaxFramerate(sdp, framerate);
+    }
+
+
+    /// Sets max-fr=|framerate| on every video fmtp line, replacing an existing
+    /// max-fr. Receivers that honour it won't assume the 30 fps default.
+    /// rtx/red/ulpfec fmtp lines describe the protected payload and are skipped.
+    static void SetVideoMaxFramerate(std::string& sdp, int framerate)
+    {
+        std::vector<std::string> sdpLines;
+        Split(sdp, "\r\n", sdpLines);
+        int vLine = FindLine(sdpLines, "m=video ");
+        if (vLine < 0)
+            return;
+        int aLine = FindLine(sdpLines, "m=audio ");
+        int videoEnd = aLine > vLine ? aLine : (int)sdpLines.size();
+
+        std::vector<std::string> repairPayloads;
+        std::regex reRepair("a=rtpmap:(\\d+)\\s+(rtx|red|ulpfec|flexfec-03)/", std::regex::icase);
+        for (int i = vLine + 1; i < videoEnd; ++i)
+        {
+            std::smatch match;
+            if (std::regex_search(sdpLines[i], match, reRepair))
+                repairPayloads.push_back("a=fmtp:" + match[1].str() + " ");
+        }
+
+        const std::string maxFr = "max-fr=" + std::to_string(framerate);
+        std::regex reMaxFr("max-fr=[0-9]+", std::regex::icase);
+        for (int i = vLine + 1; i < videoEnd; ++i)
+        {
+            if (strncmp(sdpLines[i].c_str(), "a=fmtp:", 7) != 0)
+                continue;
+            bool repair = false;
+            for (const auto& prefix : repairPayloads)
+                repair = repair || sdpLines[i].compare(0, prefix.size(), prefix) == 0;
+            if (repair)
+                continue;
+            if (std::regex_search(sdpLines[i], reMaxFr))
+                sdpLines[i] = std::regex_replace(sdpLines[i], reMaxFr, maxFr);
+            else
+                sdpLines[i].append(";" + maxFr);
+        }
+        sdp = Join(sdpLines, "\r\n");
     }
 
 
@@ -578,7 +624,7 @@ public:
             std::smatch match;
             std::string regExStr =
                 "(a=fmtp:\\d+\\s\\S+)(?:x-google-[^-]+-bitrate=\\d+)(?:;\\s*x-google-[^-]+-bitrate=\\d+)*(\\S*)";
-            std::regex re(regExStr, std::regex::flag_type::icase);
+            std::regex re(regExStr, std::regex::icase);
             if (std::regex_search(sdpLines[testLine], match, re))
             {
                 std::string pre = match[1].str();
@@ -638,7 +684,7 @@ public:
             std::smatch match;
             std::string regExStr =
                 "(a=fmtp:\\d+\\s+\\S+)(?:x-google-[^-]+-bitrate=\\d+)(?:;\\s*x-google-[^-]+-bitrate=\\d+)*(\\S*)";
-            std::regex re(regExStr, std::regex::flag_type::icase);
+            std::regex re(regExStr, std::regex::icase);
             if (std::regex_search(sdpLines[testLine], match, re))
             {
                 std::string pre = match[1].str();
@@ -682,7 +728,7 @@ public:
     static bool IsProtocol(const std::string& candidate, const std::string& protocol)
     {
         std::smatch match;
-        std::regex re("candidate:(\\d+)\\s+(\\d+)\\s+(tcp|udp)", std::regex::flag_type::icase);
+        std::regex re("candidate:(\\d+)\\s+(\\d+)\\s+(tcp|udp)", std::regex::icase);
         if (std::regex_search(candidate, match, re))
             if (CaseInsStringCompare(match[3].str(), protocol))
                 return true;
@@ -695,7 +741,7 @@ public:
     {
         std::smatch match;
         std::string reStr = "\\s(tcp|udp)\\s+\\S+\\s((?:(?:25[0-5]|2[0-4]\\d|[01]?\\d{1,2})\\.){3}(?:25[0-5]|2[0-4]\\d|[01]?\\d{1,2}))\\s+(\\d+)\\s";
-        std::regex re(reStr, std::regex::flag_type::icase);
+        std::regex re(reStr, std::regex::icase);
         if (std::regex_search(candidate, match, re))
         {
             proto   = match[1].str();
@@ -864,7 +910,7 @@ public:
     /// Removes all lines matching the RegEx string |regExStr| from |sdpLines|.
     static void RemoveLinesMatching(std::vector<std::string>& sdpLines, const std::string& regExStr)
     {
-        const std::regex re(regExStr, std::regex::flag_type::icase);
+        const std::regex re(regExStr, std::regex::icase);
         RemoveLinesMatching(sdpLines, re);
     }
 
@@ -920,7 +966,7 @@ public:
         {
             std::smatch match;
             std::string payloadRe = "a=rtpmap:(\\d+)\\s+([a-z0-9-]+)";
-            std::regex re(payloadRe, std::regex::flag_type::icase);
+            std::regex re(payloadRe, std::regex::icase);
             if (std::regex_search(sdpLines[i], match, re))
             {
                 int payloadNumber = std::stoi(match[1].str());
@@ -977,7 +1023,7 @@ public:
             if (CaseInsStringCompare("h264", payloadCodec) && h264fmtpLine != -1)
             {
                 std::smatch match;
-                std::regex re(h264fmtpRegEx, std::regex::flag_type::icase);
+                std::regex re(h264fmtpRegEx, std::regex::icase);
                 if (std::regex_search(sdpLines[h264fmtpLine], match, re))
                 {
                     if (CaseInsStringCompare(h264_profile_level_id, match[2].str())
@@ -991,7 +1037,7 @@ public:
             else if (CaseInsStringCompare("vp9", payloadCodec) && vp9fmtpLine != -1)
             {
                 std::smatch match;
-                std::regex re(vp9fmtpRegEx, std::regex::flag_type::icase);
+                std::regex re(vp9fmtpRegEx, std::regex::icase);
                 if (std::regex_search(sdpLines[vp9fmtpLine], match, re))
                 {
                     if (vp9_profile_id == std::stoi(match[1].str()))
@@ -1012,7 +1058,7 @@ public:
         if (aptLine != -1)
         {
             std::smatch matchApt;
-            std::regex reApt("a=fmtp:(\\d+)\\s+apt", std::regex::flag_type::icase);
+            std::regex reApt("a=fmtp:(\\d+)\\s+apt", std::regex::icase);
             if (std::regex_search(sdpLines[aptLine], matchApt, reApt))
             {
                 rtxPayloadNumber = std::stoi(matchApt[1].str());
@@ -1126,7 +1172,7 @@ public:
     /// Returns the (first) line number matching the RegEx string |regExStr| or -1 if there are no matching lines.
     static int FindLineRegEx(const std::vector<std::string>& sdpLines, const std::string& regExStr)
     {
-        const std::regex re(regExStr, std::regex::flag_type::icase);
+        const std::regex re(regExStr, std::regex::icase);
         return FindLine(sdpLines, re);
     }
 
@@ -1134,7 +1180,7 @@ public:
     /// Returns the (first) line number matching the RegEx string |regExStr| or -1 if there are no matching lines.
     static int FindLineRegEx(const std::vector<std::string>& sdpLines, const char* regExStr)
     {
-        const std::regex re(regExStr, std::regex::flag_type::icase);
+        const std::regex re(regExStr, std::regex::icase);
         return FindLine(sdpLines, re);
     }
 
@@ -1180,7 +1226,7 @@ public:
     /// Returns the line numbers matching the RegEx string |regExStr| or -1 if there are no matching lines.
     static std::vector<int> FindLinesRegEx(const std::vector<std::string>& sdpLines, const std::string& regExStr)
     {
-        const std::regex re(regExStr, std::regex::flag_type::icase);
+        const std::regex re(regExStr, std::regex::icase);
         return FindLines(sdpLines, re);
     }
 
@@ -1188,7 +1234,7 @@ public:
     /// Returns the line numbers matching the RegEx string |regExStr| or -1 if there are no matching lines.
     static std::vector<int> FindLinesRegEx(const std::vector<std::string>& sdpLines, const char* regExStr)
     {
-        const std::regex re(regExStr, std::regex::flag_type::icase);
+        const std::regex re(regExStr, std::regex::icase);
         return FindLines(sdpLines, re);
     }
 
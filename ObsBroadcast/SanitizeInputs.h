@@ -19,6 +19,8 @@
 #ifndef SANITIZE_INPUTS_H_
 #define SANITIZE_INPUTS_H_
 
+#include <cstdint>
+
 
 /// Selects the optimal resolution & audio bitrate for a given video bitrate.
 class SanitizeInputs
@@ -62,6 +64,32 @@ public:
     }
 
 
+    /// Frame rates above this use the high frame rate bitrate rules.
+    static const int kHighFramerateThreshold = 30;
+
+
+    /// Bitrate needed at |framerate| for the quality the 30 fps rules give at
+    /// |kbps|. Motion between frames shrinks as the rate rises, so 60 fps takes
+    /// about 1.5x the bitrate of 30 fps rather than 2x.
+    static int HighFramerateKbps(int kbps, int framerate)
+    {
+        if (framerate <= kHighFramerateThreshold)
+            return kbps;
+        return kbps + kbps * (framerate - kHighFramerateThreshold) / (2 * kHighFramerateThreshold);
+    }
+
+
+    /// Set optimal frame |width| & |height| for given |videoBitrateKbps| at |framerate|.
+    static void OptimalFrameSize(int videoBitrateKbps, int framerate, int& width, int& height)
+    {
+        // Pick the size the same bitrate would get at 30 fps with the high
+        // frame rate surcharge taken off.
+        if (framerate > kHighFramerateThreshold)
+            videoBitrateKbps = videoBitrateKbps * 30 / HighFramerateKbps(30, framerate);
+        OptimalFrameSize(videoBitrateKbps, width, height);
+    }
+
+
     /// Set optimal frame |width| & |height| for given |videoBitrateKbps|.
     static void OptimalFrameSize(int videoBitrateKbps, int& width, int& height)
     {
@@ -126,6 +154,26 @@ public:
     }
 
 
+    /// Ensure |videoBitrateKbps| is ideal for frame |height| at |framerate|.
+    /// Above 30 fps the floor and cap of every size are raised by HighFramerateKbps().
+    static void ConstrainBitrateForFramerate(int height, int framerate, int &videoBitrateKbps)
+    {
+        if (framerate <= kHighFramerateThreshold)
+        {
+            ConstrainBitrate(height, videoBitrateKbps);
+            return;
+        }
+
+        // Constrain the 30 fps equivalent, then scale back up.
+        const int scale = HighFramerateKbps(1000, framerate);
+        const int equivalentKbps = (int)((int64_t)videoBitrateKbps * 1000 / scale);
+        int constrainedKbps = equivalentKbps;
+        ConstrainBitrate(height, constrainedKbps);
+        if (constrainedKbps != equivalentKbps)
+            videoBitrateKbps = (int)((int64_t)constrainedKbps * scale / 1000);
+    }
+
+
     /// Ensure |videoBitrateKbps| is ideal for frame |height|.
     static void ConstrainBitrate(int height, int &videoBitrateKbps)
     {
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "StartupTimeline.h"
+
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <cstdio>
+
+
+StartupTimeline::StartupTimeline()
+{
+    Reset();
+}
+
+
+void StartupTimeline::Reset()
+{
+    for (auto& mark : marks_)
+        mark.store(0, std::memory_order_relaxed);
+}
+
+
+void StartupTimeline::Mark(Phase phase)
+{
+    // rtc::TimeMillis() is monotonic and never 0 once the process is up.
+    int64_t unset = 0;
+    marks_[phase].compare_exchange_strong(unset, std::max<int64_t>(rtc::TimeMillis(), 1),
+                                          std::memory_order_relaxed);
+}
+
+
+bool StartupTimeline::IsMarked(Phase phase) const
+{
+    return marks_[phase].load(std::memory_order_relaxed) != 0;
+}
+
+
+int64_t StartupTimeline::Elapsed(Phase phase) const
+{
+    const int64_t start = marks_[kStart].load(std::memory_order_relaxed);
+    const int64_t mark = marks_[phase].load(std::memory_order_relaxed);
+    if (!start || !mark)
+        return -1;
+    return mark - start;
+}
+
+
+int64_t StartupTimeline::OverlapMs() const
+{
+    const int64_t connecting = Elapsed(kWsConnecting);
+    const int64_t built = Elapsed(kTracksAdded);
+    const int64_t authenticated = Elapsed(kWsAuthenticated);
+    if (connecting < 0 || built < 0 || authenticated < 0)
+        return -1;
+    return std::max<int64_t>(std::min(built, authenticated) - connecting, 0);
+}
+
+
+int64_t StartupTimeline::GatheringWaitMs() const
+{
+    const int64_t sent = Elapsed(kOfferSent);
+    const int64_t gathered = Elapsed(kIceGatheringComplete);
+    if (sent < 0 || gathered < 0)
+        return -1;
+    return std::max<int64_t>(gathered - sent, 0);
+}
+
+
+std::string StartupTimeline::ToString() const
+{
+    std::string out;
+    char buf[64];
+    for (int i = kStart + 1; i < kPhaseCount; ++i)
+    {
+        const int64_t elapsed = Elapsed((Phase)i);
+        if (elapsed < 0)
+            continue;
+        snprintf(buf, sizeof(buf), "%s%s +%lld", out.empty() ? "" : " | ", PhaseName((Phase)i),
+                 (long long)elapsed);
+        out += buf;
+    }
+    return out;
+}
+
+
+const char* StartupTimeline::PhaseName(Phase phase)
+{
+    switch (phase)
+    {
+    case kStart:                    return "start";
+    case kConfigured:               return "configured";
+    case kWsConnecting:             return "ws connecting";
+    case kPeerConnectionCreated:    return "pc created";
+    case kTracksAdded:              return "tracks added";
+    case kWsAuthenticated:          return "ws authenticated";
+    case kLocalDescriptionSet:      return "local sdp set";
+    case kOfferSent:                return "offer sent";
+    case kAnswerReceived:           return "answer received";
+    case kRemoteDescriptionSet:     return "remote sdp set";
+    case kReadyToBroadcast:         return "ready";
+    case kIceConnected:             return "ice connected";
+    case kFirstLocalCandidate:      return "first candidate";
+    case kIceGatheringComplete:     return "gathering done";
+    default:                        return "?";
+    }
+}
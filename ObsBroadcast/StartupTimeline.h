@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#ifndef STARTUP_TIMELINE_H_
+#define STARTUP_TIMELINE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+/// Timestamps of the stream startup phases, from Start() to go-live.
+///
+/// Phases are marked from whichever thread reaches them (OBS, websocket,
+/// signaling); Mark() and Elapsed() are lock-free. Only the first mark of a
+/// phase after Reset() counts.
+class StartupTimeline
+{
+public:
+    enum Phase
+    {
+        kStart,
+        kConfigured,            // stream parameters sanitized
+        kWsConnecting,          // websocket connect (DNS, TCP, TLS) started
+        kPeerConnectionCreated,
+        kTracksAdded,           // PeerConnection ready for an offer
+        kWsAuthenticated,       // handshake done, auth accepted
+        kLocalDescriptionSet,
+        kOfferSent,
+        kAnswerReceived,
+        kRemoteDescriptionSet,
+        kReadyToBroadcast,      // server accepted the stream, capture begins
+        kIceConnected,
+        kFirstLocalCandidate,   // first candidate from the local gatherer
+        kIceGatheringComplete,
+        kPhaseCount
+    };
+
+    StartupTimeline();
+
+    void Reset();
+    void Mark(Phase phase);
+
+    bool IsMarked(Phase phase) const;
+
+    /// Milliseconds from kStart to |phase|, -1 if either is not marked.
+    int64_t Elapsed(Phase phase) const;
+
+    /// Time the PeerConnection build and the websocket handshake overlapped,
+    /// i.e. what running them in sequence would have added to go-live.
+    int64_t OverlapMs() const;
+
+    /// Time from sending the offer to the end of ICE gathering, i.e. what
+    /// sending a complete (non-trickle) offer would have added to go-live.
+    int64_t GatheringWaitMs() const;
+
+    /// One line, e.g. "configured +2 | ws connecting +2 | pc created +31 ...".
+    std::string ToString() const;
+
+    static const char* PhaseName(Phase phase);
+
+private:
+    std::array<std::atomic<int64_t>, kPhaseCount> marks_;  // 0 = not marked
+};
+
+#endif  // STARTUP_TIMELINE_H_
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "StaticSceneDetector.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define STATIC_SCENE_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define STATIC_SCENE_HAS_SSE2 0
+#endif
+
+static const int64_t kNanosPerMs = 1000000;
+
+
+/// Sum of absolute differences of 16 bytes.
+static inline uint32_t Sad16(const uint8_t* a, const uint8_t* b)
+{
+#if STATIC_SCENE_HAS_SSE2
+    const __m128i sad = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)),
+                                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+    return (uint32_t)(_mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4));
+#else
+    uint32_t sad = 0;
+    for (int i = 0; i < 16; ++i)
+        sad += (uint32_t)std::abs(a[i] - b[i]);
+    return sad;
+#endif
+}
+
+
+/// Sum of absolute differences of the |n| (< 16) bytes of an edge block.
+static inline uint32_t SadN(const uint8_t* a, const uint8_t* b, int n)
+{
+    uint32_t sad = 0;
+    for (int i = 0; i < n; ++i)
+        sad += (uint32_t)std::abs(a[i] - b[i]);
+    return sad;
+}
+
+
+StaticSceneDetector::StaticSceneDetector()
+    : enabled_(false)
+    , meanDiffThreshold_(kMeanDiffThreshold)
+    , staticAfterMs_(kStaticAfterMs)
+    , staticFps_(kStaticFps)
+    , staticNanos_(0)
+    , staticPeriods_(0)
+    , skippedFrames_(0)
+    , isStatic_(false)
+{}
+
+
+void StaticSceneDetector::Configure(const Config& config)
+{
+    meanDiffThreshold_  = std::min(std::max(config.meanDiffThreshold, 1), 255);
+    staticAfterMs_      = std::max(config.staticAfterMs, 0);
+    staticFps_          = std::min(std::max(config.staticFps, 1), 30);
+    enabled_            = config.enabled;
+}
+
+
+bool StaticSceneDetector::Changed(const uint8_t* dataY, int strideY, int width, int height,
+                                  uint32_t meanDiffThreshold)
+{
+    const int rows = (height + kSampleRowStep - 1) / kSampleRowStep;
+    if (width != width_ || height != height_ || reference_.size() != (size_t)rows * width)
+        return true;
+
+    // Blocks are |kBlockSize| pixels square, of which every |kSampleRowStep|-th
+    // row is sampled. The last column and band may be narrower; their
+    // threshold scales with the pixels they cover.
+    const int rowsPerBlock = kBlockSize / kSampleRowStep;
+    const int fullBlocksX = width / kBlockSize;
+    const int edgeWidth = width % kBlockSize;
+    const int blocksX = fullBlocksX + (edgeWidth ? 1 : 0);
+
+    blockSad_.resize(blocksX);
+    for (int band = 0; band < rows; band += rowsPerBlock)
+    {
+        const int bandRows = std::min(rowsPerBlock, rows - band);
+        std::fill(blockSad_.begin(), blockSad_.end(), 0);
+        for (int r = band; r < band + bandRows; ++r)
+        {
+            const uint8_t* cur = dataY + (size_t)r * kSampleRowStep * strideY;
+            const uint8_t* ref = &reference_[(size_t)r * width];
+            for (int bx = 0; bx < fullBlocksX; ++bx)
+                blockSad_[bx] += Sad16(cur + bx * kBlockSize, ref + bx * kBlockSize);
+            if (edgeWidth)
+                blockSad_[fullBlocksX] += SadN(cur + fullBlocksX * kBlockSize, ref + fullBlocksX * kBlockSize, edgeWidth);
+        }
+        for (int bx = 0; bx < blocksX; ++bx)
+        {
+            const int blockWidth = bx < fullBlocksX ? kBlockSize : edgeWidth;
+            if (blockSad_[bx] > meanDiffThreshold * (uint32_t)(blockWidth * bandRows))
+                return true;
+        }
+    }
+    return false;
+}
+
+
+void StaticSceneDetector::SetReference(const uint8_t* dataY, int strideY, int width, int height)
+{
+    // Only a changed frame becomes the reference, so drift that stays below
+    // the threshold from frame to frame still adds up to a change.
+    const int rows = (height + kSampleRowStep - 1) / kSampleRowStep;
+    reference_.resize((size_t)rows * width);
+    for (int r = 0; r < rows; ++r)
+        memcpy(&reference_[(size_t)r * width], dataY + (size_t)r * kSampleRowStep * strideY, width);
+    width_ = width;
+    height_ = height;
+}
+
+
+bool StaticSceneDetector::KeepFrame(const uint8_t* dataY, int strideY, int width, int height, int64_t frameTimeNanos)
+{
+    const int64_t sinceLastNanos = frameTimeNanos - lastFrameNanos_;
+    lastFrameNanos_ = frameTimeNanos;
+    if (static_ && sinceLastNanos > 0)
+        staticNanos_ += (uint64_t)sinceLastNanos;
+
+    if (!enabled_)
+    {
+        // Start afresh if enabled again.
+        static_ = false;
+        isStatic_ = false;
+        width_ = 0;
+        height_ = 0;
+        return true;
+    }
+
+    if (Changed(dataY, strideY, width, height, (uint32_t)meanDiffThreshold_.load(std::memory_order_relaxed)))
+    {
+        static_ = false;
+        isStatic_ = false;
+        lastChangeNanos_ = frameTimeNanos;
+        lastKeptNanos_ = frameTimeNanos;
+        SetReference(dataY, strideY, width, height);
+        return true;
+    }
+
+    if (!static_)
+    {
+        if (frameTimeNanos - lastChangeNanos_ < staticAfterMs_.load(std::memory_order_relaxed) * kNanosPerMs)
+        {
+            lastKeptNanos_ = frameTimeNanos;
+            return true;
+        }
+        static_ = true;
+        isStatic_ = true;
+        ++staticPeriods_;
+    }
+
+    // Allow a quarter interval of jitter so 30 fps input divides evenly.
+    const int64_t intervalNanos = 1000 * kNanosPerMs / staticFps_.load(std::memory_order_relaxed);
+    if (frameTimeNanos - lastKeptNanos_ >= intervalNanos - intervalNanos / 4)
+    {
+        lastKeptNanos_ = frameTimeNanos;
+        return true;
+    }
+
+    ++skippedFrames_;
+    return false;
+}
+
+
+StaticSceneDetector::Stats StaticSceneDetector::GetStats() const
+{
+    Stats stats;
+    stats.staticMs      = staticNanos_.load(std::memory_order_relaxed) / kNanosPerMs;
+    stats.staticPeriods = staticPeriods_.load(std::memory_order_relaxed);
+    stats.skippedFrames = skippedFrames_.load(std::memory_order_relaxed);
+    stats.isStatic      = isStatic_.load(std::memory_order_relaxed);
+    return stats;
+}
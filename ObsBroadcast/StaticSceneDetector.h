@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef STATIC_SCENE_DETECTOR_H_
+#define STATIC_SCENE_DETECTOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+
+/// Detects static video and thins it out to a low frame rate.
+///
+/// Every |kSampleRowStep|-th luma row is compared with the last changed frame
+/// in 16 pixel wide blocks (SSE2 SAD where available), including the narrower
+/// blocks at the right and bottom edges; any block whose mean absolute
+/// difference exceeds the threshold counts as a change. After |staticAfterMs|
+/// without a change only |staticFps| frames per second are kept, so the encoder
+/// sees (and, through SetRates(), reconfigures to) a low frame rate and spends
+/// its bits on fewer, better frames. The first changed frame restores the full
+/// rate.
+///
+/// Off until Configure() enables it. KeepFrame() must be called from one
+/// thread (the OBS video thread); Configure() and GetStats() may be called
+/// from any thread.
+class StaticSceneDetector
+{
+public:
+    struct Stats
+    {
+        uint64_t    staticMs;       // total time spent in static mode
+        uint64_t    staticPeriods;  // times static mode was entered
+        uint64_t    skippedFrames;  // frames dropped while static
+        bool        isStatic;
+    };
+
+    static const int        kSampleRowStep      = 4;
+    static const int        kBlockSize          = 16;
+    // Defaults of Config.
+    static const int        kMeanDiffThreshold  = 4;
+    static const int        kStaticAfterMs      = 1000;
+    static const int        kStaticFps          = 5;
+
+    struct Config
+    {
+        bool    enabled             = false;
+        int     meanDiffThreshold   = kMeanDiffThreshold;   // per pixel, 1..255
+        int     staticAfterMs       = kStaticAfterMs;       // quiet time before thinning
+        int     staticFps           = kStaticFps;           // frame rate kept while static
+    };
+
+    StaticSceneDetector();
+
+    StaticSceneDetector(const StaticSceneDetector&) = delete;
+    StaticSceneDetector& operator=(const StaticSceneDetector&) = delete;
+
+    /// Takes effect from the next frame; out of range values are clamped.
+    void Configure(const Config& config);
+
+    /// Returns false if the frame should be dropped.
+    bool KeepFrame(const uint8_t* dataY, int strideY, int width, int height, int64_t frameTimeNanos);
+
+    Stats GetStats() const;
+
+private:
+    /// Returns true if the sampled rows of |dataY| differ from |reference_|.
+    bool Changed(const uint8_t* dataY, int strideY, int width, int height, uint32_t meanDiffThreshold);
+    void SetReference(const uint8_t* dataY, int strideY, int width, int height);
+
+    std::vector<uint8_t>    reference_;     // sampled rows of the last changed frame
+    std::vector<uint32_t>   blockSad_;
+    int     width_          = 0;
+    int     height_         = 0;
+
+    std::atomic<bool>   enabled_;
+    std::atomic<int>    meanDiffThreshold_;
+    std::atomic<int>    staticAfterMs_;
+    std::atomic<int>    staticFps_;
+
+    bool    static_         = false;
+    int64_t lastFrameNanos_     = 0;
+    int64_t lastChangeNanos_    = 0;
+    int64_t lastKeptNanos_      = 0;
+
+    std::atomic<uint64_t>   staticNanos_;
+    std::atomic<uint64_t>   staticPeriods_;
+    std::atomic<uint64_t>   skippedFrames_;
+    std::atomic<bool>       isStatic_;
+};
+
+#endif  // STATIC_SCENE_DETECTOR_H_
@@ -16,7 +16,6 @@
  */
 
 #include "VideoTrackSource.h"
-#include "NV12Buf.h"
 
 #include "absl/algorithm/container.h"
 #include "api/video/color_space.h"
@@ -42,7 +41,7 @@ using rtc::RefCountedObject;
 
 static const int MAX_WIDTH = 1920;
 static const int MAX_HEIGHT = 1020;
-static const int MAX_FPS = 30;
+static const int MAX_FPS = 60;
 static const int REQUIRED_ALIGNMENT = 2;
 
 
@@ -65,32 +64,57 @@ scoped_refptr<VideoTrackSource> VideoTrackSource::Create()
 }
 
 
-bool VideoTrackSource::KeepFrame(int64_t frameTimeNanos)
+void VideoTrackSource::SetMaxFramerate(int fps)
 {
-    MutexLock lock(&next_frame_mutex_);
+    fps = std::min(std::max(fps, 1), MAX_FPS);
+    if (maxFps_.exchange(fps) == fps)
+        return;
+
+    frameIntervalNanos_ = rtc::kNumNanosecsPerSec / fps;
+    nextFrameTimeNanos_ = kNoFrameTime;  // re-anchor on the next frame
+    RTC_LOG(INFO) << __FUNCTION__ << ": " << fps;
+
+    MutexLock lock(&sinks_and_wants_mutex_);
+    UpdateWants();
+}
+
 
-    constexpr int64_t FRAME_INTERVAL_NANOS = rtc::kNumNanosecsPerSec / MAX_FPS;
+bool VideoTrackSource::KeepFrame(int64_t frameTimeNanos)
+{
+    // Called for every OBS frame, so this is lock-free: one compare-exchange
+    // on the next output time. A lost race means another caller just moved
+    // the target, so re-evaluate against the new one.
+    const int64_t interval = frameIntervalNanos_.load(std::memory_order_relaxed);
+    int64_t next = nextFrameTimeNanos_.load(std::memory_order_relaxed);
 
-    if (nextFrameTimeNanos_)
+    for (;;)
     {
-        // Time until next frame should be outputted.
-        const int64_t timeUntilNextFrameNanos = (*nextFrameTimeNanos_ - frameTimeNanos);
-        // Continue if timestamp is within expected range.
-        if (abs(timeUntilNextFrameNanos) < 2 * FRAME_INTERVAL_NANOS)
+        int64_t newNext;
+        if (next != kNoFrameTime && std::abs(next - frameTimeNanos) < 2 * interval)
         {
+            // Time until next frame should be outputted.
+            const int64_t timeUntilNextFrameNanos = next - frameTimeNanos;
             // Drop if a frame shouldn't be outputted yet.
             if (timeUntilNextFrameNanos > 0)
                 return false;
-            // Time to output new frame.
-            *nextFrameTimeNanos_ += FRAME_INTERVAL_NANOS;
+            // Time to output new frame. If the source stalled for more than an
+            // interval, re-anchor instead of letting the target catch up with
+            // a burst of frames.
+            newNext = timeUntilNextFrameNanos < -interval
+                    ? frameTimeNanos + interval / 2
+                    : next + interval;
         }
-        return true;
+        else
+        {
+            // First timestamp received or timestamp is way outside expected range, so
+            // reset. Set first timestamp target to just half the interval to prefer
+            // keeping frames in case of jitter.
+            newNext = frameTimeNanos + interval / 2;
+        }
+
+        if (nextFrameTimeNanos_.compare_exchange_weak(next, newNext, std::memory_order_relaxed))
+            return true;
     }
-    // First timestamp received or timestamp is way outside expected range, so
-    // reset. Set first timestamp target to just half the interval to prefer
-    // keeping frames in case of jitter.
-    nextFrameTimeNanos_ = frameTimeNanos + FRAME_INTERVAL_NANOS / 2;
-    return true;
 }
 
 
@@ -103,7 +127,17 @@ void VideoTrackSource::onIncomingData(const uint8_t* dataY, uint32_t strideY,
     if (!KeepFrame(frameTimeNanos))
         return;
 
-    auto buffer = NV12Buf::Create(dataY, strideY, dataUV, strideUV, width, height);
+    if (!staticScene_.KeepFrame(dataY, (int)strideY, width, height, frameTimeNanos))
+        return;
+
+    // The OBS planes are only valid for the duration of this callback, so copy
+    // them into a pooled buffer that the frame owns.
+    auto buffer = framePool_.CopyFrame(dataY, (int)strideY, dataUV, (int)strideUV, width, height);
+    if (!buffer)
+    {
+        OnDiscardedFrame();
+        return;
+    }
 
     auto frameTimeMicros = frameTimeNanos / rtc::kNumNanosecsPerMicrosec;
     auto timestampRtp = static_cast<uint32_t>(frameTimeMicros * 90 / rtc::kNumMicrosecsPerMillisec);
@@ -147,8 +181,8 @@ void VideoTrackSource::AddOrUpdateSink(VideoSinkInterface<VideoFrame>* sink, con
     auto copy = VideoSinkWants(wants);
     if (wants.resolution_alignment < REQUIRED_ALIGNMENT)
         copy.resolution_alignment = REQUIRED_ALIGNMENT;
-    if (wants.max_framerate_fps > MAX_FPS)
-        copy.max_framerate_fps = MAX_FPS;
+    if (wants.max_framerate_fps > maxFps_)
+        copy.max_framerate_fps = maxFps_;
     if (wants.max_pixel_count > MAX_WIDTH * MAX_HEIGHT)
         copy.max_pixel_count = MAX_WIDTH * MAX_HEIGHT;
 
@@ -260,7 +294,7 @@ VideoTrackSource::SinkPair* VideoTrackSource::FindSinkPair(const VideoSinkInterf
 void VideoTrackSource::UpdateWants()
 {
     VideoSinkWants wants;
-    wants.max_framerate_fps = MAX_FPS;
+    wants.max_framerate_fps = maxFps_;
     wants.max_pixel_count = MAX_WIDTH * MAX_HEIGHT;
     wants.rotation_applied = false;
     wants.resolution_alignment = REQUIRED_ALIGNMENT;
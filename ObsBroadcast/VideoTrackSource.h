@@ -22,6 +22,9 @@
 
 #include <webrtc_version.h>
 
+#include "NV12FramePool.h"
+#include "StaticSceneDetector.h"
+
 #include "absl/types/optional.h"
 #include "api/media_stream_interface.h"
 #include "api/notifier.h"
@@ -33,6 +36,11 @@
 #include "common_video/libyuv/include/webrtc_libyuv.h"
 #include "rtc_base/synchronization/mutex.h"
 #include "rtc_base/thread_annotations.h"
+#include "rtc_base/time_utils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
 
 using absl::optional;
 using rtc::scoped_refptr;
@@ -62,6 +70,10 @@ public:
 
     static scoped_refptr<VideoTrackSource> Create();
 
+    /// Caps the frame rate sent downstream; frames above it are dropped by KeepFrame().
+    void SetMaxFramerate(int fps);
+    int maxFramerate() const { return maxFps_; }
+
     bool KeepFrame(int64_t frameTimeNanos);
     void onIncomingData(const uint8_t* dataY, uint32_t strideY,
                         const uint8_t* dataUV, uint32_t strideUV,
@@ -69,6 +81,11 @@ public:
                         int width, int height,
                         VideoRotation videoRotation, VideoType videoType);
 
+    NV12FramePool::Stats GetPoolStats() const { return framePool_.GetStats(); }
+    /// Drops most frames of a static scene when enabled; off by default.
+    void ConfigureStaticScene(const StaticSceneDetector::Config& config) { staticScene_.Configure(config); }
+    StaticSceneDetector::Stats GetStaticSceneStats() const { return staticScene_.GetStats(); }
+
     /// VideoTrackSourceInterface implementation.
     bool is_screencast() const override { return false; }
     optional<bool> needs_denoising() const override { return optional<bool>(false); }
@@ -112,13 +129,20 @@ protected:
     VideoSinkWants wants() const;
 
 private:
-    Mutex next_frame_mutex_;
     mutable Mutex sinks_and_wants_mutex_;
     Mutex stats_mutex_;
 
-    optional<int64_t> nextFrameTimeNanos_ RTC_GUARDED_BY(next_frame_mutex_);
+    static constexpr int64_t kNoFrameTime = std::numeric_limits<int64_t>::min();
+    std::atomic<int>     maxFps_{30};
+    std::atomic<int64_t> frameIntervalNanos_{rtc::kNumNanosecsPerSec / 30};
+    std::atomic<int64_t> nextFrameTimeNanos_{kNoFrameTime};
     optional<Stats> stats_ RTC_GUARDED_BY(stats_mutex_);
 
+    // Owns the pixels of every frame sent downstream; only used on the OBS video thread.
+    NV12FramePool framePool_;
+    // Frames only pass through it on the OBS video thread.
+    StaticSceneDetector staticScene_;
+
     scoped_refptr<VideoFrameBuffer> black_frame_buffer_;
     VideoSinkWants current_wants_ RTC_GUARDED_BY(sinks_and_wants_mutex_);
     bool previous_frame_sent_to_all_sinks_ RTC_GUARDED_BY(sinks_and_wants_mutex_) = true;
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "WarmPool.h"
+#include "EncoderFactory.h"
+#include "X264Encoder.h"
+
+#include "api/audio_codecs/builtin_audio_decoder_factory.h"
+#include "api/audio_codecs/builtin_audio_encoder_factory.h"
+#include "api/create_peerconnection_factory.h"
+#include "api/video_codecs/builtin_video_decoder_factory.h"
+#include "p2p/client/basic_port_allocator.h"
+#include "pc/ice_server_parsing.h"
+#include "rtc_base/location.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+using rtc::scoped_refptr;
+using rtc::Thread;
+using std::unique_ptr;
+using namespace webrtc;
+
+Mutex                   WarmPool::s_mutex;
+unique_ptr<WarmPool>    WarmPool::s_instance;
+
+// Pooled candidates older than this are dropped rather than offered: the
+// host may have changed networks since.
+static const int64_t    kCandidatePoolMaxAgeMs = 10 * 60 * 1000;
+// A pre-opened encoder holds x264's threads and frame buffers; one not taken
+// by then is closed, so an idle OBS doesn't keep them for good.
+static const int        kWarmEncoderMaxAgeMs = 5 * 60 * 1000;
+
+
+static unique_ptr<Thread> CreateNetwork()
+{
+    auto network = Thread::CreateWithSocketServer();
+    network->SetName("WebRTCStream_Network", nullptr);
+    network->Start();
+    return network;
+}
+
+
+static unique_ptr<Thread> CreateWorker()
+{
+    auto worker = Thread::Create();
+    worker->SetName("WebRTCStream_Worker", nullptr);
+    worker->Start();
+    return worker;
+}
+
+
+static unique_ptr<Thread> CreateSignaling()
+{
+    auto signaling = Thread::Create();
+    signaling->SetName("WebRTCStream_Signaling", nullptr);
+    signaling->Start();
+    return signaling;
+}
+
+
+static unique_ptr<Thread> CreatePrewarm()
+{
+    auto prewarm = Thread::Create();
+    prewarm->SetName("WebRTCStream_Prewarm", nullptr);
+    prewarm->Start();
+    return prewarm;
+}
+
+
+static scoped_refptr<ADMWrapper> CreateADM(Thread* worker)
+{
+    return worker->Invoke<scoped_refptr<ADMWrapper>>(
+        RTC_FROM_HERE, []() { return ADMWrapper::Create(); });
+}
+
+
+static scoped_refptr<PeerConnectionFactoryInterface> CreatePCFactory(Thread* network, Thread* worker,
+                                                                     Thread* signaling,
+                                                                     scoped_refptr<ADMWrapper> adm,
+                                                                     scoped_refptr<AudioProcessing> apm)
+{
+    return CreatePeerConnectionFactory(network, worker, signaling, adm, CreateBuiltinAudioEncoderFactory(),
+                                       CreateBuiltinAudioDecoderFactory(), CreateX264EncoderFactory(),
+                                       CreateBuiltinVideoDecoderFactory(), nullptr, apm, nullptr);
+}
+
+
+WarmPool::WarmPool()
+{
+    const int64_t startMs = rtc::TimeMillis();
+
+    network_    = CreateNetwork();
+    worker_     = CreateWorker();
+    signaling_  = CreateSignaling();
+    prewarm_    = CreatePrewarm();
+    adm_        = CreateADM(worker_.get());
+    apm_        = AudioProcessingBuilder().Create();
+    factory_    = CreatePCFactory(network_.get(), worker_.get(), signaling_.get(), adm_, apm_);
+
+    network_->Invoke<void>(RTC_FROM_HERE, [this]()
+    {
+        networkManager_ = std::make_unique<rtc::BasicNetworkManager>();
+        socketFactory_  = std::make_unique<rtc::BasicPacketSocketFactory>(network_.get());
+    });
+
+    RTC_LOG(LS_INFO) << "WebRTC warm pool built in " << rtc::TimeMillis() - startMs << " ms";
+}
+
+
+WarmPool::~WarmPool()
+{
+    // Finishes an open in progress; queued ones are dropped.
+    prewarm_->Stop();
+    X264Encoder::ReleaseWarmEncoder();
+
+    factory_ = nullptr;
+    apm_ = nullptr;
+    worker_->Invoke<void>(RTC_FROM_HERE, [this]() { adm_ = nullptr; });
+    network_->Invoke<void>(RTC_FROM_HERE, [this]()
+    {
+        {
+            MutexLock lock(&poolMutex_);
+            candidatePool_.reset();
+        }
+        socketFactory_.reset();
+        networkManager_.reset();
+    });
+
+    network_->Stop();
+    worker_->Stop();
+    signaling_->Stop();
+}
+
+
+// static
+WarmPool& WarmPool::Instance()
+{
+    MutexLock lock(&s_mutex);
+    if (!s_instance)
+        s_instance.reset(new WarmPool());
+    return *s_instance;
+}
+
+
+// static
+void WarmPool::Shutdown()
+{
+    unique_ptr<WarmPool> pool;
+    {
+        MutexLock lock(&s_mutex);
+        pool = std::move(s_instance);
+    }
+    // Destroyed here, outside the lock: stopping the threads can take a while.
+}
+
+
+void WarmPool::PrewarmEncoder(int width, int height, int fps, int bitrateKbps, int packetizationMode)
+{
+    prewarm_->PostTask(RTC_FROM_HERE, [=]()
+    {
+        if (!X264Encoder::PrewarmEncoder(width, height, fps, bitrateKbps, packetizationMode))
+            return;
+        // A later prewarm resets the age, so this only closes an encoder left
+        // unused for the whole period.
+        prewarm_->PostDelayedTask(RTC_FROM_HERE, []()
+        {
+            X264Encoder::ExpireWarmEncoder(kWarmEncoderMaxAgeMs);
+        }, kWarmEncoderMaxAgeMs);
+    });
+}
+
+
+void WarmPool::PrewarmCandidates(const PeerConnectionInterface::IceServers& servers, int poolSize)
+{
+    if (poolSize <= 0)
+        return;
+
+    network_->PostTask(RTC_FROM_HERE, [this, servers, poolSize]()
+    {
+        cricket::ServerAddresses stunServers;
+        std::vector<cricket::RelayServerConfig> turnServers;
+        if (ParseIceServers(servers, &stunServers, &turnServers) != RTCErrorType::NONE)
+        {
+            RTC_LOG(LS_WARNING) << "Candidate pool: invalid ICE server list";
+            return;
+        }
+
+        // Set up as PeerConnection::InitializePortAllocator_n() would, so the
+        // pooled sessions are the ones the PeerConnection would have started.
+        auto allocator = std::make_unique<cricket::BasicPortAllocator>(networkManager_.get(), socketFactory_.get());
+        allocator->Initialize();
+        allocator->set_flags(allocator->flags() | cricket::PORTALLOCATOR_ENABLE_SHARED_SOCKET
+                             | cricket::PORTALLOCATOR_ENABLE_IPV6 | cricket::PORTALLOCATOR_ENABLE_IPV6_ON_WIFI);
+        allocator->set_step_delay(cricket::kMinimumStepDelay);
+        allocator->SetConfiguration(stunServers, turnServers, poolSize, NO_PRUNE);
+
+        unique_ptr<cricket::PortAllocator> previous;
+        {
+            MutexLock lock(&poolMutex_);
+            previous = std::move(candidatePool_);
+            candidatePool_ = std::move(allocator);
+            candidatePoolMs_ = rtc::TimeMillis();
+        }
+        RTC_LOG(LS_INFO) << "Candidate pool: gathering " << poolSize << " session(s), "
+                         << stunServers.size() << " STUN server(s)";
+        // |previous| is released here, on the network thread it was used on.
+    });
+}
+
+
+unique_ptr<cricket::PortAllocator> WarmPool::TakeCandidatePool()
+{
+    unique_ptr<cricket::PortAllocator> pool;
+    int64_t ageMs = 0;
+    {
+        MutexLock lock(&poolMutex_);
+        pool = std::move(candidatePool_);
+        ageMs = rtc::TimeMillis() - candidatePoolMs_;
+    }
+
+    if (pool && ageMs > kCandidatePoolMaxAgeMs)
+    {
+        RTC_LOG(LS_INFO) << "Candidate pool: dropped, gathered " << ageMs / 1000 << " s ago";
+        network_->PostTask(RTC_FROM_HERE, [stale = std::move(pool)]() mutable { stale.reset(); });
+        return nullptr;
+    }
+    return pool;
+}
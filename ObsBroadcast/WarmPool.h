@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#ifndef WARM_POOL_H_
+#define WARM_POOL_H_
+
+#include "ADMWrapper.h"
+
+#include "api/peer_connection_interface.h"
+#include "api/scoped_refptr.h"
+#include "modules/audio_processing/include/audio_processing.h"
+#include "p2p/base/basic_packet_socket_factory.h"
+#include "p2p/base/port_allocator.h"
+#include "rtc_base/network.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread.h"
+
+#include <memory>
+
+
+/// Process-lifetime WebRTC runtime shared by every WebRTCStream: the network,
+/// worker and signaling threads, the ADM and APM, and the
+/// PeerConnectionFactory built on them. Built on first use and kept across
+/// stop/start, so going live again creates only a PeerConnection.
+///
+/// Also owns a low-priority thread that pre-opens the x264 encoder for the
+/// next session while the stream is idle (see X264Encoder::PrewarmEncoder),
+/// and a port allocator that gathers the next session's ICE candidates.
+class WarmPool
+{
+public:
+    ~WarmPool();
+
+    WarmPool(const WarmPool&) = delete;
+    WarmPool& operator=(const WarmPool&) = delete;
+
+    /// Builds the pool on the first call. Any thread.
+    static WarmPool& Instance();
+    /// Tears the pool down, e.g. on module unload. No stream may be alive.
+    static void Shutdown();
+
+    rtc::Thread* network() const { return network_.get(); }
+    rtc::Thread* worker() const { return worker_.get(); }
+    rtc::Thread* signaling() const { return signaling_.get(); }
+
+    rtc::scoped_refptr<ADMWrapper> adm() const { return adm_; }
+    rtc::scoped_refptr<webrtc::AudioProcessing> apm() const { return apm_; }
+    rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory() const { return factory_; }
+
+    /// Pre-opens an encoder of this shape off the caller's thread, replacing
+    /// any encoder parked earlier, and closes it if still unused after a few
+    /// minutes. Returns immediately.
+    void PrewarmEncoder(int width, int height, int fps, int bitrateKbps, int packetizationMode);
+
+    /// Starts gathering |poolSize| ICE sessions (host candidates, plus srflx
+    /// for STUN servers in |servers|) on the network thread, replacing any
+    /// pool gathered earlier. Returns immediately.
+    void PrewarmCandidates(const webrtc::PeerConnectionInterface::IceServers& servers, int poolSize);
+
+    /// The allocator holding the pre-gathered sessions, to be passed as
+    /// PeerConnectionDependencies::allocator with the same servers and
+    /// ice_candidate_pool_size in the RTCConfiguration. nullptr if none was
+    /// gathered or it is too old to trust.
+    std::unique_ptr<cricket::PortAllocator> TakeCandidatePool();
+
+private:
+    WarmPool();
+
+    static webrtc::Mutex            s_mutex;
+    static std::unique_ptr<WarmPool> s_instance RTC_GUARDED_BY(s_mutex);
+
+    std::unique_ptr<rtc::Thread>    network_;
+    std::unique_ptr<rtc::Thread>    worker_;
+    std::unique_ptr<rtc::Thread>    signaling_;
+    std::unique_ptr<rtc::Thread>    prewarm_;
+
+    rtc::scoped_refptr<ADMWrapper>                              adm_;
+    rtc::scoped_refptr<webrtc::AudioProcessing>                 apm_;
+    rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>  factory_;
+
+    // Used on the network thread only; outlive every allocator built on them.
+    std::unique_ptr<rtc::BasicNetworkManager>       networkManager_;
+    std::unique_ptr<rtc::BasicPacketSocketFactory>  socketFactory_;
+
+    webrtc::Mutex                           poolMutex_;
+    std::unique_ptr<cricket::PortAllocator> candidatePool_ RTC_GUARDED_BY(poolMutex_);
+    int64_t                                 candidatePoolMs_ RTC_GUARDED_BY(poolMutex_) = 0;
+};
+
+#endif  // WARM_POOL_H_
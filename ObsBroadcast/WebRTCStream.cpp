@@ -26,6 +26,42 @@
 #define MFC_LIMIT_WEBRTC_BITRATE_2500 1
 #define WEBRTCSTREAM_MODIFY_SENDER_PARAMETERS 0
 #define WEBRTCSTREAM_USE_BITRATE_SETTINGS 0
+// Highest frame rate sent; OBS output rates above it are decimated. The
+// output's OPT_HIGH_FRAMERATE_ENABLED setting raises it to the high cap.
+#define WEBRTCSTREAM_MAX_FRAMERATE 30
+#define WEBRTCSTREAM_HIGH_MAX_FRAMERATE 60
+// H.264 packetization mode kept in the offer: 1 = non-interleaved (FU-A), 0 = single NAL unit.
+#define WEBRTCSTREAM_H264_PACKETIZATION_MODE 1
+// Send 720p/360p simulcast renditions alongside the output resolution.
+#define WEBRTCSTREAM_ENABLE_SIMULCAST 0
+// Write the last ~30 s of per-frame encoder telemetry to the log directory on stop.
+#define WEBRTCSTREAM_DUMP_ENCODER_TELEMETRY 1
+// Copy the encoded output to encoded-<time>.L<n>.h264 + .csv in the log directory
+// for QA and offline replay (bench --replay). Costs a copy of each frame.
+#define WEBRTCSTREAM_TEE_ENCODED_OUTPUT 0
+// Open the websocket (DNS, TCP, TLS, auth) before building the PeerConnection
+// so the two overlap; 0 restores the sequential build-then-connect startup.
+#define WEBRTCSTREAM_PIPELINED_STARTUP 1
+// Pre-open the x264 encoder for the next session after a stream stops.
+#define WEBRTCSTREAM_PREWARM_ENCODER 1
+// Recover a live stream from ICE or websocket loss in-session (ICE restart,
+// then a new websocket session) before giving up and stopping the output.
+#define WEBRTCSTREAM_FAST_RECONNECT 1
+// Keep transport-cc feedback and the transport-wide sequence number extension
+// in the offer, so WebRTC's send-side estimator (GCC) sets the encoder target.
+// 0 strips them, leaving REMB plus the encoder's loss/RTT RateController.
+#define WEBRTCSTREAM_TRANSPORT_CC 0
+// Send local ICE candidates over the websocket as they are gathered, not
+// only those that made it into the offer. Off until the Wowza servers are
+// confirmed to accept the iceCandidate command.
+#define WEBRTCSTREAM_TRICKLE_ICE 0
+// ICE sessions gathered while the output is idle (from its creation and
+// after each stop) and handed to the next PeerConnection; 0 starts
+// gathering only when the offer is made.
+#define WEBRTCSTREAM_ICE_CANDIDATE_POOL_SIZE 1
+// STUN server for srflx candidates, e.g. "stun:stun.l.google.com:19302";
+// empty gathers host candidates only.
+#define WEBRTCSTREAM_STUN_URL ""
 
 #ifdef _WIN32
 #pragma warning (disable: 4003)  // enough actual parameters for macro
@@ -35,12 +71,14 @@
 
 // project
 #include "WebRTCStream.h"
-#include "EncoderFactory.h"
 #include "ObsBroadcast.h"
 #include "SanitizeInputs.h"
+#include "SDPModel.h"
 #include "SDPUtil.h"
+#include "WarmPool.h"
 #include "X264Encoder.h"
 #include "webrtc_version.h"
+#include "wowza-stream.h"
 
 // solution
 #include <libPlugins/build_version.h>
@@ -52,17 +90,15 @@
 #include <media-io/video-io.h>
 
 // webrtc
-#include "api/create_peerconnection_factory.h"
-#include "api/audio_codecs/builtin_audio_decoder_factory.h"
-#include "api/audio_codecs/builtin_audio_encoder_factory.h"
 #include "api/audio_codecs/audio_format.h"
 #include "api/stats/rtcstats_objects.h"
 #include "api/transport/bitrate_settings.h"
 #include "api/video/video_bitrate_allocator.h"
 #include "api/video/video_bitrate_allocator_factory.h"
-#include "api/video_codecs/builtin_video_decoder_factory.h"
-//#include "api/video_codecs/builtin_video_encoder_factory.h"
 #include "pc/webrtc_sdp.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/event.h"
+#include "rtc_base/time_utils.h"
 #include "third_party/libyuv/include/libyuv.h"
 
 #include <algorithm>
@@ -87,50 +123,55 @@ using std::unique_ptr;
 using std::vector;
 using namespace webrtc;
 using PCI = webrtc::PeerConnectionInterface;
-using PCFI = webrtc::PeerConnectionFactoryInterface;
 
 extern CBroadcastCtx g_ctx;  // part of MFCLibPlugins.lib::MfcPluginAPI.obj
 
-/// Round |num| to a multiple of |multiple|.
-template<typename T>
-inline T roundUp(T num, T multiple)
-{
-    assert(multiple);
-    return ((num + multiple - 1) / multiple) * multiple;
-}
+// Time each recovery stage gets to bring ICE back before the next one.
+static const int kIceRestartTimeoutMs   = 3000;
+static const int kRenegotiateTimeoutMs  = 10000;
+// Delay between websocket connect attempts while renegotiating.
+static const int kWsRetryMs             = 1000;
+// Longest the destructor waits for a closed websocket client's thread to exit.
+static const int kWsCloseWaitMs         = 2000;
+// Longest a TCP remote candidate waits for the edge ingest lookup before it is
+// added as sent.
+static const int kEdgeIngestWaitMs      = 2000;
 
-
-static unique_ptr<Thread> CreateNetwork()
-{
-    auto network = Thread::CreateWithSocketServer();
-    network->SetName("WebRTCStream_Network", nullptr);
-    network->Start();
-    return network;
-}
+#ifdef SIDEKICK_STREAM_BENCH
+static webrtc::Mutex g_benchWsUrlMutex;
+static string g_benchWsUrl;
 
 
-static unique_ptr<Thread> CreateWorker()
+void WebRTCStream::SetBenchWsUrl(const string& url)
 {
-    auto worker = Thread::Create();
-    worker->SetName("WebRTCStream_Worker", nullptr);
-    worker->Start();
-    return worker;
+    MutexLock lock(&g_benchWsUrlMutex);
+    g_benchWsUrl = url;
 }
+#endif
 
 
-static unique_ptr<Thread> CreateSignaling()
+/// ICE servers of the PeerConnection. The candidate pool is gathered with the
+/// same list, or the PeerConnection discards it.
+static PCI::IceServers StreamIceServers()
 {
-    auto signaling = Thread::Create();
-    signaling->SetName("WebRTCStream_Signaling", nullptr);
-    signaling->Start();
-    return signaling;
+    PCI::IceServers servers;
+    const string stunUrl = WEBRTCSTREAM_STUN_URL;
+    if (!stunUrl.empty())
+    {
+        PCI::IceServer server;
+        server.urls.push_back(stunUrl);
+        servers.push_back(server);
+    }
+    return servers;
 }
 
 
-static scoped_refptr<ADMWrapper> CreateADM(Thread* worker)
+/// Round |num| to a multiple of |multiple|.
+template<typename T>
+inline T roundUp(T num, T multiple)
 {
-    return worker->Invoke<scoped_refptr<ADMWrapper>>(
-        RTC_FROM_HERE, []() { return ADMWrapper::Create(); });
+    assert(multiple);
+    return ((num + multiple - 1) / multiple) * multiple;
 }
 
 
@@ -161,23 +202,6 @@ static void ConfigureAPM(scoped_refptr<AudioProcessing> apm)
 }
 
 
-static scoped_refptr<AudioProcessing> CreateAPM()
-{
-    scoped_refptr<AudioProcessing> apm(AudioProcessingBuilder().Create());
-    ConfigureAPM(apm);
-    return apm;
-}
-
-
-static scoped_refptr<PCFI> CreatePCFactory(Thread* network, Thread* worker, Thread* signaling,
-                                           scoped_refptr<ADMWrapper> adm, scoped_refptr<AudioProcessing> apm)
-{
-    return CreatePeerConnectionFactory(network, worker, signaling, adm, CreateBuiltinAudioEncoderFactory(),
-                                       CreateBuiltinAudioDecoderFactory(), CreateX264EncoderFactory(),
-                                       CreateBuiltinVideoDecoderFactory(), nullptr, apm, nullptr);
-}
-
-
 static obs_output_t* CreateVirtualCamera()
 {
     obs_output_t* pVirtualCam = nullptr;
@@ -203,19 +227,41 @@ void LogSink::OnLogMessage(const string& message)
 WebRTCStream::WebRTCStream(obs_output_t* output)
     : m_pOutput(output)
     , m_pVirtualCam(CreateVirtualCamera())
-    , m_pWsClient(nullptr)
     , m_nWidth(0)
     , m_nHeight(0)
     , m_nVideoBitrateKbps(0)
     , m_nAudioBitrateKbps(0)
     , m_nFrameRate(0)
     , m_sAudioCodec("opus")
-    , network_(CreateNetwork())
-    , worker_(CreateWorker())
-    , signaling_(CreateSignaling())
-    , adm_(CreateADM(worker_.get()))
-    , apm_(CreateAPM())
-    , factory_(nullptr)
+    , pcReady_(false)
+    , wsAuthenticated_(false)
+    , offerRequested_(false)
+    , timelineLogged_(false)
+    , offerSent_(false)
+    , gatheringComplete_(false)
+    , candidatesGathered_(0)
+    , candidatesTrickled_(0)
+    , pooledCandidates_(false)
+    , control_(rtc::Thread::Create())
+    , session_(0)
+    , stopPending_(false)
+    , pendingRecovery_(Recovery::kNone)
+    , destroying_(false)
+    , recovery_(Recovery::kNone)
+    , recoveryGeneration_(0)
+    , dataCaptureStarted_(false)
+    , recoveryStartMs_(0)
+    , recoveries_(0)
+    , iceRestarts_(0)
+    , renegotiations_(0)
+    , started_(false)
+    , stopping_(false)
+    , network_(WarmPool::Instance().network())
+    , worker_(WarmPool::Instance().worker())
+    , signaling_(WarmPool::Instance().signaling())
+    , adm_(WarmPool::Instance().adm())
+    , apm_(WarmPool::Instance().apm())
+    , factory_(WarmPool::Instance().factory())
     , pc_(nullptr)
     , audioSource_(nullptr)
     , videoSource_(nullptr)
@@ -225,11 +271,17 @@ WebRTCStream::WebRTCStream(obs_output_t* output)
     , logLevel_(LoggingSeverity::LS_NONE)
 {
     obs_info("WebRTCStream ctor");
+    control_->SetName("WebRTCStream_Control", nullptr);
+    control_->Start();
     rtc::LogMessage::LogThreads(true);
     LogLevel(LoggingSeverity::LS_VERBOSE);
     ResetStats();
+    ConfigureAPM(apm_);
 
-    factory_ = CreatePCFactory(network_.get(), worker_.get(), signaling_.get(), adm_, apm_);
+#if WEBRTCSTREAM_ICE_CANDIDATE_POOL_SIZE > 0
+    // The output exists well before Start(); gather the candidates meanwhile.
+    WarmPool::Instance().PrewarmCandidates(StreamIceServers(), WEBRTCSTREAM_ICE_CANDIDATE_POOL_SIZE);
+#endif
 }
 
 
@@ -238,6 +290,19 @@ WebRTCStream::~WebRTCStream()
     obs_info("~WebRTCStream dtor");
     Stop(false);
 
+    // Queued control actions still run (and see |destroying_|); recovery
+    // timers and retries are dropped with the thread.
+    destroying_ = true;
+    {
+        MutexLock lock(&wsMutex_);
+        if (wsListener_)
+            wsListener_->Detach();
+    }
+    rtc::Event drained;
+    control_->PostTask(RTC_FROM_HERE, [&drained]() { drained.Set(); });
+    drained.Wait(rtc::Event::kForever);
+    control_->Stop();
+
     if (m_pVirtualCam)
     {
         obs_output_release(m_pVirtualCam);
@@ -250,8 +315,22 @@ WebRTCStream::~WebRTCStream()
         m_pOutput = nullptr;
     }
 
-    if (m_pWsClient)
-        m_pWsClient = nullptr;
+    // Stop() closed the websocket; give its thread a moment to exit before
+    // the client and listener it runs on are destroyed.
+    for (int64_t waitStartMs = rtc::TimeMillis();;)
+    {
+        {
+            MutexLock lock(&wsMutex_);
+            if (RetireWsSession())
+                break;
+        }
+        if (rtc::TimeMillis() - waitStartMs >= kWsCloseWaitMs)
+        {
+            obs_warn("Websocket client thread still running after %d ms", kWsCloseWaitMs);
+            break;
+        }
+        rtc::Thread::SleepMs(10);
+    }
 
     audioSender_    = nullptr;
     videoSender_    = nullptr;
@@ -259,20 +338,12 @@ WebRTCStream::~WebRTCStream()
     pc_             = nullptr;
     factory_        = nullptr;
     apm_            = nullptr;
+    adm_            = nullptr;
 
-    worker_->Invoke<void>(RTC_FROM_HERE, [this]() { adm_ = nullptr; });
     signaling_->Invoke<void>(RTC_FROM_HERE, [this]() { videoSource_ = nullptr; });
 
-    if (!network_->IsCurrent())
-        network_->Stop();
-    if (!worker_->IsCurrent())
-        worker_->Stop();
-    if (!signaling_->IsCurrent())
-        signaling_->Stop();
-
-    network_ = nullptr;
-    worker_ = nullptr;
-    signaling_ = nullptr;
+    // The threads, factory, ADM and APM belong to the WarmPool and outlive
+    // this stream.
 
     rtc::LogMessage::RemoveLogToStream(logSink_.get());
 }
@@ -284,23 +355,96 @@ bool WebRTCStream::Start()
         Stop(false);
     started_ = true;
     stopping_ = false;
+    ++session_;
+    stopPending_ = false;
+    pendingRecovery_ = Recovery::kNone;
+
+    timeline_.Reset();
+    timelineLogged_ = false;
+    timeline_.Mark(StartupTimeline::kStart);
 
     ResetStats();
+    X264Encoder::ResetSessionStats();
     ConfigureStreamParameters();
+    ResolveEdgeIngest();
+    timeline_.Mark(StartupTimeline::kConfigured);
 
-    if (!CreatePeerConnection())
+#if WEBRTCSTREAM_TEE_ENCODED_OUTPUT
+    {
+        std::ostringstream name;
+        std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        name << "encoded-" << std::put_time(std::localtime(&t), "%Y%m%d-%H%M%S");
+        auto basePath = CObsUtil::AppendPath(CObsUtil::getLogPath(), name.str());
+        if (!X264Encoder::StartOutputTee(basePath))
+            obs_warn("failed to open encoded output tee at %s", basePath.c_str());
+    }
+#endif
+
+#if WEBRTCSTREAM_PIPELINED_STARTUP
+    // The handshake only needs the stream parameters; it runs on the
+    // websocket thread while the PeerConnection is built below.
+    if (!OpenWebsocketConnection())
         return false;
-    if (!AddTracks())
+#endif
+
+    bool built = false;
+    {
+        MutexLock lock(&startupMutex_);
+        built = CreatePeerConnection() && AddTracks();
+        pcReady_ = built;
+    }
+    if (!built)
+    {
+#if WEBRTCSTREAM_PIPELINED_STARTUP
+        Stop(false);  // Close websocket connection
+#endif
         return false;
+    }
+
+#if !WEBRTCSTREAM_PIPELINED_STARTUP
     if (!OpenWebsocketConnection())
         return false;
+#endif
 
+    // No-op until the websocket is authenticated; onConnected() retries.
+    MaybeSetLocalDescription();
     return true;
 }
 
 
+void WebRTCStream::ResolveEdgeIngest()
+{
+    string videoServer, region;
+    {
+        auto lk = g_ctx.sharedLock();
+        videoServer = g_ctx.cfg.getString("videoserver");
+        region      = g_ctx.cfg.getString("region");
+    }
+
+    // TUK and ORD candidates are used as sent.
+    std::shared_future<MFCEdgeIngest::SiteIpPort> edgeIngest;
+    if (!SDPUtil::CaseInsStringCompare(region, "TUK") && !SDPUtil::CaseInsStringCompare(region, "ORD"))
+    {
+        // Fetched while the PeerConnection is built and signaling runs, so
+        // TCP candidates normally find it ready.
+        edgeIngest = MFCEdgeIngest::ResolveAsync(videoServer, region);
+    }
+
+    MutexLock lock(&edgeIngestMutex_);
+    edgeIngest_ = std::move(edgeIngest);
+}
+
+
 bool WebRTCStream::Stop(bool normal)
 {
+    // Inline when already on |control_|.
+    return control_->Invoke<bool>(RTC_FROM_HERE, [this, normal]() { return StopOnControl(normal); });
+}
+
+
+bool WebRTCStream::StopOnControl(bool normal)
+{
+    RTC_DCHECK(control_->IsCurrent());
     obs_info("WebRTCStream::stop");
     bool ret = false;
     started_ = false;
@@ -309,29 +453,68 @@ bool WebRTCStream::Stop(bool normal)
     // Increase logging verbosity to log end of stream summary
     LogLevel(LoggingSeverity::LS_VERBOSE);
 
+    // Cancels recovery and its timers.
+    recovery_ = Recovery::kNone;
+    ++recoveryGeneration_;
+    dataCaptureStarted_ = false;
+
+    PeerConnectionInterface* old = nullptr;
+    {
+        // Waits for a PeerConnection build in progress on another thread.
+        MutexLock lock(&startupMutex_);
+        pcReady_ = false;
+        wsAuthenticated_ = false;
+        offerRequested_ = false;
+        if (pc_)
+            old = pc_.release();
+    }
+    ResetTrickle();
+
     if (audioSender_)
         audioSender_.release();
     if (videoSender_)
         videoSender_.release();
 
-    if (pc_)
+    if (old)
     {
         ret = true;
-        auto old = pc_.release();
         old->Close();  // Close PeerConnection
         old = nullptr;
     }
 
-    if (m_pWsClient)
-        m_pWsClient->disconnect(normal);  // Close websocket connection
+#if WEBRTCSTREAM_DUMP_ENCODER_TELEMETRY
+    {
+        auto path = CObsUtil::AppendPath(CObsUtil::getLogPath(), "encoder-telemetry.csv");
+        if (!X264Encoder::DumpTelemetry(path))
+            obs_warn("failed to write encoder telemetry to %s", path.c_str());
+    }
+#endif
+#if WEBRTCSTREAM_TEE_ENCODED_OUTPUT
+    X264Encoder::StopOutputTee();
+#endif
+
+    if (auto wsClient = WsClient())
+        wsClient->disconnect(normal);  // Close websocket connection
 
 #if MFC_AGENT_EDGESOCK
     if (m_pVirtualCam)
         obs_output_stop(m_pVirtualCam);
-    g_ctx.sm_edgeSock->sendVirtualCameraState(false);
+    if (g_ctx.sm_edgeSock)
+        g_ctx.sm_edgeSock->sendVirtualCameraState(false);
 #endif
 
     obs_output_end_data_capture(m_pOutput);  // Stop main thread
+
+#if WEBRTCSTREAM_PREWARM_ENCODER
+    // Back in preview: have an encoder ready if the stream is restarted.
+    if (ret && m_nWidth > 0 && m_nHeight > 0)
+        WarmPool::Instance().PrewarmEncoder(m_nWidth, m_nHeight, m_nFrameRate, m_nVideoBitrateKbps,
+                                            WEBRTCSTREAM_H264_PACKETIZATION_MODE);
+#endif
+#if WEBRTCSTREAM_ICE_CANDIDATE_POOL_SIZE > 0
+    if (ret)
+        WarmPool::Instance().PrewarmCandidates(StreamIceServers(), WEBRTCSTREAM_ICE_CANDIDATE_POOL_SIZE);
+#endif
     return ret;
 }
 
@@ -377,6 +560,11 @@ void WebRTCStream::ResetStats()
     packets_lost_           = 0;
     rtt_                    = 0;
     jitter_                 = 0;
+
+    // Recovery
+    recoveries_             = 0;
+    iceRestarts_            = 0;
+    renegotiations_         = 0;
 }
 
 
@@ -390,7 +578,11 @@ void WebRTCStream::ConfigureStreamParameters()
     obs_encoder_t* pVideoEncoder = obs_output_get_video_encoder(m_pOutput);
     auto pVideoOutputInfo = video_output_get_info(obs_get_video());
     double fps = video_output_get_frame_rate(obs_get_video());
-    m_nFrameRate = std::min((int)round(fps), 30);
+    obs_data_t* pOutputSettings = obs_output_get_settings(m_pOutput);
+    const bool highFramerate = obs_data_get_bool(pOutputSettings, OPT_HIGH_FRAMERATE_ENABLED);
+    obs_data_release(pOutputSettings);
+    m_nFrameRate = std::min((int)round(fps), highFramerate ? WEBRTCSTREAM_HIGH_MAX_FRAMERATE
+                                                           : WEBRTCSTREAM_MAX_FRAMERATE);
     obs_data_t* pVideoSettings = obs_encoder_get_settings(pVideoEncoder);
     int videoBitrateKbps = (int)obs_data_get_int(pVideoSettings, "bitrate");
     obs_data_release(pVideoSettings);
@@ -398,18 +590,18 @@ void WebRTCStream::ConfigureStreamParameters()
     m_nWidth = (int)obs_output_get_width(m_pOutput);
     m_nHeight = (int)obs_output_get_height(m_pOutput);
 
-#if MFC_LIMIT_WEBRTC_BITRATE_2500
+#if MFC_LIMIT_WEBRTC_BITRATE_2500 && !WEBRTCSTREAM_ENABLE_SIMULCAST
     // Limiting bitrate until multiple webrtc renditions are supported
     m_nVideoBitrateKbps = std::min(videoBitrateKbps, 2500);
 #else
     m_nVideoBitrateKbps = videoBitrateKbps;
 #endif
     obs_info("\nOriginal resolution: %d x %d", m_nWidth, m_nHeight);
-    SanitizeInputs::OptimalFrameSize(m_nVideoBitrateKbps, m_nWidth, m_nHeight);
+    SanitizeInputs::OptimalFrameSize(m_nVideoBitrateKbps, m_nFrameRate, m_nWidth, m_nHeight);
     SanitizeInputs::OpusBitrate(m_nVideoBitrateKbps, m_nAudioBitrateKbps);
-    SanitizeInputs::ConstrainBitrate(m_nHeight, m_nVideoBitrateKbps);
+    SanitizeInputs::ConstrainBitrateForFramerate(m_nHeight, m_nFrameRate, m_nVideoBitrateKbps);
     m_nVideoBitrateKbps = roundUp(m_nVideoBitrateKbps, m_nFrameRate);
-    obs_info("Adjusted resolution: %d x %d\n", m_nWidth, m_nHeight);
+    obs_info("Adjusted resolution: %d x %d @ %d fps\n", m_nWidth, m_nHeight, m_nFrameRate);
 
     video_bitrate_bps_ = m_nVideoBitrateKbps * 1000;
     total_bitrate_bps_ = (m_nVideoBitrateKbps + m_nAudioBitrateKbps) * 1000;
@@ -448,8 +640,16 @@ bool WebRTCStream::CreatePeerConnection()
     config.sdp_semantics = SdpSemantics::kUnifiedPlan;
     config.set_cpu_adaptation(false);
     config.set_prerenderer_smoothing(false);
+    config.servers = StreamIceServers();
 
     PeerConnectionDependencies dependencies(this);
+#if WEBRTCSTREAM_ICE_CANDIDATE_POOL_SIZE > 0
+    // Without a pre-gathered pool, the PeerConnection starts one right away,
+    // still ahead of the offer.
+    config.ice_candidate_pool_size = WEBRTCSTREAM_ICE_CANDIDATE_POOL_SIZE;
+    dependencies.allocator = WarmPool::Instance().TakeCandidatePool();
+    pooledCandidates_ = dependencies.allocator != nullptr;
+#endif
 
     pc_ = factory_->CreatePeerConnection(config, std::move(dependencies));
     if (!pc_)
@@ -457,12 +657,51 @@ bool WebRTCStream::CreatePeerConnection()
         obs_error("Error creating PeerConnection");
         return false;
     }
-    obs_info("PeerConnection CREATED\n");
+    obs_info("PeerConnection CREATED%s\n", pooledCandidates_ ? " (pre-gathered candidates)" : "");
+    timeline_.Mark(StartupTimeline::kPeerConnectionCreated);
 
     return true;
 }
 
 
+#if WEBRTCSTREAM_ENABLE_SIMULCAST
+/// Build the send encodings for an output of |height| lines at |topKbps|,
+/// lowest resolution first as WebRTC expects. 720p and 360p renditions are
+/// added only when they are smaller than the output; each lower layer gets a
+/// share of |topKbps| proportional to its pixel count, clamped to the range
+/// SanitizeInputs allows for its height at |framerate|.
+static vector<RtpEncodingParameters> SimulcastEncodings(int height, int framerate, int topKbps)
+{
+    static const int kRenditionHeights[] = {360, 720};
+
+    vector<RtpEncodingParameters> encodings;
+    for (int targetHeight : kRenditionHeights)
+    {
+        if (targetHeight >= height)
+            continue;
+
+        const double scale = (double)height / targetHeight;
+        int kbps = (int)(topKbps / (scale * scale));
+        SanitizeInputs::ConstrainBitrateForFramerate(targetHeight, framerate, kbps);
+
+        RtpEncodingParameters encoding;
+        encoding.rid = "r" + std::to_string(encodings.size());
+        encoding.scale_resolution_down_by = scale;
+        encoding.max_bitrate_bps = kbps * 1000;
+        encodings.push_back(encoding);
+    }
+
+    RtpEncodingParameters top;
+    top.rid = "r" + std::to_string(encodings.size());
+    top.scale_resolution_down_by = 1.0;
+    top.max_bitrate_bps = topKbps * 1000;
+    encodings.push_back(top);
+
+    return encodings;
+}
+#endif
+
+
 bool WebRTCStream::AddTracks()
 {
     const string stream_id = "obs";
@@ -493,7 +732,36 @@ bool WebRTCStream::AddTracks()
     videoSource_ =
         signaling_->Invoke<scoped_refptr<VideoTrackSource>>(
             RTC_FROM_HERE, []() { return VideoTrackSource::Create(); });
+    videoSource_->SetMaxFramerate(m_nFrameRate);
+    {
+        obs_data_t* pOutputSettings = obs_output_get_settings(m_pOutput);
+        StaticSceneDetector::Config scene;
+        scene.enabled           = obs_data_get_bool(pOutputSettings, OPT_STATIC_SCENE_ENABLED);
+        scene.meanDiffThreshold = (int)obs_data_get_int(pOutputSettings, OPT_STATIC_SCENE_THRESHOLD);
+        scene.staticAfterMs     = (int)obs_data_get_int(pOutputSettings, OPT_STATIC_SCENE_AFTER_MS);
+        scene.staticFps         = (int)obs_data_get_int(pOutputSettings, OPT_STATIC_SCENE_FPS);
+        obs_data_release(pOutputSettings);
+        videoSource_->ConfigureStaticScene(scene);
+        if (scene.enabled)
+            obs_info("static scene thinning: threshold %d, after %d ms, %d fps",
+                     scene.meanDiffThreshold, scene.staticAfterMs, scene.staticFps);
+    }
     videoTrack_ = factory_->CreateVideoTrack("video", videoSource_);
+#if WEBRTCSTREAM_ENABLE_SIMULCAST
+    RtpTransceiverInit init;
+    init.direction = RtpTransceiverDirection::kSendOnly;
+    init.stream_ids = {stream_id};
+    init.send_encodings = SimulcastEncodings(m_nHeight, m_nFrameRate, m_nVideoBitrateKbps);
+    auto video_result_or_error = pc_->AddTransceiver(videoTrack_, init);
+    if (!video_result_or_error.ok())
+    {
+        auto error = video_result_or_error.MoveError();
+        obs_warn("Error adding video track to PeerConnection: %s", error.message());
+        return false;
+    }
+    videoSender_ = video_result_or_error.MoveValue()->sender();
+    obs_info("Video simulcast layers: %d", (int)init.send_encodings.size());
+#else
     auto video_result_or_error = pc_->AddTrack(videoTrack_, {stream_id});
     if (!video_result_or_error.ok())
     {
@@ -502,7 +770,9 @@ bool WebRTCStream::AddTracks()
         return false;
     }
     videoSender_ = video_result_or_error.MoveValue();
+#endif
     obs_info("Added video track to PeerConnection\n");
+    timeline_.Mark(StartupTimeline::kTracksAdded);
 
     return true;
 }
@@ -534,34 +804,49 @@ bool WebRTCStream::OpenWebsocketConnection()
         sStreamName     = "ext_x_" + std::to_string(nUid) + ".f4v";
         sWsUrl          = "wss://" + m_sVideoServer + ".myfreecams.com/webrtc-session.json";
     }
+#ifdef SIDEKICK_STREAM_BENCH
+    {
+        MutexLock lock(&g_benchWsUrlMutex);
+        if (!g_benchWsUrl.empty())
+            sWsUrl = g_benchWsUrl;
+    }
+#endif
     m_sProtocol.clear();
 
     obs_info("Video codec:         %s\n", m_sVideoCodec.c_str());
     obs_info("Video bitrate:       %d", m_nVideoBitrateKbps);
     obs_info("Audio bitrate:       %d\n", m_nAudioBitrateKbps);
 
-    m_pWsClient = CreateWebsocketClient();
-    if (!m_pWsClient)
+    std::shared_ptr<WebsocketClient> wsClient = CreateWebsocketClient();
+    if (!wsClient)
     {
         obs_warn("Error creating Websocket client");
-        Stop(false);  // Close PeerConnection
-        obs_output_set_last_error(m_pOutput, "Error creating Websocket client\n\n");
-        obs_output_signal_stop(m_pOutput, OBS_OUTPUT_CONNECT_FAILED);  // Stop main thread
+        PostStopOutput("Error creating Websocket client\n\n", OBS_OUTPUT_CONNECT_FAILED);
         return false;
     }
 
+    WsSessionListener* wsListener = nullptr;
+    {
+        // Callbacks of a previous session must not reach this one.
+        MutexLock lock(&wsMutex_);
+        RetireWsSession();
+        wsListener_ = make_unique<WsSessionListener>(this);
+        wsListener = wsListener_.get();
+        m_pWsClient = wsClient;
+    }
+
     obs_info("region: %s\nurl: %s", m_sRegion.c_str(), sWsUrl.c_str());
     obs_info("username: %s, uid: %d, sid: %d", sUsername.c_str(), nUid, nSid);
     obs_info("stream name: %s\npassword: %s", sStreamName.c_str(), sPwd.c_str());
     obs_info("vidctx: %s\nstream key: %s", sVidCtx.c_str(), sStreamKey.c_str());
 
-    if (!m_pWsClient->connect(this, sWsUrl, sStreamName, sStreamKey, sPwd, sVidCtx, nSid,
-                              nUid, nRoomId, m_nWidth, m_nHeight, m_nFrameRate, fCamScore))
+    timeline_.Mark(StartupTimeline::kWsConnecting);
+
+    if (!wsClient->connect(wsListener, sWsUrl, sStreamName, sStreamKey, sPwd, sVidCtx, nSid,
+                           nUid, nRoomId, m_nWidth, m_nHeight, m_nFrameRate, fCamScore))
     {
         obs_error("Error connecting to server");
-        Stop(false);
-        obs_output_set_last_error(m_pOutput, "Connection Failed\n\n");
-        obs_output_signal_stop(m_pOutput, OBS_OUTPUT_CONNECT_FAILED);
+        PostStopOutput("Connection Failed\n\n", OBS_OUTPUT_CONNECT_FAILED);
         return false;
     }
 
@@ -569,10 +854,74 @@ bool WebRTCStream::OpenWebsocketConnection()
 }
 
 
+std::shared_ptr<WebsocketClient> WebRTCStream::WsClient()
+{
+    MutexLock lock(&wsMutex_);
+    return m_pWsClient;
+}
+
+
+bool WebRTCStream::RetireWsSession()
+{
+    if (wsListener_)
+        wsListener_->Detach();
+    if (m_pWsClient || wsListener_)
+        retiredWsSessions_.push_back({std::move(m_pWsClient), std::move(wsListener_)});
+    m_pWsClient = nullptr;
+
+    // A client whose thread has exited makes no more listener calls.
+    retiredWsSessions_.erase(std::remove_if(retiredWsSessions_.begin(), retiredWsSessions_.end(),
+                                            [](const RetiredWsSession& retired)
+                                            {
+                                                return !retired.client || retired.client->closed();
+                                            }),
+                             retiredWsSessions_.end());
+    return retiredWsSessions_.empty();
+}
+
+
 void WebRTCStream::onConnected()
 {
-    obs_info("SETTING LOCAL DESCRIPTION\n\n");
-    pc_->SetLocalDescription(this);
+    timeline_.Mark(StartupTimeline::kWsAuthenticated);
+    {
+        MutexLock lock(&startupMutex_);
+        wsAuthenticated_ = true;
+    }
+    MaybeSetLocalDescription();
+}
+
+
+void WebRTCStream::MaybeSetLocalDescription()
+{
+    scoped_refptr<PeerConnectionInterface> pc;
+    {
+        MutexLock lock(&startupMutex_);
+        if (!pcReady_ || !wsAuthenticated_ || offerRequested_)
+            return;
+        offerRequested_ = true;
+        pc = pc_;
+    }
+
+    obs_info("SETTING LOCAL DESCRIPTION (tracks added +%lld ms, ws authenticated +%lld ms)\n\n",
+             (long long)timeline_.Elapsed(StartupTimeline::kTracksAdded),
+             (long long)timeline_.Elapsed(StartupTimeline::kWsAuthenticated));
+    ResetTrickle();
+    pc->SetLocalDescription(this);
+}
+
+
+void WebRTCStream::LogStartupTimeline()
+{
+    // Once per Start(), when both go-live signals are in, whichever is last.
+    if (!timeline_.IsMarked(StartupTimeline::kReadyToBroadcast)
+        || !timeline_.IsMarked(StartupTimeline::kIceConnected)
+        || timelineLogged_.exchange(true))
+        return;
+
+    obs_info("startup timeline:  %s", timeline_.ToString().c_str());
+    obs_info("startup go-live:   %lld ms (pc/ws overlap %lld ms)",
+             (long long)timeline_.Elapsed(StartupTimeline::kReadyToBroadcast),
+             (long long)timeline_.OverlapMs());
 }
 
 
@@ -581,19 +930,13 @@ void WebRTCStream::OnSetLocalDescriptionComplete(RTCError error)
     if (error.ok())
     {
         obs_info("\nLocal Description set\n");
+        timeline_.Mark(StartupTimeline::kLocalDescriptionSet);
         SendOffer(pc_->local_description());
     }
     else
     {
         obs_error("\nError setting Local Description: %s\n", error.message());
-        // Close must be carried out on a separate thread in order to avoid deadlock
-        auto thread = std::thread([=]()
-        {
-            Stop(false);
-            obs_output_set_last_error(m_pOutput, "Error setting Remote Description\n\n");
-            obs_output_signal_stop(m_pOutput, OBS_OUTPUT_ERROR);
-        });
-        thread.detach();
+        PostStopOutput("Error setting Local Description\n\n", OBS_OUTPUT_ERROR);
     }
 }
 
@@ -611,16 +954,54 @@ void WebRTCStream::SendOffer(const SessionDescriptionInterface* desc)
     vector<int> audioPayloads;
     vector<int> videoPayloads;
 
-    SDPUtil::ForcePayload(sdp, audioPayloads, videoPayloads, m_sAudioCodec, m_sVideoCodec, 0, "42e01f", 0);
-    SDPUtil::ConstrainVideoBitrate(sdp, m_nVideoBitrateKbps, m_nFrameRate);
-    SDPUtil::ConstrainAudioBitrateAS(sdp, m_nAudioBitrateKbps, false);
-    SDPUtil::EnableStereo(sdp);
-    SDPUtil::RemoveRtcpFb(sdp, "transport-cc");
-    SDPUtil::RemoveLinesContaining(sdp, "transport-wide-cc");
+    // Parsed once; every edit below works on the typed model.
+    SDPModel offer(sdp);
+    offer.ForcePayload(audioPayloads, videoPayloads, m_sAudioCodec, m_sVideoCodec,
+                       WEBRTCSTREAM_H264_PACKETIZATION_MODE, "42e01f", 0);
+#if WEBRTCSTREAM_ENABLE_SIMULCAST
+    // The session bandwidth must cover every rendition, not just the top one.
+    int simulcastKbps = 0;
+    for (const auto& encoding : SimulcastEncodings(m_nHeight, m_nFrameRate, m_nVideoBitrateKbps))
+        simulcastKbps += *encoding.max_bitrate_bps / 1000;
+    offer.ConstrainVideoBitrate(simulcastKbps, m_nFrameRate);
+#else
+    offer.ConstrainVideoBitrate(m_nVideoBitrateKbps, m_nFrameRate);
+#endif
+    offer.ConstrainAudioBitrateAS(m_nAudioBitrateKbps, false);
+    offer.EnableStereo();
+#if !WEBRTCSTREAM_TRANSPORT_CC
+    offer.RemoveRtcpFb("transport-cc");
+    offer.RemoveLinesContaining("transport-wide-cc");
+#endif
+    sdp = offer.ToString();
 
     obs_info("Sending OFFER (SDP) to remote peer:\n\n%s", sdp.c_str());
-    if (m_pWsClient->sendSdp(sdp, m_sVideoCodec))
+    auto wsClient = WsClient();
+    if (wsClient && wsClient->sendSdp(sdp, m_sVideoCodec))
+    {
+        timeline_.Mark(StartupTimeline::kOfferSent);
         obs_info("Offer successfully sent to remote peer");
+
+        MutexLock lock(&trickleMutex_);
+        offerSent_ = true;
+        std::istringstream lines(sdp);
+        string line;
+        while (std::getline(lines, line))
+        {
+            if (line.compare(0, 12, "a=candidate:") != 0)
+                continue;
+            if (line.back() == '\r')
+                line.pop_back();
+            offeredCandidates_.push_back(line.substr(2));
+        }
+#if WEBRTCSTREAM_TRICKLE_ICE
+        for (const auto& pending : pendingCandidates_)
+            TrickleCandidate(pending);
+        if (gatheringComplete_)
+            wsClient->trickle("", "", -1, true);
+#endif
+        pendingCandidates_.clear();
+    }
     else
         obs_warn("Failed to send offer to remote peer!");
 }
@@ -655,6 +1036,7 @@ void WebRTCStream::SetBitrate()
 
 void WebRTCStream::onAnswer(const string& sdp)
 {
+    timeline_.Mark(StartupTimeline::kAnswerReceived);
     obs_info("ANSWER:\n\n%s\n", sdp.c_str());
 
     SdpParseError error;
@@ -665,6 +1047,16 @@ void WebRTCStream::onAnswer(const string& sdp)
         return;
     }
 
+#if WEBRTCSTREAM_TRANSPORT_CC
+    // The server may still answer without transport-cc; GCC then runs on
+    // REMB and loss only, and the encoder keeps its own loss/RTT scaling.
+    const bool transportCc = sdp.find("transport-cc") != string::npos;
+    obs_info("Congestion control: %s", transportCc ? "transport-cc (GCC)" : "REMB (transport-cc not accepted)");
+    X264Encoder::SetSendSideBwe(transportCc);
+#else
+    X264Encoder::SetSendSideBwe(false);
+#endif
+
     obs_info("\nSETTING REMOTE DESCRIPTION\n\n%s", sdp.c_str());
     pc_->SetRemoteDescription(std::move(answer), this);
 }
@@ -672,14 +1064,77 @@ void WebRTCStream::onAnswer(const string& sdp)
 
 void WebRTCStream::OnIceCandidate(const IceCandidateInterface* candidate)
 {
-    string str;
-    candidate->ToString(&str);
+    timeline_.Mark(StartupTimeline::kFirstLocalCandidate);
+
+    LocalCandidate local;
+    candidate->ToString(&local.candidate);
+    local.mid = candidate->sdp_mid();
+    local.index = candidate->sdp_mline_index();
+
+    MutexLock lock(&trickleMutex_);
+    ++candidatesGathered_;
+#if WEBRTCSTREAM_TRICKLE_ICE
+    // The server must have the offer before any candidate.
+    if (offerSent_)
+        TrickleCandidate(local);
+    else
+        pendingCandidates_.push_back(std::move(local));
+#endif
+}
+
+
+void WebRTCStream::TrickleCandidate(const LocalCandidate& local)
+{
+    if (std::find(offeredCandidates_.begin(), offeredCandidates_.end(), local.candidate) != offeredCandidates_.end())
+        return;
+    auto wsClient = WsClient();
+    if (wsClient && wsClient->trickle(local.candidate, local.mid, local.index, false))
+        ++candidatesTrickled_;
+}
 
-    const string mid = candidate->sdp_mid();
-    const int mline_index = candidate->sdp_mline_index();
 
-    // Send candidate to remote peer
-    m_pWsClient->trickle(str, mid, mline_index, false);
+void WebRTCStream::ResetTrickle()
+{
+    MutexLock lock(&trickleMutex_);
+    offerSent_ = false;
+    gatheringComplete_ = false;
+    pendingCandidates_.clear();
+    offeredCandidates_.clear();
+    candidatesGathered_ = 0;
+    candidatesTrickled_ = 0;
+}
+
+
+void WebRTCStream::OnIceGatheringChange(PCI::IceGatheringState state)
+{
+    if (state != PCI::kIceGatheringComplete)
+        return;
+
+    const bool startup = !timeline_.IsMarked(StartupTimeline::kIceGatheringComplete);
+    timeline_.Mark(StartupTimeline::kIceGatheringComplete);
+
+    uint32_t gathered = 0, offered = 0, trickled = 0;
+    {
+        MutexLock lock(&trickleMutex_);
+        gatheringComplete_ = true;
+#if WEBRTCSTREAM_TRICKLE_ICE
+        auto wsClient = WsClient();
+        if (offerSent_ && wsClient)
+            wsClient->trickle("", "", -1, true);
+#endif
+        gathered = candidatesGathered_;
+        offered = (uint32_t)offeredCandidates_.size();
+        trickled = candidatesTrickled_;
+    }
+
+    obs_info("ICE gathering complete: %u candidates, %u in the offer, %u trickled (%s)",
+             gathered, offered, trickled, pooledCandidates_ ? "pre-gathered pool" : "gathered on offer");
+    // What a complete (non-trickle) offer would have waited for.
+    if (startup && timeline_.GatheringWaitMs() >= 0)
+        obs_info("startup gathering: +%lld ms (first candidate +%lld ms), offer sent %lld ms earlier",
+                 (long long)timeline_.Elapsed(StartupTimeline::kIceGatheringComplete),
+                 (long long)timeline_.Elapsed(StartupTimeline::kFirstLocalCandidate),
+                 (long long)timeline_.GatheringWaitMs());
 }
 
 
@@ -710,21 +1165,24 @@ void WebRTCStream::onRemoteIceCandidate(const string& candidate, const string& m
     cricket::Candidate c;
     webrtc::SdpDeserializeCandidate(mid, s, &c, &error);
 
-    if (SDPUtil::IsProtocol(s, "TCP"))
+    std::shared_future<MFCEdgeIngest::SiteIpPort> edgeIngest;
     {
-        string site = m_sRegion;
+        MutexLock lock(&edgeIngestMutex_);
+        edgeIngest = edgeIngest_;
+    }
+
+    if (SDPUtil::IsProtocol(s, "TCP") && edgeIngest.valid())
+    {
+        // Don't hold up the websocket thread on a slow lookup; an unresolved
+        // site leaves the candidate as sent.
+        const int64_t waitStartMs = rtc::TimeMillis();
         MFCEdgeIngest::SiteIpPort edge;
-        if (m_sRegion.empty())
-        {
-            edge = MFCEdgeIngest::WebrtcTcpIpPort(m_sVideoServer);
-            site = edge.site;
-        }
-        else if (!SDPUtil::CaseInsStringCompare(m_sRegion, "TUK")
-                 && !SDPUtil::CaseInsStringCompare(m_sRegion, "ORD"))
-        {
-            edge = MFCEdgeIngest::WebrtcTcpIpPort(m_sVideoServer, m_sRegion);
-            site = edge.site;
-        }
+        if (edgeIngest.wait_for(std::chrono::milliseconds(kEdgeIngestWaitMs)) == std::future_status::ready)
+            edge = edgeIngest.get();
+        const string& site = edge.site;
+        obs_info("edge ingest: %s (waited %lld ms)", site.empty() ? "unresolved" : site.c_str(),
+                 (long long)(rtc::TimeMillis() - waitStartMs));
+
         if (!edge.tcpIp.empty() && edge.port > 0
             && !SDPUtil::CaseInsStringCompare(site, "TUK")
             && !SDPUtil::CaseInsStringCompare(site, "ORD"))
@@ -759,22 +1217,28 @@ void WebRTCStream::OnSetRemoteDescriptionComplete(RTCError error)
     if (!error.ok())
     {
         obs_error("\nError setting Remote Description: %s\n", error.message());
-        // Close must be carried out on a separate thread in order to avoid deadlock
-        auto thread = std::thread([=]()
-        {
-            Stop(false);
-            obs_output_set_last_error(m_pOutput, "Error setting Remote Description\n\n");
-            obs_output_signal_stop(m_pOutput, OBS_OUTPUT_ERROR);
-        });
-        thread.detach();
+        PostStopOutput("Error setting Remote Description\n\n", OBS_OUTPUT_ERROR);
+        return;
     }
 
     obs_info("\nRemote Description set\n");
+    timeline_.Mark(StartupTimeline::kRemoteDescriptionSet);
 }
 
 
 void WebRTCStream::onReadyToStartBroadcast()
 {
+    timeline_.Mark(StartupTimeline::kReadyToBroadcast);
+    LogStartupTimeline();
+
+    // A websocket session opened by recovery reports ready again; capture and
+    // the encoder never stopped.
+    if (dataCaptureStarted_.exchange(true))
+    {
+        obs_info("Broadcast resumed on new websocket session");
+        return;
+    }
+
     ConfigureAPM(apm_);
 
 #if WEBRTCSTREAM_USE_BITRATE_SETTINGS
@@ -796,7 +1260,8 @@ void WebRTCStream::onReadyToStartBroadcast()
     {
         if (obs_output_start(m_pVirtualCam))
         {
-            g_ctx.sm_edgeSock->sendVirtualCameraState(true);
+            if (g_ctx.sm_edgeSock)
+                g_ctx.sm_edgeSock->sendVirtualCameraState(true);
             obs_info("Virtual Camera active");
         }
         else obs_warn("Failed to activate Virtual Camera");
@@ -810,8 +1275,9 @@ void WebRTCStream::onAudioFrame(audio_data* frame)
     if (!frame || !adm_)
         return;
 
-    worker_->Invoke<void>(
-        RTC_FROM_HERE, [this,frame]() { adm_->onIncomingData(frame->data[0], frame->frames); });
+    // Hand off to the ADM's lock-free ring; the OBS audio thread must never
+    // wait on the WebRTC worker thread.
+    adm_->onIncomingData(frame->data[0], frame->frames);
 }
 
 
@@ -834,16 +1300,31 @@ void WebRTCStream::OnIceConnectionChange(PeerConnectionInterface::IceConnectionS
 
     switch (state)
     {
+    case PeerConnectionInterface::IceConnectionState::kIceConnectionConnected:
+    case PeerConnectionInterface::IceConnectionState::kIceConnectionCompleted:
+    {
+        timeline_.Mark(StartupTimeline::kIceConnected);
+        LogStartupTimeline();
+
+        const Recovery stage = recovery_.exchange(Recovery::kNone);
+        if (stage != Recovery::kNone)
+        {
+            ++recoveryGeneration_;  // cancel the stage timer
+            ++recoveries_;
+            obs_info("Connection recovered in %lld ms (%s)",
+                     (long long)(rtc::TimeMillis() - recoveryStartMs_.load()), RecoveryName(stage));
+        }
+        break;
+    }
+    case PeerConnectionInterface::IceConnectionState::kIceConnectionDisconnected:
+        BeginRecovery(Recovery::kIceRestart, "ICE disconnected");
+        break;
     case PeerConnectionInterface::IceConnectionState::kIceConnectionFailed:
     {
+        if (BeginRecovery(Recovery::kIceRestart, "ICE failed"))
+            break;
         obs_error("Ice Connection Failed");
-        // Close must be carried out on a separate thread in order to avoid deadlock
-        auto thread = std::thread([=]()
-        {
-            obs_output_set_last_error(m_pOutput, "Ice Connection Failed\n\n");
-            obs_output_signal_stop(m_pOutput, OBS_OUTPUT_ERROR);
-        });
-        thread.detach();
+        PostStopOutput("Ice Connection Failed\n\n", OBS_OUTPUT_ERROR);
         break;
     }
     default:
@@ -860,14 +1341,10 @@ void WebRTCStream::OnConnectionChange(PeerConnectionInterface::PeerConnectionSta
     {
     case PeerConnectionInterface::PeerConnectionState::kFailed:
     {
+        if (BeginRecovery(Recovery::kIceRestart, "connection failed"))
+            break;
         obs_error("Connection Failed");
-        // Close must be carried out on a separate thread in order to avoid deadlock
-        auto thread = std::thread([=]()
-        {
-            obs_output_set_last_error(m_pOutput, "Connection Failed\n\n");
-            obs_output_signal_stop(m_pOutput, OBS_OUTPUT_ERROR);
-        });
-        thread.detach();
+        PostStopOutput("Connection Failed\n\n", OBS_OUTPUT_ERROR);
         break;
     }
     default:
@@ -977,6 +1454,11 @@ void WebRTCStream::OnStatsDelivered(const scoped_refptr<const RTCStatsReport>& r
             avg_video_bitrate_ = ((video_bytes_sent_ - prev_video_bytes_) * 8 / (uint32_t)(prev_outbound_delta_t * 1000));
 
             obs_info("date + time:       %s",       oss.str().c_str());
+            obs_info("go-live:           %lld ms (pc/ws overlap %lld ms)",
+                     (long long)timeline_.Elapsed(StartupTimeline::kReadyToBroadcast),
+                     (long long)timeline_.OverlapMs());
+            obs_info("recoveries:        %u (%u ICE restarts, %u renegotiations)",
+                     recoveries_.load(), iceRestarts_.load(), renegotiations_.load());
             obs_info("timestamp:         %lld",     outbound_time_us_);
             obs_info("frame size:        %u x %u",  frame_width_, frame_height_);
             obs_info("fps out:           %f",       outbound_fps_);
@@ -997,6 +1479,68 @@ void WebRTCStream::OnStatsDelivered(const scoped_refptr<const RTCStatsReport>& r
             obs_info("NACK received:     %u",       nack_received_);
             obs_info("packet send delay: %d",       (int)round(total_pkt_send_delay_ / packets_sent_ * 1000));
 
+            if (adm_)
+            {
+                auto audio = adm_->GetStats();
+                obs_info("audio chunks sent: %llu",     (unsigned long long)audio.chunksDelivered);
+                obs_info("audio overruns:    %llu",     (unsigned long long)audio.overruns);
+                obs_info("audio underruns:   %llu",     (unsigned long long)audio.underruns);
+                obs_info("audio buffered ms: %zu",      audio.bufferedMs);
+            }
+
+            if (videoSource_)
+            {
+                auto pool = videoSource_->GetPoolStats();
+                obs_info("frame pool hits:   %llu",     (unsigned long long)pool.hits);
+                obs_info("frame pool misses: %llu",     (unsigned long long)pool.misses);
+                obs_info("frame pool full:   %llu",     (unsigned long long)pool.exhausted);
+                obs_info("frame pool size:   %zu",      pool.allocated);
+
+                auto scene = videoSource_->GetStaticSceneStats();
+                obs_info("static scene:      %s",       scene.isStatic ? "yes" : "no");
+                obs_info("static time:       %llu ms (%llu periods)", (unsigned long long)scene.staticMs,
+                         (unsigned long long)scene.staticPeriods);
+                obs_info("static skipped:    %llu",     (unsigned long long)scene.skippedFrames);
+            }
+
+            auto queue = X264Encoder::GetQueueStats();
+            obs_info("encoded frames:    %llu",     (unsigned long long)queue.encoded);
+            obs_info("encode queue:      %zu",      queue.depth);
+            obs_info("encode q dropped:  %llu",     (unsigned long long)queue.dropped);
+            obs_info("encode q wait avg: %.1f ms",  queue.avgWaitMs);
+            obs_info("encode q wait max: %lld ms",  (long long)queue.maxWaitMs);
+
+            auto rate = X264Encoder::GetRateControlStats();
+            obs_info("rate ctrl state:   %s",       RateController::StateName(rate.controller.state));
+            obs_info("rate ctrl scale:   %.2f",     rate.controller.scale);
+            obs_info("rate ctrl target:  %u kbps",  rate.targetKbps);
+            obs_info("rate ctrl applied: %u kbps",  rate.appliedKbps);
+            obs_info("rate ctrl bwe:     %u kbps (%s)", rate.bandwidthKbps, rate.sendSideBwe ? "transport-cc" : "remb");
+            obs_info("rate ctrl loss:    %.1f%%",   rate.controller.lossRate * 100.0f);
+            obs_info("rate ctrl rtt:     %lld ms (min %lld ms)", (long long)rate.controller.rttMs, (long long)rate.controller.minRttMs);
+            obs_info("rate ctrl backoff: %llu",     (unsigned long long)rate.controller.backoffs);
+
+            auto packets = X264Encoder::GetPacketRateStats();
+            obs_info("packets/sec:       %u (%u frames)", packets.packets, packets.frames);
+            obs_info("packets/frame max: %u (%u bytes)", packets.maxPacketsPerFrame, packets.maxFrameBytes);
+            obs_info("idr frames/sec:    %u",       packets.idrFrames);
+            obs_info("refresh waves/sec: %u",       packets.refreshWaves);
+
+            auto keyRequests = X264Encoder::GetKeyFrameRequestStats();
+            obs_info("key req honored:   %llu",     (unsigned long long)keyRequests.honored);
+            obs_info("key req merged:    %llu",     (unsigned long long)keyRequests.merged);
+            obs_info("key req ignored:   %llu (%llu refresh waves)", (unsigned long long)keyRequests.ignored,
+                     (unsigned long long)keyRequests.refreshWaves);
+
+            auto telemetry = X264Encoder::TakeTelemetryHistograms();
+            obs_info("key frames:        %llu (%llu bytes)", (unsigned long long)telemetry.keyFrames, (unsigned long long)telemetry.keyBytes);
+            obs_info("delta frames:      %llu (%llu bytes)", (unsigned long long)telemetry.deltaFrames, (unsigned long long)telemetry.deltaBytes);
+            obs_info("encoder dropped:   %llu",     (unsigned long long)telemetry.droppedFrames);
+            obs_info("encode max:        %llu ms",  (unsigned long long)telemetry.maxEncodeMs);
+            std::istringstream histograms(telemetry.ToString());
+            for (std::string line; std::getline(histograms, line);)
+                obs_info("%s", line.c_str());
+
             prev_video_bytes_   = video_bytes_sent_;
             prev_timestamp_     = outbound_time_us_;
 
@@ -1011,18 +1555,28 @@ void WebRTCStream::OnStatsDelivered(const scoped_refptr<const RTCStatsReport>& r
 void WebRTCStream::onAuthFailure()
 {
     obs_info(__FUNCTION__);
-    Stop(false);
-    obs_output_set_last_error(m_pOutput, "Authentication Failed\n\n");
-    obs_output_signal_stop(m_pOutput, OBS_OUTPUT_INVALID_STREAM);
+    PostStopOutput("Authentication Failed\n\n", OBS_OUTPUT_INVALID_STREAM);
 }
 
 
 void WebRTCStream::onConnectError()
 {
     obs_error(__FUNCTION__);
-    Stop(false);
-    obs_output_set_last_error(m_pOutput, "Websocket Connection Error\n\n");
-    obs_output_signal_stop(m_pOutput, OBS_OUTPUT_ERROR);
+
+    // While renegotiating, keep retrying until the stage times out: the
+    // network may not be back yet.
+    if (recovery_ == Recovery::kRenegotiate && !stopping_)
+    {
+        const uint32_t generation = recoveryGeneration_;
+        control_->PostDelayedTask(RTC_FROM_HERE, [this, generation]()
+        {
+            if (generation == recoveryGeneration_ && !stopping_)
+                ReopenWebsocket();
+        }, kWsRetryMs);
+        return;
+    }
+
+    PostStopOutput("Websocket Connection Error\n\n", OBS_OUTPUT_ERROR);
 }
 
 
@@ -1030,19 +1584,180 @@ void WebRTCStream::onDisconnected()
 {
     obs_info(__FUNCTION__);
 
-    if (close_async_.joinable())
-        close_async_.join();
+    {
+        MutexLock lock(&startupMutex_);
+        wsAuthenticated_ = false;
+    }
+    if (BeginRecovery(Recovery::kRenegotiate, "websocket closed"))
+        return;
 
-    // Close must be carried out on a separate thread in order to avoid deadlock
-    close_async_ = std::thread([&]()
+    PostStopOutput("Websocket Disconnected\n\n", OBS_OUTPUT_ERROR);
+}
+
+
+void WebRTCStream::PostStopOutput(const char* lastError, int code)
+{
+    // The first error of a failure storm is the one reported.
+    if (stopPending_.exchange(true))
     {
-        Stop(false);
-        obs_output_set_last_error(m_pOutput, "Websocket Disconnected\n\n");
-        obs_output_signal_stop(m_pOutput, OBS_OUTPUT_ERROR);
+        obs_info("Stop already pending, not queueing: %s", lastError);
+        return;
+    }
+
+    // Never run inline: callers are on WebRTC and websocket threads that
+    // Stop() tears down.
+    const uint32_t session = session_;
+    control_->PostTask(RTC_FROM_HERE, [this, session, lastError, code]()
+    {
+        // Skipped when the user stopped or restarted the stream meanwhile.
+        if (session != session_ || destroying_ || !started_)
+            return;
+        StopOnControl(false);
+        obs_output_set_last_error(m_pOutput, lastError);
+        obs_output_signal_stop(m_pOutput, code);
     });
 }
 
 
+// static
+const char* WebRTCStream::RecoveryName(Recovery stage)
+{
+    switch (stage)
+    {
+    case Recovery::kNone:           return "none";
+    case Recovery::kIceRestart:     return "ICE restart";
+    case Recovery::kRenegotiate:    return "renegotiation";
+    default:                        return "?";
+    }
+}
+
+
+bool WebRTCStream::BeginRecovery(Recovery stage, const char* reason)
+{
+#if WEBRTCSTREAM_FAST_RECONNECT
+    if (!dataCaptureStarted_ || stopping_)
+        return false;
+
+    // A queued request for this stage or a later one covers this one.
+    Recovery pending = pendingRecovery_;
+    do
+    {
+        if (pending >= stage)
+            return true;
+    } while (!pendingRecovery_.compare_exchange_weak(pending, stage));
+
+    const uint32_t session = session_;
+    control_->PostTask(RTC_FROM_HERE, [this, reason, session]()
+    {
+        const Recovery stage = pendingRecovery_.exchange(Recovery::kNone);
+        const Recovery current = recovery_;
+        if (stopping_ || destroying_ || stage == Recovery::kNone || current >= stage)
+            return;  // already at or past this stage; its timer escalates
+
+        if (current == Recovery::kNone)
+        {
+            recoveryStartMs_ = rtc::TimeMillis();
+            obs_warn("Connection lost (%s), recovering in-session", reason);
+        }
+        RunRecoveryStage(stage, session);
+    });
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void WebRTCStream::RunRecoveryStage(Recovery stage, uint32_t session)
+{
+    RTC_DCHECK(control_->IsCurrent());
+
+    // Start() rebuilds the PeerConnection under |startupMutex_|.
+    scoped_refptr<PeerConnectionInterface> pc;
+    bool wsUp = false;
+    {
+        MutexLock lock(&startupMutex_);
+        if (session == session_ && pcReady_)
+            pc = pc_;
+        wsUp = wsAuthenticated_;
+    }
+    if (!pc)
+    {
+        recovery_ = Recovery::kNone;  // the stream was stopped or restarted
+        return;
+    }
+
+    // An ICE restart needs the websocket to carry the offer.
+    if (stage == Recovery::kIceRestart && !wsUp)
+        stage = Recovery::kRenegotiate;
+
+    recovery_ = stage;
+    const uint32_t generation = ++recoveryGeneration_;
+
+    if (stage == Recovery::kIceRestart)
+    {
+        ++iceRestarts_;
+        obs_info("Recovery: ICE restart over the current websocket session");
+        pc->RestartIce();
+        ResetTrickle();
+        pc->SetLocalDescription(this);
+    }
+    else
+    {
+        ++renegotiations_;
+        obs_info("Recovery: new websocket session and offer");
+        {
+            MutexLock lock(&startupMutex_);
+            wsAuthenticated_ = false;
+            offerRequested_ = false;  // onConnected() makes the new offer
+        }
+        pc->RestartIce();
+        ReopenWebsocket();
+    }
+
+    control_->PostDelayedTask(RTC_FROM_HERE, [this, generation, session]()
+    {
+        OnRecoveryTimeout(generation, session);
+    }, stage == Recovery::kIceRestart ? kIceRestartTimeoutMs : kRenegotiateTimeoutMs);
+}
+
+
+void WebRTCStream::OnRecoveryTimeout(uint32_t generation, uint32_t session)
+{
+    if (generation != recoveryGeneration_ || recovery_ == Recovery::kNone || stopping_)
+        return;
+
+    if (recovery_ == Recovery::kIceRestart)
+    {
+        obs_warn("Recovery: ICE restart timed out");
+        RunRecoveryStage(Recovery::kRenegotiate, session);
+        return;
+    }
+
+    obs_error("Recovery failed after %lld ms, stopping output",
+              (long long)(rtc::TimeMillis() - recoveryStartMs_.load()));
+    recovery_ = Recovery::kNone;
+    PostStopOutput("Reconnect Failed\n\n", OBS_OUTPUT_DISCONNECTED);
+}
+
+
+void WebRTCStream::ReopenWebsocket()
+{
+    std::shared_ptr<WebsocketClient> wsClient;
+    {
+        // Detach first so the old session's close is not taken as a new loss.
+        MutexLock lock(&wsMutex_);
+        if (wsListener_)
+            wsListener_->Detach();
+        wsClient = m_pWsClient;
+    }
+    if (wsClient)
+        wsClient->disconnect(false);
+
+    OpenWebsocketConnection();
+}
+
+
 #if 0
 void WebRTCStream::OnFailure(RTCError error)
 {
@@ -27,9 +27,11 @@
 
 // project
 #include "ADMWrapper.h"
+#include "StartupTimeline.h"
 #include "VideoTrackSource.h"
 
 // solution
+#include <libPlugins/MFCEdgeIngest.h>
 #include <websocket-client/WebsocketClient.h>
 
 // obs
@@ -49,10 +51,11 @@
 #include "rtc_base/thread.h"
 #include "rtc_base/thread_annotations.h"
 
+#include <atomic>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <string>
-#include <thread>
 #include <vector>
 
 
@@ -63,6 +66,50 @@ public:
 };
 
 
+/// Forwards one websocket session's callbacks to the stream. A session that
+/// is replaced during recovery is detached first, so late callbacks from it
+/// (close, errors) are dropped instead of acting on its successor.
+class WsSessionListener : public WebsocketClient::Listener
+{
+public:
+    explicit WsSessionListener(WebsocketClient::Listener* target) : target_(target) {}
+
+    void Detach() { target_ = nullptr; }
+
+    void onConnected() override
+    {
+        if (auto target = target_.load()) target->onConnected();
+    }
+    void onAnswer(const std::string& sdp) override
+    {
+        if (auto target = target_.load()) target->onAnswer(sdp);
+    }
+    void onRemoteIceCandidate(const std::string& candidate, const std::string& mid, int index) override
+    {
+        if (auto target = target_.load()) target->onRemoteIceCandidate(candidate, mid, index);
+    }
+    void onReadyToStartBroadcast() override
+    {
+        if (auto target = target_.load()) target->onReadyToStartBroadcast();
+    }
+    void onAuthFailure() override
+    {
+        if (auto target = target_.load()) target->onAuthFailure();
+    }
+    void onConnectError() override
+    {
+        if (auto target = target_.load()) target->onConnectError();
+    }
+    void onDisconnected() override
+    {
+        if (auto target = target_.load()) target->onDisconnected();
+    }
+
+private:
+    std::atomic<WebsocketClient::Listener*> target_;
+};
+
+
 class WebRTCStreamInterface
     : public WebsocketClient::Listener
     , public webrtc::PeerConnectionObserver
@@ -83,9 +130,33 @@ public:
 
     void ResetStats();
     void ConfigureStreamParameters();
+    void ResolveEdgeIngest();
     bool CreatePeerConnection();
     bool AddTracks();
     bool OpenWebsocketConnection();
+    void MaybeSetLocalDescription();
+    void LogStartupTimeline();
+
+    /// In-session recovery stages, escalated in order. kNone when healthy.
+    enum class Recovery
+    {
+        kNone,
+        kIceRestart,    // new ICE credentials, offer over the current websocket
+        kRenegotiate,   // new websocket session, then a new offer
+    };
+    static const char* RecoveryName(Recovery stage);
+
+#ifdef SIDEKICK_STREAM_BENCH
+    /// Signaling URL used instead of the video server's, so the stream bench
+    /// can reach its local stand-in. Bench builds only: the URL must never
+    /// come from the config, which the server fills.
+    static void SetBenchWsUrl(const std::string& url);
+#endif
+
+    /// Starts (or escalates to) |stage| of recovery on the control thread.
+    /// Returns false when the stream is not live or is stopping, in which case
+    /// the caller tears the output down as before. Any thread.
+    bool BeginRecovery(Recovery stage, const char* reason);
     void SendOffer(const webrtc::SessionDescriptionInterface* desc);
     void SetBitrate();
 
@@ -111,7 +182,7 @@ public:
     void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState /*new_state*/) override {}
     void OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> /*channel*/) override {}
     void OnRenegotiationNeeded() override {}
-    void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState /*new_state*/) override {}
+    void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState state) override;
     void OnIceCandidatesRemoved(const std::vector<cricket::Candidate>& /*candidates*/) override {}
     void OnAddTrack(rtc::scoped_refptr<webrtc::RtpReceiverInterface> /*receiver*/,
                     const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>& /*streams*/) override {}
@@ -142,10 +213,28 @@ public:
     int packetsLost() const { return packets_lost_; }
     int packetsSent() const { return (int)packets_sent_; }
 
+    const StartupTimeline& startupTimeline() const { return timeline_; }
+
 private:
     obs_output_t* m_pOutput;  // OBS stream output
     obs_output_t* m_pVirtualCam;
-    std::unique_ptr<WebsocketClient> m_pWsClient;
+
+    // Websocket session. Start() and recovery on |control_| replace it while
+    // the signaling and websocket threads send on it, so senders take a
+    // reference with WsClient() rather than using |m_pWsClient| directly.
+    struct RetiredWsSession
+    {
+        std::shared_ptr<WebsocketClient> client;
+        std::unique_ptr<WsSessionListener> listener;
+    };
+    std::shared_ptr<WebsocketClient> WsClient();
+    bool RetireWsSession() RTC_EXCLUSIVE_LOCKS_REQUIRED(wsMutex_);
+    webrtc::Mutex wsMutex_;
+    std::shared_ptr<WebsocketClient> m_pWsClient RTC_GUARDED_BY(wsMutex_);
+    std::unique_ptr<WsSessionListener> wsListener_ RTC_GUARDED_BY(wsMutex_);
+    // Replaced sessions, kept until their client thread has exited: it may
+    // still call the detached listener, and it runs on the client object.
+    std::vector<RetiredWsSession> retiredWsSessions_ RTC_GUARDED_BY(wsMutex_);
 
     int m_nWidth;
     int m_nHeight;
@@ -157,15 +246,77 @@ private:
     std::string m_sVideoServer;
     std::string m_sProtocol;
     std::string m_sRegion;
+    // TCP candidate override, resolved from Start(); invalid if not needed.
+    webrtc::Mutex edgeIngestMutex_;
+    std::shared_future<MFCEdgeIngest::SiteIpPort> edgeIngest_ RTC_GUARDED_BY(edgeIngestMutex_);
 
     mutable webrtc::Mutex mutex_;
 
+    // Startup join: the websocket handshake runs on its own thread while
+    // Start() builds the PeerConnection, and the offer is made once both are
+    // done. Start() holds |startupMutex_| across the build so a websocket
+    // error cannot tear down a half-built PeerConnection.
+    webrtc::Mutex startupMutex_;
+    bool pcReady_ RTC_GUARDED_BY(startupMutex_);
+    bool wsAuthenticated_ RTC_GUARDED_BY(startupMutex_);
+    bool offerRequested_ RTC_GUARDED_BY(startupMutex_);
+    StartupTimeline timeline_;
+    std::atomic<bool> timelineLogged_;
+
+    // Outbound trickle ICE, reset for every offer. Candidates found before
+    // the offer is sent are held, then sent unless the offer carried them.
+    struct LocalCandidate
+    {
+        std::string candidate;
+        std::string mid;
+        int index;
+    };
+    void ResetTrickle();
+    void TrickleCandidate(const LocalCandidate& local) RTC_EXCLUSIVE_LOCKS_REQUIRED(trickleMutex_);
+    webrtc::Mutex trickleMutex_;
+    bool offerSent_ RTC_GUARDED_BY(trickleMutex_);
+    bool gatheringComplete_ RTC_GUARDED_BY(trickleMutex_);
+    std::vector<LocalCandidate> pendingCandidates_ RTC_GUARDED_BY(trickleMutex_);
+    std::vector<std::string> offeredCandidates_ RTC_GUARDED_BY(trickleMutex_);
+    uint32_t candidatesGathered_ RTC_GUARDED_BY(trickleMutex_);
+    uint32_t candidatesTrickled_ RTC_GUARDED_BY(trickleMutex_);
+    bool pooledCandidates_;  // the PeerConnection took the WarmPool's pre-gathered candidates
+
+    // Control plane: error stops, recovery stages, their timers and retries,
+    // and Stop() itself run one at a time on |control_|, one thread per
+    // stream. A queued stop covers any later request to stop, and a queued
+    // recovery any request for the same or an earlier stage. The destructor
+    // runs what is queued, then drops pending timers.
+    void PostStopOutput(const char* lastError, int code);
+    bool StopOnControl(bool normal);
+    std::unique_ptr<rtc::Thread> control_;
+    std::atomic<uint32_t> session_;  // bumped by Start(); stale stops are skipped
+    std::atomic<bool> stopPending_;
+    std::atomic<Recovery> pendingRecovery_;
+    std::atomic<bool> destroying_;
+
+    // Recovery state machine. Stages run on |control_|; a stage bumps
+    // |recoveryGeneration_| so timers of earlier stages are ignored.
+    void RunRecoveryStage(Recovery stage, uint32_t session);
+    void OnRecoveryTimeout(uint32_t generation, uint32_t session);
+    void ReopenWebsocket();
+    std::atomic<Recovery> recovery_;
+    std::atomic<uint32_t> recoveryGeneration_;
+    std::atomic<bool> dataCaptureStarted_;  // the stream is live
+    // Written on |control_| and the signaling thread, read by the stats log.
+    std::atomic<int64_t> recoveryStartMs_;
+    std::atomic<uint32_t> recoveries_;
+    std::atomic<uint32_t> iceRestarts_;
+    std::atomic<uint32_t> renegotiations_;
+
     int video_bitrate_bps_;
     int total_bitrate_bps_;
     uint16_t frame_id_;
 
-    bool started_;
-    bool stopping_;
+    // Written by Start() and StopOnControl(), read by the websocket,
+    // signaling and control threads.
+    std::atomic<bool> started_;
+    std::atomic<bool> stopping_;
 
     // Outbound RTP Stream Stats
     int64_t outbound_time_us_;
@@ -203,11 +354,10 @@ private:
     int rtt_;
     double jitter_;
 
-    std::thread close_async_;
-
-    std::unique_ptr<rtc::Thread> network_;
-    std::unique_ptr<rtc::Thread> worker_;
-    std::unique_ptr<rtc::Thread> signaling_;
+    // Owned by the WarmPool.
+    rtc::Thread* network_;
+    rtc::Thread* worker_;
+    rtc::Thread* signaling_;
 
     rtc::scoped_refptr<ADMWrapper> adm_;
     rtc::scoped_refptr<webrtc::AudioProcessing> apm_;
@@ -18,31 +18,50 @@
 #define WEBRTC_ADAPT_FRAME_ENABLED 0
 #define X264ENC_ENABLE_RECONFIGURE 1
 #define X264ENC_DISABLE_HRD 1
-#define X264ENC_ENABLE_FIR 0
+// Honor FIR/PLI key frame requests, coalesced and rate limited by KeyFrameArbiter.
+#define X264ENC_ENABLE_FIR 1
+// Refresh the picture with a rolling intra column over each GOP instead of a
+// periodic IDR. Key frame requests the arbiter ignores are then answered with
+// a refresh wave, and requested IDRs are spaced |kIntraRefreshIdrSpacingMs| apart.
+#define X264ENC_INTRA_REFRESH 0
 #define X264ENC_LOG_RTT 0
 #define X264ENC_VERBOSE_LOG 0
 #define X264ENC_TRELLIS 0
+// Run x264 on a dedicated thread behind a small drop-oldest queue instead of
+// inline on WebRTC's encoder queue.
+#define X264ENC_ASYNC_ENCODE 0
+// Step the x264 speed preset down/up when encode time exceeds/undercuts the frame budget.
+#define X264ENC_ADAPTIVE_PRESET 1
+// Scale the SetRates() target on packet loss / rising RTT (see RateController).
+#define X264ENC_RATE_CONTROL 1
 
 #include "X264Encoder.h"
 #include "SanitizeInputs.h"
 #include "webrtc_version.h"
 
 #include "absl/types/optional.h"
+#include "api/units/data_rate.h"
 #include "api/video/color_space.h"
+#include "api/video/nv12_buffer.h"
+#include "api/video/video_bitrate_allocator.h"
 #include "api/video/video_frame_buffer.h"
 #include "common_video/libyuv/include/webrtc_libyuv.h"
+#include "media/base/media_constants.h"
 #include "modules/video_coding/utility/simulcast_rate_allocator.h"
 #include "modules/video_coding/utility/simulcast_utility.h"
 #include "rtc_base/checks.h"
+#include "rtc_base/location.h"
 #include "rtc_base/logging.h"
 #include "rtc_base/time_utils.h"
 #include "system_wrappers/include/metrics.h"
 #include "video/video_stream_encoder.h"
 
 #include <algorithm>
+#include <atomic>
 #include <limits>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <cassert>
 
 using std::string;
@@ -64,10 +83,21 @@ using RangeID = ColorSpace::RangeID;
 #endif
 
 static const uint32_t kIDRIntervalSec   = 1;
-static const uint32_t kMaxFramerate     = 30;
+static const uint32_t kMaxFramerate     = 60;
 
-static const uint32_t kLongStartcodeSize  = 4;
-static const uint32_t kShortStartcodeSize = 3;
+// Key frame requests within this long of an IDR are answered by it.
+static const int64_t kKeyFrameCoalesceWindowMs  = 500;
+// Minimum time between requested IDRs. Wowza sends an FIR every second.
+static const int64_t kMinIdrSpacingMs           = 2000;
+static const int64_t kIntraRefreshIdrSpacingMs  = 5000;
+
+// In non-interleaved mode (FU-A) slices needn't fit a packet, so x264 cuts one
+// slice per sliced thread; auto thread counts are capped so a frame has at
+// most this many slices.
+static const int kMaxSlices = 4;
+
+// Frames waiting for the async encode thread; older frames are dropped first.
+static const size_t kMaxQueuedFrames    = 2;
 
 static const float kHighQualityCrf   = 18.0;
 static const float kNormalQualityCrf = 21.5;
@@ -79,6 +109,11 @@ static const int kMinBitrateKbpsHighQualityCrf = 1000;
 
 // Divide bitrate by |kVbvBufferSizeFactor| to determine VBV buffer size.
 static const int kVbvBufferSizeFactor = 2;
+// VBV buffer divisor while backing off; a smaller buffer keeps frame sizes
+// close to the reduced rate so a congested uplink isn't hit with bursts.
+static const int kCongestedVbvBufferSizeFactor = 4;
+// Ignore rate controller changes smaller than 1/|kRateChangeThreshold| of the current rate.
+static const int kRateChangeThreshold = 20;
 
 // Used by histograms. Values of entries should not be changed.
 enum X264EncoderEvent
@@ -89,6 +124,50 @@ enum X264EncoderEvent
 };
 
 
+// Encode queue counters. There is one active encoder per process, so these
+// are shared rather than per instance; GetQueueStats() reads them from the
+// stats logger thread. ResetSessionStats() clears these and the stats below
+// when a stream starts.
+static std::atomic<size_t>   g_queueDepth{0};
+static std::atomic<uint64_t> g_queueEncoded{0};
+static std::atomic<uint64_t> g_queueDropped{0};
+static std::atomic<int64_t>  g_queueWaitTotalMs{0};
+static std::atomic<int64_t>  g_queueWaitMaxMs{0};
+
+// Last rate controller snapshot, published from the encode path.
+static Mutex                         g_rateStatsMutex;
+static X264Encoder::RateControlStats g_rateStats{};
+static std::atomic<bool>             g_sendSideBwe{false};
+
+// Key frame request outcomes.
+static std::atomic<uint64_t> g_keyRequestsHonored{0};
+static std::atomic<uint64_t> g_keyRequestsMerged{0};
+static std::atomic<uint64_t> g_keyRequestsIgnored{0};
+static std::atomic<uint64_t> g_keyRequestRefreshes{0};
+
+// Last complete second of output packet counts.
+static Mutex                         g_packetStatsMutex;
+static X264Encoder::PacketRateStats  g_packetStats{};
+
+// Per-frame telemetry, written from every layer thread of every instance.
+static EncoderTelemetry g_telemetry;
+
+// Optional copy of the encoded output; see StartOutputTee().
+static Mutex                        g_teeMutex;
+static unique_ptr<EncodedFrameTee>  g_tee RTC_GUARDED_BY(g_teeMutex);
+
+// Encoder pre-opened by PrewarmEncoder(), with the parameters it was opened with.
+static Mutex        g_warmMutex;
+static x264_t*      g_warmEncoder RTC_GUARDED_BY(g_warmMutex) = nullptr;
+static x264_param_t g_warmParams RTC_GUARDED_BY(g_warmMutex);
+static string       g_warmPreset RTC_GUARDED_BY(g_warmMutex);
+static int64_t      g_warmParkedMs RTC_GUARDED_BY(g_warmMutex) = 0;
+
+// Payload size assumed for a pre-opened single NAL unit mode encoder; only
+// used to size slices, so a different negotiated size just misses the cache.
+static const size_t kPrewarmMaxPayloadSize = 1200;
+
+
 /// Round |num| to a multiple of |multiple|.
 template<typename T>
 inline T roundUp(T num, T multiple)
@@ -128,8 +207,12 @@ static VideoFrameType X264ToWebrtcFrameType(int type)
 
 static VideoFrameType WebrtcFrameType(const x264_picture_t* pictureOut)
 {
+#if !X264ENC_INTRA_REFRESH
+    // With intra refresh, b_keyframe marks recovery points, which receivers
+    // can't start decoding from; only IDRs are key frames then.
     if (pictureOut->b_keyframe)
         return VideoFrameType::kVideoFrameKey;
+#endif
 
     return X264ToWebrtcFrameType(pictureOut->i_type);
 }
@@ -165,81 +248,65 @@ static void X264Logger(void*, int level, const char* format, va_list args)
 
 /// Helper method used by X264Encoder::Encode.
 ///
-/// Fixes NALU start codes and copies the encoded bytes from |nal| to |encImg|.
+/// Fixes NALU start codes and places the encoded bytes from |nal| in |encImg|.
 ///
 /// After x264 encoding, the encoded bytes ("NAL units") are stored in |nal|. Each
 /// NAL unit is a fragment starting with a 3-byte (00 00 01) or 4-byte (00 00 00 01)
-/// start code.
+/// start code. x264 writes the NAL units of a frame back to back in one buffer, and
+/// |frameSize| (the x264_encoder_encode() result) is the sum of their sizes.
 ///
 /// LibWebRTC's H.264 decoder requires that all NALUs begin with a 4-byte start code.
 /// x264 uses 4-byte start codes for SPS, PPS, and the initial NALU. 3-byte start codes
 /// are used for all other NALUs.
 ///
-/// All of this data (including the start codes) is copied to |encImg->_buffer|.
-/// |encImg->_buffer| may be deleted and reallocated if a bigger buffer is required.
-static void RtpFragmentize(EncodedImage* encImg, uint32_t numNals, x264_nal_t* nal)
+/// When every NALU already has a 4-byte start code (a single-slice frame), |encImg|
+/// wraps x264's buffer without copying; it stays valid until the next encode. Otherwise
+/// the NALUs are written in one pass into a pooled buffer, padding short start codes.
+static void RtpFragmentize(EncodedBufferPool& pool, EncodedImage* encImg,
+                           uint32_t numNals, x264_nal_t* nal, int frameSize)
 {
-    size_t requiredCapacity = 0;
-    size_t fragmentsCount = 0;
+    RTC_CHECK_GE(frameSize, 0);
 
-    // Calculate minimum buffer size required to hold encoded data.
-    for (uint32_t idx = 0; idx < numNals; ++idx, ++fragmentsCount)
+    bool allLong = true;
+    for (uint32_t idx = 0; idx < numNals && allLong; ++idx)
     {
-        RTC_CHECK_GE(nal[idx].i_payload, 0);
-
-        // Ensure |requiredCapacity| will not overflow.
-        RTC_CHECK_LE((size_t)nal[idx].i_payload, std::numeric_limits<size_t>::max() - requiredCapacity);
-
-        requiredCapacity += nal[idx].i_payload;
-
-        // When a 3-byte start code (00 00 01) is found, increment |requiredCapacity| by 1.
-        if (!nal[idx].b_long_startcode)
-            ++requiredCapacity;
+        allLong = nal[idx].b_long_startcode
+                  && (idx == 0 || nal[idx].p_payload == nal[idx - 1].p_payload + nal[idx - 1].i_payload);
     }
 
-    // Allocate required bytes.
-    auto buffer = EncodedImageBuffer::Create(requiredCapacity);
-    encImg->SetEncodedData(buffer);
+    if (numNals == 0 || allLong)
+    {
+        encImg->SetEncodedData(pool.Wrap(numNals ? nal[0].p_payload : nullptr, (size_t)frameSize));
+        encImg->set_size((size_t)frameSize);
+        return;
+    }
 
-    const uint8_t startCode[4] = {0, 0, 0, 1};
-    encImg->set_size(0);
-    size_t frag = 0;
-    size_t length = 0;
+    // Upper bound: every NALU may need one extra start code byte.
+    auto buffer = pool.Get((size_t)frameSize + numNals);
+    uint8_t* out = buffer->data();
 
-    // Iterate NAL units, note each NAL unit as a fragment and copy
-    // the data to |encImg->_buffer|.
-    //
-    // Remove the start code generated by x264 and prepend a
-    // 4-byte start code (00 00 00 01) in front of the NALU.
-    for (uint32_t idx = 0; idx < numNals; ++idx, ++frag)
+    for (uint32_t idx = 0; idx < numNals; ++idx)
     {
         RTC_DCHECK_GE(nal[idx].i_payload, 4);
 
-        uint32_t offset = !nal[idx].b_long_startcode ? kShortStartcodeSize : kLongStartcodeSize;
-        uint32_t naluSize = nal[idx].i_payload - offset;
-
-        // Copy the (4-byte) start code first.
-        memcpy(buffer->data() + encImg->size(), startCode, sizeof(startCode));
-        length += sizeof(startCode);
-        encImg->set_size(length);
-
-        // Copy the data without start code.
-        memcpy(buffer->data() + encImg->size(), nal[idx].p_payload + offset, naluSize);
-        length += naluSize;
-        encImg->set_size(length);
+        // x264's start code is kept; a 3-byte one just gets a leading zero.
+        if (!nal[idx].b_long_startcode)
+            *out++ = 0;
+        memcpy(out, nal[idx].p_payload, nal[idx].i_payload);
+        out += nal[idx].i_payload;
     }
+
+    buffer->set_size(out - buffer->data());
+    encImg->SetEncodedData(buffer);
+    encImg->set_size(buffer->size());
 }
 
 
 X264Encoder::X264Encoder(const cricket::VideoCodec& codec)
-    : encoder_(nullptr)
-    , encodedImageCallback_(nullptr)
+    : encodedImageCallback_(nullptr)
     , packetizationMode_(H264PacketizationMode::SingleNalUnit)
-    , width_(0)
-    , height_(0)
     , maxFramerate_(0.0)
     , fps_(0)
-    , bitrate_kbps_(0)
     , maxPayloadSize_(0)
     , paused_(false)
     , hasReportedInit_(false)
@@ -254,6 +321,8 @@ X264Encoder::X264Encoder(const cricket::VideoCodec& codec)
         if (pktModeStr == "1")
             packetizationMode_ = H264PacketizationMode::NonInterleaved;
     }
+    RTC_LOG(LS_INFO) << "H.264 packetization mode: "
+                     << (packetizationMode_ == H264PacketizationMode::NonInterleaved ? "1 (non-interleaved)" : "0 (single NAL unit)");
 }
 
 
@@ -303,24 +372,27 @@ int X264Encoder::InitEncode(const VideoCodec* inst, const VideoEncoder::Settings
         return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
     }
 
-    if (encoder_ != nullptr)
+    const int numLayers = std::max(1, SimulcastUtility::NumberOfSimulcastStreams(*inst));
+    if (numLayers > 1 && !SimulcastUtility::ValidSimulcastParameters(*inst, numLayers))
+    {
+        RTC_LOG_F(LS_ERROR) << "Error: unsupported simulcast parameters";
+        ReportError();
+        return WEBRTC_VIDEO_CODEC_ERR_SIMULCAST_PARAMETERS_NOT_SUPPORTED;
+    }
+
+    int32_t ret = Release();
+    if (ret != WEBRTC_VIDEO_CODEC_OK)
     {
-        x264_encoder_close(encoder_);
-        encoder_ = nullptr;
+        ReportError();
+        return ret;
     }
-    RTC_CHECK(!encoder_);
 
-    width_          = inst->width;
-    height_         = inst->height;
     fps_            = std::min(kMaxFramerate, inst->maxFramerate);
     maxFramerate_   = (double)fps_;
     maxPayloadSize_ = settings.max_payload_size;
     frameCount_     = 0;
-
-    int videoBitrate = (int)inst->maxBitrate;
-    // Ensure bitrate is reasonable for frame size.
-    SanitizeInputs::ConstrainBitrate(height_, videoBitrate);
-    bitrate_kbps_ = roundUp((uint32_t)videoBitrate, fps_);
+    packetWindow_   = {};
+    packetWindowStartMs_ = 0;
 
     if (&codec_ != inst)
         codec_ = *inst;
@@ -335,78 +407,143 @@ int X264Encoder::InitEncode(const VideoCodec* inst, const VideoEncoder::Settings
         codec_.simulcastStream[0].height    = codec_.height;
     }
 
+    // Initial per-layer targets come from the same allocator WebRTC uses for
+    // later SetRates() calls.
+    SimulcastRateAllocator initAllocator(codec_);
+    VideoBitrateAllocation allocation =
+        initAllocator.Allocate(VideoBitrateAllocationParameters(
+            DataRate::KilobitsPerSec(numLayers > 1 ? codec_.startBitrate : codec_.maxBitrate), fps_));
+
+    // Layers are ordered highest resolution first, the reverse of |simulcastStream|.
+    for (int i = 0; i < numLayers; ++i)
+    {
+        auto layer = make_unique<Layer>();
+        layer->simulcastIdx = (size_t)(numLayers - 1 - i);
+
+        int videoBitrate;
+        if (numLayers > 1)
+        {
+            const auto& stream  = codec_.simulcastStream[layer->simulcastIdx];
+            layer->width        = stream.width;
+            layer->height       = stream.height;
+            layer->sending      = stream.active;
+            layer->scalePool    = make_unique<NV12FramePool>(2);
+            videoBitrate        = std::max((int)stream.minBitrate,
+                                           (int)allocation.GetSpatialLayerSum(layer->simulcastIdx) / 1000);
+            layer->maxBitrateKbps = stream.maxBitrate;
+        }
+        else
+        {
+            layer->width        = codec_.width;
+            layer->height       = codec_.height;
+            videoBitrate        = (int)inst->maxBitrate;
+        }
+
+        // Ensure bitrate is reasonable for frame size.
+        SanitizeInputs::ConstrainBitrateForFramerate(layer->height, (int)fps_, videoBitrate);
+        layer->bitrateKbps = roundUp((uint32_t)videoBitrate, fps_);
+        if (layer->maxBitrateKbps == 0)
+            layer->maxBitrateKbps = layer->bitrateKbps;
+
 #if X264ENC_VERBOSE_LOG
-    RTC_LOG(INFO) << "frame width:          " << width_;
-    RTC_LOG(INFO) << "frame height:         " << height_;
-    RTC_LOG(INFO) << "target bitrate:       " << bitrate_kbps_;
-    RTC_LOG(INFO) << "max framerate:        " << maxFramerate_;
-    RTC_LOG(INFO) << "max payload size:     " << maxPayloadSize_;
-    RTC_LOG(INFO) << "frame dropping on:    " << codec_.H264()->frameDroppingOn;
-    RTC_LOG(INFO) << "keyframe interval:    " << codec_.H264()->keyFrameInterval;
-    RTC_LOG(INFO) << "simulcast streams:    " << codec_.numberOfSimulcastStreams;
-    RTC_LOG(INFO) << "temporal layers:      " << codec_.simulcastStream[0].numberOfTemporalLayers;
+        RTC_LOG(INFO) << "layer:                " << i << " (simulcast idx " << layer->simulcastIdx << ")";
+        RTC_LOG(INFO) << "frame width:          " << layer->width;
+        RTC_LOG(INFO) << "frame height:         " << layer->height;
+        RTC_LOG(INFO) << "target bitrate:       " << layer->bitrateKbps;
 #endif
 
-    auto params = CreateEncoderParams();
-    if (!params)
-        return WEBRTC_VIDEO_CODEC_ERROR;
+        auto params = CreateEncoderParams(layer->width, layer->height, layer->bitrateKbps);
+        if (!params)
+        {
+            Release();
+            return WEBRTC_VIDEO_CODEC_ERROR;
+        }
 
-    // Allocate picture.
-    int ret = x264_picture_alloc(&picIn_, params->i_csp, params->i_width, params->i_height);
-    if (ret < 0)
-    {
-        RTC_LOG_F(LS_ERROR) << "Failed to allocate picture. errno: " << ret;
-        ReportError();
-        return WEBRTC_VIDEO_CODEC_ERROR;
-    }
+        layer->maxRefFrames = params->i_frame_reference;
+        layer->openFps      = params->i_fps_num;
 
-    // Create encoder.
-    encoder_ = x264_encoder_open(params.get());
-    if (!encoder_)
-    {
-        RTC_LOG_F(LS_ERROR) << "Failed to open x264 encoder";
-        x264_picture_clean(&picIn_);
-        ReportError();
-        return WEBRTC_VIDEO_CODEC_ERROR;
-    }
+        KeyFrameArbiter::Config arbiterConfig;
+        arbiterConfig.coalesceWindowMs  = kKeyFrameCoalesceWindowMs;
+#if X264ENC_INTRA_REFRESH
+        arbiterConfig.minIdrSpacingMs   = kIntraRefreshIdrSpacingMs;
+#else
+        arbiterConfig.minIdrSpacingMs   = kMinIdrSpacingMs;
+#endif
+        layer->keyFrameArbiter.Reset(arbiterConfig);
+        layer->appliedKbps  = layer->bitrateKbps;
+        layer->vbvDivisor   = kVbvBufferSizeFactor;
+        x264_picture_init(&layer->picIn);
+
+        // Create encoder, or adopt the one pre-opened between sessions. Rate
+        // control is the only part that differs; it is reconfigurable.
+        layer->encoder = numLayers == 1 ? TakeWarmEncoder(*params) : nullptr;
+        if (layer->encoder)
+            ReconfigureBitrate(*layer, (int)layer->bitrateKbps, layer->vbvDivisor);
+        else
+            layer->encoder = x264_encoder_open(params.get());
+        if (!layer->encoder)
+        {
+            RTC_LOG_F(LS_ERROR) << "Failed to open x264 encoder";
+            Release();
+            ReportError();
+            return WEBRTC_VIDEO_CODEC_ERROR;
+        }
 
-    // Initialize encoded image using the size of unencoded data for buffer capacity allocation.
-    const size_t newCapacity = CalcBufferSize(VideoType::kNV12, width_, height_);
+        // Initialize encoded image using the size of unencoded data for buffer capacity allocation.
+        const size_t newCapacity = CalcBufferSize(VideoType::kNV12, layer->width, layer->height);
 
-    image_.SetEncodedData(EncodedImageBuffer::Create(newCapacity));
-    image_._encodedWidth  = (uint32_t)width_;
-    image_._encodedHeight = (uint32_t)height_;
-    image_.set_size(0);
-    //image_.playout_delay_ = {0, 0};
+        layer->image.SetEncodedData(layer->outputPool.Get(newCapacity));
+        layer->image._encodedWidth  = (uint32_t)layer->width;
+        layer->image._encodedHeight = (uint32_t)layer->height;
+        layer->image.set_size(0);
+        //layer->image.playout_delay_ = {0, 0};
 
-    const ColorSpace cs(PrimaryID::kBT709, TransferID::kBT709, MatrixID::kBT709, RangeID::kLimited);
-    image_.SetColorSpace(cs);
+        const ColorSpace cs(PrimaryID::kBT709, TransferID::kBT709, MatrixID::kBT709, RangeID::kLimited);
+        layer->image.SetColorSpace(cs);
 
-#if 0
-    SimulcastRateAllocator init_allocator(codec_);
-    auto datarate = DataRate::KilobitsPerSec(bitrate_kbps_);
+        if (i > 0)
+        {
+            auto thread = rtc::Thread::Create();
+            thread->SetName("X264Encoder_Layer" + std::to_string(i), nullptr);
+            thread->Start();
+            layerThreads_.push_back(std::move(thread));
+        }
 
-    VideoBitrateAllocation allocation =
-       init_allocator.Allocate(
-           VideoBitrateAllocationParameters(datarate, maxFramerate_));
-    allocation.SetBitrate(0, 0, bitrate_kbps_ * 1000);
-    allocation.set_bw_limited(false);
+        layers_.push_back(std::move(layer));
+    }
 
-    const auto rc_params =
-       VideoEncoder::RateControlParameters(allocation, maxFramerate_, datarate);
+#if X264ENC_ADAPTIVE_PRESET
+    if (adaptivePreset_)
+        presetController_.Reset(preset_, fps_);
+#endif
 
-    SetRates(rc_params);
+    rateController_.Reset();
+
+#if X264ENC_ASYNC_ENCODE
+    encodeThread_ = rtc::Thread::Create();
+    encodeThread_->SetName("X264Encoder_Encode", nullptr);
+    encodeThread_->Start();
+    asyncError_ = false;
+#endif
+
+#if X264ENC_VERBOSE_LOG
+    RTC_LOG(INFO) << "max framerate:        " << maxFramerate_;
+    RTC_LOG(INFO) << "max payload size:     " << maxPayloadSize_;
+    RTC_LOG(INFO) << "frame dropping on:    " << codec_.H264()->frameDroppingOn;
+    RTC_LOG(INFO) << "keyframe interval:    " << codec_.H264()->keyFrameInterval;
+    RTC_LOG(INFO) << "simulcast streams:    " << codec_.numberOfSimulcastStreams;
+    RTC_LOG(INFO) << "temporal layers:      " << codec_.simulcastStream[0].numberOfTemporalLayers;
 #endif
 
     return WEBRTC_VIDEO_CODEC_OK;
 }
 
 
-unique_ptr<x264_param_t> X264Encoder::CreateEncoderParams()
+unique_ptr<x264_param_t> X264Encoder::CreateEncoderParams(int width, int height, uint32_t bitrateKbps)
 {
     auto params = make_unique<x264_param_t>();
 
-    int ret = x264_param_default_preset(params.get(), "veryfast", "zerolatency");
+    int ret = x264_param_default_preset(params.get(), preset_.c_str(), "zerolatency");
     if (ret != 0)
     {
         RTC_LOG_F(LS_ERROR) << "Failed to create x264 param defaults. code: " << ret;
@@ -423,21 +560,41 @@ unique_ptr<x264_param_t> X264Encoder::CreateEncoderParams()
     params->b_repeat_headers        = 1;
     params->b_vfr_input             = 0;
 
-    params->i_width                 = width_;
-    params->i_height                = height_;
+    params->i_width                 = width;
+    params->i_height                = height;
     params->i_fps_den               = 1;
     params->i_fps_num               = fps_;
     params->i_timebase_den          = 90000;
     params->i_timebase_num          = params->i_timebase_den * params->i_fps_den / params->i_fps_num;
-    params->i_level_idc             = height_ > 720 ? 41 : 31;
+    // 720p60 needs level 3.2 and 1080p60 level 4.2 for their macroblock rate.
+    if (height > 720)
+        params->i_level_idc         = fps_ > 30 ? 42 : 41;
+    else
+        params->i_level_idc         = fps_ > 30 ? 32 : 31;
 
     /// CPU flags.
-    params->i_threads               = X264_THREADS_AUTO;
+    params->i_threads               = threads_;
     params->b_sliced_threads        = 1;
-    params->i_slice_max_size        = (int)maxPayloadSize_;  // Using single NALU per packet, limit slice size: MTU - overhead
+    if (packetizationMode_ == H264PacketizationMode::NonInterleaved)
+    {
+        // FU-A fragments large NAL units, so use a few big slices (one per
+        // thread); fewer slice headers and better prediction than one per MTU.
+        if (threads_ == X264_THREADS_AUTO)
+            params->i_threads       = (int)std::min(std::max(std::thread::hardware_concurrency(), 1u), (unsigned)kMaxSlices);
+        params->i_slice_max_size    = 0;
+        params->i_slice_count       = 0;  // one per sliced thread
+    }
+    else
+    {
+        params->i_slice_max_size    = (int)maxPayloadSize_;  // Using single NALU per packet, limit slice size: MTU - overhead
+    }
 
     /// Bitstream parameters.
+#if X264ENC_INTRA_REFRESH
+    params->b_intra_refresh         = 1;  // One refresh wave per |i_keyint_max| frames
+#else
     params->b_intra_refresh         = 0;
+#endif
     params->i_bframe                = 0;
 #if X264ENC_ENABLE_RECONFIGURE
 #if X264ENC_DISABLE_HRD
@@ -458,7 +615,7 @@ unique_ptr<x264_param_t> X264Encoder::CreateEncoderParams()
 #else
     params->rc.i_rc_method          = X264_RC_ABR;
 #endif
-    params->rc.i_bitrate            = (int)bitrate_kbps_;
+    params->rc.i_bitrate            = (int)bitrateKbps;
     params->rc.i_vbv_max_bitrate    = params->rc.i_bitrate;
     params->rc.i_vbv_buffer_size    = params->rc.i_bitrate / kVbvBufferSizeFactor;
     params->rc.f_rate_tolerance     = 0.1f;  // Minimizes inter-frame delay variance
@@ -467,7 +624,7 @@ unique_ptr<x264_param_t> X264Encoder::CreateEncoderParams()
     if (params->rc.i_rc_method == X264_RC_CRF)
     {
         params->rc.f_rf_constant =
-            UseHqCrf(height_, params->rc.i_bitrate) ? kHighQualityCrf : kNormalQualityCrf;
+            UseHqCrf(height, params->rc.i_bitrate) ? kHighQualityCrf : kNormalQualityCrf;
     }
 
     params->analyse.i_weighted_pred = 0;  // Not supported by WebRTC's bitstream parser
@@ -496,12 +653,36 @@ unique_ptr<x264_param_t> X264Encoder::CreateEncoderParams()
 
 int32_t X264Encoder::Release()
 {
-    if (encoder_ != nullptr)
+    // The encode thread uses everything below; stop it before tearing down.
+    // Frames still queued are dropped with it.
+    if (encodeThread_)
     {
-        x264_encoder_close(encoder_);
-        encoder_ = nullptr;
+        encodeThread_->Stop();
+        encodeThread_.reset();
     }
-    image_.ClearEncodedData();
+    {
+        MutexLock lock(&queueMutex_);
+        queue_.clear();
+        g_queueDepth = 0;
+    }
+
+    // Layer threads may still reference |layers_|; stop them first.
+    for (auto& thread : layerThreads_)
+        thread->Stop();
+    layerThreads_.clear();
+
+    for (auto& layer : layers_)
+    {
+        if (layer->encoder != nullptr)
+        {
+            x264_encoder_close(layer->encoder);
+            layer->encoder = nullptr;
+        }
+        layer->image.ClearEncodedData();
+        layer->outputPool.Release();
+    }
+    layers_.clear();
+
     encodedImageCallback_ = nullptr;
     frameCount_ = 0;
 
@@ -537,20 +718,55 @@ void X264Encoder::SetRates(const RateControlParameters& parameters)
     }
     paused_ = false;
 
-    uint32_t newBitrateKbps = parameters.bitrate.get_sum_kbps();
-    if (newBitrateKbps > maxBitrateKbps_)
+    // x264_encoder_reconfig() must not race x264_encoder_encode(); apply the
+    // new rates in order with queued frames on the encode thread.
+    if (encodeThread_)
+        encodeThread_->PostTask(RTC_FROM_HERE, [this, parameters]() { ApplyRates(parameters); });
+    else
+        ApplyRates(parameters);
+}
+
+
+void X264Encoder::ApplyRates(const RateControlParameters& parameters)
+{
+    bandwidthKbps_ = (uint32_t)parameters.bandwidth_allocation.kbps();
+
+    for (auto& layer : layers_)
     {
-        RTC_LOG_F(LS_INFO) << "Requested bitrate, " << newBitrateKbps
-                           << ", exceeds maximum (" << maxBitrateKbps_ << ")";
-        newBitrateKbps = maxBitrateKbps_;
+        // Per-layer split from WebRTC's SimulcastRateAllocator. A layer the
+        // allocator gives no bitrate is not sent until it gets some again.
+        uint32_t newBitrateKbps = parameters.bitrate.GetSpatialLayerSum(layer->simulcastIdx) / 1000;
+        if (newBitrateKbps == 0)
+        {
+            if (layer->sending)
+                RTC_LOG_F(LS_INFO) << "Layer " << layer->simulcastIdx << " paused";
+            layer->sending = false;
+            continue;
+        }
+        if (!layer->sending)
+        {
+            // Resume with a key frame so receivers of this layer can decode.
+            layer->sending = true;
+            layer->sendIDR = true;
+        }
+
+        if (newBitrateKbps > layer->maxBitrateKbps)
+        {
+            RTC_LOG_F(LS_INFO) << "Requested bitrate, " << newBitrateKbps
+                               << ", exceeds maximum (" << layer->maxBitrateKbps << ")";
+            newBitrateKbps = layer->maxBitrateKbps;
+        }
+
+        layer->bitrateKbps = newBitrateKbps;
     }
 
 #if X264ENC_ENABLE_RECONFIGURE
-    if (newBitrateKbps != bitrate_kbps_)
-    {
-        bitrate_kbps_ = newBitrateKbps;
-        ReconfigureBitrate((int)bitrate_kbps_);
-    }
+    // Apply the new targets, scaled by the loss/RTT controller. GCC updates
+    // arrive every few hundred ms; small steps are left to the threshold.
+    ApplyRateControl(!g_sendSideBwe);
+#endif
+
+#if X264ENC_ENABLE_RECONFIGURE
     double newMaxFramerate = std::min((double)kMaxFramerate, parameters.framerate_fps);
     if (abs(newMaxFramerate - maxFramerate_) > 1.0)
     {
@@ -558,6 +774,7 @@ void X264Encoder::SetRates(const RateControlParameters& parameters)
         codec_.maxFramerate = std::min(kMaxFramerate, static_cast<uint32_t>(parameters.framerate_fps + 0.5));
         fps_ = codec_.maxFramerate;
         ReconfigureFps(fps_);
+        presetController_.SetFps(fps_);
     }
  #endif
 
@@ -566,6 +783,82 @@ void X264Encoder::SetRates(const RateControlParameters& parameters)
 }
 
 
+/// Encodes |buffer| with |layer|'s x264 instance and packs the NAL units into
+/// |layer.image|. May run on a layer thread; touches only |layer|.
+void X264Encoder::EncodeLayer(Layer& layer, const NV12BufferInterface& buffer)
+{
+#if X264ENC_ENABLE_RECONFIGURE
+    // x264_encoder_reconfig() keeps the keyint the encoder was opened with, in
+    // frames, so below that frame rate (e.g. a static scene thinned to 5 fps)
+    // the GOP would stretch to several seconds. Keep it at |kIDRIntervalSec|.
+    const int64_t nowMs = rtc::TimeMillis();
+    if (fps_ < layer.openFps)
+    {
+#if X264ENC_INTRA_REFRESH
+        if (nowMs - layer.lastRefreshMs >= kIDRIntervalSec * 1000)
+        {
+            layer.sendRefresh = true;
+            layer.lastRefreshMs = nowMs;
+        }
+#else
+        if (nowMs - layer.lastIdrMs >= kIDRIntervalSec * 1000)
+            layer.sendIDR = true;
+#endif
+    }
+#endif
+
+    layer.picIn.i_type          = layer.sendIDR ? X264_TYPE_IDR : X264_TYPE_AUTO;  // Send an IDR-frame on FIR request.
+#if X264ENC_INTRA_REFRESH
+    if (layer.sendRefresh && !layer.sendIDR)
+    {
+        // Restart the refresh wave now rather than at the next scheduled one.
+        x264_encoder_intra_refresh(layer.encoder);
+    }
+    layer.sendRefresh = false;
+#endif
+    layer.picIn.i_pts           = frameCount_;
+    layer.picIn.img.i_csp       = X264_CSP_NV12;
+    layer.picIn.img.i_plane     = 2;
+    layer.picIn.img.plane[0]    = const_cast<uint8_t*>(buffer.DataY());
+    layer.picIn.img.plane[1]    = const_cast<uint8_t*>(buffer.DataUV());
+    layer.picIn.img.i_stride[0] = buffer.StrideY();
+    layer.picIn.img.i_stride[1] = buffer.StrideUV();
+
+    int numNals = 0;
+    x264_nal_t* nal = nullptr;
+    layer.picOut = {};
+
+    // Encode one picture(frame).
+    layer.encodeStartMs = rtc::TimeMillis();
+    layer.encodedFrameSize = x264_encoder_encode(layer.encoder, &nal, &numNals, &layer.picIn, &layer.picOut);
+    layer.encodeFinishMs = rtc::TimeMillis();
+    if (layer.encodedFrameSize < 0)
+        return;
+
+    layer.sendIDR = false;
+    if (layer.picOut.i_type == X264_TYPE_IDR)
+    {
+        layer.lastIdrMs = layer.encodeFinishMs;
+        layer.keyFrameArbiter.OnIdr(layer.encodeFinishMs);
+    }
+
+    // One packet per NAL unit, or several FU-As when it exceeds the payload size.
+    layer.packets = 0;
+    for (int i = 0; i < numNals; ++i)
+    {
+        const size_t payload = (size_t)nal[i].i_payload;
+        layer.packets += maxPayloadSize_ ? (uint32_t)std::max<size_t>(1, (payload + maxPayloadSize_ - 1) / maxPayloadSize_) : 1;
+    }
+
+    //auto nalBuffer = (uint8_t*)malloc(nal->i_payload * 3 / 2 + 5 + 64);
+    //x264_nal_encode(encoder_, nalBuffer, nal);
+
+    // Split encoded image into fragments and place them in |image|.
+    RtpFragmentize(layer.outputPool, &layer.image, (uint32_t)numNals, nal, layer.encodedFrameSize);
+    layer.image.timing_.packetization_finish_ms = rtc::TimeMillis();
+}
+
+
 int32_t X264Encoder::Encode(const VideoFrame& inputFrame, const vector<VideoFrameType>* frameTypes)
 {
     if (!IsInitialized())
@@ -582,139 +875,345 @@ int32_t X264Encoder::Encode(const VideoFrame& inputFrame, const vector<VideoFram
         return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
     }
 
+    if (asyncError_)
+    {
+        // EncodeFrame() failed on the encode thread, which cannot release itself.
+        Release();
+        ReportError();
+        return WEBRTC_VIDEO_CODEC_ERROR;
+    }
+
     if (paused_)
     {
         encodedImageCallback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
         return WEBRTC_VIDEO_CODEC_OK;
     }
 
-    bool sendIDR = false;
+    if (encodeThread_)
+    {
+        EnqueueFrame(inputFrame, frameTypes);
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    return EncodeFrame(inputFrame, frameTypes);
+}
+
+
+void X264Encoder::EnqueueFrame(const VideoFrame& inputFrame, const vector<VideoFrameType>* frameTypes)
+{
+    QueuedFrame queued{inputFrame, {}, rtc::TimeMillis()};
+    if (frameTypes != nullptr)
+        queued.frameTypes = *frameTypes;
+
+    size_t dropped = 0;
+    {
+        MutexLock lock(&queueMutex_);
+        while (queue_.size() >= kMaxQueuedFrames)
+        {
+            // Drop oldest, but OR its key frame requests into the new frame so
+            // a receiver asking for an IDR still gets one, even when the new
+            // frame came without frame types of its own.
+            const auto& oldest = queue_.front();
+            for (size_t i = 0; i < oldest.frameTypes.size(); ++i)
+            {
+                if (oldest.frameTypes[i] != VideoFrameType::kVideoFrameKey)
+                    continue;
+                if (queued.frameTypes.size() < oldest.frameTypes.size())
+                    queued.frameTypes.resize(oldest.frameTypes.size(), VideoFrameType::kVideoFrameDelta);
+                queued.frameTypes[i] = VideoFrameType::kVideoFrameKey;
+            }
+            queue_.pop_front();
+            ++dropped;
+        }
+        queue_.push_back(std::move(queued));
+        g_queueDepth = queue_.size();
+    }
+
+    for (size_t i = 0; i < dropped; ++i)
+    {
+        ++g_queueDropped;
+        encodedImageCallback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
+    }
+
+    // One task per enqueued frame; a task finding the queue empty means its
+    // frame was dropped in favour of a newer one.
+    encodeThread_->PostTask(RTC_FROM_HERE, [this]() { EncodeQueued(); });
+}
+
+
+void X264Encoder::EncodeQueued()
+{
+    absl::optional<QueuedFrame> queued;
+    {
+        MutexLock lock(&queueMutex_);
+        if (queue_.empty())
+            return;
+        queued.emplace(std::move(queue_.front()));
+        queue_.pop_front();
+        g_queueDepth = queue_.size();
+    }
+
+    const int64_t waitMs = rtc::TimeMillis() - queued->enqueuedMs;
+    g_queueWaitTotalMs += waitMs;
+    int64_t maxMs = g_queueWaitMaxMs.load();
+    while (waitMs > maxMs && !g_queueWaitMaxMs.compare_exchange_weak(maxMs, waitMs)) {}
+    queueWaitMs_ = waitMs;
+
+    if (asyncError_)
+        return;
+
+    // Frames are popped and delivered on this one thread, so the encode
+    // complete callback still sees them in capture order.
+    const auto* frameTypes = queued->frameTypes.empty() ? nullptr : &queued->frameTypes;
+    if (EncodeFrame(queued->frame, frameTypes) != WEBRTC_VIDEO_CODEC_OK)
+        asyncError_ = true;
+    queueWaitMs_ = 0;
+}
+
+
+// static
+X264Encoder::QueueStats X264Encoder::GetQueueStats()
+{
+    QueueStats stats;
+    stats.depth     = g_queueDepth.load(std::memory_order_relaxed);
+    stats.encoded   = g_queueEncoded.load(std::memory_order_relaxed);
+    stats.dropped   = g_queueDropped.load(std::memory_order_relaxed);
+    stats.avgWaitMs = stats.encoded
+                    ? (double)g_queueWaitTotalMs.load(std::memory_order_relaxed) / stats.encoded
+                    : 0.0;
+    stats.maxWaitMs = g_queueWaitMaxMs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+
+int32_t X264Encoder::EncodeFrame(const VideoFrame& inputFrame, const vector<VideoFrameType>* frameTypes)
+{
+#if X264ENC_ENABLE_RECONFIGURE
+    ApplyRateControl(false);
+#endif
+
 #if WEBRTC_ADAPT_FRAME_ENABLED
     // Check if frame size has been changed by the AdaptFrame API.
-    if (height_ != inputFrame.height())
+    if (layers_.size() == 1 && layers_[0]->height != inputFrame.height())
     {
         RTC_LOG_F(LS_INFO) << "Frame size has been changed. Reconfiguring x264 encoder";
 #if X264ENC_ENABLE_RECONFIGURE
-        // Frame size can only be changed per-GOP. Send an IDR-frame to start a new GOP.
-        sendIDR = true;
+        auto& layer = *layers_[0];
 
-        width_ = inputFrame.width();
-        height_ = inputFrame.height();
+        // Frame size can only be changed per-GOP. Send an IDR-frame to start a new GOP.
+        layer.sendIDR = true;
 
-        if (!ReconfigureFrameSize(width_, height_))
+        if (!ReconfigureFrameSize(layer, inputFrame.width(), inputFrame.height()))
             return WEBRTC_VIDEO_CODEC_ERROR;
 
-        int videoBitrate = (int)bitrate_kbps_;
+        int videoBitrate = (int)layer.bitrateKbps;
         // Ensure bitrate is reasonable for frame size.
-        SanitizeInputs::ConstrainBitrate(height_, videoBitrate);
-        if (videoBitrate != (int)bitrate_kbps_)
+        SanitizeInputs::ConstrainBitrateForFramerate(layer.height, (int)fps_, videoBitrate);
+        if (videoBitrate != (int)layer.bitrateKbps)
         {
-            bitrate_kbps_ = (uint32_t)videoBitrate;
-            if (!ReconfigureBitrate(videoBitrate))
+            layer.bitrateKbps = (uint32_t)videoBitrate;
+            if (!ReconfigureBitrate(layer, videoBitrate, layer.vbvDivisor))
                 return WEBRTC_VIDEO_CODEC_ERROR;
         }
 #endif
     }
 #endif
 
-    bool firRequest = false;
-    if (frameTypes != nullptr)
+    bool skipAll = true;
+    for (auto& layer : layers_)
     {
-        // No SVC support (only supporting a single stream for now).
-        RTC_DCHECK_EQ(frameTypes->size(), 1);
-
-        // Check whether to skip this frame.
-        if ((*frameTypes)[0] == VideoFrameType::kEmptyFrame)
+        if (frameTypes != nullptr)
         {
-            encodedImageCallback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
-            return WEBRTC_VIDEO_CODEC_OK;
-        }
-// Ignore FIR requests for now because Wowza sends an FIR packet every 1 second, not in response to packet loss.
-#if X264ENC_ENABLE_FIR
-        // Check if a Full Intra Refresh (FIR) is requested.
-        firRequest = (*frameTypes)[0] == VideoFrameType::kVideoFrameKey;
+            RTC_DCHECK_GT(frameTypes->size(), layer->simulcastIdx);
+            const auto frameType = (*frameTypes)[layer->simulcastIdx];
+
+            // Check whether to skip this layer.
+            if (frameType == VideoFrameType::kEmptyFrame)
+                continue;
+// Wowza sends an FIR packet every 1 second, not in response to packet loss;
+// OnKeyFrameRequest() keeps those from turning into an IDR each.
+#if X264ENC_ENABLE_FIR || X264ENC_INTRA_REFRESH
+            // Check if a Full Intra Refresh (FIR) or PLI is requested.
+            if (frameType == VideoFrameType::kVideoFrameKey)
+                OnKeyFrameRequest(*layer);
 #endif
+        }
+        if (layer->sending)
+            skipAll = false;
     }
 
-    picIn_                  = {0};
-    picIn_.i_type           = (firRequest || sendIDR) ? X264_TYPE_IDR : X264_TYPE_AUTO;  // Send an IDR-frame on FIR request.
-    picIn_.i_pts            = frameCount_;
-    picIn_.img.i_csp        = X264_CSP_NV12;
-    picIn_.img.i_plane      = 2;
-    const auto frameBuffer  = inputFrame.video_frame_buffer()->GetNV12();
-    picIn_.img.plane[0]     = const_cast<uint8_t*>(frameBuffer->DataY());
-    picIn_.img.plane[1]     = const_cast<uint8_t*>(frameBuffer->DataUV());
-    picIn_.img.i_stride[0]  = frameBuffer->StrideY();
-    picIn_.img.i_stride[1]  = frameBuffer->StrideUV();
+    if (skipAll)
+    {
+        encodedImageCallback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
 
-    int numNals = 0;
-    x264_nal_t* nal = nullptr;
-    x264_picture_t picOut{};
+    const auto frameBuffer = inputFrame.video_frame_buffer()->GetNV12();
+    RTC_CHECK(frameBuffer);
 
-    // Encode one picture(frame).
-    auto encode_start = rtc::TimeMillis();
-    int encodedFrameSize = x264_encoder_encode(encoder_, &nal, &numNals, &picIn_, &picOut);
-    if (encodedFrameSize < 0)
+    // One downscale pass: each layer is scaled (libyuv, SIMD) from the previous,
+    // already smaller layer rather than from the full-size input.
+    const NV12BufferInterface* source = frameBuffer;
+    for (size_t i = 1; i < layers_.size(); ++i)
     {
-        RTC_LOG_F(LS_ERROR) << "x264 frame encoding failed. encoded frame size: " << encodedFrameSize;
-        Release();
-        ReportError();
-        return WEBRTC_VIDEO_CODEC_ERROR;
+        auto& layer = *layers_[i];
+        layer.scaled = layer.scalePool->CreateBuffer(layer.width, layer.height);
+        if (!layer.scaled)
+            return WEBRTC_VIDEO_CODEC_ERROR;
+        layer.scaled->CropAndScaleFrom(*source, 0, 0, source->width(), source->height());
+        source = layer.scaled.get();
     }
-    auto encode_finish = rtc::TimeMillis();
 
-    //auto nalBuffer = (uint8_t*)malloc(nal->i_payload * 3 / 2 + 5 + 64);
-    //x264_nal_encode(encoder_, nalBuffer, nal);
+    // Encode all layers in parallel: layers_[1..n] on their own threads, the
+    // full resolution layer on this one.
+    for (size_t i = 1; i < layers_.size(); ++i)
+    {
+        Layer* layer = layers_[i].get();
+        if (!layer->sending)
+            continue;
+        layerThreads_[i - 1]->PostTask(RTC_FROM_HERE, [this, layer]()
+        {
+            EncodeLayer(*layer, *layer->scaled);
+            layer->done.Set();
+        });
+    }
+    if (layers_[0]->sending)
+        EncodeLayer(*layers_[0], *frameBuffer);
+    for (size_t i = 1; i < layers_.size(); ++i)
+    {
+        if (layers_[i]->sending)
+            layers_[i]->done.Wait(rtc::Event::kForever);
+    }
 
-    image_._encodedWidth    = frameBuffer->width();
-    image_._encodedHeight   = frameBuffer->height();
-    image_._frameType       = WebrtcFrameType(&picOut);
-    image_.ntp_time_ms_     = inputFrame.ntp_time_ms();
-    image_.SetTimestamp(inputFrame.timestamp());
-    image_.SetEncodeTime(encode_start, encode_finish);
-    //image_.playout_delay_   = {0, 0};
+    // Deliver in layer order on the calling (encoder queue) thread.
+    int32_t result = WEBRTC_VIDEO_CODEC_OK;
+    for (auto& layerPtr : layers_)
+    {
+        auto& layer = *layerPtr;
+        if (!layer.sending)
+            continue;
 
-    // Split encoded image into fragments and copy from |nal| to |image_|.
-    RtpFragmentize(&image_, numNals, nal);
-    image_.timing_.packetization_finish_ms = rtc::TimeMillis();
+        if (layer.encodedFrameSize < 0)
+        {
+            RTC_LOG_F(LS_ERROR) << "x264 frame encoding failed. encoded frame size: " << layer.encodedFrameSize;
+            result = WEBRTC_VIDEO_CODEC_ERROR;
+            break;
+        }
 
-    // Encoder can skip frames to save bandwidth.
-    if (image_.size() == 0)
-    {
-        RTC_LOG(INFO) << "ENCODER DROPPED FRAME";
-        encodedImageCallback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
-        return WEBRTC_VIDEO_CODEC_OK;
-    }
+        auto& image = layer.image;
+        image._encodedWidth    = (uint32_t)layer.width;
+        image._encodedHeight   = (uint32_t)layer.height;
+        image._frameType       = WebrtcFrameType(&layer.picOut);
+        image.ntp_time_ms_     = inputFrame.ntp_time_ms();
+        image.SetTimestamp(inputFrame.timestamp());
+        image.SetEncodeTime(layer.encodeStartMs, layer.encodeFinishMs);
+        if (layers_.size() > 1)
+            image.SetSpatialIndex((int)layer.simulcastIdx);
+        //image.playout_delay_   = {0, 0};
+
+        EncoderTelemetry::Frame telemetry{};
+        telemetry.timeMs        = layer.encodeFinishMs;
+        telemetry.rtpTimestamp  = inputFrame.timestamp();
+        telemetry.sizeBytes     = (uint32_t)image.size();
+        telemetry.crfAvg        = layer.picOut.prop.f_crf_avg;
+        telemetry.encodeMs      = (uint16_t)std::min<int64_t>(layer.encodeFinishMs - layer.encodeStartMs, UINT16_MAX);
+        telemetry.queueMs       = (uint16_t)std::min<int64_t>(queueWaitMs_, UINT16_MAX);
+        telemetry.layer         = (uint8_t)layer.simulcastIdx;
+
+        // Encoder can skip frames to save bandwidth.
+        if (image.size() == 0)
+        {
+            telemetry.kind = EncoderTelemetry::kDropped;
+            g_telemetry.Record(telemetry);
+            RTC_LOG(INFO) << "ENCODER DROPPED FRAME";
+            encodedImageCallback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
+            continue;
+        }
+
+        // Parse bitstream for QP.
+        int qp;
+        auto bitstream = rtc::ArrayView<const uint8_t>(image.data(), image.size());
+        layer.bitstreamParser.ParseBitstream(bitstream);
+        if (layer.bitstreamParser.GetLastSliceQp(&qp))
+            image.qp_ = qp;
 
-    // Parse bitstream for QP.
-    int qp;
-    auto bitstream = rtc::ArrayView<const uint8_t>(image_.data(), image_.size());
-    bitstreamParser_.ParseBitstream(bitstream);
-    if (bitstreamParser_.GetLastSliceQp(&qp))
-        image_.qp_ = qp;
+        telemetry.kind  = image._frameType == VideoFrameType::kVideoFrameKey ? EncoderTelemetry::kKey : EncoderTelemetry::kDelta;
+        telemetry.qp    = (uint8_t)std::max(image.qp_, 0);
+        g_telemetry.Record(telemetry);
 
 #if X264ENC_VERBOSE_LOG
-    RTC_LOG(INFO) << "resolution:       " << width_ << "x" << height_;
-    RTC_LOG(INFO) << "numNals:          " << numNals;
-    RTC_LOG(INFO) << "enc frame size:   " << encodedFrameSize;
-    RTC_LOG(INFO) << "enc image size:   " << image_.size();
-    RTC_LOG(INFO) << "keyframe:         " << (picOut.b_keyframe ? "yes" : "no");
-    RTC_LOG(INFO) << "crf:              " << picOut.prop.f_crf_avg;
-    RTC_LOG(INFO) << "qp:               " << picOut.i_qpplus1;
-    RTC_LOG(INFO) << "qp (last slice):  " << image_.qp_;
+        RTC_LOG(INFO) << "resolution:       " << layer.width << "x" << layer.height;
+        RTC_LOG(INFO) << "enc frame size:   " << layer.encodedFrameSize;
+        RTC_LOG(INFO) << "enc image size:   " << image.size();
+        RTC_LOG(INFO) << "keyframe:         " << (layer.picOut.b_keyframe ? "yes" : "no");
+        RTC_LOG(INFO) << "crf:              " << layer.picOut.prop.f_crf_avg;
+        RTC_LOG(INFO) << "qp:               " << layer.picOut.i_qpplus1;
+        RTC_LOG(INFO) << "qp (last slice):  " << image.qp_;
 #endif
 
-    CodecSpecificInfo codec_specific{};
-    codec_specific.codecType                                = VideoCodecType::kVideoCodecH264;
-    codec_specific.codecSpecific.H264.packetization_mode    = H264PacketizationMode::SingleNalUnit;
-    codec_specific.codecSpecific.H264.temporal_idx          = kNoTemporalIdx;
-    codec_specific.codecSpecific.H264.idr_frame             = static_cast<bool>(picOut.b_keyframe);
-    codec_specific.codecSpecific.H264.base_layer_sync       = false;
+        CodecSpecificInfo codec_specific{};
+        codec_specific.codecType                                = VideoCodecType::kVideoCodecH264;
+        codec_specific.codecSpecific.H264.packetization_mode    = packetizationMode_;
+        codec_specific.codecSpecific.H264.temporal_idx          = kNoTemporalIdx;
+        codec_specific.codecSpecific.H264.idr_frame             = image._frameType == VideoFrameType::kVideoFrameKey;
+        codec_specific.codecSpecific.H264.base_layer_sync       = false;
 
-    // Deliver encoded image.
-    encodedImageCallback_->OnEncodedImage(image_, &codec_specific);
+        packetWindow_.packets += layer.packets;
+        packetWindow_.maxPacketsPerFrame = std::max(packetWindow_.maxPacketsPerFrame, layer.packets);
+        packetWindow_.maxFrameBytes = std::max(packetWindow_.maxFrameBytes, (uint32_t)image.size());
+        if (image._frameType == VideoFrameType::kVideoFrameKey)
+            ++packetWindow_.idrFrames;
+
+        // Copy exactly what is handed to the packetizer.
+        {
+            MutexLock lock(&g_teeMutex);
+            if (g_tee)
+            {
+                EncodedFrameTee::Frame frame;
+                frame.layer             = (uint32_t)layer.simulcastIdx;
+                frame.rtpTimestamp      = inputFrame.timestamp();
+                frame.captureTimeMs     = inputFrame.render_time_ms();
+                frame.encodeStartMs     = layer.encodeStartMs;
+                frame.encodeFinishMs    = layer.encodeFinishMs;
+                frame.width             = image._encodedWidth;
+                frame.height            = image._encodedHeight;
+                frame.key               = image._frameType == VideoFrameType::kVideoFrameKey;
+                frame.qp                = image.qp_;
+                frame.data.assign(image.data(), image.data() + image.size());
+                g_tee->Write(std::move(frame));
+            }
+        }
+
+        // Deliver encoded image.
+        encodedImageCallback_->OnEncodedImage(image, &codec_specific);
+    }
+
+    if (result != WEBRTC_VIDEO_CODEC_OK)
+    {
+        // Release() joins the encode thread, so it can't run on it.
+        if (!encodeThread_ || !encodeThread_->IsCurrent())
+        {
+            Release();
+            ReportError();
+        }
+        return result;
+    }
 
     ++frameCount_;
+    ++g_queueEncoded;
+    ++packetWindow_.frames;
+    UpdatePacketRateStats(rtc::TimeMillis());
+
+#if X264ENC_ADAPTIVE_PRESET
+    // Layers encode in parallel, so the slowest one sets the frame's cost.
+    int64_t encodeMs = 0;
+    for (const auto& layer : layers_)
+    {
+        if (layer->sending)
+            encodeMs = std::max(encodeMs, layer->encodeFinishMs - layer->encodeStartMs);
+    }
+    UpdatePreset(encodeMs);
+#endif
 
     return WEBRTC_VIDEO_CODEC_OK;
 }
@@ -730,7 +1229,7 @@ VideoEncoder::EncoderInfo X264Encoder::GetEncoderInfo() const
     info.scaling_settings               = VideoEncoder::ScalingSettings::kOff;
     info.has_internal_source            = false;
     info.is_hardware_accelerated        = false;
-    info.supports_simulcast             = false;
+    info.supports_simulcast             = true;
     //info.preferred_pixel_formats        = {VideoFrameBuffer::Type::kNV12};
     return info;
 }
@@ -738,29 +1237,360 @@ VideoEncoder::EncoderInfo X264Encoder::GetEncoderInfo() const
 
 bool X264Encoder::ReconfigureFps(uint32_t fps)
 {
-    x264_param_t params{};
-    x264_encoder_parameters(encoder_, &params);
+    bool ok = true;
+    for (auto& layer : layers_)
+    {
+        x264_param_t params{};
+        x264_encoder_parameters(layer->encoder, &params);
 
-    params.i_fps_num    = fps;
-    params.i_fps_den    = 1;
-    params.i_keyint_max = (int)fps * kIDRIntervalSec;
-    params.i_keyint_min = params.i_keyint_max / 2;
+        params.i_fps_num    = fps;
+        params.i_fps_den    = 1;
+        params.i_keyint_max = (int)fps * kIDRIntervalSec;
+        params.i_keyint_min = params.i_keyint_max / 2;
 
-    int ret = x264_encoder_reconfig(encoder_, &params);
-    if (ret < 0)
+        int ret = x264_encoder_reconfig(layer->encoder, &params);
+        if (ret < 0)
+        {
+            RTC_LOG_F(LS_WARNING) << "Failed to reconfigure encoder (fps). code: " << ret;
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+
+/// Reconfigures every sending layer to its SetRates() target times the rate
+/// controller's scale. Runs on the thread that owns x264; skips changes below
+/// the threshold unless |force|.
+void X264Encoder::ApplyRateControl(bool force)
+{
+    const bool sendSideBwe = g_sendSideBwe;
+#if X264ENC_RATE_CONTROL
+    const double controllerScale = rateController_.Update(rtc::TimeMillis());
+    const double scale = sendSideBwe ? 1.0 : controllerScale;
+#else
+    const double scale = 1.0;
+#endif
+    const int vbvDivisor = scale < 1.0 ? kCongestedVbvBufferSizeFactor : kVbvBufferSizeFactor;
+
+    uint32_t targetKbps = 0;
+    uint32_t appliedKbps = 0;
+    for (auto& layer : layers_)
+    {
+        if (!layer->sending)
+            continue;
+
+        const uint32_t kbps = std::max<uint32_t>(1, (uint32_t)(layer->bitrateKbps * scale));
+        const uint32_t delta = kbps > layer->appliedKbps ? kbps - layer->appliedKbps : layer->appliedKbps - kbps;
+        if (force || vbvDivisor != layer->vbvDivisor || delta * kRateChangeThreshold > layer->appliedKbps)
+            ReconfigureBitrate(*layer, (int)kbps, vbvDivisor);
+
+        targetKbps += layer->bitrateKbps;
+        appliedKbps += layer->appliedKbps;
+    }
+
+    MutexLock lock(&g_rateStatsMutex);
+    g_rateStats.controller  = rateController_.GetStats();
+    g_rateStats.targetKbps  = targetKbps;
+    g_rateStats.appliedKbps = appliedKbps;
+    g_rateStats.bandwidthKbps = bandwidthKbps_;
+    g_rateStats.sendSideBwe = sendSideBwe;
+}
+
+
+// static
+void X264Encoder::SetSendSideBwe(bool enabled)
+{
+    if (g_sendSideBwe.exchange(enabled) != enabled)
+        RTC_LOG(LS_INFO) << "Rate control: " << (enabled ? "transport-cc (GCC) targets" : "REMB targets with loss/RTT scaling");
+}
+
+
+void X264Encoder::OnKeyFrameRequest(Layer& layer)
+{
+    const int64_t nowMs = rtc::TimeMillis();
+    const auto decision = layer.keyFrameArbiter.OnRequest(nowMs);
+    RTC_LOG(LS_VERBOSE) << "Key frame request on layer " << layer.simulcastIdx << ": "
+                        << KeyFrameArbiter::DecisionName(decision);
+
+    switch (decision)
+    {
+    case KeyFrameArbiter::Decision::kHonored:
+        layer.sendIDR = true;
+        ++g_keyRequestsHonored;
+        break;
+
+    case KeyFrameArbiter::Decision::kMerged:
+        ++g_keyRequestsMerged;
+        break;
+
+    case KeyFrameArbiter::Decision::kIgnored:
+        ++g_keyRequestsIgnored;
+#if X264ENC_INTRA_REFRESH
+        // A decoder that lost sync recovers from a refresh wave; start one
+        // unless a requested wave is still sweeping the picture.
+        if (nowMs - layer.lastRefreshMs >= kIDRIntervalSec * 1000)
+        {
+            layer.sendRefresh = true;
+            layer.lastRefreshMs = nowMs;
+            ++packetWindow_.refreshWaves;
+            ++g_keyRequestRefreshes;
+        }
+#endif
+        break;
+    }
+}
+
+
+// static
+X264Encoder::KeyFrameRequestStats X264Encoder::GetKeyFrameRequestStats()
+{
+    KeyFrameRequestStats stats;
+    stats.honored       = g_keyRequestsHonored.load(std::memory_order_relaxed);
+    stats.merged        = g_keyRequestsMerged.load(std::memory_order_relaxed);
+    stats.ignored       = g_keyRequestsIgnored.load(std::memory_order_relaxed);
+    stats.refreshWaves  = g_keyRequestRefreshes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+
+void X264Encoder::UpdatePacketRateStats(int64_t nowMs)
+{
+    if (packetWindowStartMs_ == 0)
+        packetWindowStartMs_ = nowMs;
+    if (nowMs - packetWindowStartMs_ < 1000)
+        return;
+
+    {
+        MutexLock lock(&g_packetStatsMutex);
+        g_packetStats = packetWindow_;
+    }
+    packetWindow_ = {};
+    packetWindowStartMs_ = nowMs;
+}
+
+
+// static
+X264Encoder::PacketRateStats X264Encoder::GetPacketRateStats()
+{
+    MutexLock lock(&g_packetStatsMutex);
+    return g_packetStats;
+}
+
+
+// static
+X264Encoder::RateControlStats X264Encoder::GetRateControlStats()
+{
+    MutexLock lock(&g_rateStatsMutex);
+    return g_rateStats;
+}
+
+
+// static
+EncoderTelemetry::Histograms X264Encoder::TakeTelemetryHistograms()
+{
+    return g_telemetry.TakeHistograms();
+}
+
+
+// static
+bool X264Encoder::DumpTelemetry(const std::string& path)
+{
+    return g_telemetry.DumpToFile(path);
+}
+
+
+// static
+void X264Encoder::ResetSessionStats()
+{
+    g_queueDepth        = 0;
+    g_queueEncoded      = 0;
+    g_queueDropped      = 0;
+    g_queueWaitTotalMs  = 0;
+    g_queueWaitMaxMs    = 0;
+
+    g_keyRequestsHonored    = 0;
+    g_keyRequestsMerged     = 0;
+    g_keyRequestsIgnored    = 0;
+    g_keyRequestRefreshes   = 0;
+
+    {
+        MutexLock lock(&g_rateStatsMutex);
+        g_rateStats = {};
+    }
+    {
+        MutexLock lock(&g_packetStatsMutex);
+        g_packetStats = {};
+    }
+
+    g_telemetry.Reset();
+}
+
+
+// static
+bool X264Encoder::StartOutputTee(const std::string& basePath)
+{
+    auto tee = make_unique<EncodedFrameTee>(basePath);
+    if (!tee->IsOpen())
+        return false;
+
+    {
+        MutexLock lock(&g_teeMutex);
+        std::swap(g_tee, tee);
+    }
+    // A previous tee, if any, is flushed here, outside the lock.
+    return true;
+}
+
+
+// static
+void X264Encoder::StopOutputTee()
+{
+    unique_ptr<EncodedFrameTee> tee;
+    {
+        MutexLock lock(&g_teeMutex);
+        tee = std::move(g_tee);
+    }
+    // |tee| is flushed on return, outside the lock, so the encoder isn't held up.
+}
+
+
+/// True if encoders opened with |a| and |b| differ only in what
+/// x264_encoder_reconfig() can change: not the picture format, threading,
+/// GOP and lookahead structure, entropy coder, stream headers, or whether
+/// VBV is on.
+static bool SameEncoderLayout(const x264_param_t& a, const x264_param_t& b)
+{
+    return a.i_width                == b.i_width
+        && a.i_height               == b.i_height
+        && a.i_csp                  == b.i_csp
+        && a.i_bitdepth             == b.i_bitdepth
+        && a.i_fps_num              == b.i_fps_num
+        && a.i_fps_den              == b.i_fps_den
+        && a.i_timebase_num         == b.i_timebase_num
+        && a.i_timebase_den         == b.i_timebase_den
+        && a.i_level_idc            == b.i_level_idc
+        && a.i_threads              == b.i_threads
+        && a.b_sliced_threads       == b.b_sliced_threads
+        && a.i_sync_lookahead       == b.i_sync_lookahead
+        && a.i_slice_max_size       == b.i_slice_max_size
+        && a.i_slice_count          == b.i_slice_count
+        && a.i_keyint_max           == b.i_keyint_max
+        && a.i_keyint_min           == b.i_keyint_min
+        && a.i_bframe               == b.i_bframe
+        && a.b_open_gop             == b.b_open_gop
+        && a.b_interlaced           == b.b_interlaced
+        && a.b_cabac                == b.b_cabac
+        && a.i_frame_reference      == b.i_frame_reference
+        && a.i_nal_hrd              == b.i_nal_hrd
+        && a.b_intra_refresh        == b.b_intra_refresh
+        && a.b_annexb               == b.b_annexb
+        && a.b_repeat_headers       == b.b_repeat_headers
+        && a.analyse.b_transform_8x8 == b.analyse.b_transform_8x8
+        && a.vui.b_fullrange        == b.vui.b_fullrange
+        && a.vui.i_colorprim        == b.vui.i_colorprim
+        && a.vui.i_transfer         == b.vui.i_transfer
+        && a.vui.i_colmatrix        == b.vui.i_colmatrix
+        && a.rc.i_rc_method         == b.rc.i_rc_method
+        && a.rc.i_lookahead         == b.rc.i_lookahead
+        && a.rc.b_mb_tree           == b.rc.b_mb_tree
+        && (a.rc.i_vbv_max_bitrate > 0) == (b.rc.i_vbv_max_bitrate > 0)
+        && (a.rc.i_vbv_buffer_size > 0) == (b.rc.i_vbv_buffer_size > 0);
+}
+
+
+// static
+bool X264Encoder::PrewarmEncoder(int width, int height, int fps, int bitrateKbps, int packetizationMode)
+{
+    if (width < 1 || height < 1 || fps < 1)
+        return false;
+
+    // Same parameters InitEncode() builds for a single layer of this shape.
+    cricket::VideoCodec codec(cricket::kH264CodecName);
+    codec.SetParam(cricket::kH264FmtpPacketizationMode, std::to_string(packetizationMode));
+    X264Encoder shape(codec);
+    shape.fps_              = std::min(kMaxFramerate, (uint32_t)fps);
+    shape.maxPayloadSize_   = kPrewarmMaxPayloadSize;
+    auto params = shape.CreateEncoderParams(width, height, (uint32_t)bitrateKbps);
+    if (!params)
+        return false;
+
+    const int64_t startMs = rtc::TimeMillis();
+    x264_t* encoder = x264_encoder_open(params.get());
+    if (!encoder)
     {
-        RTC_LOG_F(LS_WARNING) << "Failed to reconfigure encoder (fps). code: " << ret;
+        RTC_LOG_F(LS_WARNING) << "Failed to pre-open x264 encoder";
         return false;
     }
+    RTC_LOG(LS_INFO) << "Pre-opened x264 encoder " << width << "x" << height << "@" << shape.fps_
+                     << " in " << rtc::TimeMillis() - startMs << " ms";
 
+    x264_t* old = nullptr;
+    {
+        MutexLock lock(&g_warmMutex);
+        old = g_warmEncoder;
+        g_warmEncoder = encoder;
+        g_warmParams = *params;
+        g_warmPreset = shape.preset_;
+        g_warmParkedMs = rtc::TimeMillis();
+    }
+    if (old)
+        x264_encoder_close(old);
     return true;
 }
 
 
-bool X264Encoder::ReconfigureBitrate(int bitrateKbps)
+// static
+void X264Encoder::ReleaseWarmEncoder()
+{
+    x264_t* old = nullptr;
+    {
+        MutexLock lock(&g_warmMutex);
+        std::swap(old, g_warmEncoder);
+    }
+    if (old)
+        x264_encoder_close(old);
+}
+
+
+// static
+void X264Encoder::ExpireWarmEncoder(int64_t maxAgeMs)
+{
+    x264_t* old = nullptr;
+    {
+        MutexLock lock(&g_warmMutex);
+        if (!g_warmEncoder || rtc::TimeMillis() - g_warmParkedMs < maxAgeMs)
+            return;
+        std::swap(old, g_warmEncoder);
+    }
+    RTC_LOG(LS_INFO) << "Closing unused pre-opened x264 encoder";
+    x264_encoder_close(old);
+}
+
+
+x264_t* X264Encoder::TakeWarmEncoder(const x264_param_t& params)
+{
+    MutexLock lock(&g_warmMutex);
+    if (!g_warmEncoder)
+        return nullptr;
+    if (g_warmPreset != preset_ || !SameEncoderLayout(g_warmParams, params))
+    {
+        RTC_LOG(LS_INFO) << "Pre-opened x264 encoder does not match, opening a new one";
+        return nullptr;
+    }
+
+    RTC_LOG(LS_INFO) << "Using pre-opened x264 encoder";
+    x264_t* encoder = nullptr;
+    std::swap(encoder, g_warmEncoder);
+    return encoder;
+}
+
+
+bool X264Encoder::ReconfigureBitrate(Layer& layer, int bitrateKbps, int vbvDivisor)
 {
     x264_param_t params{};
-    x264_encoder_parameters(encoder_, &params);
+    x264_encoder_parameters(layer.encoder, &params);
 
     // Reset rate control parameters.
     params.rc.i_bitrate = bitrateKbps;
@@ -769,48 +1599,108 @@ bool X264Encoder::ReconfigureBitrate(int bitrateKbps)
     if (params.i_nal_hrd == X264_NAL_HRD_NONE)
     {
         params.rc.i_vbv_max_bitrate = params.rc.i_bitrate;
-        params.rc.i_vbv_buffer_size = params.rc.i_bitrate / kVbvBufferSizeFactor;
+        params.rc.i_vbv_buffer_size = params.rc.i_bitrate / vbvDivisor;
     }
 
     if (params.rc.i_rc_method == X264_RC_CRF)
     {
         params.rc.f_rf_constant =
-            UseHqCrf(height_, bitrateKbps) ? kHighQualityCrf : kNormalQualityCrf;
+            UseHqCrf(layer.height, bitrateKbps) ? kHighQualityCrf : kNormalQualityCrf;
     }
 
-    int ret = x264_encoder_reconfig(encoder_, &params);
+    int ret = x264_encoder_reconfig(layer.encoder, &params);
     if (ret < 0)
     {
         RTC_LOG_F(LS_WARNING) << "Failed to reconfigure encoder (bitrate). code: " << ret;
         return false;
     }
 
+    layer.appliedKbps = (uint32_t)bitrateKbps;
+    layer.vbvDivisor = vbvDivisor;
     return true;
 }
 
 
-bool X264Encoder::ReconfigureFrameSize(int width, int height)
+bool X264Encoder::ReconfigureFrameSize(Layer& layer, int width, int height)
 {
     x264_param_t params{};
-    x264_encoder_parameters(encoder_, &params);
+    x264_encoder_parameters(layer.encoder, &params);
 
     params.i_width  = width;
     params.i_height = height;
 
-    int ret = x264_encoder_reconfig(encoder_, &params);
+    int ret = x264_encoder_reconfig(layer.encoder, &params);
     if (ret < 0)
     {
         RTC_LOG_F(LS_WARNING) << "Failed to reconfigure encoder (frame size). code: " << ret;
         return false;
     }
 
+    layer.width  = width;
+    layer.height = height;
+    return true;
+}
+
+
+void X264Encoder::UpdatePreset(int64_t encodeMs)
+{
+    if (!presetController_.OnFrameEncoded(encodeMs))
+        return;
+
+    const auto& level = presetController_.current();
+    RTC_LOG_F(LS_INFO) << "Encode time " << encodeMs << " ms at " << fps_ << " fps, switching to preset level "
+                       << presetController_.level() << " (" << level.preset
+                       << (level.subme ? ", reduced subme/ref" : "") << ")";
+
+    for (auto& layer : layers_)
+        ReconfigurePreset(*layer, level);
+}
+
+
+bool X264Encoder::ReconfigurePreset(Layer& layer, const PresetLevel& level)
+{
+    x264_param_t presetParams{};
+    int ret = x264_param_default_preset(&presetParams, level.preset, "zerolatency");
+    if (ret < 0)
+    {
+        RTC_LOG_F(LS_WARNING) << "Unknown x264 preset: " << level.preset;
+        return false;
+    }
+
+    x264_param_t params{};
+    x264_encoder_parameters(layer.encoder, &params);
+
+    // Only the analysis settings of a preset can change on an open encoder.
+    // Keep the ones the stream was opened with or WebRTC depends on.
+    const int transform8x8  = params.analyse.b_transform_8x8;
+    const int trellis       = params.analyse.i_trellis;
+    const float psyTrellis  = params.analyse.f_psy_trellis;
+
+    params.analyse                  = presetParams.analyse;
+    params.analyse.b_transform_8x8  = transform8x8;
+    params.analyse.i_trellis        = trellis;
+    params.analyse.f_psy_trellis    = psyTrellis;
+    params.analyse.i_weighted_pred  = 0;  // Not supported by WebRTC's bitstream parser
+
+    if (level.subme > 0)
+        params.analyse.i_subpel_refine = level.subme;
+    params.i_frame_reference =
+        std::min(layer.maxRefFrames, level.ref > 0 ? level.ref : presetParams.i_frame_reference);
+
+    ret = x264_encoder_reconfig(layer.encoder, &params);
+    if (ret < 0)
+    {
+        RTC_LOG_F(LS_WARNING) << "Failed to reconfigure encoder (preset). code: " << ret;
+        return false;
+    }
+
     return true;
 }
 
 
 bool X264Encoder::IsInitialized() const
 {
-    return encoder_ != nullptr;
+    return !layers_.empty() && layers_[0]->encoder != nullptr;
 }
 
 
@@ -840,6 +1730,7 @@ void X264Encoder::OnPacketLossRateUpdate(float packet_loss_rate)
     {
         RTC_LOG(INFO) << "packet loss rate: " << packet_loss_rate;
     }
+    rateController_.OnPacketLoss(packet_loss_rate, rtc::TimeMillis());
 }
 
 
@@ -854,6 +1745,7 @@ void X264Encoder::OnRttUpdate(int64_t rtt_ms)
 #endif
     }
     rtt_ms_ = rtt_ms;
+    rateController_.OnRtt(rtt_ms, rtc::TimeMillis());
 }
 
 
@@ -863,4 +1755,10 @@ void X264Encoder::OnLossNotification(const VideoEncoder::LossNotification& loss_
     RTC_LOG(INFO) << "time of last received:   " << loss_notification.timestamp_of_last_received;
     RTC_LOG(INFO) << "last received decodable? " << (loss_notification.last_received_decodable ? "yes" : "no");
     RTC_LOG(INFO) << "dependencies decodable?  " << (loss_notification.dependencies_of_last_received_decodable ? "yes" : "no");
+
+    if (!loss_notification.last_received_decodable.value_or(true)
+        || !loss_notification.dependencies_of_last_received_decodable.value_or(true))
+    {
+        rateController_.OnUndecodable(rtc::TimeMillis());
+    }
 }
@@ -28,7 +28,17 @@
 #include "modules/video_coding/codecs/h264/include/h264.h"
 #include "modules/video_coding/codecs/h264/include/h264_globals.h"
 #include "modules/video_coding/include/video_codec_interface.h"
+#include "rtc_base/event.h"
 #include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread.h"
+
+#include "EncodedBufferPool.h"
+#include "EncodedFrameTee.h"
+#include "EncoderTelemetry.h"
+#include "KeyFrameArbiter.h"
+#include "NV12FramePool.h"
+#include "PresetController.h"
+#include "RateController.h"
 
 #ifdef _WIN32
 #ifndef X264_API_IMPORTS
@@ -40,8 +50,11 @@
 #include <cstdint>
 #include <x264.h>
 
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <string>
 
 using std::unique_ptr;
 using std::vector;
@@ -78,34 +91,185 @@ public:
     void SetFecControllerOverride(FecControllerOverride* fec_controller_override) override {};
 #endif
 
-    unique_ptr<x264_param_t> CreateEncoderParams();
+    unique_ptr<x264_param_t> CreateEncoderParams(int width, int height, uint32_t bitrateKbps);
+
+    /// Encode queue statistics, shared by all instances.
+    struct QueueStats
+    {
+        size_t      depth;          // frames currently waiting for the encode thread
+        uint64_t    encoded;        // frames encoded
+        uint64_t    dropped;        // frames dropped because the queue was full
+        double      avgWaitMs;      // mean time a frame waited in the queue
+        int64_t     maxWaitMs;      // longest time a frame waited in the queue
+    };
+    static QueueStats GetQueueStats();
+
+    /// Loss/RTT rate controller state, shared by all instances.
+    struct RateControlStats
+    {
+        RateController::Stats   controller;
+        uint32_t                targetKbps;     // sum of SetRates() layer targets
+        uint32_t                appliedKbps;    // sum of rates configured in x264
+        uint32_t                bandwidthKbps;  // WebRTC's bandwidth estimate from SetRates()
+        bool                    sendSideBwe;    // targets come from transport-cc (GCC) as is
+    };
+    static RateControlStats GetRateControlStats();
+
+    /// With transport-cc negotiated, WebRTC's send-side estimator (GCC) already
+    /// reacts to loss and queuing delay, so SetRates() targets are applied as
+    /// is and the local RateController scaling is bypassed. Shared by all
+    /// instances; takes effect on the next rate update.
+    static void SetSendSideBwe(bool enabled);
+
+    /// Output packet rate over the last complete second, shared by all instances.
+    struct PacketRateStats
+    {
+        uint32_t    frames;
+        uint32_t    packets;                // packets per second
+        uint32_t    maxPacketsPerFrame;     // largest single-frame burst
+        uint32_t    maxFrameBytes;
+        uint32_t    idrFrames;
+        uint32_t    refreshWaves;           // requested intra-refresh waves started
+    };
+    static PacketRateStats GetPacketRateStats();
+
+    /// Key frame request (FIR/PLI) outcomes, shared by all instances.
+    struct KeyFrameRequestStats
+    {
+        uint64_t    honored;        // answered with an IDR
+        uint64_t    merged;         // answered by a pending or just-sent IDR
+        uint64_t    ignored;        // inside the minimum IDR spacing
+        uint64_t    refreshWaves;   // ignored requests answered with an intra-refresh wave
+    };
+    static KeyFrameRequestStats GetKeyFrameRequestStats();
+
+    /// Per-frame telemetry histograms since the last call, shared by all instances.
+    static EncoderTelemetry::Histograms TakeTelemetryHistograms();
+    /// Writes the last EncoderTelemetry::kRingSize layer frames as CSV.
+    static bool DumpTelemetry(const std::string& path);
+
+    /// Clears the shared queue, rate, packet and key request stats and the
+    /// telemetry, so they cover one stream. Call before the stream's encoder
+    /// is created.
+    static void ResetSessionStats();
+
+    /// Copies every encoded layer frame to "<basePath>.L<n>.h264" plus a
+    /// "<basePath>.csv" index until StopOutputTee(). See EncodedFrameTee.
+    static bool StartOutputTee(const std::string& basePath);
+    static void StopOutputTee();
+
+    /// Opens an x264 encoder for |width| x |height| at |fps| and parks it. The
+    /// next single-layer InitEncode() whose encoder layout matches adopts it
+    /// instead of opening its own; a mismatch opens as usual. Replaces any
+    /// encoder already parked. Blocks for the x264 open; call off hot threads.
+    static bool PrewarmEncoder(int width, int height, int fps, int bitrateKbps, int packetizationMode);
+    /// Closes the parked encoder, if any.
+    static void ReleaseWarmEncoder();
+    /// Closes the parked encoder if it was parked at least |maxAgeMs| ago.
+    static void ExpireWarmEncoder(int64_t maxAgeMs);
 
     // Exposed for testing.
     webrtc::H264PacketizationMode PacketizationModeForTesting() const { return packetizationMode_; }
+    /// Overrides the x264 preset and thread count (0 = auto) used by the next InitEncode().
+    void SetEncoderOptionsForTesting(const std::string& preset, int threads)
+    {
+        preset_ = preset;
+        threads_ = threads > 0 ? threads : X264_THREADS_AUTO;
+        adaptivePreset_ = false;
+    }
 
 private:
+    /// Encoder state for one simulcast layer. |layers_[0]| encodes the input
+    /// resolution; every following layer is downscaled from the layer before it.
+    struct Layer
+    {
+        x264_t*                         encoder             = nullptr;
+        x264_picture_t                  picIn{};
+        x264_picture_t                  picOut{};
+        webrtc::EncodedImage            image;
+        webrtc::H264BitstreamParser     bitstreamParser;
+        EncodedBufferPool               outputPool;
+
+        // Downscaled input for layers > 0 (null for layer 0).
+        unique_ptr<NV12FramePool>       scalePool;
+        rtc::scoped_refptr<webrtc::NV12Buffer> scaled;
+
+        // Signalled when an encode posted to a layer thread has finished.
+        rtc::Event                      done;
+
+        size_t      simulcastIdx        = 0;
+        int         width               = 0;
+        int         height              = 0;
+        uint32_t    bitrateKbps         = 0;
+        uint32_t    maxBitrateKbps      = 0;
+        uint32_t    appliedKbps         = 0;  // rate configured in x264 (target scaled by rate control)
+        int         vbvDivisor          = 0;
+        int         maxRefFrames        = 1;  // reference frames allocated at open; reconfig can't exceed it
+        uint32_t    openFps             = 0;  // frame rate at open; reconfig keeps its keyint (in frames)
+        bool        sending             = true;
+        bool        sendIDR             = false;
+        bool        sendRefresh         = false;  // start an intra-refresh wave (intra-refresh mode)
+        int64_t     lastRefreshMs       = 0;
+        int64_t     lastIdrMs           = 0;
+        KeyFrameArbiter                 keyFrameArbiter;
+
+        // Results of the last EncodeLayer() call.
+        int         encodedFrameSize    = 0;
+        uint32_t    packets             = 0;  // estimated RTP packets
+        int64_t     encodeStartMs       = 0;
+        int64_t     encodeFinishMs      = 0;
+    };
+
+    /// A frame waiting for the async encode thread.
+    struct QueuedFrame
+    {
+        webrtc::VideoFrame              frame;
+        vector<webrtc::VideoFrameType>  frameTypes;
+        int64_t                         enqueuedMs = 0;
+    };
+
+    int32_t EncodeFrame(const webrtc::VideoFrame& frame, const vector<webrtc::VideoFrameType>* frameTypes);
+    void EnqueueFrame(const webrtc::VideoFrame& frame, const vector<webrtc::VideoFrameType>* frameTypes);
+    void EncodeQueued();
+    void ApplyRates(const webrtc::VideoEncoder::RateControlParameters& parameters);
+    void EncodeLayer(Layer& layer, const webrtc::NV12BufferInterface& buffer);
+    void OnKeyFrameRequest(Layer& layer);
+    void UpdatePacketRateStats(int64_t nowMs);
     bool ReconfigureFps(uint32_t fps);
-    bool ReconfigureBitrate(int bitrateKbps);
-    bool ReconfigureFrameSize(int width, int height);
+    bool ReconfigureBitrate(Layer& layer, int bitrateKbps, int vbvDivisor);
+    void ApplyRateControl(bool force);
+    bool ReconfigureFrameSize(Layer& layer, int width, int height);
+    bool ReconfigurePreset(Layer& layer, const PresetLevel& level);
+    void UpdatePreset(int64_t encodeMs);
+    x264_t* TakeWarmEncoder(const x264_param_t& params);
     bool IsInitialized() const;
     void ReportInit();
     void ReportError();
 
-    x264_t*                         encoder_ = nullptr;
-    x264_picture_t                  picIn_;
+    vector<unique_ptr<Layer>>               layers_;
+    // Threads running x264 for layers_[1..n]; layers_[0] encodes on the caller's thread.
+    vector<unique_ptr<rtc::Thread>>         layerThreads_;
+
+    // Async mode (X264ENC_ASYNC_ENCODE): Encode() queues frames here and the
+    // encode thread encodes and delivers them.
+    unique_ptr<rtc::Thread>                 encodeThread_;
+    webrtc::Mutex                           queueMutex_;
+    std::deque<QueuedFrame>                 queue_ RTC_GUARDED_BY(queueMutex_);
+    std::atomic<bool>                       asyncError_{false};
 
-    webrtc::EncodedImage            image_;
     webrtc::EncodedImageCallback*   encodedImageCallback_ = nullptr;
-    webrtc::H264BitstreamParser     bitstreamParser_;
     webrtc::H264PacketizationMode   packetizationMode_;
     webrtc::VideoCodec              codec_;
 
-    int         width_              = 0;
-    int         height_             = 0;
+    std::string preset_             = "veryfast";
+    int         threads_            = X264_THREADS_AUTO;
+    bool        adaptivePreset_     = true;
+    // Only used on the thread that runs x264 (see |encodeThread_|).
+    PresetController presetController_;
+    RateController   rateController_;
+
     double      maxFramerate_       = 0.0;
     uint32_t    fps_                = 0;
-    uint32_t    bitrate_kbps_       = 0;
-    uint32_t    maxBitrateKbps_     = 0;
     size_t      maxPayloadSize_     = 0;
 
     bool        paused_             = false;
@@ -113,7 +277,13 @@ private:
     bool        hasReportedError_   = false;
 
     int64_t     frameCount_         = 0;
+    int64_t     queueWaitMs_        = 0;    // queue wait of the frame being encoded
+
+    // Packet rate window being accumulated; x264 thread only.
+    PacketRateStats packetWindow_{};
+    int64_t     packetWindowStartMs_ = 0;
     int64_t     rtt_ms_             = 0;
+    uint32_t    bandwidthKbps_      = 0;    // last SetRates() bandwidth allocation
 };
 
 #endif  // X264_ENCODER_H_
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "BenchUtil.h"
+
+#include <algorithm>
+#include <sstream>
+
+using std::string;
+using std::vector;
+
+
+void CreateObserver::OnSuccess(webrtc::SessionDescriptionInterface* desc)
+{
+    this->desc.reset(desc);
+    done.Set();
+}
+
+
+void CreateObserver::OnFailure(webrtc::RTCError error)
+{
+    this->error = error.message();
+    done.Set();
+}
+
+
+void SetObserver::Complete(const webrtc::RTCError& error)
+{
+    if (!error.ok())
+        this->error = error.message();
+    done.Set();
+}
+
+
+vector<string> BenchUtil::Split(const string& list)
+{
+    vector<string> out;
+    std::istringstream stream(list);
+    string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+            out.push_back(item);
+    }
+    return out;
+}
+
+
+int64_t BenchUtil::Percentile(vector<int64_t>& values, double p)
+{
+    if (values.empty())
+        return 0;
+    const size_t k = std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#ifndef BENCH_UTIL_H_
+#define BENCH_UTIL_H_
+
+#include "api/jsep.h"
+#include "api/set_local_description_observer_interface.h"
+#include "api/set_remote_description_observer_interface.h"
+#include "rtc_base/event.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/// Keeps the description made by CreateOffer()/CreateAnswer(); |done| is set
+/// on success and failure alike.
+class CreateObserver : public webrtc::CreateSessionDescriptionObserver
+{
+public:
+    void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
+    void OnFailure(webrtc::RTCError error) override;
+
+    std::unique_ptr<webrtc::SessionDescriptionInterface>    desc;
+    std::string                                             error;
+    rtc::Event                                              done;
+};
+
+
+/// Waits for SetLocalDescription() or SetRemoteDescription(); |error| is empty
+/// on success.
+class SetObserver
+    : public webrtc::SetLocalDescriptionObserverInterface
+    , public webrtc::SetRemoteDescriptionObserverInterface
+{
+public:
+    void OnSetLocalDescriptionComplete(webrtc::RTCError error) override { Complete(error); }
+    void OnSetRemoteDescriptionComplete(webrtc::RTCError error) override { Complete(error); }
+
+    std::string error;
+    rtc::Event  done;
+
+private:
+    void Complete(const webrtc::RTCError& error);
+};
+
+
+/// Helpers shared by the sidekick benches.
+class BenchUtil
+{
+public:
+    /// Splits a comma separated option value, dropping empty items.
+    static std::vector<std::string> Split(const std::string& list);
+
+    /// The |p| (0..1) percentile of |values|, which are reordered; 0 when empty.
+    static int64_t Percentile(std::vector<int64_t>& values, double p);
+};
+
+#endif  // BENCH_UTIL_H_
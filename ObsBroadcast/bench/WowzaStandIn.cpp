@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "WowzaStandIn.h"
+
+#define ASIO_STANDALONE
+#define _WEBSOCKETPP_CPP11_STL_
+#define _WEBSOCKETPP_CPP11_THREAD_
+#define _WEBSOCKETPP_CPP11_FUNCTIONAL_
+#define _WEBSOCKETPP_CPP11_SYSTEM_ERROR_
+#define _WEBSOCKETPP_CPP11_RANDOM_DEVICE_
+#define _WEBSOCKETPP_CPP11_MEMORY_
+
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/server.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <cstdio>
+#include <thread>
+
+using njson = nlohmann::json;
+using std::string;
+using std::vector;
+
+typedef websocketpp::server<websocketpp::config::asio_tls> Server;
+typedef Server::message_ptr message_ptr;
+
+
+/// PEM of a P-256 key and a one-day self-signed certificate for localhost.
+static bool MakeSelfSignedCertificate(string& sCertPem, string& sKeyPem)
+{
+    bool retVal = false;
+    EVP_PKEY* pKey = nullptr;
+    EVP_PKEY_CTX* pKeyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    X509* pCert = X509_new();
+    BIO* pCertBio = BIO_new(BIO_s_mem());
+    BIO* pKeyBio = BIO_new(BIO_s_mem());
+
+    if (pKeyCtx && pCert && pCertBio && pKeyBio
+        && EVP_PKEY_keygen_init(pKeyCtx) > 0
+        && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pKeyCtx, NID_X9_62_prime256v1) > 0
+        && EVP_PKEY_keygen(pKeyCtx, &pKey) > 0)
+    {
+        X509_set_version(pCert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(pCert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(pCert), -3600);
+        X509_gmtime_adj(X509_getm_notAfter(pCert), 24 * 3600);
+        X509_set_pubkey(pCert, pKey);
+
+        X509_NAME* pName = X509_get_subject_name(pCert);
+        X509_NAME_add_entry_by_txt(pName, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+        X509_set_issuer_name(pCert, pName);
+
+        if (X509_sign(pCert, pKey, EVP_sha256()) > 0
+            && PEM_write_bio_X509(pCertBio, pCert) > 0
+            && PEM_write_bio_PrivateKey(pKeyBio, pKey, nullptr, nullptr, 0, nullptr, nullptr) > 0)
+        {
+            char* pData = nullptr;
+            long nLen = BIO_get_mem_data(pCertBio, &pData);
+            sCertPem.assign(pData, nLen);
+            nLen = BIO_get_mem_data(pKeyBio, &pData);
+            sKeyPem.assign(pData, nLen);
+            retVal = true;
+        }
+    }
+
+    BIO_free(pKeyBio);
+    BIO_free(pCertBio);
+    X509_free(pCert);
+    EVP_PKEY_free(pKey);
+    EVP_PKEY_CTX_free(pKeyCtx);
+    return retVal;
+}
+
+
+class WowzaStandInImpl : public WowzaStandIn
+{
+public:
+    WowzaStandInImpl();
+    ~WowzaStandInImpl() override;
+
+    ///
+    /// WowzaStandIn implementation.
+    ///
+    string start(Handler* pHandler, uint16_t nPort) override;
+    void stop() override;
+
+private:
+    void onMessage(websocketpp::connection_hdl hdl, message_ptr frame);
+    void reply(websocketpp::connection_hdl hdl, const njson& msg);
+
+    Server      m_server;
+    Handler*    m_pHandler;
+    std::thread m_thread;
+    string      m_sCertPem;
+    string      m_sKeyPem;
+};
+
+
+WowzaStandInImpl::WowzaStandInImpl()
+    : m_pHandler(nullptr)
+{
+    m_server.clear_access_channels(websocketpp::log::alevel::all);
+    m_server.clear_error_channels(websocketpp::log::elevel::all);
+    m_server.set_error_channels(websocketpp::log::elevel::rerror | websocketpp::log::elevel::fatal);
+    m_server.init_asio();
+    m_server.set_reuse_addr(true);
+}
+
+
+WowzaStandInImpl::~WowzaStandInImpl()
+{
+    stop();
+}
+
+
+string WowzaStandInImpl::start(Handler* pHandler, uint16_t nPort)
+{
+    if (m_thread.joinable() || !MakeSelfSignedCertificate(m_sCertPem, m_sKeyPem))
+        return "";
+
+    m_pHandler = pHandler;
+    try
+    {
+        m_server.set_tls_init_handler([this](websocketpp::connection_hdl /*hdl*/)
+        {
+            auto ctx = std::make_shared<asio::ssl::context>(asio::ssl::context::tlsv12_server);
+            ctx->set_options(asio::ssl::context::default_workarounds |
+                             asio::ssl::context::no_sslv2 |
+                             asio::ssl::context::no_sslv3 |
+                             asio::ssl::context::single_dh_use);
+            ctx->use_certificate_chain(asio::buffer(m_sCertPem));
+            ctx->use_private_key(asio::buffer(m_sKeyPem), asio::ssl::context::pem);
+            return ctx;
+        });
+        m_server.set_message_handler([this](websocketpp::connection_hdl hdl, message_ptr frame)
+        {
+            onMessage(hdl, frame);
+        });
+
+        m_server.listen(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), nPort));
+        m_server.start_accept();
+
+        asio::error_code ec;
+        const auto local = m_server.get_local_endpoint(ec);
+        if (ec)
+        {
+            fprintf(stderr, "stand-in: no local endpoint: %s\n", ec.message().c_str());
+            return "";
+        }
+
+        m_thread = std::thread([this]() { m_server.run(); });
+        return "wss://127.0.0.1:" + std::to_string(local.port()) + "/webrtc-session.json";
+    }
+    catch (const websocketpp::exception& e)
+    {
+        fprintf(stderr, "stand-in: listen failed: %s\n", e.what());
+        return "";
+    }
+}
+
+
+void WowzaStandInImpl::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    websocketpp::lib::error_code ec;
+    m_server.stop_listening(ec);
+    m_server.stop();
+    m_thread.join();
+}
+
+
+void WowzaStandInImpl::onMessage(websocketpp::connection_hdl hdl, message_ptr frame)
+{
+    const njson msg = njson::parse(frame->get_payload(), nullptr, false);
+    if (msg.is_discarded() || !msg.is_object())
+        return;
+
+    const string command = msg.value("command", "");
+    if (command == "auth")
+    {
+        const njson userData = msg.value("userData", njson::object());
+        if (m_pHandler->onAuth(userData.value("streamName", ""), userData.value("password", "")))
+            reply(hdl, {{ "status", 200 }, { "statusDescription", "OK" }, { "command", command }});
+        else
+            reply(hdl, {{ "status", 502 }, { "statusDescription", "Invalid credentials" }, { "command", command }});
+    }
+    else if (command == "sendOffer")
+    {
+        const njson sdp = msg.value("sdp", njson::object());
+        string sAnswer;
+        vector<Candidate> candidates;
+        if (!m_pHandler->onOffer(sdp.value("sdp", ""), sAnswer, candidates))
+        {
+            reply(hdl, {{ "status", 400 }, { "statusDescription", "Offer rejected" }, { "command", command }});
+            return;
+        }
+
+        njson iceCandidates = njson::array();
+        for (const auto& candidate : candidates)
+        {
+            iceCandidates.push_back({{ "candidate",     candidate.sCandidate   },
+                                     { "sdpMid",        candidate.sMid         },
+                                     { "sdpMLineIndex", candidate.nIndex       }});
+        }
+
+        reply(hdl,
+        {
+            {   "status",            200                                         },
+            {   "statusDescription", "OK"                                        },
+            {   "direction",         "publish"                                   },
+            {   "command",           command                                     },
+            {   "streamInfo",        msg.value("streamInfo", njson::object())    },
+            {   "sdp",               {{ "type", "answer" }, { "sdp", sAnswer }}  },
+            {   "iceCandidates",     iceCandidates                               }
+        });
+    }
+    else if (command == "iceCandidate")
+    {
+        // Trickled publisher candidates; accepted silently.
+        for (const auto& iceCandidate : msg.value("iceCandidates", njson::array()))
+        {
+            m_pHandler->onCandidate({iceCandidate.value("candidate", ""),
+                                     iceCandidate.value("sdpMid", ""),
+                                     iceCandidate.value("sdpMLineIndex", -1)});
+        }
+    }
+    else if (command == "updateState")
+    {
+        m_pHandler->onStateUpdate(msg.value("state", 0));
+        reply(hdl, {{ "status", 200 }, { "statusDescription", "OK" }, { "command", command }});
+    }
+    else
+    {
+        reply(hdl, {{ "status", 400 }, { "statusDescription", "Unknown command" }, { "command", command }});
+    }
+}
+
+
+void WowzaStandInImpl::reply(websocketpp::connection_hdl hdl, const njson& msg)
+{
+    websocketpp::lib::error_code ec;
+    m_server.send(hdl, msg.dump(), websocketpp::frame::opcode::text, ec);
+    if (ec)
+        fprintf(stderr, "stand-in: send failed: %s\n", ec.message().c_str());
+}
+
+
+WOWZA_STANDIN_API std::unique_ptr<WowzaStandIn> CreateWowzaStandIn()
+{
+    return std::make_unique<WowzaStandInImpl>();
+}
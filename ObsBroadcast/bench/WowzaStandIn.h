@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#ifndef WOWZA_STAND_IN_H_
+#define WOWZA_STAND_IN_H_
+
+#ifdef _MSC_VER
+#ifdef WOWZA_STANDIN_EXPORTS
+#define WOWZA_STANDIN_API __declspec(dllexport)
+#else
+#define WOWZA_STANDIN_API __declspec(dllimport)
+#endif
+#else
+#define WOWZA_STANDIN_API __attribute__((visibility("default")))
+#endif
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/// Local stand-in for the Wowza signaling server, for benches that drive
+/// WowzaWebsocketClientImpl without a network.
+///
+/// Serves wss:// on 127.0.0.1 with a self-signed certificate (the client does
+/// not verify peers) and speaks the JSON protocol of the client: "auth",
+/// "sendOffer" (answered with the SDP and iceCandidates), "updateState" and
+/// trickled "iceCandidate" messages. Media is left to the Handler, normally a
+/// receiving PeerConnection.
+///
+/// Built as its own library so its OpenSSL stays apart from libwebrtc's
+/// BoringSSL, as in websocket-client.
+class WOWZA_STANDIN_API WowzaStandIn
+{
+public:
+    struct Candidate
+    {
+        std::string sCandidate;  // empty at the end of candidates
+        std::string sMid;
+        int         nIndex;
+    };
+
+    /// Called on the server thread, one message at a time.
+    class Handler
+    {
+    public:
+        virtual ~Handler() = default;
+
+        /// Accepts or refuses a publisher.
+        virtual bool onAuth(const std::string& sStreamName, const std::string& sPassword) = 0;
+        /// Produces the answer to |sOffer|, and the candidates sent with it.
+        /// May block until the answer is ready; false answers with an error.
+        virtual bool onOffer(const std::string& sOffer, std::string& sAnswer, std::vector<Candidate>& candidates) = 0;
+        virtual void onCandidate(const Candidate& candidate) = 0;
+        virtual void onStateUpdate(int nState) = 0;
+    };
+
+    virtual ~WowzaStandIn() = default;
+
+    /// Listens on 127.0.0.1:|nPort| (0 picks a free port). Returns the URL to
+    /// pass to WebsocketClient::connect(), or "" on failure.
+    virtual std::string start(Handler* pHandler, uint16_t nPort) = 0;
+    virtual void stop() = 0;
+};
+
+
+WOWZA_STANDIN_API std::unique_ptr<WowzaStandIn> CreateWowzaStandIn();
+
+#endif  // WOWZA_STAND_IN_H_
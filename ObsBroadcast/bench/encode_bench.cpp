@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/// sidekick_encode_bench: offline encode cost measurement.
+///
+/// Feeds synthetic (or Y4M) NV12 frames through VideoTrackSource::onIncomingData()
+/// into X264Encoder::Encode() as fast as possible, for every resolution tier of
+/// SanitizeInputs::OptimalFrameSize() and a matrix of x264 presets and thread
+/// counts, and prints one row of results per configuration.
+///
+/// With --tee each configuration's output is also written through
+/// X264Encoder::StartOutputTee() to "<base>-<size>-<preset>-t<threads>".
+/// --replay reads such a capture (or one written by the plugin) back, runs
+/// every frame through WebRTC's RTP packetizer, and prints packetization cost
+/// and output pacing per layer instead of encoding.
+///
+/// Usage: sidekick_encode_bench [--frames N] [--fps F] [--mode 0|1] [--y4m file.y4m]
+///                              [--presets p1,p2,...] [--threads t1,t2,...] [--tee base]
+///        sidekick_encode_bench --replay base [--mode 0|1]
+
+#include "BenchUtil.h"
+#include "EncodedFrameTee.h"
+#include "SanitizeInputs.h"
+#include "VideoTrackSource.h"
+#include "X264Encoder.h"
+
+#include "api/video/encoded_image.h"
+#include "api/video/video_frame.h"
+#include "media/base/media_constants.h"
+#include "modules/rtp_rtcp/source/rtp_format.h"
+#include "modules/rtp_rtcp/source/rtp_packet_to_send.h"
+#include "modules/rtp_rtcp/source/rtp_video_header.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+#include "third_party/libyuv/include/libyuv.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using namespace webrtc;
+
+static const int kDefaultFps = 30;
+static const size_t kMaxPayloadSize = 1200;
+
+
+/// Source of NV12 frames: a moving synthetic pattern or a looped Y4M file.
+class FrameSource
+{
+public:
+    bool OpenY4m(const string& path)
+    {
+        file_.open(path, std::ios::binary);
+        string header;
+        if (!file_ || !std::getline(file_, header) || header.compare(0, 9, "YUV4MPEG2") != 0)
+            return false;
+
+        std::istringstream tokens(header);
+        string token;
+        while (tokens >> token)
+        {
+            if (token[0] == 'W')
+                width_ = atoi(token.c_str() + 1);
+            else if (token[0] == 'H')
+                height_ = atoi(token.c_str() + 1);
+            else if (token[0] == 'C' && token.compare(0, 4, "C420") != 0)
+                return false;  // Only 4:2:0 input is supported.
+        }
+        dataStart_ = file_.tellg();
+        i420_.resize((size_t)width_ * height_ * 3 / 2);
+        Allocate(width_, height_);
+        return width_ > 0 && height_ > 0;
+    }
+
+    bool IsY4m() const { return file_.is_open(); }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    void Allocate(int width, int height)
+    {
+        width_ = width;
+        height_ = height;
+        strideY_ = width;
+        strideUV_ = width + width % 2;
+        y_.resize((size_t)strideY_ * height);
+        uv_.resize((size_t)strideUV_ * ((height + 1) / 2));
+    }
+
+    /// Produces frame |n|; the Y4M file is rewound when it ends.
+    void Next(int n)
+    {
+        if (IsY4m())
+            ReadY4m();
+        else
+            Synthesize(n);
+    }
+
+    const uint8_t* dataY() const { return y_.data(); }
+    const uint8_t* dataUV() const { return uv_.data(); }
+    int strideY() const { return strideY_; }
+    int strideUV() const { return strideUV_; }
+
+private:
+    void Synthesize(int n)
+    {
+        // Diagonal gradient scrolling a few pixels per frame, plus a block of
+        // noise so motion estimation and entropy coding have real work to do.
+        for (int y = 0; y < height_; ++y)
+        {
+            uint8_t* row = &y_[(size_t)y * strideY_];
+            for (int x = 0; x < width_; ++x)
+                row[x] = (uint8_t)((x + y + n * 4) & 0xff);
+        }
+        for (int y = 0; y < height_ / 4; ++y)
+        {
+            uint8_t* row = &y_[(size_t)y * strideY_];
+            for (int x = 0; x < width_ / 4; ++x)
+                row[x] = (uint8_t)rand();
+        }
+        for (int y = 0; y < (height_ + 1) / 2; ++y)
+        {
+            uint8_t* row = &uv_[(size_t)y * strideUV_];
+            for (int x = 0; x < strideUV_; x += 2)
+            {
+                row[x]     = (uint8_t)(128 + ((x + n) & 0x3f));
+                row[x + 1] = (uint8_t)(128 - ((y + n) & 0x3f));
+            }
+        }
+    }
+
+    void ReadY4m()
+    {
+        string frameHeader;
+        if (!std::getline(file_, frameHeader) || !file_.read((char*)i420_.data(), i420_.size()))
+        {
+            file_.clear();
+            file_.seekg(dataStart_);
+            std::getline(file_, frameHeader);
+            file_.read((char*)i420_.data(), i420_.size());
+        }
+
+        const int chromaW = (width_ + 1) / 2;
+        const int chromaH = (height_ + 1) / 2;
+        const uint8_t* srcY = i420_.data();
+        const uint8_t* srcU = srcY + (size_t)width_ * height_;
+        const uint8_t* srcV = srcU + (size_t)chromaW * chromaH;
+        libyuv::I420ToNV12(srcY, width_, srcU, chromaW, srcV, chromaW,
+                           y_.data(), strideY_, uv_.data(), strideUV_, width_, height_);
+    }
+
+    std::ifstream file_;
+    std::streampos dataStart_;
+    vector<uint8_t> i420_;
+    vector<uint8_t> y_;
+    vector<uint8_t> uv_;
+    int width_ = 0;
+    int height_ = 0;
+    int strideY_ = 0;
+    int strideUV_ = 0;
+};
+
+
+/// Drops every encoded image after recording its size and encode latency.
+class NullEncodedImageCallback : public EncodedImageCallback
+{
+public:
+    Result OnEncodedImage(const EncodedImage& image, const CodecSpecificInfo* codecSpecificInfo) override
+    {
+        // Called on the encode thread when X264ENC_ASYNC_ENCODE is on.
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = encodeStartUs.find(image.Timestamp());
+        if (it != encodeStartUs.end())
+        {
+            latenciesUs.push_back(rtc::TimeMicros() - it->second);
+            encodeStartUs.erase(it);
+        }
+        bytes += image.size();
+        ++frames;
+        return Result(Result::OK);
+    }
+
+    void OnDroppedFrame(DropReason reason) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++dropped;
+    }
+
+    void StartEncode(uint32_t timestamp)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        encodeStartUs[timestamp] = rtc::TimeMicros();
+    }
+
+    std::mutex mutex;
+    std::map<uint32_t, int64_t> encodeStartUs;
+    vector<int64_t> latenciesUs;
+    uint64_t bytes = 0;
+    uint64_t frames = 0;
+    uint64_t dropped = 0;
+};
+
+
+/// Sink attached to VideoTrackSource that hands every frame to the encoder.
+class EncodeSink : public rtc::VideoSinkInterface<VideoFrame>
+{
+public:
+    EncodeSink(X264Encoder* encoder, NullEncodedImageCallback* callback)
+        : encoder_(encoder), callback_(callback)
+    {}
+
+    void OnFrame(const VideoFrame& frame) override
+    {
+        const vector<VideoFrameType> frameTypes{first_ ? VideoFrameType::kVideoFrameKey
+                                                       : VideoFrameType::kVideoFrameDelta};
+        first_ = false;
+        callback_->StartEncode(frame.timestamp());
+        encoder_->Encode(frame, &frameTypes);
+    }
+
+private:
+    X264Encoder* encoder_;
+    NullEncodedImageCallback* callback_;
+    bool first_ = true;
+};
+
+
+struct BenchResult
+{
+    double p50Ms, p90Ms, p99Ms, maxMs;
+    double fps;
+    double bytesPerFrame;
+    double cpuSec;
+    uint64_t dropped;
+};
+
+
+static bool RunOne(FrameSource& source, int width, int height, int fps, int bitrateKbps,
+                   const string& packetizationMode, const string& preset, int threads,
+                   int numFrames, const string& teeBase, BenchResult& result)
+{
+    if (!teeBase.empty())
+    {
+        const string base = teeBase + "-" + std::to_string(width) + "x" + std::to_string(height)
+                            + "-" + preset + "-t" + std::to_string(threads);
+        if (!X264Encoder::StartOutputTee(base))
+            fprintf(stderr, "Failed to open output tee: %s\n", base.c_str());
+    }
+
+    cricket::VideoCodec h264(cricket::kH264CodecName);
+    h264.SetParam(cricket::kH264FmtpPacketizationMode, packetizationMode);
+    X264Encoder encoder(h264);
+    encoder.SetEncoderOptionsForTesting(preset, threads);
+
+    VideoCodec codec;
+    codec.codecType     = kVideoCodecH264;
+    codec.width         = (uint16_t)width;
+    codec.height        = (uint16_t)height;
+    codec.maxFramerate  = (uint32_t)fps;
+    codec.startBitrate  = bitrateKbps;
+    codec.maxBitrate    = bitrateKbps;
+    codec.minBitrate    = bitrateKbps / 4;
+
+    const VideoEncoder::Settings settings(VideoEncoder::Capabilities(false), 4, kMaxPayloadSize);
+    if (encoder.InitEncode(&codec, settings) != WEBRTC_VIDEO_CODEC_OK)
+        return false;
+
+    NullEncodedImageCallback callback;
+    encoder.RegisterEncodeCompleteCallback(&callback);
+
+    auto trackSource = VideoTrackSource::Create();
+    trackSource->SetMaxFramerate(fps);
+    EncodeSink sink(&encoder, &callback);
+    trackSource->AddOrUpdateSink(&sink, rtc::VideoSinkWants());
+
+    if (!source.IsY4m())
+        source.Allocate(width, height);
+
+    const int64_t frameIntervalNanos = rtc::kNumNanosecsPerSec / fps;
+    const std::clock_t cpuStart = std::clock();
+    const int64_t wallStartUs = rtc::TimeMicros();
+
+    for (int n = 0; n < numFrames; ++n)
+    {
+        source.Next(n);
+        trackSource->onIncomingData(source.dataY(), (uint32_t)source.strideY(),
+                                    source.dataUV(), (uint32_t)source.strideUV(),
+                                    (n + 1) * frameIntervalNanos, (uint16_t)n,
+                                    width, height, kVideoRotation_0, VideoType::kNV12);
+    }
+
+    const double wallSec = (rtc::TimeMicros() - wallStartUs) / 1e6;
+    result.cpuSec = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    // In async mode frames may still be in flight; Release() joins the encoder.
+    encoder.Release();
+    trackSource->RemoveSink(&sink);
+    X264Encoder::StopOutputTee();
+
+    auto& lat = callback.latenciesUs;
+    result.p50Ms         = BenchUtil::Percentile(lat, 0.50) / 1000.0;
+    result.p90Ms         = BenchUtil::Percentile(lat, 0.90) / 1000.0;
+    result.p99Ms         = BenchUtil::Percentile(lat, 0.99) / 1000.0;
+    result.maxMs         = BenchUtil::Percentile(lat, 1.0) / 1000.0;
+    result.fps           = wallSec > 0 ? callback.frames / wallSec : 0.0;
+    result.bytesPerFrame = callback.frames ? (double)callback.bytes / callback.frames : 0.0;
+    result.dropped       = callback.dropped;
+    return true;
+}
+
+
+/// Per-layer replay totals of an EncodedFrameTee capture.
+struct ReplayLayer
+{
+    vector<int64_t> packetizeUs;
+    vector<int64_t> encodeLatencyMs;    // capture to encode finish
+    uint64_t frames = 0;
+    uint64_t keyFrames = 0;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint32_t maxPackets = 0;
+    int64_t firstFinishMs = -1;
+    int64_t lastFinishMs = -1;
+    int64_t maxOutputGapMs = 0;         // longest time between two encoded frames
+};
+
+
+static int Replay(const string& base, const string& packetizationMode)
+{
+    FILE* index = fopen(EncodedFrameTee::IndexPath(base).c_str(), "r");
+    if (!index)
+    {
+        fprintf(stderr, "Failed to open %s\n", EncodedFrameTee::IndexPath(base).c_str());
+        return 1;
+    }
+
+    RtpPacketizer::PayloadSizeLimits limits;
+    limits.max_payload_len = kMaxPayloadSize;
+
+    RTPVideoHeader header;
+    header.codec = kVideoCodecH264;
+    auto& h264 = header.video_type_header.emplace<RTPVideoHeaderH264>();
+    h264.packetization_mode = packetizationMode == "1" ? H264PacketizationMode::NonInterleaved
+                                                       : H264PacketizationMode::SingleNalUnit;
+
+    std::map<uint32_t, std::ifstream> streams;
+    std::map<uint32_t, ReplayLayer> layers;
+    vector<uint8_t> payload;
+    uint64_t lastSequence = 0;
+    uint64_t missing = 0;
+    int failures = 0;
+
+    char line[512];
+    fgets(line, sizeof(line), index);  // header
+    while (fgets(line, sizeof(line), index))
+    {
+        unsigned long long sequence, offset, size;
+        unsigned layer, rtpTimestamp, width, height;
+        long long captureMs, startMs, finishMs;
+        int key, qp;
+        if (sscanf(line, "%llu,%u,%u,%lld,%lld,%lld,%llu,%llu,%d,%u,%u,%d",
+                   &sequence, &layer, &rtpTimestamp, &captureMs, &startMs, &finishMs,
+                   &offset, &size, &key, &width, &height, &qp) != 12)
+            continue;
+
+        if (sequence > lastSequence + 1)
+            missing += sequence - lastSequence - 1;
+        lastSequence = sequence;
+
+        auto& stream = streams[layer];
+        if (!stream.is_open())
+            stream.open(EncodedFrameTee::LayerPath(base, layer), std::ios::binary);
+        payload.resize((size_t)size);
+        if (!stream.seekg((std::streamoff)offset) || !stream.read((char*)payload.data(), payload.size()))
+        {
+            ++failures;
+            continue;
+        }
+
+        const int64_t startUs = rtc::TimeMicros();
+        auto packetizer = RtpPacketizer::Create(kVideoCodecH264, payload, limits, header);
+        RtpPacketToSend packet(nullptr, kMaxPayloadSize + 100);
+        uint32_t packets = 0;
+        while (packetizer && packetizer->NextPacket(&packet))
+            ++packets;
+        const int64_t elapsedUs = rtc::TimeMicros() - startUs;
+
+        // Single NAL unit mode can't carry a NAL larger than one packet.
+        if (!packetizer || packets == 0)
+        {
+            ++failures;
+            continue;
+        }
+
+        auto& stats = layers[layer];
+        stats.packetizeUs.push_back(elapsedUs);
+        stats.encodeLatencyMs.push_back(finishMs - captureMs);
+        stats.frames++;
+        stats.keyFrames += key ? 1 : 0;
+        stats.packets += packets;
+        stats.bytes += size;
+        stats.maxPackets = std::max(stats.maxPackets, packets);
+        if (stats.lastFinishMs >= 0)
+            stats.maxOutputGapMs = std::max<int64_t>(stats.maxOutputGapMs, finishMs - stats.lastFinishMs);
+        if (stats.firstFinishMs < 0)
+            stats.firstFinishMs = finishMs;
+        stats.lastFinishMs = finishMs;
+    }
+    fclose(index);
+
+    printf("%5s %7s %5s | %10s %10s | %8s %8s | %10s %10s %8s\n",
+           "layer", "frames", "keys", "pkt us p50", "pkt us p99",
+           "pkts/frm", "max pkts", "enc ms p50", "enc ms p99", "gap ms");
+    for (auto& entry : layers)
+    {
+        auto& stats = entry.second;
+
+        printf("%5u %7llu %5llu | %10.1f %10.1f | %8.1f %8u | %10.1f %10.1f %8lld\n",
+               entry.first, (unsigned long long)stats.frames, (unsigned long long)stats.keyFrames,
+               (double)BenchUtil::Percentile(stats.packetizeUs, 0.50),
+               (double)BenchUtil::Percentile(stats.packetizeUs, 0.99),
+               stats.frames ? (double)stats.packets / stats.frames : 0.0, stats.maxPackets,
+               (double)BenchUtil::Percentile(stats.encodeLatencyMs, 0.50),
+               (double)BenchUtil::Percentile(stats.encodeLatencyMs, 0.99),
+               (long long)stats.maxOutputGapMs);
+
+        const int64_t durationMs = stats.lastFinishMs - stats.firstFinishMs;
+        if (durationMs > 0)
+        {
+            printf("      %.1f fps, %.0f kbps, %.0f packets/s\n",
+                   (stats.frames - 1) * 1000.0 / durationMs, stats.bytes * 8.0 / durationMs,
+                   stats.packets * 1000.0 / durationMs);
+        }
+    }
+    if (missing)
+        printf("%llu frames missing from the capture (tee queue full)\n", (unsigned long long)missing);
+    if (failures)
+        fprintf(stderr, "%d frames could not be read or packetized\n", failures);
+
+    return failures ? 1 : 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    int numFrames = 300;
+    int fps = kDefaultFps;
+    string packetizationMode = "0";
+    string y4mPath;
+    string teeBase;
+    string replayBase;
+    vector<string> presets = {"ultrafast", "superfast", "veryfast", "faster"};
+    vector<int> threadCounts = {0, 1, 2, 4};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue)
+            numFrames = std::max(1, atoi(argv[++i]));
+        else if (arg == "--fps" && hasValue)
+            fps = std::min(std::max(atoi(argv[++i]), 1), 60);
+        else if (arg == "--mode" && hasValue)
+            packetizationMode = argv[++i];
+        else if (arg == "--y4m" && hasValue)
+            y4mPath = argv[++i];
+        else if (arg == "--tee" && hasValue)
+            teeBase = argv[++i];
+        else if (arg == "--replay" && hasValue)
+            replayBase = argv[++i];
+        else if (arg == "--presets" && hasValue)
+            presets = BenchUtil::Split(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+        {
+            threadCounts.clear();
+            for (const auto& t : BenchUtil::Split(argv[++i]))
+                threadCounts.push_back(atoi(t.c_str()));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--frames N] [--fps F] [--mode 0|1] [--y4m file.y4m] [--presets p1,p2] [--threads t1,t2] [--tee base]\n"
+                            "       %s --replay base [--mode 0|1]\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    rtc::LogMessage::LogToDebug(rtc::LS_WARNING);
+
+    if (!replayBase.empty())
+        return Replay(replayBase, packetizationMode);
+
+    FrameSource source;
+    if (!y4mPath.empty() && !source.OpenY4m(y4mPath))
+    {
+        fprintf(stderr, "Failed to open Y4M file (4:2:0 only): %s\n", y4mPath.c_str());
+        return 1;
+    }
+
+    // One representative bitrate per SanitizeInputs::OptimalFrameSize() tier.
+    struct Tier { int width, height, kbps; };
+    vector<Tier> tiers;
+    if (source.IsY4m())
+    {
+        // A Y4M file is encoded at its own resolution only.
+        Tier tier{source.width(), source.height(), 2500};
+        SanitizeInputs::ConstrainBitrateForFramerate(tier.height, fps, tier.kbps);
+        tiers.push_back(tier);
+    }
+    else
+    {
+        for (int kbps : {800, 1200, 2500, 5000})
+        {
+            Tier tier{0, 0, kbps};
+            SanitizeInputs::OptimalFrameSize(kbps, fps, tier.width, tier.height);
+            SanitizeInputs::ConstrainBitrateForFramerate(tier.height, fps, tier.kbps);
+            tiers.push_back(tier);
+        }
+    }
+
+    printf("%-10s %6s %-10s %7s | %8s %8s %8s %8s | %7s %10s %7s %7s\n",
+           "size", "kbps", "preset", "threads",
+           "p50 ms", "p90 ms", "p99 ms", "max ms", "fps", "bytes/frm", "cpu s", "dropped");
+
+    int failures = 0;
+    for (const auto& tier : tiers)
+    {
+        for (const auto& preset : presets)
+        {
+            for (int threads : threadCounts)
+            {
+                BenchResult r{};
+                if (!RunOne(source, tier.width, tier.height, fps, tier.kbps, packetizationMode, preset, threads, numFrames, teeBase, r))
+                {
+                    fprintf(stderr, "InitEncode failed: %dx%d %s threads=%d\n",
+                            tier.width, tier.height, preset.c_str(), threads);
+                    ++failures;
+                    continue;
+                }
+
+                char size[16];
+                snprintf(size, sizeof(size), "%dx%d", tier.width, tier.height);
+                printf("%-10s %6d %-10s %7s | %8.2f %8.2f %8.2f %8.2f | %7.1f %10.0f %7.2f %7llu\n",
+                       size, tier.kbps, preset.c_str(), threads > 0 ? std::to_string(threads).c_str() : "auto",
+                       r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs, r.fps, r.bytesPerFrame, r.cpuSec,
+                       (unsigned long long)r.dropped);
+                fflush(stdout);
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,626 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+
+/// sidekick_loopback_bench: congestion control over a simulated bottleneck.
+///
+/// Two in-process PeerConnections send synthetic video from X264Encoder to a
+/// receiver over rtc::VirtualSocketServer, which models the uplink the way
+/// netem would: a rate limit with a bounded queue, one-way delay and random
+/// loss. The capacity steps high -> low -> high, one phase each. Every mode
+/// runs the same profile:
+///  - remb: transport-cc stripped from the offer, as the plugin does with
+///          WEBRTCSTREAM_TRANSPORT_CC 0 (REMB + the encoder's RateController)
+///  - gcc:  transport-cc kept (WEBRTCSTREAM_TRANSPORT_CC 1), send-side BWE
+/// and one row is printed per mode. It shows how long the encoder target
+/// took to fall under the reduced capacity and to climb back afterwards,
+/// and the receiver's freezes (an inter-frame gap above
+/// max(3 * average, average + 150 ms), WebRTC's definition).
+///
+/// The receiver does not decode: a pass-through decoder emits a blank frame
+/// for every complete frame out of the jitter buffer, which is what freezes
+/// are measured on. Needs a libwebrtc build that includes rtc_base's test
+/// utilities (VirtualSocketServer, FakeNetworkManager).
+///
+/// Usage: sidekick_loopback_bench [--high kbps] [--low kbps] [--phase sec] [--delay ms]
+///                                [--queue ms] [--loss pct] [--size WxH] [--fps F]
+///                                [--modes remb,gcc]
+
+#include "ADMWrapper.h"
+#include "BenchUtil.h"
+#include "EncoderFactory.h"
+#include "SDPModel.h"
+#include "VideoTrackSource.h"
+#include "X264Encoder.h"
+
+#include "api/audio_codecs/builtin_audio_decoder_factory.h"
+#include "api/audio_codecs/builtin_audio_encoder_factory.h"
+#include "api/create_peerconnection_factory.h"
+#include "api/jsep.h"
+#include "api/peer_connection_interface.h"
+#include "api/video/i420_buffer.h"
+#include "api/video/video_frame.h"
+#include "api/video_codecs/video_decoder.h"
+#include "api/video_codecs/video_decoder_factory.h"
+#include "media/base/media_constants.h"
+#include "p2p/base/basic_packet_socket_factory.h"
+#include "p2p/client/basic_port_allocator.h"
+#include "rtc_base/event.h"
+#include "rtc_base/fake_network.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/ref_counted_object.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/time_utils.h"
+#include "rtc_base/virtual_socket_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using rtc::scoped_refptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using namespace webrtc;
+
+static const int kConnectTimeoutMs  = 10000;
+static const int kSampleIntervalMs  = 250;
+
+
+struct Options
+{
+    int     highKbps    = 2500;
+    int     lowKbps     = 800;
+    int     phaseSec    = 15;
+    int     delayMs     = 40;
+    int     queueMs     = 200;
+    double  lossPct     = 1.0;
+    int     width       = 1280;
+    int     height      = 720;
+    int     fps         = 30;
+    vector<string> modes = {"remb", "gcc"};
+};
+
+
+/// Emits a blank frame of the last known size for every encoded frame.
+class PassthroughDecoder : public VideoDecoder
+{
+public:
+    int32_t InitDecode(const VideoCodec* codec, int32_t /*numberOfCores*/) override
+    {
+        if (codec && codec->width > 0 && codec->height > 0)
+        {
+            width_ = codec->width;
+            height_ = codec->height;
+        }
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t Decode(const EncodedImage& image, bool /*missingFrames*/, int64_t renderTimeMs) override
+    {
+        if (image._encodedWidth > 0 && image._encodedHeight > 0)
+        {
+            width_ = (int)image._encodedWidth;
+            height_ = (int)image._encodedHeight;
+        }
+        if (!buffer_ || buffer_->width() != width_ || buffer_->height() != height_)
+        {
+            buffer_ = I420Buffer::Create(width_, height_);
+            I420Buffer::SetBlack(buffer_);
+        }
+
+        VideoFrame frame = VideoFrame::Builder()
+                               .set_video_frame_buffer(buffer_)
+                               .set_timestamp_rtp(image.Timestamp())
+                               .set_timestamp_ms(renderTimeMs)
+                               .build();
+        callback_->Decoded(frame);
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t RegisterDecodeCompleteCallback(DecodedImageCallback* callback) override
+    {
+        callback_ = callback;
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t Release() override { return WEBRTC_VIDEO_CODEC_OK; }
+    const char* ImplementationName() const override { return "Passthrough"; }
+
+private:
+    DecodedImageCallback*       callback_ = nullptr;
+    scoped_refptr<I420Buffer>   buffer_;
+    int                         width_ = 320;
+    int                         height_ = 180;
+};
+
+
+class PassthroughDecoderFactory : public VideoDecoderFactory
+{
+public:
+    vector<SdpVideoFormat> GetSupportedFormats() const override { return EncoderFactory().GetSupportedFormats(); }
+
+    unique_ptr<VideoDecoder> CreateVideoDecoder(const SdpVideoFormat& /*format*/) override
+    {
+        return std::make_unique<PassthroughDecoder>();
+    }
+};
+
+
+/// Records when each frame reaches the receiving track.
+class ArrivalSink : public rtc::VideoSinkInterface<VideoFrame>
+{
+public:
+    void OnFrame(const VideoFrame& /*frame*/) override
+    {
+        MutexLock lock(&mutex_);
+        arrivals_.push_back(rtc::TimeMillis());
+    }
+
+    vector<int64_t> Take()
+    {
+        MutexLock lock(&mutex_);
+        return std::move(arrivals_);
+    }
+
+private:
+    Mutex           mutex_;
+    vector<int64_t> arrivals_ RTC_GUARDED_BY(mutex_);
+};
+
+
+class Peer : public PeerConnectionObserver
+{
+public:
+    explicit Peer(const char* name) : name_(name) {}
+
+    void OnIceGatheringChange(PeerConnectionInterface::IceGatheringState state) override
+    {
+        if (state == PeerConnectionInterface::kIceGatheringComplete)
+            gathered.Set();
+    }
+
+    void OnIceConnectionChange(PeerConnectionInterface::IceConnectionState state) override
+    {
+        if (state == PeerConnectionInterface::kIceConnectionConnected
+            || state == PeerConnectionInterface::kIceConnectionCompleted)
+            connected.Set();
+    }
+
+    void OnTrack(scoped_refptr<RtpTransceiverInterface> transceiver) override
+    {
+        auto track = transceiver->receiver()->track();
+        if (track->kind() == MediaStreamTrackInterface::kVideoKind)
+            static_cast<VideoTrackInterface*>(track.get())->AddOrUpdateSink(&sink, rtc::VideoSinkWants());
+    }
+
+    // Full SDP is exchanged once gathering completes; no trickle.
+    void OnIceCandidate(const IceCandidateInterface* /*candidate*/) override {}
+    void OnSignalingChange(PeerConnectionInterface::SignalingState /*state*/) override {}
+    void OnDataChannel(scoped_refptr<DataChannelInterface> /*channel*/) override {}
+    void OnRenegotiationNeeded() override {}
+
+    const char*                         name_;
+    scoped_refptr<PeerConnectionInterface> pc;
+    ArrivalSink                         sink;
+    rtc::Event                          gathered;
+    rtc::Event                          connected;
+};
+
+
+/// Creates an offer or answer on |peer|, sets it as local description and
+/// waits for ICE gathering; returns the resulting SDP, or "" on failure.
+static string NegotiateLocal(Peer& peer, bool offer)
+{
+    scoped_refptr<CreateObserver> create(new rtc::RefCountedObject<CreateObserver>());
+    if (offer)
+        peer.pc->CreateOffer(create, PeerConnectionInterface::RTCOfferAnswerOptions());
+    else
+        peer.pc->CreateAnswer(create, PeerConnectionInterface::RTCOfferAnswerOptions());
+    create->done.Wait(rtc::Event::kForever);
+    if (!create->desc)
+    {
+        fprintf(stderr, "%s: create %s failed: %s\n", peer.name_, offer ? "offer" : "answer", create->error.c_str());
+        return "";
+    }
+
+    scoped_refptr<SetObserver> set(new rtc::RefCountedObject<SetObserver>());
+    peer.pc->SetLocalDescription(std::move(create->desc), set);
+    set->done.Wait(rtc::Event::kForever);
+    if (!set->error.empty() || !peer.gathered.Wait(kConnectTimeoutMs))
+    {
+        fprintf(stderr, "%s: set local description failed: %s\n", peer.name_, set->error.c_str());
+        return "";
+    }
+
+    string sdp;
+    peer.pc->local_description()->ToString(&sdp);
+    return sdp;
+}
+
+
+static bool SetRemote(Peer& peer, SdpType type, const string& sdp)
+{
+    SdpParseError parseError;
+    auto desc = CreateSessionDescription(type, sdp, &parseError);
+    if (!desc)
+    {
+        fprintf(stderr, "%s: bad SDP: %s\n", peer.name_, parseError.description.c_str());
+        return false;
+    }
+
+    scoped_refptr<SetObserver> set(new rtc::RefCountedObject<SetObserver>());
+    peer.pc->SetRemoteDescription(std::move(desc), set);
+    set->done.Wait(rtc::Event::kForever);
+    if (!set->error.empty())
+    {
+        fprintf(stderr, "%s: set remote description failed: %s\n", peer.name_, set->error.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+/// The video part of WebRTCStream::SendOffer()'s munging.
+static string MungeOffer(const string& sdp, const Options& options, bool transportCc)
+{
+    SDPModel offer(sdp);
+    vector<int> audioPayloads, videoPayloads;
+    offer.ForcePayload(audioPayloads, videoPayloads, "opus", "H264", 1, "42e01f", 0);
+    offer.ConstrainVideoBitrate(options.highKbps, options.fps);
+    if (!transportCc)
+    {
+        offer.RemoveRtcpFb("transport-cc");
+        offer.RemoveLinesContaining("transport-wide-cc");
+    }
+    return offer.ToString();
+}
+
+
+/// Moving gradient plus a noise block, so every frame costs real bits.
+static void Synthesize(vector<uint8_t>& y, vector<uint8_t>& uv, int width, int height, int n)
+{
+    for (int row = 0; row < height; ++row)
+    {
+        uint8_t* line = &y[(size_t)row * width];
+        for (int x = 0; x < width; ++x)
+            line[x] = (uint8_t)((x + row + n * 4) & 0xff);
+        if (row < height / 4)
+        {
+            for (int x = 0; x < width / 4; ++x)
+                line[x] = (uint8_t)rand();
+        }
+    }
+    for (int row = 0; row < height / 2; ++row)
+    {
+        uint8_t* line = &uv[(size_t)row * width];
+        for (int x = 0; x < width; x += 2)
+        {
+            line[x]     = (uint8_t)(128 + ((x + n) & 0x3f));
+            line[x + 1] = (uint8_t)(128 - ((row + n) & 0x3f));
+        }
+    }
+}
+
+
+struct Freezes
+{
+    int     count   = 0;
+    int64_t totalMs = 0;
+};
+
+
+static Freezes CountFreezes(const vector<int64_t>& arrivals)
+{
+    Freezes freezes;
+    double avgMs = 0.0;
+    int samples = 0;
+    for (size_t i = 1; i < arrivals.size(); ++i)
+    {
+        const int64_t gap = arrivals[i] - arrivals[i - 1];
+        if (samples >= 5 && gap > std::max(3.0 * avgMs, avgMs + 150.0))
+        {
+            ++freezes.count;
+            freezes.totalMs += gap;
+            continue;  // freezes do not feed the average
+        }
+        // Average of the last ~30 inter-frame gaps.
+        samples = std::min(samples + 1, 30);
+        avgMs += (gap - avgMs) / samples;
+    }
+    return freezes;
+}
+
+
+struct Sample
+{
+    int64_t     ms;             // since the profile started
+    int         capacityKbps;
+    uint32_t    appliedKbps;
+    uint32_t    bandwidthKbps;
+};
+
+
+struct Result
+{
+    bool        ok              = false;
+    int64_t     downMs          = -1;   // low phase start until target <= capacity
+    int64_t     upMs            = -1;   // second high phase start until target >= 80% capacity
+    double      avgKbps[3]      = {};   // mean applied target per phase
+    size_t      frames          = 0;
+    Freezes     freezes;
+};
+
+
+static Result RunMode(const string& mode, const Options& options)
+{
+    Result result;
+    const bool transportCc = mode == "gcc";
+    X264Encoder::SetSendSideBwe(transportCc);
+    X264Encoder::ResetSessionStats();  // no stats from the previous mode
+
+    // The network thread runs the virtual socket server: the bottleneck.
+    rtc::VirtualSocketServer vss;
+    rtc::Thread network(&vss);
+    network.SetName("Loopback_Network", nullptr);
+    network.Start();
+    auto worker = rtc::Thread::Create();
+    worker->SetName("Loopback_Worker", nullptr);
+    worker->Start();
+    auto signaling = rtc::Thread::Create();
+    signaling->SetName("Loopback_Signaling", nullptr);
+    signaling->Start();
+
+    auto setCapacity = [&](int kbps)
+    {
+        network.Invoke<void>(RTC_FROM_HERE, [&]()
+        {
+            const uint32_t bytesPerSec = (uint32_t)kbps * 1000 / 8;
+            vss.set_bandwidth(bytesPerSec);
+            vss.set_network_capacity(std::max<uint32_t>(bytesPerSec * options.queueMs / 1000, 1500));
+        });
+    };
+    network.Invoke<void>(RTC_FROM_HERE, [&]()
+    {
+        vss.set_delay_mean(options.delayMs);
+        vss.set_delay_stddev(options.delayMs / 10);
+        vss.UpdateDelayDistribution();
+        vss.set_drop_probability(options.lossPct / 100.0);
+    });
+    setCapacity(options.highKbps);
+
+    // Network managers and socket factories live on the network thread.
+    unique_ptr<rtc::FakeNetworkManager> senderNetwork, receiverNetwork;
+    unique_ptr<rtc::BasicPacketSocketFactory> socketFactory;
+    network.Invoke<void>(RTC_FROM_HERE, [&]()
+    {
+        senderNetwork = std::make_unique<rtc::FakeNetworkManager>();
+        senderNetwork->AddInterface(rtc::SocketAddress("10.0.0.1", 0));
+        receiverNetwork = std::make_unique<rtc::FakeNetworkManager>();
+        receiverNetwork->AddInterface(rtc::SocketAddress("10.0.0.2", 0));
+        socketFactory = std::make_unique<rtc::BasicPacketSocketFactory>(&vss);
+    });
+
+    auto adm = worker->Invoke<scoped_refptr<ADMWrapper>>(RTC_FROM_HERE, []() { return ADMWrapper::Create(); });
+    auto factory = CreatePeerConnectionFactory(&network, worker.get(), signaling.get(), adm,
+                                               CreateBuiltinAudioEncoderFactory(), CreateBuiltinAudioDecoderFactory(),
+                                               CreateX264EncoderFactory(), std::make_unique<PassthroughDecoderFactory>(),
+                                               nullptr, nullptr, nullptr);
+
+    Peer sender("sender"), receiver("receiver");
+    auto createPc = [&](Peer& peer, rtc::NetworkManager* networkManager)
+    {
+        PeerConnectionInterface::RTCConfiguration config;
+        config.sdp_semantics = SdpSemantics::kUnifiedPlan;
+        PeerConnectionDependencies dependencies(&peer);
+        auto allocator = std::make_unique<cricket::BasicPortAllocator>(networkManager, socketFactory.get());
+        allocator->set_flags(cricket::PORTALLOCATOR_DISABLE_TCP | cricket::PORTALLOCATOR_DISABLE_STUN
+                             | cricket::PORTALLOCATOR_DISABLE_RELAY);
+        dependencies.allocator = std::move(allocator);
+        peer.pc = factory->CreatePeerConnection(config, std::move(dependencies));
+        return peer.pc != nullptr;
+    };
+
+    scoped_refptr<VideoTrackSource> source;
+    if (factory && createPc(sender, senderNetwork.get()) && createPc(receiver, receiverNetwork.get()))
+    {
+        source = signaling->Invoke<scoped_refptr<VideoTrackSource>>(
+            RTC_FROM_HERE, []() { return VideoTrackSource::Create(); });
+        source->SetMaxFramerate(options.fps);
+        auto track = factory->CreateVideoTrack("video", source);
+        auto added = sender.pc->AddTrack(track, {"loopback"});
+        if (added.ok())
+        {
+            // Same cap WebRTCStream sets through b=AS and the sender parameters.
+            auto videoSender = added.MoveValue();
+            auto params = videoSender->GetParameters();
+            if (!params.encodings.empty())
+                params.encodings[0].max_bitrate_bps = options.highKbps * 1000;
+            videoSender->SetParameters(params);
+
+            const string offer = NegotiateLocal(sender, true);
+            if (!offer.empty() && SetRemote(receiver, SdpType::kOffer, MungeOffer(offer, options, transportCc)))
+            {
+                const string answer = NegotiateLocal(receiver, false);
+                result.ok = !answer.empty() && SetRemote(sender, SdpType::kAnswer, answer);
+            }
+        }
+    }
+
+    // Frames are produced in real time on their own thread.
+    std::atomic<bool> feeding{result.ok};
+    std::thread feeder([&]()
+    {
+        vector<uint8_t> y((size_t)options.width * options.height);
+        vector<uint8_t> uv((size_t)options.width * options.height / 2);
+        const int64_t intervalUs = rtc::kNumMicrosecsPerSec / options.fps;
+        const int64_t startUs = rtc::TimeMicros();
+        for (int n = 0; feeding; ++n)
+        {
+            Synthesize(y, uv, options.width, options.height, n);
+            source->onIncomingData(y.data(), options.width, uv.data(), options.width,
+                                   startUs + n * intervalUs, (uint16_t)n,
+                                   options.width, options.height, kVideoRotation_0, VideoType::kNV12);
+            const int64_t sleepUs = startUs + (n + 1) * intervalUs - rtc::TimeMicros();
+            if (sleepUs > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(sleepUs));
+        }
+    });
+
+    if (result.ok && !sender.connected.Wait(kConnectTimeoutMs))
+    {
+        fprintf(stderr, "%s: ICE did not connect\n", mode.c_str());
+        result.ok = false;
+    }
+
+    if (result.ok)
+    {
+        receiver.sink.Take();  // count from the start of the profile
+
+        vector<Sample> samples;
+        const int phaseMs = options.phaseSec * 1000;
+        const int capacities[3] = {options.highKbps, options.lowKbps, options.highKbps};
+        const int64_t startMs = rtc::TimeMillis();
+        int phase = 0;
+        for (int64_t elapsed = 0; elapsed < 3 * phaseMs; elapsed = rtc::TimeMillis() - startMs)
+        {
+            if (elapsed / phaseMs != phase)
+            {
+                phase = (int)(elapsed / phaseMs);
+                setCapacity(capacities[phase]);
+            }
+            auto rate = X264Encoder::GetRateControlStats();
+            samples.push_back({elapsed, capacities[phase], rate.appliedKbps, rate.bandwidthKbps});
+            std::this_thread::sleep_for(std::chrono::milliseconds(kSampleIntervalMs));
+        }
+
+        int counts[3] = {};
+        for (const auto& sample : samples)
+        {
+            const int p = std::min((int)(sample.ms / phaseMs), 2);
+            result.avgKbps[p] += sample.appliedKbps;
+            ++counts[p];
+
+            if (p == 1 && result.downMs < 0 && (int)sample.appliedKbps <= options.lowKbps)
+                result.downMs = sample.ms - phaseMs;
+            if (p == 2 && result.upMs < 0 && sample.appliedKbps * 10 >= (uint32_t)options.highKbps * 8)
+                result.upMs = sample.ms - 2 * phaseMs;
+        }
+        for (int p = 0; p < 3; ++p)
+            result.avgKbps[p] = counts[p] ? result.avgKbps[p] / counts[p] : 0.0;
+
+        const auto arrivals = receiver.sink.Take();
+        result.frames = arrivals.size();
+        result.freezes = CountFreezes(arrivals);
+    }
+
+    feeding = false;
+    feeder.join();
+
+    if (sender.pc)
+        sender.pc->Close();
+    if (receiver.pc)
+        receiver.pc->Close();
+    sender.pc = nullptr;
+    receiver.pc = nullptr;
+    source = nullptr;
+    factory = nullptr;
+    worker->Invoke<void>(RTC_FROM_HERE, [&]() { adm = nullptr; });
+    network.Invoke<void>(RTC_FROM_HERE, [&]()
+    {
+        socketFactory.reset();
+        senderNetwork.reset();
+        receiverNetwork.reset();
+    });
+    signaling->Stop();
+    worker->Stop();
+    network.Stop();
+    return result;
+}
+
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--high" && hasValue)
+            options.highKbps = std::max(100, atoi(argv[++i]));
+        else if (arg == "--low" && hasValue)
+            options.lowKbps = std::max(50, atoi(argv[++i]));
+        else if (arg == "--phase" && hasValue)
+            options.phaseSec = std::max(2, atoi(argv[++i]));
+        else if (arg == "--delay" && hasValue)
+            options.delayMs = std::max(0, atoi(argv[++i]));
+        else if (arg == "--queue" && hasValue)
+            options.queueMs = std::max(10, atoi(argv[++i]));
+        else if (arg == "--loss" && hasValue)
+            options.lossPct = std::min(std::max(atof(argv[++i]), 0.0), 50.0);
+        else if (arg == "--size" && hasValue && sscanf(argv[i + 1], "%dx%d", &options.width, &options.height) == 2)
+            ++i;
+        else if (arg == "--fps" && hasValue)
+            options.fps = std::min(std::max(atoi(argv[++i]), 1), 60);
+        else if (arg == "--modes" && hasValue)
+            options.modes = BenchUtil::Split(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--high kbps] [--low kbps] [--phase sec] [--delay ms] [--queue ms] [--loss pct]\n"
+                            "       [--size WxH] [--fps F] [--modes remb,gcc]\n", argv[0]);
+            return 1;
+        }
+    }
+    options.width &= ~1;
+    options.height &= ~1;
+
+    rtc::LogMessage::LogToDebug(rtc::LS_WARNING);
+
+    printf("bottleneck: %d -> %d -> %d kbps, %d s phases, %d ms delay, %d ms queue, %.1f%% loss, %dx%d@%d\n",
+           options.highKbps, options.lowKbps, options.highKbps, options.phaseSec, options.delayMs,
+           options.queueMs, options.lossPct, options.width, options.height, options.fps);
+    printf("%-6s %10s %10s %10s %10s %10s %8s %8s %10s\n",
+           "mode", "high kbps", "low kbps", "high kbps", "down ms", "up ms", "frames", "freezes", "freeze ms");
+
+    for (const auto& mode : options.modes)
+    {
+        if (mode != "remb" && mode != "gcc")
+        {
+            fprintf(stderr, "unknown mode: %s\n", mode.c_str());
+            continue;
+        }
+
+        const Result r = RunMode(mode, options);
+        if (!r.ok)
+        {
+            printf("%-6s failed to connect\n", mode.c_str());
+            continue;
+        }
+        printf("%-6s %10.0f %10.0f %10.0f %10lld %10lld %8zu %8d %10lld\n",
+               mode.c_str(), r.avgKbps[0], r.avgKbps[1], r.avgKbps[2],
+               (long long)r.downMs, (long long)r.upMs, r.frames, r.freezes.count, (long long)r.freezes.totalMs);
+    }
+    return 0;
+}
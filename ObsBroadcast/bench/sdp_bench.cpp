@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/// sidekick_sdp_bench: offer munging cost, SDPUtil vs SDPModel.
+///
+/// Runs the SDP munging chain of WebRTCStream::SendOffer() over a libwebrtc
+/// offer (a built-in sample, or --sdp file) with the regex based SDPUtil
+/// functions and with one SDPModel, and prints the mean time per offer.
+/// --print shows both munged offers.
+///
+/// Usage: sidekick_sdp_bench [--iterations N] [--sdp offer.sdp] [--print]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SDPModel.h"
+#include "SDPUtil.h"
+
+using std::string;
+using std::vector;
+
+// Mirrors WebRTCStream::SendOffer().
+static const int  kVideoBitrateKbps         = 2500;
+static const int  kAudioBitrateKbps         = 128;
+static const int  kFramerate                = 30;
+static const int  kH264PacketizationMode    = 1;
+
+// Offer from a libwebrtc M88 PeerConnection with one audio and one video track.
+static const char kSampleOffer[] =
+    "v=0\r\n"
+    "o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+    "s=-\r\n"
+    "t=0 0\r\n"
+    "a=group:BUNDLE 0 1\r\n"
+    "a=extmap-allow-mixed\r\n"
+    "a=msid-semantic: WMS stream_id\r\n"
+    "m=audio 9 UDP/TLS/RTP/SAVPF 111 103 104 9 102 0 8 106 105 13 110 112 113 126\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+    "a=ice-ufrag:Zb+k\r\n"
+    "a=ice-pwd:PbQ3QmFdKCcqFQDNdLpdQ4rR\r\n"
+    "a=ice-options:trickle\r\n"
+    "a=fingerprint:sha-256 5C:6F:6E:1B:73:28:62:0A:1D:9C:57:84:A8:6E:0B:4D:2B:2E:73:3D:0F:14:23:4E:31:84:71:0E:8B:54:6F:B3\r\n"
+    "a=setup:actpass\r\n"
+    "a=mid:0\r\n"
+    "a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+    "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+    "a=extmap:3 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+    "a=extmap:4 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+    "a=extmap:5 urn:ietf:params:rtp-hdrext:sdes:rtp-stream-id\r\n"
+    "a=extmap:6 urn:ietf:params:rtp-hdrext:sdes:repaired-rtp-stream-id\r\n"
+    "a=sendonly\r\n"
+    "a=msid:stream_id audio_label\r\n"
+    "a=rtcp-mux\r\n"
+    "a=rtpmap:111 opus/48000/2\r\n"
+    "a=rtcp-fb:111 transport-cc\r\n"
+    "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+    "a=rtpmap:103 ISAC/16000\r\n"
+    "a=rtpmap:104 ISAC/32000\r\n"
+    "a=rtpmap:9 G722/8000\r\n"
+    "a=rtpmap:102 ILBC/8000\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:106 CN/32000\r\n"
+    "a=rtpmap:105 CN/16000\r\n"
+    "a=rtpmap:13 CN/8000\r\n"
+    "a=rtpmap:110 telephone-event/48000\r\n"
+    "a=rtpmap:112 telephone-event/32000\r\n"
+    "a=rtpmap:113 telephone-event/16000\r\n"
+    "a=rtpmap:126 telephone-event/8000\r\n"
+    "a=ssrc:2914541519 cname:uQhPvmHN4Ih+ZSmr\r\n"
+    "a=ssrc:2914541519 msid:stream_id audio_label\r\n"
+    "a=ssrc:2914541519 mslabel:stream_id\r\n"
+    "a=ssrc:2914541519 label:audio_label\r\n"
+    "m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100 101 127 120 125 107 108 109 35 36 124 119 123\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+    "a=ice-ufrag:Zb+k\r\n"
+    "a=ice-pwd:PbQ3QmFdKCcqFQDNdLpdQ4rR\r\n"
+    "a=ice-options:trickle\r\n"
+    "a=fingerprint:sha-256 5C:6F:6E:1B:73:28:62:0A:1D:9C:57:84:A8:6E:0B:4D:2B:2E:73:3D:0F:14:23:4E:31:84:71:0E:8B:54:6F:B3\r\n"
+    "a=setup:actpass\r\n"
+    "a=mid:1\r\n"
+    "a=extmap:14 urn:ietf:params:rtp-hdrext:toffset\r\n"
+    "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+    "a=extmap:13 urn:3gpp:video-orientation\r\n"
+    "a=extmap:3 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+    "a=extmap:12 http://www.webrtc.org/experiments/rtp-hdrext/playout-delay\r\n"
+    "a=extmap:11 http://www.webrtc.org/experiments/rtp-hdrext/video-content-type\r\n"
+    "a=extmap:7 http://www.webrtc.org/experiments/rtp-hdrext/video-timing\r\n"
+    "a=extmap:8 http://www.webrtc.org/experiments/rtp-hdrext/color-space\r\n"
+    "a=extmap:4 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+    "a=extmap:5 urn:ietf:params:rtp-hdrext:sdes:rtp-stream-id\r\n"
+    "a=extmap:6 urn:ietf:params:rtp-hdrext:sdes:repaired-rtp-stream-id\r\n"
+    "a=sendonly\r\n"
+    "a=msid:stream_id video_label\r\n"
+    "a=rtcp-mux\r\n"
+    "a=rtcp-rsize\r\n"
+    "a=rtpmap:96 VP8/90000\r\n"
+    "a=rtcp-fb:96 goog-remb\r\n"
+    "a=rtcp-fb:96 transport-cc\r\n"
+    "a=rtcp-fb:96 ccm fir\r\n"
+    "a=rtcp-fb:96 nack\r\n"
+    "a=rtcp-fb:96 nack pli\r\n"
+    "a=rtpmap:97 rtx/90000\r\n"
+    "a=fmtp:97 apt=96\r\n"
+    "a=rtpmap:98 VP9/90000\r\n"
+    "a=rtcp-fb:98 goog-remb\r\n"
+    "a=rtcp-fb:98 transport-cc\r\n"
+    "a=rtcp-fb:98 ccm fir\r\n"
+    "a=rtcp-fb:98 nack\r\n"
+    "a=rtcp-fb:98 nack pli\r\n"
+    "a=fmtp:98 profile-id=0\r\n"
+    "a=rtpmap:99 rtx/90000\r\n"
+    "a=fmtp:99 apt=98\r\n"
+    "a=rtpmap:100 VP9/90000\r\n"
+    "a=rtcp-fb:100 goog-remb\r\n"
+    "a=rtcp-fb:100 transport-cc\r\n"
+    "a=rtcp-fb:100 ccm fir\r\n"
+    "a=rtcp-fb:100 nack\r\n"
+    "a=rtcp-fb:100 nack pli\r\n"
+    "a=fmtp:100 profile-id=2\r\n"
+    "a=rtpmap:101 rtx/90000\r\n"
+    "a=fmtp:101 apt=100\r\n"
+    "a=rtpmap:127 H264/90000\r\n"
+    "a=rtcp-fb:127 goog-remb\r\n"
+    "a=rtcp-fb:127 transport-cc\r\n"
+    "a=rtcp-fb:127 ccm fir\r\n"
+    "a=rtcp-fb:127 nack\r\n"
+    "a=rtcp-fb:127 nack pli\r\n"
+    "a=fmtp:127 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42001f\r\n"
+    "a=rtpmap:120 rtx/90000\r\n"
+    "a=fmtp:120 apt=127\r\n"
+    "a=rtpmap:125 H264/90000\r\n"
+    "a=rtcp-fb:125 goog-remb\r\n"
+    "a=rtcp-fb:125 transport-cc\r\n"
+    "a=rtcp-fb:125 ccm fir\r\n"
+    "a=rtcp-fb:125 nack\r\n"
+    "a=rtcp-fb:125 nack pli\r\n"
+    "a=fmtp:125 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42e01f\r\n"
+    "a=rtpmap:107 rtx/90000\r\n"
+    "a=fmtp:107 apt=125\r\n"
+    "a=rtpmap:108 H264/90000\r\n"
+    "a=rtcp-fb:108 goog-remb\r\n"
+    "a=rtcp-fb:108 transport-cc\r\n"
+    "a=rtcp-fb:108 ccm fir\r\n"
+    "a=rtcp-fb:108 nack\r\n"
+    "a=rtcp-fb:108 nack pli\r\n"
+    "a=fmtp:108 level-asymmetry-allowed=1;packetization-mode=0;profile-level-id=42e01f\r\n"
+    "a=rtpmap:109 rtx/90000\r\n"
+    "a=fmtp:109 apt=108\r\n"
+    "a=rtpmap:35 AV1X/90000\r\n"
+    "a=rtcp-fb:35 goog-remb\r\n"
+    "a=rtcp-fb:35 transport-cc\r\n"
+    "a=rtcp-fb:35 ccm fir\r\n"
+    "a=rtcp-fb:35 nack\r\n"
+    "a=rtcp-fb:35 nack pli\r\n"
+    "a=rtpmap:36 rtx/90000\r\n"
+    "a=fmtp:36 apt=35\r\n"
+    "a=rtpmap:124 red/90000\r\n"
+    "a=rtpmap:119 rtx/90000\r\n"
+    "a=fmtp:119 apt=124\r\n"
+    "a=rtpmap:123 ulpfec/90000\r\n"
+    "a=ssrc-group:FID 1650125340 3373392384\r\n"
+    "a=ssrc:1650125340 cname:uQhPvmHN4Ih+ZSmr\r\n"
+    "a=ssrc:1650125340 msid:stream_id video_label\r\n"
+    "a=ssrc:1650125340 mslabel:stream_id\r\n"
+    "a=ssrc:1650125340 label:video_label\r\n"
+    "a=ssrc:3373392384 cname:uQhPvmHN4Ih+ZSmr\r\n"
+    "a=ssrc:3373392384 msid:stream_id video_label\r\n"
+    "a=ssrc:3373392384 mslabel:stream_id\r\n"
+    "a=ssrc:3373392384 label:video_label\r\n";
+
+
+static void MungeWithSDPUtil(string& sdp)
+{
+    vector<int> audioPayloads;
+    vector<int> videoPayloads;
+    SDPUtil::ForcePayload(sdp, audioPayloads, videoPayloads, "opus", "h264",
+                          kH264PacketizationMode, "42e01f", 0);
+    SDPUtil::ConstrainVideoBitrate(sdp, kVideoBitrateKbps, kFramerate);
+    SDPUtil::ConstrainAudioBitrateAS(sdp, kAudioBitrateKbps, false);
+    SDPUtil::EnableStereo(sdp);
+    SDPUtil::RemoveRtcpFb(sdp, "transport-cc");
+    SDPUtil::RemoveLinesContaining(sdp, "transport-wide-cc");
+}
+
+
+static void MungeWithSDPModel(string& sdp)
+{
+    vector<int> audioPayloads;
+    vector<int> videoPayloads;
+    SDPModel offer(sdp);
+    offer.ForcePayload(audioPayloads, videoPayloads, "opus", "h264",
+                       kH264PacketizationMode, "42e01f", 0);
+    offer.ConstrainVideoBitrate(kVideoBitrateKbps, kFramerate);
+    offer.ConstrainAudioBitrateAS(kAudioBitrateKbps, false);
+    offer.EnableStereo();
+    offer.RemoveRtcpFb("transport-cc");
+    offer.RemoveLinesContaining("transport-wide-cc");
+    sdp = offer.ToString();
+}
+
+
+/// Returns the mean microseconds per call of |munge| on a fresh copy of |sdp|.
+template<typename Munge>
+static double TimeMunge(const string& sdp, int iterations, Munge munge, string& result)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        result = sdp;
+        munge(result);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+}
+
+
+int main(int argc, char** argv)
+{
+    int iterations = 200;
+    string sdp = kSampleOffer;
+    bool print = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue)
+        {
+            iterations = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--sdp" && hasValue)
+        {
+            std::ifstream file(argv[++i], std::ios::binary);
+            std::ostringstream contents;
+            contents << file.rdbuf();
+            if (!file || contents.str().empty())
+            {
+                fprintf(stderr, "Failed to read SDP file: %s\n", argv[i]);
+                return 1;
+            }
+            sdp = contents.str();
+        }
+        else if (arg == "--print")
+        {
+            print = true;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--iterations N] [--sdp offer.sdp] [--print]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    string utilResult, modelResult;
+    const double utilUs = TimeMunge(sdp, iterations, MungeWithSDPUtil, utilResult);
+    const double modelUs = TimeMunge(sdp, iterations, MungeWithSDPModel, modelResult);
+
+    printf("offer: %zu bytes, %d iterations\n", sdp.size(), iterations);
+    printf("%-10s %12s %10s\n", "", "us/offer", "bytes out");
+    printf("%-10s %12.1f %10zu\n", "SDPUtil", utilUs, utilResult.size());
+    printf("%-10s %12.1f %10zu\n", "SDPModel", modelUs, modelResult.size());
+    printf("speedup:   %.0fx\n", modelUs > 0 ? utilUs / modelUs : 0.0);
+    printf("outputs:   %s\n", utilResult == modelResult ? "identical" : "differ (see --print)");
+
+    if (print)
+        printf("\nSDPUtil:\n%s\nSDPModel:\n%s", utilResult.c_str(), modelResult.c_str());
+    return 0;
+}
@@ -0,0 +1,752 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+
+/// sidekick_stream_bench: end-to-end publish against a local Wowza stand-in.
+///
+/// Runs the plugin's output the way OBS does: a headless libobs with the
+/// "mfc_wowza_output" type registered, started and stopped through
+/// obs_output_start()/obs_output_stop(), so WebRTCStream, WarmPool,
+/// X264Encoder and WowzaWebsocketClientImpl all run as shipped. The other end
+/// is WowzaStandIn on 127.0.0.1, which answers with a receiving PeerConnection
+/// that decodes every frame. No network or Wowza account is needed; libobs
+/// does need its graphics module. Like the plugin, it only builds on Windows
+/// and macOS: libfcs and libPlugins have no Linux target.
+///
+/// Frames come from an async source on the canvas, so they take OBS's render
+/// and NV12 conversion path into the output. The canvas is the size
+/// WebRTCStream picks for --kbps, so normally nothing is scaled. Each frame
+/// carries its number in luma blocks on the top row; the receiver reads it
+/// back, which gives capture-to-decoded latency per frame.
+/// Reported:
+///  - WebRTCStream's startup timeline and time to first decoded frame
+///  - frame latency p50/p95/p99/max
+///  - sustained frame rate and received bitrate
+///
+/// Usage: sidekick_stream_bench [--duration sec] [--fps F] [--kbps K] [--port P] [--verbose]
+
+#include "ADMWrapper.h"
+#include "BenchUtil.h"
+#include "ObsBroadcast.h"
+#include "SanitizeInputs.h"
+#include "StartupTimeline.h"
+#include "WebRTCStream.h"
+#include "WowzaStandIn.h"
+#include "X264Encoder.h"
+#include "wowza-stream.h"
+
+#include <libobs/obs-module.h>
+#include <libobs/util/base.h>
+#include <libobs/util/platform.h>
+
+#include "api/audio_codecs/builtin_audio_decoder_factory.h"
+#include "api/audio_codecs/builtin_audio_encoder_factory.h"
+#include "api/create_peerconnection_factory.h"
+#include "api/jsep.h"
+#include "api/peer_connection_interface.h"
+#include "api/stats/rtcstats_objects.h"
+#include "api/video/i420_buffer.h"
+#include "api/video/video_frame.h"
+#include "api/video_codecs/builtin_video_decoder_factory.h"
+#include "api/video_codecs/builtin_video_encoder_factory.h"
+#include "rtc_base/event.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/ref_counted_object.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Module symbols the plugin sources expect (obs_module_text() and friends);
+// the bench is not loaded as a module, so lookups fall back to the key.
+OBS_DECLARE_MODULE()
+OBS_MODULE_USE_DEFAULT_LOCALE("sidekick_stream_bench", "en-US")
+
+extern CBroadcastCtx g_ctx;  // part of MFCLibPlugins.lib::MfcPluginAPI.obj
+extern "C" struct obs_output_info wowza_output_info;
+
+using rtc::scoped_refptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using namespace webrtc;
+
+static const int kStartTimeoutMs    = 15000;
+static const int kStopTimeoutMs     = 5000;
+static const int kStampBits         = 24;
+static const int kStampBlock        = 16;   // px per bit; survives any sane bitrate
+
+
+struct Options
+{
+    int     durationSec = 20;
+    int     width       = 0;    // from --kbps, as WebRTCStream picks it
+    int     height      = 0;
+    int     fps         = 30;
+    int     kbps        = 2500;
+    int     port        = 0;
+    bool    verbose     = false;
+};
+
+
+/// Writes |n| as kStampBits black/white blocks along the top of the luma.
+static void StampFrameNumber(uint8_t* y, int stride, uint32_t n)
+{
+    for (int bit = 0; bit < kStampBits; ++bit)
+    {
+        const uint8_t value = (n >> bit) & 1 ? 235 : 16;
+        for (int row = 0; row < kStampBlock; ++row)
+            memset(y + (size_t)row * stride + bit * kStampBlock, value, kStampBlock);
+    }
+}
+
+
+/// Reads StampFrameNumber() back from the centre of each block, with the
+/// blocks scaled if the frame was scaled from |stampWidth|.
+static uint32_t ReadFrameNumber(const I420BufferInterface& frame, int stampWidth)
+{
+    const int block = std::max(4, kStampBlock * frame.width() / stampWidth);
+    uint32_t n = 0;
+    for (int bit = 0; bit < kStampBits; ++bit)
+    {
+        int sum = 0, count = 0;
+        for (int row = block / 4; row < block * 3 / 4; ++row)
+        {
+            const uint8_t* line = frame.DataY() + (size_t)row * frame.StrideY() + bit * block;
+            for (int x = block / 4; x < block * 3 / 4; ++x, ++count)
+                sum += line[x];
+        }
+        if (sum / count > 128)
+            n |= 1u << bit;
+    }
+    return n;
+}
+
+
+/// Capture times by frame number, written by the feeder, read by the receiver.
+class FrameClock
+{
+public:
+    explicit FrameClock(size_t frames) : sentUs_(frames) {}
+
+    size_t size() const { return sentUs_.size(); }
+    void Sent(uint32_t n, int64_t us) { if (n < sentUs_.size()) sentUs_[n] = us; }
+    int64_t SentUs(uint32_t n) const { return n < sentUs_.size() ? sentUs_[n].load() : 0; }
+
+private:
+    vector<std::atomic<int64_t>> sentUs_;
+};
+
+
+class StatsObserver : public RTCStatsCollectorCallback
+{
+public:
+    void OnStatsDelivered(const scoped_refptr<const RTCStatsReport>& report) override
+    {
+        this->report = report;
+        done.Set();
+    }
+
+    scoped_refptr<const RTCStatsReport> report;
+    rtc::Event                          done;
+};
+
+
+/// The stand-in's media end: one receiving PeerConnection per offer, on its
+/// own threads and factory so it shares nothing with the publisher.
+class Receiver : public WowzaStandIn::Handler, public PeerConnectionObserver, public rtc::VideoSinkInterface<VideoFrame>
+{
+public:
+    Receiver(const FrameClock& clock, int stampWidth) : clock_(clock), stampWidth_(stampWidth), seen_(clock.size())
+    {
+        network_ = rtc::Thread::CreateWithSocketServer();
+        network_->SetName("StandIn_Network", nullptr);
+        network_->Start();
+        worker_ = rtc::Thread::Create();
+        worker_->SetName("StandIn_Worker", nullptr);
+        worker_->Start();
+        signaling_ = rtc::Thread::Create();
+        signaling_->SetName("StandIn_Signaling", nullptr);
+        signaling_->Start();
+
+        adm_ = worker_->Invoke<scoped_refptr<ADMWrapper>>(RTC_FROM_HERE, []() { return ADMWrapper::Create(); });
+        factory_ = CreatePeerConnectionFactory(network_.get(), worker_.get(), signaling_.get(), adm_,
+                                               CreateBuiltinAudioEncoderFactory(), CreateBuiltinAudioDecoderFactory(),
+                                               CreateBuiltinVideoEncoderFactory(), CreateBuiltinVideoDecoderFactory(),
+                                               nullptr, nullptr, nullptr);
+    }
+
+    ~Receiver() override
+    {
+        if (pc_)
+            pc_->Close();
+        pc_ = nullptr;
+        factory_ = nullptr;
+        worker_->Invoke<void>(RTC_FROM_HERE, [this]() { adm_ = nullptr; });
+        signaling_->Stop();
+        worker_->Stop();
+        network_->Stop();
+    }
+
+    /// WowzaStandIn::Handler implementation.
+    bool onAuth(const string& sStreamName, const string& /*sPassword*/) override
+    {
+        return !sStreamName.empty();
+    }
+
+    bool onOffer(const string& sOffer, string& sAnswer, vector<WowzaStandIn::Candidate>& candidates) override
+    {
+        if (pc_)
+            pc_->Close();
+        gathered_.Reset();
+
+        PeerConnectionInterface::RTCConfiguration config;
+        config.sdp_semantics = SdpSemantics::kUnifiedPlan;
+        pc_ = factory_->CreatePeerConnection(config, PeerConnectionDependencies(this));
+        if (!pc_)
+            return false;
+
+        SdpParseError parseError;
+        auto offer = CreateSessionDescription(SdpType::kOffer, sOffer, &parseError);
+        if (!offer)
+        {
+            fprintf(stderr, "stand-in: bad offer: %s\n", parseError.description.c_str());
+            return false;
+        }
+        scoped_refptr<SetObserver> setRemote(new rtc::RefCountedObject<SetObserver>());
+        pc_->SetRemoteDescription(std::move(offer), setRemote);
+        setRemote->done.Wait(rtc::Event::kForever);
+
+        scoped_refptr<CreateObserver> create(new rtc::RefCountedObject<CreateObserver>());
+        pc_->CreateAnswer(create, PeerConnectionInterface::RTCOfferAnswerOptions());
+        create->done.Wait(rtc::Event::kForever);
+        if (!setRemote->error.empty() || !create->desc)
+        {
+            fprintf(stderr, "stand-in: answer failed: %s%s\n", setRemote->error.c_str(), create->error.c_str());
+            return false;
+        }
+
+        scoped_refptr<SetObserver> setLocal(new rtc::RefCountedObject<SetObserver>());
+        pc_->SetLocalDescription(std::move(create->desc), setLocal);
+        setLocal->done.Wait(rtc::Event::kForever);
+        // Like Wowza: the answer goes out with every server candidate.
+        gathered_.Wait(kStartTimeoutMs);
+
+        pc_->local_description()->ToString(&sAnswer);
+        for (size_t index = 0; index < pc_->local_description()->number_of_mediasections(); ++index)
+        {
+            const auto* collection = pc_->local_description()->candidates(index);
+            for (size_t i = 0; collection && i < collection->count(); ++i)
+            {
+                string candidate;
+                collection->at(i)->ToString(&candidate);
+                candidates.push_back({candidate, collection->at(i)->sdp_mid(), (int)index});
+            }
+        }
+        return true;
+    }
+
+    void onCandidate(const WowzaStandIn::Candidate& candidate) override
+    {
+        ++candidatesReceived_;
+        if (candidate.sCandidate.empty() || !pc_)
+            return;
+
+        SdpParseError parseError;
+        unique_ptr<IceCandidateInterface> ice(
+            CreateIceCandidate(candidate.sMid, candidate.nIndex, candidate.sCandidate, &parseError));
+        if (ice)
+            pc_->AddIceCandidate(std::move(ice), [](RTCError /*error*/) {});
+    }
+
+    void onStateUpdate(int /*nState*/) override {}
+
+    /// PeerConnectionObserver implementation.
+    void OnIceGatheringChange(PeerConnectionInterface::IceGatheringState state) override
+    {
+        if (state == PeerConnectionInterface::kIceGatheringComplete)
+            gathered_.Set();
+    }
+    void OnTrack(scoped_refptr<RtpTransceiverInterface> transceiver) override
+    {
+        auto track = transceiver->receiver()->track();
+        if (track->kind() == MediaStreamTrackInterface::kVideoKind)
+            static_cast<VideoTrackInterface*>(track.get())->AddOrUpdateSink(this, rtc::VideoSinkWants());
+    }
+    void OnIceCandidate(const IceCandidateInterface* /*candidate*/) override {}
+    void OnSignalingChange(PeerConnectionInterface::SignalingState /*state*/) override {}
+    void OnDataChannel(scoped_refptr<DataChannelInterface> /*channel*/) override {}
+    void OnRenegotiationNeeded() override {}
+
+    /// VideoSinkInterface implementation, on the decoder thread.
+    void OnFrame(const VideoFrame& frame) override
+    {
+        const int64_t nowUs = rtc::TimeMicros();
+        const uint32_t n = ReadFrameNumber(*frame.video_frame_buffer()->ToI420(), stampWidth_);
+        const int64_t sentUs = clock_.SentUs(n);
+
+        MutexLock lock(&mutex_);
+        if (!firstFrameUs_)
+            firstFrameUs_ = nowUs;
+        ++frames_;
+        if (sentUs <= 0 || nowUs < sentUs)
+            ++unreadable_;
+        else if (seen_[n])
+            ++repeated_;  // the canvas showed the same source frame again
+        else
+        {
+            seen_[n] = true;
+            latenciesUs_.push_back(nowUs - sentUs);
+        }
+    }
+
+    struct Result
+    {
+        int64_t         firstFrameUs    = 0;
+        uint64_t        frames          = 0;
+        uint64_t        unreadable      = 0;
+        uint64_t        repeated        = 0;
+        uint64_t        bytesReceived   = 0;
+        uint32_t        candidates      = 0;
+        vector<int64_t> latenciesUs;
+    };
+
+    /// Drains the latencies collected so far.
+    Result Take()
+    {
+        Result result;
+        if (pc_)
+        {
+            scoped_refptr<StatsObserver> stats(new rtc::RefCountedObject<StatsObserver>());
+            pc_->GetStats(stats.get());
+            if (stats->done.Wait(kStartTimeoutMs) && stats->report)
+            {
+                for (const auto* inbound : stats->report->GetStatsOfType<RTCInboundRTPStreamStats>())
+                {
+                    if (inbound->kind.is_defined() && *inbound->kind == "video" && inbound->bytes_received.is_defined())
+                        result.bytesReceived += *inbound->bytes_received;
+                }
+            }
+        }
+
+        MutexLock lock(&mutex_);
+        result.firstFrameUs = firstFrameUs_;
+        result.frames = frames_;
+        result.unreadable = unreadable_;
+        result.repeated = repeated_;
+        result.candidates = candidatesReceived_;
+        result.latenciesUs = std::move(latenciesUs_);
+        frames_ = 0;
+        unreadable_ = 0;
+        repeated_ = 0;
+        return result;
+    }
+
+private:
+    const FrameClock&                       clock_;
+    const int                               stampWidth_;
+    unique_ptr<rtc::Thread>                 network_;
+    unique_ptr<rtc::Thread>                 worker_;
+    unique_ptr<rtc::Thread>                 signaling_;
+    scoped_refptr<ADMWrapper>               adm_;
+    scoped_refptr<PeerConnectionFactoryInterface> factory_;
+    scoped_refptr<PeerConnectionInterface>  pc_;        // replaced by onOffer()
+    rtc::Event                              gathered_;
+    std::atomic<uint32_t>                   candidatesReceived_{0};
+
+    Mutex                                   mutex_;
+    int64_t                                 firstFrameUs_ RTC_GUARDED_BY(mutex_) = 0;
+    uint64_t                                frames_ RTC_GUARDED_BY(mutex_) = 0;
+    uint64_t                                unreadable_ RTC_GUARDED_BY(mutex_) = 0;
+    uint64_t                                repeated_ RTC_GUARDED_BY(mutex_) = 0;
+    vector<bool>                            seen_ RTC_GUARDED_BY(mutex_);
+    vector<int64_t>                         latenciesUs_ RTC_GUARDED_BY(mutex_);
+};
+
+
+/// Bench-side OBS types: the frame source on the canvas, and the service and
+/// encoders the UI would attach to the stream output. The output is raw, so
+/// the encoders only carry the bitrates WebRTCStream reads from them.
+static const char* kFrameSourceId   = "sidekick_bench_frames";
+static const char* kServiceId       = "sidekick_bench_service";
+static const char* kVideoEncoderId  = "sidekick_bench_h264";
+static const char* kAudioEncoderId  = "sidekick_bench_opus";
+
+static const char* BenchTypeName(void* /*typeData*/) { return "sidekick bench"; }
+static void* CreateBenchSource(obs_data_t* /*settings*/, obs_source_t* source) { return source; }
+static void* CreateBenchService(obs_data_t* settings, obs_service_t* /*service*/) { return settings; }
+static void* CreateBenchEncoder(obs_data_t* settings, obs_encoder_t* /*encoder*/) { return settings; }
+static void DestroyBenchType(void* /*data*/) {}
+static bool BenchEncode(void* /*data*/, encoder_frame* /*frame*/, encoder_packet* /*packet*/, bool* received)
+{
+    *received = false;
+    return false;
+}
+static size_t BenchAudioFrameSize(void* /*data*/) { return 960; }
+
+
+static void RegisterBenchTypes()
+{
+    obs_source_info source = {};
+    source.id           = kFrameSourceId;
+    source.type         = OBS_SOURCE_TYPE_INPUT;
+    source.output_flags = OBS_SOURCE_ASYNC_VIDEO;
+    source.get_name     = BenchTypeName;
+    source.create       = CreateBenchSource;
+    source.destroy      = DestroyBenchType;
+    obs_register_source(&source);
+
+    obs_service_info service = {};
+    service.id          = kServiceId;
+    service.get_name    = BenchTypeName;
+    service.create      = CreateBenchService;
+    service.destroy     = DestroyBenchType;
+    obs_register_service(&service);
+
+    obs_encoder_info video = {};
+    video.id            = kVideoEncoderId;
+    video.type          = OBS_ENCODER_VIDEO;
+    video.codec         = "h264";
+    video.get_name      = BenchTypeName;
+    video.create        = CreateBenchEncoder;
+    video.destroy       = DestroyBenchType;
+    video.encode        = BenchEncode;
+    obs_register_encoder(&video);
+
+    obs_encoder_info audio = video;
+    audio.id            = kAudioEncoderId;
+    audio.type          = OBS_ENCODER_AUDIO;
+    audio.codec         = "opus";
+    audio.get_frame_size = BenchAudioFrameSize;
+    obs_register_encoder(&audio);
+}
+
+
+/// The plugin's output type, with create() wrapped to keep the stream so its
+/// startup timeline can be read.
+static WebRTCStream* g_stream = nullptr;
+
+static void* CreateStream(obs_data_t* settings, obs_output_t* output)
+{
+    g_stream = (WebRTCStream*)wowza_stream_create(settings, output);
+    return g_stream;
+}
+
+
+static void RegisterStreamOutput()
+{
+    obs_output_info info = wowza_output_info;
+    info.create = CreateStream;
+    obs_register_output(&info);
+}
+
+
+/// Points WebRTCStream at the stand-in and sets the signaling config it reads
+/// from |g_ctx|.
+static void ConfigureStream(const string& url)
+{
+    WebRTCStream::SetBenchWsUrl(url);
+
+    auto lk = g_ctx.sharedLock();
+    g_ctx.cfg.set("videoserver", string("video0"));
+    g_ctx.cfg.set("region", string("TUK"));  // skips the edge ingest lookup
+    g_ctx.cfg.set("uid", 1);
+    g_ctx.cfg.set("sid", 1);
+    g_ctx.cfg.set("ctx", string("bench-key"));
+}
+
+
+/// The output's "activate" (data capture started) and "stop" signals.
+struct OutputSignals
+{
+    rtc::Event          ready;
+    rtc::Event          stopped;
+    std::atomic<int>    stopCode{OBS_OUTPUT_SUCCESS};
+    std::atomic<bool>   failed{false};
+};
+
+static void OnOutputActivate(void* param, calldata_t* /*data*/)
+{
+    static_cast<OutputSignals*>(param)->ready.Set();
+}
+
+static void OnOutputStop(void* param, calldata_t* data)
+{
+    auto signals = static_cast<OutputSignals*>(param);
+    signals->stopCode = (int)calldata_int(data, "code");
+    signals->failed = true;
+    signals->ready.Set();  // a stop before "activate" is a failed start
+    signals->stopped.Set();
+}
+
+
+static bool g_verbose = false;
+
+static void BenchLogHandler(int level, const char* format, va_list args, void* /*param*/)
+{
+    // Plugin code logs through blog(); keep warnings and errors only.
+    if (!g_verbose && level > LOG_WARNING)
+        return;
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+}
+
+
+static bool StartObs(const Options& options)
+{
+    if (!obs_startup("en-US", nullptr, nullptr))
+        return false;
+
+    obs_audio_info audio = {};
+    audio.samples_per_sec = 48000;
+    audio.speakers = SPEAKERS_STEREO;
+    if (!obs_reset_audio(&audio))
+        return false;
+
+    obs_video_info video = {};
+#ifdef _WIN32
+    video.graphics_module = "libobs-d3d11";
+#else
+    video.graphics_module = "libobs-opengl";
+#endif
+    video.fps_num = (uint32_t)options.fps;
+    video.fps_den = 1;
+    video.base_width = video.output_width = (uint32_t)options.width;
+    video.base_height = video.output_height = (uint32_t)options.height;
+    video.output_format = VIDEO_FORMAT_NV12;
+    video.colorspace = VIDEO_CS_709;
+    video.range = VIDEO_RANGE_PARTIAL;
+    video.scale_type = OBS_SCALE_BICUBIC;
+    video.gpu_conversion = true;
+    if (obs_reset_video(&video) != OBS_VIDEO_SUCCESS)
+        return false;
+
+    RegisterBenchTypes();
+    RegisterStreamOutput();
+    return true;
+}
+
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--duration" && hasValue)
+            options.durationSec = std::max(4, atoi(argv[++i]));
+        else if (arg == "--fps" && hasValue)
+            options.fps = std::min(std::max(atoi(argv[++i]), 1), 60);
+        else if (arg == "--kbps" && hasValue)
+            options.kbps = std::max(100, atoi(argv[++i]));
+        else if (arg == "--port" && hasValue)
+            options.port = std::min(std::max(atoi(argv[++i]), 0), 65535);
+        else if (arg == "--verbose")
+            options.verbose = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [--duration sec] [--fps F] [--kbps K] [--port P] [--verbose]\n", argv[0]);
+            return 1;
+        }
+    }
+    // The canvas is what the stream sends, so the stamp reaches the receiver unscaled.
+    SanitizeInputs::OptimalFrameSize(options.kbps, options.fps, options.width, options.height);
+
+    g_verbose = options.verbose;
+    base_set_log_handler(BenchLogHandler, nullptr);
+    rtc::LogMessage::LogToDebug(options.verbose ? rtc::LS_INFO : rtc::LS_WARNING);
+
+    if (!StartObs(options))
+    {
+        fprintf(stderr, "libobs failed to start\n");
+        obs_shutdown();
+        return 1;
+    }
+
+    // Frames for the whole run, with a few seconds of slack.
+    FrameClock clock((size_t)(options.durationSec + 10) * options.fps);
+    auto receiver = std::make_unique<Receiver>(clock, options.width);
+    auto standIn = CreateWowzaStandIn();
+    const string url = standIn->start(receiver.get(), (uint16_t)options.port);
+    if (url.empty())
+    {
+        fprintf(stderr, "stand-in failed to start\n");
+        obs_shutdown();
+        return 1;
+    }
+    ConfigureStream(url);
+
+    printf("stand-in: %s\n", url.c_str());
+    printf("stream:   %dx%d@%d, %d kbps, %d s\n", options.width, options.height, options.fps, options.kbps,
+           options.durationSec);
+
+    obs_source_t* frames = obs_source_create(kFrameSourceId, "bench frames", nullptr, nullptr);
+    obs_source_set_async_unbuffered(frames, true);
+    obs_set_output_source(0, frames);
+
+    obs_data_t* videoSettings = obs_data_create();
+    obs_data_set_int(videoSettings, "bitrate", options.kbps);
+    obs_encoder_t* videoEncoder = obs_video_encoder_create(kVideoEncoderId, "bench video", videoSettings, nullptr);
+    obs_data_release(videoSettings);
+    obs_encoder_set_video(videoEncoder, obs_get_video());
+    obs_data_t* audioSettings = obs_data_create();
+    obs_data_set_int(audioSettings, "bitrate", 128);
+    obs_encoder_t* audioEncoder = obs_audio_encoder_create(kAudioEncoderId, "bench audio", audioSettings, 0, nullptr);
+    obs_data_release(audioSettings);
+    obs_encoder_set_audio(audioEncoder, obs_get_audio());
+    obs_service_t* service = obs_service_create(kServiceId, "bench service", nullptr, nullptr);
+
+    // The output exists well before it is started, as in OBS; WebRTCStream
+    // warms its pool meanwhile.
+    OutputSignals signals;
+    obs_data_t* outputSettings = obs_data_create();
+    obs_data_set_bool(outputSettings, OPT_HIGH_FRAMERATE_ENABLED, options.fps > 30);
+    obs_output_t* output = obs_output_create("mfc_wowza_output", "bench stream", outputSettings, nullptr);
+    obs_data_release(outputSettings);
+    signal_handler_t* handler = obs_output_get_signal_handler(output);
+    signal_handler_connect(handler, "activate", OnOutputActivate, &signals);
+    signal_handler_connect(handler, "stop", OnOutputStop, &signals);
+    obs_output_set_service(output, service);
+    obs_output_set_video_encoder(output, videoEncoder);
+    obs_output_set_audio_encoder(output, audioEncoder, 0);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    int exitCode = 0;
+    const bool started = g_stream && obs_output_start(output);
+    if (!started || !signals.ready.Wait(kStartTimeoutMs) || signals.failed)
+    {
+        fprintf(stderr, "publish failed (stop code %d)\n", signals.stopCode.load());
+        exitCode = 1;
+    }
+    else
+    {
+        // "activate" is obs_output_begin_data_capture(), on the server's "ready".
+        const int64_t readyUs = rtc::TimeMicros();
+        const int64_t intervalUs = rtc::kNumMicrosecsPerSec / options.fps;
+        const uint32_t numFrames = (uint32_t)std::min<size_t>((size_t)options.durationSec * options.fps, clock.size());
+        vector<uint8_t> y((size_t)options.width * options.height);
+        vector<uint8_t> uv((size_t)options.width * options.height / 2, 128);
+
+        obs_source_frame frame = {};
+        frame.data[0] = y.data();
+        frame.data[1] = uv.data();
+        frame.linesize[0] = (uint32_t)options.width;
+        frame.linesize[1] = (uint32_t)options.width;
+        frame.width = (uint32_t)options.width;
+        frame.height = (uint32_t)options.height;
+        frame.format = VIDEO_FORMAT_NV12;
+        video_format_get_parameters(VIDEO_CS_709, VIDEO_RANGE_PARTIAL, frame.color_matrix, frame.color_range_min,
+                                    frame.color_range_max);
+
+        int64_t steadyStartUs = 0;
+        uint64_t steadyStartBytes = 0;
+        for (uint32_t n = 0; n < numFrames && !signals.failed; ++n)
+        {
+            // Moving gradient so every frame costs bits, then the stamp on top.
+            for (int row = kStampBlock; row < options.height; ++row)
+            {
+                uint8_t* line = &y[(size_t)row * options.width];
+                for (int x = 0; x < options.width; ++x)
+                    line[x] = (uint8_t)((x + row + n * 4) & 0xff);
+            }
+            StampFrameNumber(y.data(), options.width, n);
+
+            clock.Sent(n, rtc::TimeMicros());
+            frame.timestamp = os_gettime_ns();
+            obs_source_output_video(frames, &frame);
+
+            // The first two seconds are startup; throughput is measured after.
+            if (n == (uint32_t)options.fps * 2)
+            {
+                steadyStartBytes = receiver->Take().bytesReceived;
+                steadyStartUs = rtc::TimeMicros();
+            }
+
+            const int64_t sleepUs = readyUs + (n + 1) * intervalUs - rtc::TimeMicros();
+            if (sleepUs > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(sleepUs));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));  // let the tail arrive
+
+        auto result = receiver->Take();
+        const double steadySec = (rtc::TimeMicros() - steadyStartUs) / 1e6;
+        const auto rate = X264Encoder::GetRateControlStats();
+        const auto& timeline = g_stream->startupTimeline();
+
+        if (signals.failed)
+            fprintf(stderr, "stream stopped early (stop code %d)\n", signals.stopCode.load());
+        printf("\nstartup:  %s\n", timeline.ToString().c_str());
+        printf("go-live:  ready +%lld ms, ice connected +%lld ms, pc/ws overlap %lld ms\n",
+               (long long)timeline.Elapsed(StartupTimeline::kReadyToBroadcast),
+               (long long)timeline.Elapsed(StartupTimeline::kIceConnected), (long long)timeline.OverlapMs());
+        printf("ice:      %u candidates received by the stand-in\n", result.candidates);
+        if (result.firstFrameUs)
+            printf("first frame: +%lld ms after start, %lld ms after ready\n",
+                   (long long)(timeline.Elapsed(StartupTimeline::kReadyToBroadcast)
+                               + (result.firstFrameUs - readyUs) / 1000),
+                   (long long)((result.firstFrameUs - readyUs) / 1000));
+        else
+            printf("first frame: none received\n");
+
+        auto& latencies = result.latenciesUs;
+        printf("latency:  p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms (%zu frames, %llu repeated, %llu unreadable)\n",
+               BenchUtil::Percentile(latencies, 0.50) / 1000.0, BenchUtil::Percentile(latencies, 0.95) / 1000.0,
+               BenchUtil::Percentile(latencies, 0.99) / 1000.0, BenchUtil::Percentile(latencies, 1.0) / 1000.0,
+               latencies.size(), (unsigned long long)result.repeated, (unsigned long long)result.unreadable);
+        printf("steady:   %.1f fps received, %.0f kbps received (encoder target %u kbps, applied %u kbps)\n",
+               result.frames / steadySec, (result.bytesReceived - steadyStartBytes) * 8 / 1000.0 / steadySec,
+               rate.targetKbps, rate.appliedKbps);
+        if (signals.failed)
+            exitCode = 1;
+    }
+
+    // As OBS stops and destroys the output; destroy releases the stream.
+    if (started && !signals.failed)
+    {
+        obs_output_stop(output);
+        if (!signals.stopped.Wait(kStopTimeoutMs))
+            fprintf(stderr, "output did not stop within %d ms\n", kStopTimeoutMs);
+    }
+    signal_handler_disconnect(handler, "activate", OnOutputActivate, &signals);
+    signal_handler_disconnect(handler, "stop", OnOutputStop, &signals);
+    obs_output_release(output);
+    g_stream = nullptr;
+    obs_service_release(service);
+    obs_encoder_release(audioEncoder);
+    obs_encoder_release(videoEncoder);
+    obs_set_output_source(0, nullptr);
+    obs_source_release(frames);
+
+    standIn->stop();
+    receiver = nullptr;
+    wowza_stream_unload();
+    obs_shutdown();
+    return exitCode;
+}
@@ -15,6 +15,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 #include "wowza-stream.h"
+#include "StaticSceneDetector.h"
+#include "WarmPool.h"
 #include "WebRTCStream.h"
 
 #include <libobs/obs-module.h>
@@ -116,6 +118,11 @@ extern "C" void wowza_stream_defaults(obs_data_t* defaults)
     obs_data_set_default_string(defaults,   OPT_BIND_IP,                "default");
     obs_data_set_default_bool(defaults,     OPT_NEWSOCKETLOOP_ENABLED,  false);
     obs_data_set_default_bool(defaults,     OPT_LOWLATENCY_ENABLED,     false);
+    obs_data_set_default_bool(defaults,     OPT_HIGH_FRAMERATE_ENABLED, false);
+    obs_data_set_default_bool(defaults,     OPT_STATIC_SCENE_ENABLED,   false);
+    obs_data_set_default_int(defaults,      OPT_STATIC_SCENE_THRESHOLD, StaticSceneDetector::kMeanDiffThreshold);
+    obs_data_set_default_int(defaults,      OPT_STATIC_SCENE_AFTER_MS,  StaticSceneDetector::kStaticAfterMs);
+    obs_data_set_default_int(defaults,      OPT_STATIC_SCENE_FPS,       StaticSceneDetector::kStaticFps);
 }
 
 
@@ -130,6 +137,10 @@ extern "C" obs_properties_t* wowza_stream_properties(void* unused)
                             obs_module_text("WOWZAStream.NewSocketLoop"));
     obs_properties_add_bool(props, OPT_LOWLATENCY_ENABLED,
                             obs_module_text("WOWZAStream.LowLatencyMode"));
+    obs_properties_add_bool(props, OPT_HIGH_FRAMERATE_ENABLED,
+                            obs_module_text("WOWZAStream.HighFramerate"));
+    obs_properties_add_bool(props, OPT_STATIC_SCENE_ENABLED,
+                            obs_module_text("WOWZAStream.StaticScene"));
     return props;
 }
 
@@ -171,6 +182,13 @@ extern "C" float wowza_stream_congestion(void* data)
 }
 
 
+extern "C" void wowza_stream_unload()
+{
+    trace();
+    WarmPool::Shutdown();  // Threads and factory are kept across streams until now
+}
+
+
 extern "C"
 {
 #ifdef _WIN32 // to avoid MSVC compilation error
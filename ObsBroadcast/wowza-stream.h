@@ -23,6 +23,16 @@
 
 #include <cstdint>
 
+// Output setting that lets WebRTCStream send above 30 fps; see
+// WEBRTCSTREAM_HIGH_MAX_FRAMERATE.
+#define OPT_HIGH_FRAMERATE_ENABLED  "high_framerate_enabled"
+
+// Output settings of the static scene frame thinning (StaticSceneDetector).
+#define OPT_STATIC_SCENE_ENABLED    "static_scene_enabled"
+#define OPT_STATIC_SCENE_THRESHOLD  "static_scene_threshold"
+#define OPT_STATIC_SCENE_AFTER_MS   "static_scene_after_ms"
+#define OPT_STATIC_SCENE_FPS        "static_scene_fps"
+
 extern "C" const char* wowza_stream_getname(void* unused);
 extern "C" void* wowza_stream_create(obs_data_t* settings, obs_output_t* output);
 extern "C" bool wowza_stream_start(void* data);
@@ -36,5 +46,6 @@ extern "C" obs_properties_t* wowza_stream_properties(void* unused);
 extern "C" uint64_t wowza_stream_total_bytes_sent(void* data);
 extern "C" int wowza_stream_dropped_frames(void* data);
 extern "C" float wowza_stream_congestion(void* data);
+extern "C" void wowza_stream_unload();
 
 #endif  // WOWZA_STREAM_H_
@@ -23,7 +23,10 @@
 
 #include <algorithm>
 #include <cctype>
-#include <regex>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <mutex>
 
 #define MFC_EDGE_DETAILS_URL "https://modelweb.mfcimg.com/edge/details.json"
 #define MFC_EDGE_RTP_INFO_URL "https://rtp-edgeingest.myfreecams.com/edge/info.json"
@@ -35,6 +38,19 @@
 using njson = nlohmann::json;
 using std::string;
 
+// How long fetched edge info is reused.
+static const std::chrono::minutes kEdgeInfoTtl(10);
+
+struct EdgeInfoCacheEntry
+{
+    std::shared_future<MFCEdgeIngest::SiteIpPort>   info;       // site and tcpIp; port unset
+    std::chrono::steady_clock::time_point           fetched;
+};
+
+// Keyed by info.json URL, i.e. per edge host.
+static std::mutex                                   g_edgeInfoMutex;
+static std::map<string, EdgeInfoCacheEntry>         g_edgeInfoCache;
+
 
 static string ToLower(const string& s)
 {
@@ -61,107 +77,101 @@ string MFCEdgeIngest::RtmpPublishUrl(const string& region)
 }
 
 
-// static
-MFCEdgeIngest::SiteIpPort MFCEdgeIngest::WebrtcTcpIpPort(const std::string& videoServer)
-{
-    string ip, site;
-    MFCEdgeIngest::SiteIpPort siteIpPort;
-    if (!MFCEdgeIngest::WebrtcTcpIp(site, ip))
-        return siteIpPort;
-
-    int port = WebrtcTcpPort(videoServer);
-    if (port > 0)
-    {
-        siteIpPort.site = site;
-        siteIpPort.tcpIp = ip;
-        siteIpPort.port = port;
-    }
-    return siteIpPort;
-}
-
-
-// static
-MFCEdgeIngest::SiteIpPort MFCEdgeIngest::WebrtcTcpIpPort(const string& videoServer, const string& region)
-{
-    string ip;
-    MFCEdgeIngest::SiteIpPort siteIpPort;
-    if (!MFCEdgeIngest::WebrtcTcpIp(region, ip))
-        return siteIpPort;
-
-    int port = WebrtcTcpPort(videoServer);
-    if (port > 0)
-    {
-        siteIpPort.site = ToLower(region);
-        siteIpPort.tcpIp = ip;
-        siteIpPort.port = port;
-    }
-    return siteIpPort;
-}
-
-
-// static
-bool MFCEdgeIngest::WebrtcTcpIp(std::string& site, std::string& ip)
+/// Fetches |url| (an edge info.json) and returns its ip and site. The site is
+/// |region| if given. Returns an empty tcpIp on failure.
+static MFCEdgeIngest::SiteIpPort FetchEdgeInfo(const string& url, const string& region)
 {
+    MFCEdgeIngest::SiteIpPort info;
     try
     {
-        const string url = MFC_EDGE_RTP_INFO_URL;
         unsigned int dwLen = 0;
         CCurlHttpRequest httpreq;
         uint8_t* pResponse = httpreq.Get(url, &dwLen, "", nullptr);
         if (!pResponse)
-            return false;
-
-        const auto res = njson::parse((char*)pResponse);
-        ip = res["ip"].get<string>();
-        site = ToLower(res["site"].get<string>());
+            return info;
 
+        const string body((char*)pResponse, dwLen);
         free(pResponse);
         pResponse = nullptr;
-        return true;
+
+        const auto res = njson::parse(body);
+        info.tcpIp = res["ip"].get<string>();
+        info.site = region.empty() ? ToLower(res["site"].get<string>()) : ToLower(region);
     }
     catch (const std::exception& e)
     {
         _MESG("Error fetching edge IP: %s", e.what());
-        return false;
+        info = MFCEdgeIngest::SiteIpPort();
     }
+    return info;
 }
 
 
 // static
-bool MFCEdgeIngest::WebrtcTcpIp(const string& region, std::string& ip)
+MFCEdgeIngest::SiteIpPort MFCEdgeIngest::WebrtcTcpIpPort(const std::string& videoServer)
 {
-    try
-    {
-        const string url = string("https://rtp-edgeingest-") + ToLower(region) + ".myfreecams.com/edge/info.json";
-        unsigned int dwLen = 0;
-        CCurlHttpRequest httpreq;
-        uint8_t* pResponse = httpreq.Get(url, &dwLen, "", nullptr);
-        if (!pResponse)
-            return false;
+    return ResolveAsync(videoServer, "").get();
+}
 
-        const auto res = njson::parse((char*)pResponse);
-        ip = res["ip"].get<string>();
 
-        free(pResponse);
-        pResponse = nullptr;
-        return true;
-    }
-    catch (const std::exception& e)
+// static
+MFCEdgeIngest::SiteIpPort MFCEdgeIngest::WebrtcTcpIpPort(const string& videoServer, const string& region)
+{
+    return ResolveAsync(videoServer, region).get();
+}
+
+
+// static
+std::shared_future<MFCEdgeIngest::SiteIpPort> MFCEdgeIngest::ResolveAsync(const string& videoServer,
+                                                                          const string& region)
+{
+    const string url = region.empty()
+                       ? string(MFC_EDGE_RTP_INFO_URL)
+                       : string("https://rtp-edgeingest-") + ToLower(region) + ".myfreecams.com/edge/info.json";
+
+    std::shared_future<SiteIpPort> info;
     {
-        _MESG("Error fetching edge IP: %s", e.what());
-        return false;
+        std::lock_guard<std::mutex> lock(g_edgeInfoMutex);
+        const auto now = std::chrono::steady_clock::now();
+        auto& entry = g_edgeInfoCache[url];
+
+        bool stale = !entry.info.valid() || now - entry.fetched > kEdgeInfoTtl;
+        if (!stale && entry.info.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            stale = entry.info.get().tcpIp.empty();  // retry failures
+        if (stale)
+        {
+            entry.info = std::async(std::launch::async, FetchEdgeInfo, url, region).share();
+            entry.fetched = now;
+        }
+        info = entry.info;
     }
+
+    // The port only depends on |videoServer|; it is added when the caller
+    // asks for the result, on the caller's thread.
+    const int port = WebrtcTcpPort(videoServer);
+    return std::async(std::launch::deferred, [info, port]()
+    {
+        SiteIpPort siteIpPort = info.get();
+        if (siteIpPort.tcpIp.empty() || port <= 0)
+            return SiteIpPort();
+        siteIpPort.port = port;
+        return siteIpPort;
+    }).share();
 }
 
 
 // static
 int MFCEdgeIngest::WebrtcTcpPort(const string& videoServer)
 {
-    std::smatch match;
-    std::regex re("video([0-9]{3,4})");
-    if (!std::regex_search(videoServer, match, re))
-        return 0;
-
-    int port = std::stoi(match[1].str()) + 2000;
-    return port;
+    // Equivalent to regex_search("video([0-9]{3,4})"): the first "video"
+    // followed by at least 3 digits, of which up to 4 are used.
+    for (size_t pos = videoServer.find("video"); pos != string::npos; pos = videoServer.find("video", pos + 1))
+    {
+        int number = 0, digits = 0;
+        for (size_t i = pos + 5; i < videoServer.size() && digits < 4 && isdigit((unsigned char)videoServer[i]); ++i, ++digits)
+            number = number * 10 + (videoServer[i] - '0');
+        if (digits >= 3)
+            return number + 2000;
+    }
+    return 0;
 }
@@ -19,6 +19,7 @@
 #ifndef MFC_EDGE_INGEST_H_
 #define MFC_EDGE_INGEST_H_
 
+#include <future>
 #include <string>
 #include <tuple>
 
@@ -57,19 +58,17 @@ public:
      */
     static SiteIpPort WebrtcTcpIpPort(const std::string& videoServer, const std::string& region);
 
-private:
-    /**
-     * WebRTC ingest |ip| address for nearest |site|.
-     */
-    static bool WebrtcTcpIp(std::string& site, std::string& ip);
-
     /**
-     * WebRTC ingest |ip| address for |region|.
-     * @param region - TUK: Seattle, ORD: Chicago, AMS: Amsterdam, BUH: Bucharest, SYD: Sydney, SAO: Sao Paulo, TYO: Tokyo
-     * @param ip - TCP ice candidate IP address override
+     * Starts resolving WebrtcTcpIpPort() in the background and returns at once.
+     * Edge info is cached per edge host for a few minutes, so a repeat call
+     * (e.g. the next go-live) is usually ready without a request. Failed
+     * lookups are not cached. The result is empty on failure.
+     * @param videoServer - Example: "video343"
+     * @param region - empty for the nearest edge, otherwise as for WebrtcTcpIpPort()
      */
-    static bool WebrtcTcpIp(const std::string& region, std::string& ip);
+    static std::shared_future<SiteIpPort> ResolveAsync(const std::string& videoServer, const std::string& region);
 
+private:
     /**
      * WebRTC ingest |port| number for |videoServer|.
      * @param videoServer - Example: "video343"
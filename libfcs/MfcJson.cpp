@@ -20,7 +20,9 @@
 #include <assert.h>
 #include <stdarg.h>
 
+#include <algorithm>
 #include <iostream>
+#include <new>
 #include <sstream>
 
 #include "fcslib_string.h"
@@ -30,32 +32,256 @@
 
 const char* MfcJsonObj::sm_pszHexVals = "0123456789ABCDEF";
 
-void MfcJsonObj::clear(void)
+//---------------------------------------------------------------------------------------------------------------
+// MfcJsonArena
+//
+// Backing store for one json document. Nodes are all sizeof(MfcJsonObj), so they are bump allocated out of
+// blocks and recycled through a free list when removed. Keys are interned once per document, so the same key
+// repeated through an array of objects shares one copy. Memory is only handed back to the heap when the
+// root node is cleared or destroyed, so a long lived root that keeps adding new, unique keys grows with the
+// number of distinct keys it has ever seen rather than the number it currently holds.
+//
+// Interned keys are stored as [uint32_t length][chars][NUL], and the pointer handed out points at the chars,
+// so the length of a key can always be recovered without strlen() (and keys may contain embedded NULs).
+//
+class MfcJsonArena
 {
-    if (m_dwType == JSON_T_ARRAY)
+public:
+    MfcJsonArena()
+        : m_pCur(m_achFirst)
+        , m_nLeft(sizeof(m_achFirst))
+        , m_nNextBlock(4096)
+        , m_pFreeNodes(NULL)
+        , m_nKeys(0)
+    {}
+
+    ~MfcJsonArena()
+    {
+        for (size_t n = 0; n < m_vBlocks.size(); n++)
+            ::operator delete(m_vBlocks[n]);
+    }
+
+    // Forget everything allocated so far. Only valid once every node from this arena has been destroyed.
+    void reset(void)
+    {
+        for (size_t n = 0; n < m_vBlocks.size(); n++)
+            ::operator delete(m_vBlocks[n]);
+
+        m_vBlocks.clear();
+        m_pCur = m_achFirst;
+        m_nLeft = sizeof(m_achFirst);
+        m_nNextBlock = 4096;
+        m_pFreeNodes = NULL;
+        m_vKeys.clear();
+        m_nKeys = 0;
+    }
+
+    void* allocNode(void)
     {
-        for (unsigned int n = 0; n < m_vArray.size(); n++)
+        if (m_pFreeNodes)
         {
-            MfcJsonObj* pObj = m_vArray[n];
+            void* p = m_pFreeNodes;
+            m_pFreeNodes = *(void**)p;
+            return p;
+        }
+
+        return _alloc(sizeof(MfcJsonObj), alignof(MfcJsonObj));
+    }
 
-            delete pObj;
+    void freeNode(void* p)
+    {
+        *(void**)p = m_pFreeNodes;
+        m_pFreeNodes = p;
+    }
+
+    static size_t keyLen(const char* pszKey)
+    {
+        return *((const uint32_t*)pszKey - 1);
+    }
+
+    const char* intern(const char* pch, size_t nLen)
+    {
+        if (m_nKeys * 2 >= m_vKeys.size())
+            _growKeys();
+
+        size_t nMask = m_vKeys.size() - 1;
+        size_t nSlot = _hash(pch, nLen) & nMask;
+
+        while (m_vKeys[nSlot] != NULL)
+        {
+            const char* pszKey = m_vKeys[nSlot];
+            if (keyLen(pszKey) == nLen && memcmp(pszKey, pch, nLen) == 0)
+                return pszKey;
+
+            nSlot = (nSlot + 1) & nMask;
         }
+
+        uint32_t* pLen = (uint32_t*)_alloc(sizeof(uint32_t) + nLen + 1, alignof(uint32_t));
+        char* pszKey = (char*)(pLen + 1);
+
+        *pLen = (uint32_t)nLen;
+        memcpy(pszKey, pch, nLen);
+        pszKey[nLen] = '\0';
+
+        m_vKeys[nSlot] = pszKey;
+        m_nKeys++;
+
+        return pszKey;
     }
-    else if (m_dwType == JSON_T_OBJECT)
+
+private:
+    static size_t _hash(const char* pch, size_t nLen)
     {
-        while (m_mObj.size() > 0)
+        // FNV-1a
+        uint32_t dwHash = 2166136261u;
+        for (size_t n = 0; n < nLen; n++)
         {
-            map< string,MfcJsonObj* >::iterator i = m_mObj.begin();
+            dwHash ^= (uint8_t)pch[n];
+            dwHash *= 16777619u;
+        }
+        return dwHash;
+    }
+
+    void _growKeys(void)
+    {
+        vector< const char* > vOld;
+        vOld.swap(m_vKeys);
+        m_vKeys.assign(vOld.empty() ? 32 : vOld.size() * 2, NULL);
 
-            MfcJsonObj* pObj = i->second;
-            m_mObj.erase(i);
-            delete pObj;
+        size_t nMask = m_vKeys.size() - 1;
+        for (size_t n = 0; n < vOld.size(); n++)
+        {
+            if (vOld[n])
+            {
+                size_t nSlot = _hash(vOld[n], keyLen(vOld[n])) & nMask;
+                while (m_vKeys[nSlot] != NULL)
+                    nSlot = (nSlot + 1) & nMask;
+
+                m_vKeys[nSlot] = vOld[n];
+            }
         }
     }
 
-    m_dwType = JSON_T_NULL;
-    m_mObj.clear();
+    void* _alloc(size_t nBytes, size_t nAlign)
+    {
+        size_t nPad = (nAlign - ((uintptr_t)m_pCur & (nAlign - 1))) & (nAlign - 1);
+
+        if (nPad + nBytes > m_nLeft)
+        {
+            size_t nBlock = max(m_nNextBlock, nBytes + nAlign);
+            char* pBlock = (char*)::operator new(nBlock);
+
+            m_vBlocks.push_back(pBlock);
+            m_pCur = pBlock;
+            m_nLeft = nBlock;
+            m_nNextBlock = min< size_t >(m_nNextBlock * 2, 65536);
+
+            nPad = (nAlign - ((uintptr_t)m_pCur & (nAlign - 1))) & (nAlign - 1);
+        }
+
+        void* p = m_pCur + nPad;
+        m_pCur += nPad + nBytes;
+        m_nLeft -= nPad + nBytes;
+
+        return p;
+    }
+
+    alignas(16) char m_achFirst[4096];          // first block lives inline, so small documents cost one allocation
+    char* m_pCur;                               // next free byte of the current block
+    size_t m_nLeft;                             // bytes left in the current block
+    size_t m_nNextBlock;                        // size of the next heap block
+    vector< char* > m_vBlocks;                  // heap blocks, freed on reset() or destruction
+    void* m_pFreeNodes;                         // destroyed nodes, linked through their first word
+    vector< const char* > m_vKeys;              // open addressed intern table, power of two sized
+    size_t m_nKeys;                             // keys in m_vKeys
+};
+
+// Compare an interned key against sKey, ordering them the same way std::string does
+static int _keyCompare(const char* pszKey, const string& sKey)
+{
+    size_t nKeyLen = MfcJsonArena::keyLen(pszKey), nLen = sKey.size();
+    int nRet = memcmp(pszKey, sKey.data(), min(nKeyLen, nLen));
+
+    if (nRet == 0)
+        nRet = (nKeyLen < nLen ? -1 : (nKeyLen > nLen ? 1 : 0));
+
+    return nRet;
+}
+
+static bool _keyLess(const MfcJsonPair& a, const MfcJsonPair& b)
+{
+    if (a.first == b.first)                     // same arena interns equal keys to the same pointer
+        return false;
+
+    size_t nLenA = MfcJsonArena::keyLen(a.first), nLenB = MfcJsonArena::keyLen(b.first);
+    int nRet = memcmp(a.first, b.first, min(nLenA, nLenB));
+
+    return (nRet < 0 || (nRet == 0 && nLenA < nLenB));
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+MfcJsonObj::~MfcJsonObj()
+{
+    _clearChildren();
+
+    if (!m_fArenaNode)
+        delete m_pArena;
+    m_pArena = NULL;
+
+    delete m_psThisSerialized;
+    m_psThisSerialized = NULL;
+
+    free(m_pszFloatPrecisionFmt);                   // stores optional override for floating point format precision
+    m_pszFloatPrecisionFmt = NULL;
+}
+
+MfcJsonArena* MfcJsonObj::_arena(void)
+{
+    if (m_pArena == NULL)
+        m_pArena = new MfcJsonArena();
+
+    return m_pArena;
+}
+
+MfcJsonObj* MfcJsonObj::_newChild(JSON_type jsType)
+{
+    MfcJsonArena* pArena = _arena();
+    return new (pArena->allocNode()) MfcJsonObj(pArena, jsType);
+}
+
+void MfcJsonObj::_freeChild(MfcJsonObj* pObj)
+{
+    if (pObj->m_fArenaNode)
+    {
+        MfcJsonArena* pArena = pObj->m_pArena;
+        pObj->~MfcJsonObj();
+        pArena->freeNode(pObj);
+    }
+    else delete pObj;
+}
+
+void MfcJsonObj::_clearChildren(void)
+{
+    for (size_t n = 0; n < m_vArray.size(); n++)
+        _freeChild(m_vArray[n]);
+
+    for (size_t n = 0; n < m_vObj.size(); n++)
+        _freeChild(m_vObj[n].second);
+
     m_vArray.clear();
+    m_vObj.clear();
+}
+
+void MfcJsonObj::clear(void)
+{
+    _clearChildren();
+
+    // Nothing else can be using a root's arena once its children are gone, so start it over
+    if (m_pArena && !m_fArenaNode)
+        m_pArena->reset();
+
+    m_dwType = JSON_T_NULL;
     m_nUpdates = 1;
 }
 
@@ -75,71 +301,62 @@ MfcJsonObj::MfcJsonObj()
     _initialize(JSON_T_NULL);
 }
 
+MfcJsonObj::MfcJsonObj(MfcJsonArena* pArena, JSON_type jsType)
+{
+    _initialize(jsType);
+    m_pArena = pArena;
+    m_fArenaNode = true;
+}
+
 #ifdef _MFCDEV_
-// Shallow copy swap object method
+// Swap object method. Children can't move between documents without changing arenas, so this is deep copies.
 void MfcJsonObj::swap(MfcJsonObj& js)
 {
-    // Save the contents of other object in temporary variables
-    uint32_t dwType                 = js.m_dwType;
-    vector< MfcJsonObj* > vArray    = js.m_vArray;
-    map< string,MfcJsonObj* > mObj  = js.m_mObj;
-    int64_t nVal                    = js.m_nVal;
-    double dVal                     = js.m_dVal;
-    bool fVal                       = js.m_fVal;
-    string sVal                     = js.m_sVal;
+    MfcJsonObj jsTmp(js);
+
+    js._copyFrom(*this);
+    _copyFrom(jsTmp);
+
     char* pszFloatPrecisionFmt      = js.m_pszFloatPrecisionFmt;
-    string sThisSerialized          = js.m_sThisSerialized;
-    size_t nUpdates                 = js.m_nUpdates;
-
-    // Set other object to our current state
-    js.m_dwType                     = m_dwType;
-    js.m_vArray                     = m_vArray;
-    js.m_mObj                       = m_mObj;
-    js.m_nVal                       = m_nVal;
-    js.m_dVal                       = m_dVal;
-    js.m_fVal                       = m_fVal;
-    js.m_sVal                       = m_sVal;
     js.m_pszFloatPrecisionFmt       = m_pszFloatPrecisionFmt;
-    js.m_sThisSerialized            = m_sThisSerialized;
-    js.m_nUpdates                   = m_nUpdates;
-
-    // Set this object to the previous state of other object
-    m_dwType                        = dwType;
-    m_vArray                        = vArray;
-    m_mObj                          = mObj;
-    m_nVal                          = nVal;
-    m_dVal                          = dVal;
-    m_fVal                          = fVal;
-    m_sVal                          = sVal;
     m_pszFloatPrecisionFmt          = pszFloatPrecisionFmt;
-    m_sThisSerialized               = sThisSerialized;
-    m_nUpdates                      = nUpdates;
 }
 
-// Detach value under sKey from this object
+// Detach value under sKey from this object. Values living in our arena are handed back as a heap copy.
 MfcJsonObj* MfcJsonObj::detach(const string& sKey)
 {
     MfcJsonObj* pRet = NULL;
-    if (isObject())
+    bool fFound = false;
+    size_t nPos = _objectFind(sKey, fFound);
+
+    if (fFound)
     {
-        map< string,MfcJsonObj* >::iterator i = m_mObj.find(sKey);
-        if (i != m_mObj.end())
+        pRet = m_vObj[nPos].second;
+        if (pRet->m_fArenaNode)
         {
-            pRet = i->second;
-            m_mObj.erase(i);
-            m_nUpdates++;
+            MfcJsonObj* pCopy = new MfcJsonObj(*pRet);
+            _freeChild(pRet);
+            pRet = pCopy;
         }
+        m_vObj.erase(m_vObj.begin() + nPos);
+        m_nUpdates++;
     }
     return pRet;
 }
 
-// Detach value under position nPos from this array
+// Detach value under position nPos from this array. Values living in our arena are handed back as a heap copy.
 MfcJsonObj* MfcJsonObj::detach(size_t nPos)
 {
     MfcJsonObj* pRet = NULL;
     if (arrayLen() > nPos)
     {
         pRet = m_vArray.at(nPos);
+        if (pRet->m_fArenaNode)
+        {
+            MfcJsonObj* pCopy = new MfcJsonObj(*pRet);
+            _freeChild(pRet);
+            pRet = pCopy;
+        }
         m_vArray.erase(m_vArray.begin() + nPos);
         m_nUpdates++;
     }
@@ -152,17 +369,14 @@ void MfcJsonObj::_initialize(JSON_type jsType)
     m_dwType = jsType;
     m_nUpdates = 1;
 
-    m_pszFloatPrecisionFmt = NULL;
+    m_pArena = NULL;
+    m_fArenaNode = false;
 
-    m_lastDeserializedKey = "";
+    m_pszFloatPrecisionFmt = NULL;
+    m_psThisSerialized = NULL;
 
-    // Initialize basic types to their default values
-    switch (m_dwType)
-    {
-        case JSON_T_BOOLEAN:        m_fVal = false; break;
-        case JSON_T_FLOAT:          m_dVal = 0;     break;
-        case JSON_T_INTEGER:        m_nVal = 0;     break;
-    }
+    // Initialize basic types to their default values (zeroing the union covers 0, 0.0 and false)
+    m_nVal = 0;
 }
 
 MfcJsonObj::MfcJsonObj(int64_t nVal)
@@ -208,11 +422,6 @@ void MfcJsonObj::_copyFrom(const MfcJsonObj& src)
     clear();
 
     m_dwType = src.m_dwType;
-    static int s_nLevel = -1;
-
-    s_nLevel++;
-
-    string sMargin = string(s_nLevel * 4, ' ');
 
     switch (m_dwType)
     {
@@ -223,13 +432,32 @@ void MfcJsonObj::_copyFrom(const MfcJsonObj& src)
         case JSON_T_INTEGER:        m_nVal = src.m_nVal; break;
 
         case JSON_T_OBJECT:
-            for (map< string,MfcJsonObj* >::const_iterator i = src.m_mObj.begin(); i != src.m_mObj.end(); ++i)
-                m_mObj[i->first] = new MfcJsonObj(*(i->second));
+        {
+            // src is already sorted, so entries can be appended in order. Keys interned in the same arena
+            // are shared as is, anything else is interned into ours.
+            MfcJsonArena* pArena = _arena();
+            m_vObj.reserve(src.m_vObj.size());
+            for (size_t n = 0; n < src.m_vObj.size(); n++)
+            {
+                const char* pszKey = src.m_vObj[n].first;
+                MfcJsonPair pair;
+
+                pair.first = (src.m_pArena == pArena ? pszKey : pArena->intern(pszKey, MfcJsonArena::keyLen(pszKey)));
+                pair.second = _newChild(JSON_T_NULL);
+                pair.second->_copyFrom(*src.m_vObj[n].second);
+                m_vObj.push_back(pair);
+            }
             break;
+        }
 
         case JSON_T_ARRAY:
+            m_vArray.reserve(src.m_vArray.size());
             for (size_t n = 0; n < src.m_vArray.size(); n++)
-                m_vArray.push_back( new MfcJsonObj( *(src.m_vArray[n]) ) );
+            {
+                MfcJsonObj* pObj = _newChild(JSON_T_NULL);
+                pObj->_copyFrom(*src.m_vArray[n]);
+                m_vArray.push_back(pObj);
+            }
             break;
 
         default:
@@ -237,29 +465,35 @@ void MfcJsonObj::_copyFrom(const MfcJsonObj& src)
             m_dwType = JSON_T_NULL;
             break;
     }
-
-    s_nLevel--;
-
 }
 
 void MfcJsonObj::arrayAdd(int64_t nVal)
 {
     _makeType(JSON_T_ARRAY);
-    m_vArray.push_back(new MfcJsonObj(nVal));
+
+    MfcJsonObj* pObj = _newChild(JSON_T_INTEGER);
+    pObj->m_nVal = nVal;
+    m_vArray.push_back(pObj);
     m_nUpdates++;
 }
 
 void MfcJsonObj::arrayAdd(double dVal)
 {
     _makeType(JSON_T_ARRAY);
-    m_vArray.push_back(new MfcJsonObj(dVal));
+
+    MfcJsonObj* pObj = _newChild(JSON_T_FLOAT);
+    pObj->m_dVal = dVal;
+    m_vArray.push_back(pObj);
     m_nUpdates++;
 }
 
 void MfcJsonObj::arrayAdd(bool fVal)
 {
     _makeType(JSON_T_ARRAY);
-    m_vArray.push_back(new MfcJsonObj(fVal));
+
+    MfcJsonObj* pObj = _newChild(JSON_T_BOOLEAN);
+    pObj->m_fVal = fVal;
+    m_vArray.push_back(pObj);
     m_nUpdates++;
 }
 
@@ -267,7 +501,8 @@ void MfcJsonObj::arrayAdd(const string& sVal)
 {
     _makeType(JSON_T_ARRAY);
 
-    MfcJsonObj* pStr = new MfcJsonObj(sVal);
+    MfcJsonObj* pStr = _newChild(JSON_T_STRING);
+    pStr->m_sVal = sVal;
     m_vArray.push_back(pStr);
     m_nUpdates++;
 }
@@ -285,119 +520,176 @@ void MfcJsonObj::arrayAdd(MfcJsonObj* pObj)
 void MfcJsonObj::arrayAdd(const MfcJsonObj& jsVal)
 {
     _makeType(JSON_T_ARRAY);
-    m_vArray.push_back(new MfcJsonObj(jsVal));
+
+    MfcJsonObj* pObj = _newChild(JSON_T_NULL);
+    pObj->_copyFrom(jsVal);
+    m_vArray.push_back(pObj);
     m_nUpdates++;
 }
 
-void MfcJsonObj::objectRemove(const string& sKey)
+size_t MfcJsonObj::_objectFind(const string& sKey, bool& fFound) const
 {
-    map< string,MfcJsonObj* >::iterator i;
-    if (isObject())
+    size_t nLo = 0, nHi = m_vObj.size();
+
+    fFound = false;
+
+    while (nLo < nHi)
     {
-        if ((i = m_mObj.find(sKey)) != m_mObj.end())
+        size_t nMid = nLo + (nHi - nLo) / 2;
+        int nCmp = _keyCompare(m_vObj[nMid].first, sKey);
+
+        if (nCmp < 0)
+            nLo = nMid + 1;
+        else if (nCmp > 0)
+            nHi = nMid;
+        else
         {
-            MfcJsonObj* pObj = i->second;
-            m_mObj.erase(i);
-            delete pObj;
-            m_nUpdates++;
+            fFound = true;
+            return nMid;
         }
     }
+
+    return nLo;
 }
 
-bool MfcJsonObj::objectAdd(const string& sKey, int64_t nVal, bool fReplace)
+// Adds pObj under sKey, taking ownership of it. Returns false without taking ownership if sKey is already
+// present and fReplace is false.
+bool MfcJsonObj::_objectInsert(const string& sKey, MfcJsonObj* pObj, bool fReplace)
 {
-    _makeType(JSON_T_OBJECT);
+    bool fFound = false;
+    size_t nPos;
 
-    if (fReplace)
-        objectRemove(sKey);
+    _makeType(JSON_T_OBJECT);
 
-    if (m_mObj.find(sKey) == m_mObj.end())
+    nPos = _objectFind(sKey, fFound);
+    if (fFound)
     {
-        m_mObj[sKey] = new MfcJsonObj(nVal);
-        m_nUpdates++;
+        if (!fReplace)
+            return false;
 
-        return true;
+        _freeChild(m_vObj[nPos].second);
+        m_vObj[nPos].second = pObj;
+    }
+    else
+    {
+        MfcJsonPair pair;
+        pair.first = _arena()->intern(sKey.data(), sKey.size());
+        pair.second = pObj;
+        m_vObj.insert(m_vObj.begin() + nPos, pair);
     }
 
-    return false;
+    m_nUpdates++;
+    return true;
 }
 
-bool MfcJsonObj::objectAdd(const string& sKey, double dVal, bool fReplace)
+void MfcJsonObj::_objectSort(void)
 {
-    _makeType(JSON_T_OBJECT);
+    if (m_vObj.size() < 2)
+        return;
+
+    // Objects off the wire are small, and an insertion sort doesn't need stable_sort()'s scratch buffer
+    if (m_vObj.size() <= 32)
+    {
+        for (size_t n = 1; n < m_vObj.size(); n++)
+        {
+            MfcJsonPair pair = m_vObj[n];
+            size_t nPos = n;
+
+            for ( ; nPos > 0 && _keyLess(pair, m_vObj[nPos - 1]); nPos--)
+                m_vObj[nPos] = m_vObj[nPos - 1];
 
-    if (fReplace)
-        objectRemove(sKey);
+            m_vObj[nPos] = pair;
+        }
+    }
+    else stable_sort(m_vObj.begin(), m_vObj.end(), _keyLess);
 
-    if (m_mObj.find(sKey) == m_mObj.end())
+    // For duplicate keys, the last one parsed wins
+    size_t nOut = 0;
+    for (size_t n = 0; n < m_vObj.size(); n++)
     {
-        m_mObj[sKey] = new MfcJsonObj(dVal);
-        m_nUpdates++;
+        if (n + 1 < m_vObj.size() && !_keyLess(m_vObj[n], m_vObj[n + 1]))
+            _freeChild(m_vObj[n].second);
+        else
+            m_vObj[nOut++] = m_vObj[n];
+    }
+    m_vObj.resize(nOut);
+}
 
-        return true;
+void MfcJsonObj::objectRemove(const string& sKey)
+{
+    bool fFound = false;
+    size_t nPos;
+
+    if (isObject())
+    {
+        nPos = _objectFind(sKey, fFound);
+        if (fFound)
+        {
+            _freeChild(m_vObj[nPos].second);
+            m_vObj.erase(m_vObj.begin() + nPos);
+            m_nUpdates++;
+        }
     }
+}
 
-    return false;
+bool MfcJsonObj::objectAdd(const string& sKey, int64_t nVal, bool fReplace)
+{
+    _makeType(JSON_T_OBJECT);                       // before allocating, so a clear() can't reset the arena under us
+
+    if (!fReplace && objectHas(sKey))
+        return false;
+
+    MfcJsonObj* pObj = _newChild(JSON_T_INTEGER);
+    pObj->m_nVal = nVal;
+
+    return _objectInsert(sKey, pObj, true);
 }
 
-bool MfcJsonObj::objectAdd(const string& sKey, bool fVal, bool fReplace)
+bool MfcJsonObj::objectAdd(const string& sKey, double dVal, bool fReplace)
 {
-    _makeType(JSON_T_OBJECT);
+    _makeType(JSON_T_OBJECT);                       // before allocating, so a clear() can't reset the arena under us
 
-    if (fReplace)
-        objectRemove(sKey);
+    if (!fReplace && objectHas(sKey))
+        return false;
 
-    if (m_mObj.find(sKey) == m_mObj.end())
-    {
-        m_mObj[sKey] = new MfcJsonObj(fVal);
-        m_nUpdates++;
+    MfcJsonObj* pObj = _newChild(JSON_T_FLOAT);
+    pObj->m_dVal = dVal;
 
-        return true;
-    }
+    return _objectInsert(sKey, pObj, true);
+}
 
-    return false;
+bool MfcJsonObj::objectAdd(const string& sKey, bool fVal, bool fReplace)
+{
+    _makeType(JSON_T_OBJECT);                       // before allocating, so a clear() can't reset the arena under us
+
+    if (!fReplace && objectHas(sKey))
+        return false;
+
+    MfcJsonObj* pObj = _newChild(JSON_T_BOOLEAN);
+    pObj->m_fVal = fVal;
+
+    return _objectInsert(sKey, pObj, true);
 }
 
 bool MfcJsonObj::objectAdd(const string& sKey, const string& sVal, bool fReplace)
 {
-    _makeType(JSON_T_OBJECT);
+    _makeType(JSON_T_OBJECT);                       // before allocating, so a clear() can't reset the arena under us
 
-    if (fReplace)
-        objectRemove(sKey);
+    if (!fReplace && objectHas(sKey))
+        return false;
 
-    if (m_mObj.find(sKey) == m_mObj.end())
-    {
-        MfcJsonObj* pStr = new MfcJsonObj(sVal);
-        m_mObj[sKey] = pStr;
-        m_nUpdates++;
+    MfcJsonObj* pStr = _newChild(JSON_T_STRING);
+    pStr->m_sVal = sVal;
 
-        return true;
-    }
-
-    return false;
+    return _objectInsert(sKey, pStr, true);
 }
 
 bool MfcJsonObj::objectAdd(const string& sKey, MfcJsonObj* pObj, bool fReplace)
 {
     if (pObj)
     {
-        _makeType(JSON_T_OBJECT);
-
-        if (fReplace)
-            objectRemove(sKey);
-
-        if (m_mObj.find(sKey) == m_mObj.end())
-        {
-            m_mObj[sKey] = pObj;
-            m_nUpdates++;
-
-            return true;
-        }
-        else
-        {
-            //Duplicate key found. Just retain original value.
-            return false;
-        }
+        //Duplicate key found when fReplace is false. Just retain original value.
+        return _objectInsert(sKey, pObj, fReplace);
     }
     else
     {
@@ -407,20 +699,15 @@ bool MfcJsonObj::objectAdd(const string& sKey, MfcJsonObj* pObj, bool fReplace)
 
 bool MfcJsonObj::objectAdd(const string& sKey, const MfcJsonObj& json, bool fReplace)
 {
-    _makeType(JSON_T_OBJECT);
+    _makeType(JSON_T_OBJECT);                       // before allocating, so a clear() can't reset the arena under us
 
-    if (fReplace)
-        objectRemove(sKey);
+    if (!fReplace && objectHas(sKey))
+        return false;
 
-    if (m_mObj.find(sKey) == m_mObj.end())
-    {
-        m_mObj[sKey] = new MfcJsonObj(json);
-        m_nUpdates++;
-
-        return true;
-    }
+    MfcJsonObj* pObj = _newChild(JSON_T_NULL);
+    pObj->_copyFrom(json);
 
-    return false;
+    return _objectInsert(sKey, pObj, true);
 }
 
 size_t MfcJsonObj::arrayRead(unordered_set< uint32_t >& stVals) const
@@ -582,6 +869,22 @@ size_t MfcJsonObj::arrayWrite(const vector< string >& vVals)
     return m_vArray.size();
 }
 
+MfcJsonObj* MfcJsonObj::objectGet(const string& sKey) const
+{
+    MfcJsonObj* pRet = NULL;
+    bool fFound = false;
+    size_t nPos;
+
+    if (isObject())
+    {
+        nPos = _objectFind(sKey, fFound);
+        if (fFound)
+            pRet = m_vObj[nPos].second;
+    }
+
+    return pRet;
+}
+
 // Convert to and from 32bit <-> 64bit to avoid rebuilding many structs
 bool MfcJsonObj::objectGetInt(const string& sKey, int32_t& nVal) const
 {
@@ -594,17 +897,11 @@ bool MfcJsonObj::objectGetInt(const string& sKey, int32_t& nVal) const
 
 bool MfcJsonObj::objectGetInt(const string& sKey, int64_t& nVal) const
 {
-    if (isObject())
+    MfcJsonObj* pObj = objectGet(sKey);
+    if (pObj && pObj->isInt())
     {
-        map< string,MfcJsonObj* >::const_iterator i = m_mObj.find(sKey);
-        if (i != m_mObj.end())
-        {
-            if (i->second->isInt())
-            {
-                nVal = i->second->m_nVal;
-                return true;
-            }
-        }
+        nVal = pObj->m_nVal;
+        return true;
     }
 
     return false;
@@ -612,17 +909,11 @@ bool MfcJsonObj::objectGetInt(const string& sKey, int64_t& nVal) const
 
 bool MfcJsonObj::objectGetBool(const string& sKey, bool& fVal) const
 {
-    if (isObject())
+    MfcJsonObj* pObj = objectGet(sKey);
+    if (pObj && pObj->isBoolean())
     {
-        map< string,MfcJsonObj* >::const_iterator i = m_mObj.find(sKey);
-        if (i != m_mObj.end())
-        {
-            if (i->second->isBoolean())
-            {
-                fVal = i->second->m_fVal;
-                return true;
-            }
-        }
+        fVal = pObj->m_fVal;
+        return true;
     }
 
     return false;
@@ -630,17 +921,11 @@ bool MfcJsonObj::objectGetBool(const string& sKey, bool& fVal) const
 
 bool MfcJsonObj::objectGetFloat(const string& sKey, double& dVal) const
 {
-    if (isObject())
+    MfcJsonObj* pObj = objectGet(sKey);
+    if (pObj && pObj->isFloat())
     {
-        map< string,MfcJsonObj* >::const_iterator i = m_mObj.find(sKey);
-        if (i != m_mObj.end())
-        {
-            if (i->second->isFloat())
-            {
-                dVal = i->second->m_dVal;
-                return true;
-            }
-        }
+        dVal = pObj->m_dVal;
+        return true;
     }
 
     return false;
@@ -648,17 +933,11 @@ bool MfcJsonObj::objectGetFloat(const string& sKey, double& dVal) const
 
 bool MfcJsonObj::objectGetString(const string& sKey, string& sVal) const
 {
-    if (isObject())
+    MfcJsonObj* pObj = objectGet(sKey);
+    if (pObj && pObj->isString())
     {
-        map< string,MfcJsonObj* >::const_iterator i = m_mObj.find(sKey);
-        if (i != m_mObj.end())
-        {
-            if (i->second->isString())
-            {
-                sVal =i->second->m_sVal;
-                return true;
-            }
-        }
+        sVal = pObj->m_sVal;
+        return true;
     }
 
     return false;
@@ -666,31 +945,23 @@ bool MfcJsonObj::objectGetString(const string& sKey, string& sVal) const
 
 bool MfcJsonObj::objectGetObject(const string& sKey, MfcJsonObj** ppVal) const
 {
-    if (isObject())
+    MfcJsonObj* pObj = objectGet(sKey);
+    if (pObj)
     {
-        map< string,MfcJsonObj* >::const_iterator i = m_mObj.find(sKey);
-        if (i != m_mObj.end())
-        {
-            *ppVal = i->second;
-            return true;
-        }
-        //else _MESG("key %s not found!", sKey.c_str());
+        *ppVal = pObj;
+        return true;
     }
-    //else _MESG("isObject() failed!");
 
     return false;
 }
 
 bool MfcJsonObj::objectGetObject(const string& sKey, MfcJsonObj& jsVal) const
 {
-    if (isObject())
+    MfcJsonObj* pObj = objectGet(sKey);
+    if (pObj)
     {
-        map< string,MfcJsonObj* >::const_iterator i = m_mObj.find(sKey);
-        if (i != m_mObj.end())
-        {
-            jsVal = *(i->second);
-            return true;
-        }
+        jsVal = *pObj;
+        return true;
     }
 
     return false;
@@ -701,8 +972,8 @@ size_t MfcJsonObj::objectReadKeys(vector< string >& vKeys) const
     vKeys.clear();
 
     if (isObject())
-        for (map< string,MfcJsonObj* >::const_iterator i = m_mObj.begin(); i != m_mObj.end(); ++i)
-            vKeys.push_back(i->first);
+        for (MfcJsonIter i = m_vObj.begin(); i != m_vObj.end(); ++i)
+            vKeys.push_back(string(i->first, MfcJsonArena::keyLen(i->first)));
 
     return vKeys.size();
 }
@@ -712,9 +983,9 @@ size_t MfcJsonObj::objectRead(map< string,int64_t >& mVals) const
     mVals.clear();
 
     if (isObject())
-        for (map< string,MfcJsonObj* >::const_iterator i = m_mObj.begin(); i != m_mObj.end(); ++i)
+        for (MfcJsonIter i = m_vObj.begin(); i != m_vObj.end(); ++i)
             if (i->second->isInt())
-                mVals[i->first] = i->second->m_nVal;
+                mVals[string(i->first, MfcJsonArena::keyLen(i->first))] = i->second->m_nVal;
 
     return mVals.size();
 }
@@ -724,9 +995,9 @@ size_t MfcJsonObj::objectRead(map< string,string >& mVals) const
     mVals.clear();
 
     if (isObject())
-        for (map< string,MfcJsonObj* >::const_iterator i = m_mObj.begin(); i != m_mObj.end(); ++i)
+        for (MfcJsonIter i = m_vObj.begin(); i != m_vObj.end(); ++i)
             if (i->second->isString())
-                mVals[i->first] = i->second->m_sVal;
+                mVals[string(i->first, MfcJsonArena::keyLen(i->first))] = i->second->m_sVal;
 
     return mVals.size();
 }
@@ -736,7 +1007,7 @@ size_t MfcJsonObj::objectWrite(const map< string,int64_t >& mVals)
     for (map< string,int64_t >::const_iterator i = mVals.begin(); i != mVals.end(); ++i)
         objectAdd(i->first, i->second);
 
-    return m_mObj.size();
+    return m_vObj.size();
 }
 
 size_t MfcJsonObj::objectWrite(const map< string,string >& mVals)
@@ -744,35 +1015,72 @@ size_t MfcJsonObj::objectWrite(const map< string,string >& mVals)
     for (map< string,string >::const_iterator i = mVals.begin(); i != mVals.end(); ++i)
         objectAdd(i->first, i->second);
 
-    return m_mObj.size();
+    return m_vObj.size();
 }
 
 const string& MfcJsonObj::Serialize(int nOpt)
 {
+    if (m_psThisSerialized == NULL)
+        m_psThisSerialized = new string();
+
     if (m_nUpdates > 0)
     {
-        Serialize(m_sThisSerialized, nOpt);
+        Serialize(*m_psThisSerialized, nOpt);
         m_nUpdates = 0;
     }
 
-    return m_sThisSerialized;
+    return *m_psThisSerialized;
 }
 
 size_t MfcJsonObj::Serialize(string& str, int nOpt) const
 {
-    string str2;
-    int nCx;
-
     str.clear();
+    _serialize(str, nOpt);
 
-    if (m_dwType == JSON_T_OBJECT)
+    return str.size();
+}
+
+// Same escaping as EscapeString(), appended in place rather than built up in an ostringstream
+static void _escapeAppend(string& str, const char* pch, size_t nLen)
+{
+    size_t nRun = 0;
+
+    for (size_t n = 0; n < nLen; n++)
     {
-        map< string,MfcJsonObj* >::const_iterator i;
+        const char* pszEsc = NULL;
+
+        switch (pch[n])
+        {
+            case '\\': pszEsc = "\\\\"; break;
+            case '"':  pszEsc = "\\\""; break;
+            case '/':  pszEsc = "\\/";  break;
+            case '\b': pszEsc = "\\b";  break;
+            case '\f': pszEsc = "\\f";  break;
+            case '\n': pszEsc = "\\n";  break;
+            case '\r': pszEsc = "\\r";  break;
+            case '\t': pszEsc = "\\t";  break;
+        }
+
+        if (pszEsc)
+        {
+            str.append(pch + nRun, n - nRun);
+            str.append(pszEsc, 2);
+            nRun = n + 1;
+        }
+    }
+
+    str.append(pch + nRun, nLen - nRun);
+}
+
+void MfcJsonObj::_serialize(string& str, int nOpt) const
+{
+    int nCx;
 
+    if (m_dwType == JSON_T_OBJECT)
+    {
         str += "{";
 
-        nCx = 0;
-        for (i = m_mObj.begin(); i != m_mObj.end(); ++i)
+        for (nCx = 0; nCx < (int)m_vObj.size(); nCx++)
         {
             if (nCx > 0)
                 str += ",";
@@ -791,16 +1099,15 @@ size_t MfcJsonObj::Serialize(string& str, int nOpt) const
 
 
             // Serialize key name
-            str += "\"" + EscapeString(i->first) + "\":";
+            str += "\"";
+            _escapeAppend(str, m_vObj[nCx].first, MfcJsonArena::keyLen(m_vObj[nCx].first));
+            str += "\":";
 
             if (nOpt >= JSOPT_PRETTY)
                 str += " ";             // Space after : in key: value output
 
             // Serialize value
-            str2 = "null";
-            i->second->Serialize(str2, nOpt < JSOPT_PRETTY ? nOpt : nOpt + 1);
-            str += str2;
-            nCx++;
+            m_vObj[nCx].second->_serialize(str, nOpt < JSOPT_PRETTY ? nOpt : nOpt + 1);
         }
 
         if (nOpt >= JSOPT_PRETTY)
@@ -833,9 +1140,7 @@ size_t MfcJsonObj::Serialize(string& str, int nOpt) const
             }
 
             // Serialize value
-            str2 = "null";
-            m_vArray[nCx]->Serialize(str2, nOpt < JSOPT_PRETTY ? nOpt : nOpt + 1);
-            str += str2;
+            m_vArray[nCx]->_serialize(str, nOpt < JSOPT_PRETTY ? nOpt : nOpt + 1);
         }
 
         if (nOpt >= JSOPT_PRETTY)
@@ -848,7 +1153,9 @@ size_t MfcJsonObj::Serialize(string& str, int nOpt) const
     }
     else if (m_dwType == JSON_T_INTEGER)
     {
-        str += stdprintf("%" INT64_FMT, m_nVal);
+        char szVal[32];
+        snprintf(szVal, sizeof(szVal), "%" INT64_FMT, m_nVal);
+        str += szVal;
     }
     else if (m_dwType == JSON_T_FLOAT)
     {
@@ -863,21 +1170,64 @@ size_t MfcJsonObj::Serialize(string& str, int nOpt) const
         if (nOpt == JSOPT_RAW)
             str += m_sVal;
         else
-            str += "\"" + EscapeString(m_sVal) + "\"";
+        {
+            str += "\"";
+            _escapeAppend(str, m_sVal.data(), m_sVal.size());
+            str += "\"";
+        }
     }
     else if (m_dwType == JSON_T_NULL)
     {
         str += "null";
     }
+}
 
-    return str.size();
+// State threaded through _processJson() while deserializing. Children of the open containers are staged in
+// vPending and moved into their container in one go when it closes (see _closeContainer()), so each container
+// allocates its child vector once at the right size instead of growing it a value at a time.
+struct MfcJsonParseCtx
+{
+    vector< MfcJsonObj* > vStack;               // containers we are currently inside of, root first
+    vector< size_t > vStart;                    // where each container in vStack starts in vPending
+    vector< MfcJsonPair > vPending;             // children (and their keys, for objects) not yet in their container
+    const char* pszKey;                         // key for the next value added to an object, interned in its arena
+};
+
+// Moves the staged children of the innermost open container into it and pops it off the stack. Objects are
+// sorted at this point, which also resolves duplicate keys.
+void MfcJsonObj::_closeContainer(MfcJsonParseCtx* pParse)
+{
+    MfcJsonObj* pObj = pParse->vStack.back();
+    size_t nStart = pParse->vStart.back();
+    size_t nCount = pParse->vPending.size() - nStart;
+
+    if (nCount > 0)
+    {
+        if (pObj->isObject())
+        {
+            pObj->m_vObj.insert(pObj->m_vObj.end(), pParse->vPending.begin() + nStart, pParse->vPending.end());
+            pObj->_objectSort();
+        }
+        else
+        {
+            pObj->m_vArray.reserve(pObj->m_vArray.size() + nCount);
+            for (size_t n = nStart; n < pParse->vPending.size(); n++)
+                pObj->m_vArray.push_back(pParse->vPending[n].second);
+        }
+
+        pObj->m_nUpdates += nCount;
+        pParse->vPending.resize(nStart);
+    }
+
+    pParse->vStack.pop_back();
+    pParse->vStart.pop_back();
 }
 
 bool MfcJsonObj::Deserialize(const BYTE* pData, size_t nLen)
 {
     struct JSON_parser_struct* jc = NULL;
     JSON_config config;
-    MfcJsonStack jsStack;
+    MfcJsonParseCtx ctx;
     bool fRet = false;
     size_t nCx = 0;
 
@@ -885,7 +1235,12 @@ bool MfcJsonObj::Deserialize(const BYTE* pData, size_t nLen)
     clear();
 
     // add ourselves to stack
-    jsStack.push(this);
+    ctx.vStack.reserve(8);
+    ctx.vStart.reserve(8);
+    ctx.vPending.reserve(64);
+    ctx.vStack.push_back(this);
+    ctx.vStart.push_back(0);
+    ctx.pszKey = NULL;
 
     if (nLen > 0)
     {
@@ -895,7 +1250,7 @@ bool MfcJsonObj::Deserialize(const BYTE* pData, size_t nLen)
         config.callback               = MfcJsonObj::_processJson;
         config.allow_comments         = 1;
         config.handle_floats_manually = 1;
-        config.callback_ctx             = (void*)&jsStack;
+        config.callback_ctx             = (void*)&ctx;
 
         jc = new_JSON_parser(&config);
 
@@ -911,6 +1266,11 @@ bool MfcJsonObj::Deserialize(const BYTE* pData, size_t nLen)
 
         delete_JSON_parser(jc);
 
+        // The root is never popped by _processJson(), and if we stopped early neither is anything under it.
+        // Close them all, innermost first, so partial results end up in the tree just like complete ones.
+        while (!ctx.vStack.empty())
+            _closeContainer(&ctx);
+
         if (nCx < nLen)
         {
             _MESG("Error in json decode, nCx[%d] < nLen[%d]: data: '%s'", (int)nCx, (int)nLen, string((const char*)pData, nLen).c_str());
@@ -924,23 +1284,23 @@ bool MfcJsonObj::Deserialize(const BYTE* pData, size_t nLen)
 
 int MfcJsonObj::_processJson(void* pCtx, int nType, const JSON_value* pValue)
 {
-    MfcJsonStack* pStack = (MfcJsonStack*)pCtx;
+    MfcJsonParseCtx* pParse = (MfcJsonParseCtx*)pCtx;
 
-    if (pStack == NULL || pStack->size() < 1)
+    if (pParse == NULL || pParse->vStack.size() < 1)
     {
-        _MESG("Unable to process, null MfcJsonStack ptr or size 0");
+        _MESG("Unable to process, null MfcJsonParseCtx ptr or stack size 0");
         return 0;
     }
 
-    MfcJsonObj* pCur = pStack->top();
+    MfcJsonObj* pCur = pParse->vStack.back();
     int nRet = 1;
 
     // handle non-value state changes first
 
     if (nType == JSON_T_ARRAY_END || nType == JSON_T_OBJECT_END)
     {
-        if (pStack->size() > 1)         // pop off top from stack as long as that won't remove root object
-            pStack->pop();
+        if (pParse->vStack.size() > 1)  // pop off top from stack as long as that won't remove root object
+            _closeContainer(pParse);
 
         return nRet;
     }
@@ -951,12 +1311,12 @@ int MfcJsonObj::_processJson(void* pCtx, int nType, const JSON_value* pValue)
         {
             if(pValue->vu.str.value != NULL)
             {
-                pCur->m_lastDeserializedKey = pValue->vu.str.value;
+                pParse->pszKey = pCur->_arena()->intern(pValue->vu.str.value, pValue->vu.str.length);
             }
             else
             {
                 _MESG("Unable to save JSON key. Key is NULL.");
-                pCur->m_lastDeserializedKey = "";
+                pParse->pszKey = NULL;
                 nRet = 0;
             }
         }
@@ -967,7 +1327,7 @@ int MfcJsonObj::_processJson(void* pCtx, int nType, const JSON_value* pValue)
             else
                 _MESG("Unable to save JSON key, parent not an object (also, key is NULL).");
 
-            pCur->m_lastDeserializedKey = "";
+            pParse->pszKey = NULL;
             nRet = 0;
         }
 
@@ -977,20 +1337,19 @@ int MfcJsonObj::_processJson(void* pCtx, int nType, const JSON_value* pValue)
     //
     // Create new value
     //
-    MfcJsonObj* pChild = new MfcJsonObj((JSON_type)nType);
+    MfcJsonObj* pChild = NULL;
 
     if (nType == JSON_T_ARRAY_BEGIN || nType == JSON_T_OBJECT_BEGIN)
     {
         // If array or object and pCur->isNull, use root note instead of creating new instance
-        if (pCur->isNull() && pStack->size() == 1)
+        if (pCur->isNull() && pParse->vStack.size() == 1)
         {
-            delete pChild;                                  // delete child we previously created, we're using parent container
             pCur->_makeType((JSON_type)nType);              // make parent container of our new type
             pChild = pCur;                                  // set child to parent container ptr
         }
         else
         {
-            pStack->push(pChild);                           // not root, so add child to stack
+            pChild = pCur->_newChild((JSON_type)nType);     // not root, pushed on the stack once added to pCur below
         }
     }
 
@@ -998,22 +1357,31 @@ int MfcJsonObj::_processJson(void* pCtx, int nType, const JSON_value* pValue)
     // Or else set value of non-container types
     //
     else if (nType == JSON_T_INTEGER)
-        pChild->setInt((int64_t)pValue->vu.integer_value);
+    {
+        pChild = pCur->_newChild(JSON_T_INTEGER);
+        pChild->m_nVal = (int64_t)pValue->vu.integer_value;
+    }
 
     else if (nType == JSON_T_FLOAT)
-        pChild->setFloat(atof(pValue->vu.str.value));
+    {
+        pChild = pCur->_newChild(JSON_T_FLOAT);
+        pChild->m_dVal = atof(pValue->vu.str.value);
+    }
 
     else if (nType == JSON_T_NULL)
-        pChild->setNull();
-
-    else if (nType == JSON_T_TRUE)
-        pChild->setBoolean(true);
+        pChild = pCur->_newChild(JSON_T_NULL);
 
-    else if (nType == JSON_T_FALSE)
-        pChild->setBoolean(false);
+    else if (nType == JSON_T_TRUE || nType == JSON_T_FALSE)
+    {
+        pChild = pCur->_newChild(JSON_T_BOOLEAN);
+        pChild->m_fVal = (nType == JSON_T_TRUE);
+    }
 
     else if (nType == JSON_T_STRING)
-        pChild->setString(string(pValue->vu.str.value));
+    {
+        pChild = pCur->_newChild(JSON_T_STRING);
+        pChild->m_sVal.assign(pValue->vu.str.value, pValue->vu.str.length);
+    }
 
     else
     {
@@ -1028,38 +1396,47 @@ int MfcJsonObj::_processJson(void* pCtx, int nType, const JSON_value* pValue)
     {
         if (pCur->isObject())                                   // Add value to container object
         {
-            if (pCur->m_lastDeserializedKey == "")              // make sure we have a key to add it under
+            if (pParse->pszKey == NULL)                         // make sure we have a key to add it under
             {
                 _MESG("Unable to save %s value, no key to associate with in parent object!", MapJsonType(nType));
                 nRet = 0;
             }
             else
             {
-                bool success = pCur->objectAdd(pCur->m_lastDeserializedKey, pChild);    // add value with given key
-
-                if(!success)
-                    _MESG("Unable to save duplicate key '%s'; parent already had key defined.", pCur->m_lastDeserializedKey.c_str());
+                // Staged until the object closes, duplicates and order are sorted out then
+                MfcJsonPair pair;
+                pair.first = pParse->pszKey;
+                pair.second = pChild;
+                pParse->vPending.push_back(pair);
 
-                pCur->m_lastDeserializedKey = "";
+                pParse->pszKey = NULL;
             }
         }
 
         else if (pCur->isArray())                               // .. or add to container vector
-            pCur->arrayAdd(pChild);
+        {
+            MfcJsonPair pair;
+            pair.first = NULL;
+            pair.second = pChild;
+            pParse->vPending.push_back(pair);
+        }
 
         else                                                    // is parent not a container?
         {
             _MESG("Unable to save %s value, parent type %s is not a container!", MapJsonType(nType), MapJsonType(pCur->m_dwType));
             nRet = 0;
         }
+
+        if (nRet == 1 && (nType == JSON_T_ARRAY_BEGIN || nType == JSON_T_OBJECT_BEGIN))
+        {
+            pParse->vStack.push_back(pChild);                   // new container, following values go in it
+            pParse->vStart.push_back(pParse->vPending.size());
+        }
     }
 
-    if (nRet == 0)                                              // some problem with new value, remove from stack (if present) and delete, return error
+    if (nRet == 0 && pChild && pChild != pCur)                  // some problem with new value, delete it, return error
     {
-        if (pStack->top() == pChild)
-            pStack->pop();
-
-        delete pChild;
+        _freeChild(pChild);
         pChild = NULL;
     }
 
@@ -1072,20 +1449,22 @@ size_t MfcJsonObj::objectQueryString(string& sOut, bool fIncludeQuestionMark)
 
     if (isObject())
     {
-        for (map< string,MfcJsonObj* >::const_iterator i = m_mObj.begin(); i != m_mObj.end(); ++i)
+        for (MfcJsonIter i = m_vObj.begin(); i != m_vObj.end(); ++i)
         {
             if (i->second->isArray() == false && i->second->isObject() == false)
             {
-                string sFirst, sSecond;
+                string sFirst, sSecond, sVal;
 
                 if (sOut.size() > 0)                // string already has some data? speerate with '&'
                     sOut += "&";
                 else if (fIncludeQuestionMark)      // beginning of string? if question mark requested, add it
                     sOut += "?";
 
-                sOut += encodeURIComponent(i->first, sFirst);
+                i->second->Serialize(sVal, JSOPT_RAW);
+
+                sOut += encodeURIComponent(string(i->first, MfcJsonArena::keyLen(i->first)), sFirst);
                 sOut += "=";
-                sOut += encodeURIComponent(i->second->Serialize(JSOPT_RAW), sSecond);
+                sOut += encodeURIComponent(sVal, sSecond);
             }
         }
     }
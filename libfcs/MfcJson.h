@@ -50,13 +50,23 @@ using namespace std;
 #endif
 
 class MfcJsonObj;
+class MfcJsonArena;
+struct MfcJsonParseCtx;
 
 // used to track state information about where in a json tree we are during decoding
 typedef stack< MfcJsonObj* > MfcJsonStack;
 
-// used for walking through m_mObj to enum all nodes in a json object container (only for JSON_T_OBJECT types)
+// key:value entry of a JSON_T_OBJECT container. m_vObj keeps these sorted by key, and the key is interned
+// in the arena of the document that owns the container, so it stays valid for as long as the entry does.
+struct MfcJsonPair
+{
+    const char* first;                          // interned key (NUL terminated)
+    MfcJsonObj* second;                         // value
+};
+
+// used for walking through m_vObj to enum all nodes in a json object container (only for JSON_T_OBJECT types)
 // a const interator used, client should not attempt editing tree, for reading data only
-typedef map< string,MfcJsonObj* >::const_iterator MfcJsonIter;
+typedef vector< MfcJsonPair >::const_iterator MfcJsonIter;
 
 typedef MfcJsonObj* MfcJsonPtr;
 
@@ -116,12 +126,7 @@ public:
     const MfcJsonObj& operator=(double dVal)      { setFloat(dVal);   return *this; }
     const MfcJsonObj& operator=(bool fVal)        { setBoolean(fVal); return *this; }
 
-    virtual ~MfcJsonObj()
-    {
-        clear();
-        free(m_pszFloatPrecisionFmt);               // stores optional override for floating point format precision
-        m_pszFloatPrecisionFmt = NULL;
-    }
+    virtual ~MfcJsonObj();
 
     static MfcJsonObj* newType(JSON_type jsType)
     {
@@ -164,11 +169,7 @@ public:
 
     bool objectHas(const string& sKey) const
     {
-        if (isObject())
-            if (m_mObj.find(sKey) != m_mObj.end())
-                return true;
-
-        return false;
+        return (objectGet(sKey) != NULL);
     }
 
     bool isNull(void) const                 { return m_dwType == JSON_T_NULL;                       }
@@ -191,7 +192,7 @@ public:
     void setNull(void)                      { _makeType(JSON_T_NULL);                               }
 
     size_t arrayLen(void) const             { return (isArray() ? m_vArray.size() : 0);             }
-    size_t objectLen(void) const            { return (isObject() ? m_mObj.size() : 0);              }
+    size_t objectLen(void) const            { return (isObject() ? m_vObj.size() : 0);              }
 
     // Clears existing data if not JSON_T_ARRAY, adds a value to container m_vArray
     void arrayAdd(int64_t nVal);
@@ -210,7 +211,7 @@ public:
     void arrayAdd(size_t nVal) { arrayAdd((int64_t)nVal); }
 #endif
 
-    // Clears existing data if not JSON_T_OBJECT, then adds a key:value pair to container m_mObj, deleting old value first,
+    // Clears existing data if not JSON_T_OBJECT, then adds a key:value pair to container m_vObj, deleting old value first,
     // if found and fReplace == true.  the MfcJsonObj* version of objectAdd() assumes it now OWNS pObj, so it will delete
     // pObj when it is done using it.  Do not pass in objects that arent created with new operator or referenced elsewhere.
     // Return true if add was successful (this is used when fReplace =  false to detect duplicate keys).
@@ -238,7 +239,7 @@ public:
 
     void objectRemove(const string& sKey);
 
-    // Sets val argument to typed values from m_mObj, if we are an object.
+    // Sets val argument to typed values from m_vObj, if we are an object.
     // returns true if key found and value set, otherwise false
 
 
@@ -254,17 +255,7 @@ public:
     bool objectGetInt(const string& sKey, uint64_t& qwVal) const { return objectGetInt(sKey, (int64_t&)qwVal); }
 
     // Returns node under key sKey if this instance is an object
-    MfcJsonObj* objectGet(const string& sKey) const
-    {
-        MfcJsonObj* pRet = NULL;
-        MfcJsonIter iObj;
-
-        if (isObject())
-            if ((iObj = m_mObj.find(sKey)) != m_mObj.end())
-                pRet = iObj->second;
-
-        return pRet;
-    }
+    MfcJsonObj* objectGet(const string& sKey) const;
 
     // Returns node at position nPos if this instance is an array
     MfcJsonObj* arrayAt(size_t nPos) const
@@ -315,12 +306,12 @@ public:
 
     MfcJsonIter objectEnum(void) const                          // Begin enumeration of JSON_T_OBJECT
     {
-        return isObject() ? m_mObj.begin() : m_mObj.end();
+        return isObject() ? m_vObj.begin() : m_vObj.end();
     }
 
-    bool objectEnd(MfcJsonIter& iObj) const                     // Test if iterator of m_mObj is at end
+    bool objectEnd(MfcJsonIter& iObj) const                     // Test if iterator of m_vObj is at end
     {
-        return (!isObject() || iObj == m_mObj.end() ? true : false);
+        return (!isObject() || iObj == m_vObj.end() ? true : false);
     }
 
     MfcJsonObj* objectAt(MfcJsonIter& iObj) const               // Return MfcJsonObj* for value of key at iObj iter position
@@ -363,7 +354,7 @@ public:
     //
     size_t Serialize(string& str, int nOpt = JSOPT_NORMAL) const;
 
-    // Wrapper for Serialize that returns string reference to m_sThisSerialized
+    // Wrapper for Serialize that returns string reference to m_psThisSerialized
     const string& Serialize(int nOpt = JSOPT_NORMAL);
 
     string prettySerialize(void) const
@@ -529,16 +520,34 @@ public:
     uint32_t m_dwType;                          // Type of data this object represents (JSON_T_OBJECT, JSON_T_INTEGER, etc)
 
     //
-    // data this object could represent
+    // data this object could represent, m_dwType says which of the scalar members is valid
     //
-    int64_t m_nVal;                             // Integer number
-    double m_dVal;                              // Floating point number
-    bool m_fVal;                                // Boolean value
+    union
+    {
+        int64_t m_nVal;                         // Integer number
+        double m_dVal;                          // Floating point number
+        bool m_fVal;                            // Boolean value
+    };
     string m_sVal;                              // String data
     vector< MfcJsonObj* > m_vArray;             // Vector of other json data items (array)
-    map< string,MfcJsonObj* > m_mObj;           // Map of other json data items (child object)
+    vector< MfcJsonPair > m_vObj;               // Key sorted vector of other json data items (child object)
 
 protected:
+    MfcJsonObj(MfcJsonArena* pArena, JSON_type jsType); // Initializes a child node living in pArena (see _newChild())
+
+    // Child nodes are carved out of an arena owned by the root of their document instead of being allocated one
+    // at a time, and object keys are interned in the same arena. Root nodes (on the stack, or from new) create
+    // their arena on first use; nodes handed to objectAdd()/arrayAdd() by pointer keep their own.
+    MfcJsonArena* _arena(void);
+    MfcJsonObj* _newChild(JSON_type jsType);    // Allocate an empty child node from our arena
+    static void _freeChild(MfcJsonObj* pObj);   // Destroy a child node, returning it to its arena or the heap
+
+    size_t _objectFind(const string& sKey, bool& fFound) const; // Position of sKey in m_vObj, or where it would go
+    bool _objectInsert(const string& sKey, MfcJsonObj* pObj, bool fReplace);
+    void _objectSort(void);                     // Sort m_vObj after deserializing, keeping the last of duplicate keys
+    void _clearChildren(void);                  // Frees all children without touching our arena
+
+    void _serialize(string& str, int nOpt) const;   // Appends serialized value to str
 
     void _makeType(uint32_t dwType)             // force an object to a given type, clearing it if the type changes
     {
@@ -551,14 +560,16 @@ protected:
 
     // static callback for JSON library code to call back into during deserialization when new value or state occurs
     static int _processJson(void* pCtx, int nType, const JSON_value* pValue);
+    static void _closeContainer(MfcJsonParseCtx* pParse);  // Hand staged children to the innermost open container
 
     void _copyFrom(const MfcJsonObj& src);      // Copy one MfcJsonObj to another (recursive deep copy)
     void _initialize(JSON_type jsType);         // Initialize empty or zere/false type var
 
-    char* m_pszFloatPrecisionFmt;               // if non-null, use this instead of %f for floating point precision in snprintf
+    MfcJsonArena* m_pArena;                     // arena children of this node are allocated from
+    bool m_fArenaNode;                          // true if this node itself lives in m_pArena, false if it owns m_pArena
 
-    string m_lastDeserializedKey;               // Stores key for each entry specified in a json object during deserialization.
+    char* m_pszFloatPrecisionFmt;               // if non-null, use this instead of %f for floating point precision in snprintf
 
     size_t m_nUpdates;                          // Count of updates to object since last Serialize() (newly constructed objects start with 1)
-    string m_sThisSerialized;                   // This json object serialized to a string, reference returned in Serialize()
+    string* m_psThisSerialized;                 // This json object serialized to a string, reference returned in Serialize(), created on first use
 };
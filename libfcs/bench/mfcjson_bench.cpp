@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2013-2020 MFCXY, Inc. <mfcxy@mfcxy.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/// mfcjson_bench: MfcJsonObj parse/build/serialize cost on FCS payloads.
+///
+/// For each payload (a built-in set captured from FCS traffic, or one payload
+/// per line of --payloads file), times and counts heap allocations for:
+///   parse      FcMsg::js() style: newType(JSON_T_OBJECT), Deserialize, delete
+///   lookup     objectGet*() on every key of the parsed payload
+///   envelope   FcMsg::js(): type/from/to/arg1/arg2 plus the parsed payload
+///   serialize  Serialize() of the parsed payload
+///
+/// Usage: mfcjson_bench [--iterations N] [--payloads file]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "MfcJson.h"
+
+using std::string;
+using std::vector;
+
+// Every heap allocation made by the process goes through here, so the counts
+// include the JSON parser, std::string/vector growth and the node storage.
+static size_t s_nAllocs = 0;
+static size_t s_nAllocBytes = 0;
+
+void* operator new(size_t nBytes)
+{
+    s_nAllocs++;
+    s_nAllocBytes += nBytes;
+
+    if (void* p = malloc(nBytes ? nBytes : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t nBytes, const std::nothrow_t&) noexcept
+{
+    s_nAllocs++;
+    s_nAllocBytes += nBytes;
+
+    return malloc(nBytes ? nBytes : 1);
+}
+
+void operator delete(void* p) noexcept                                  { free(p); }
+void operator delete(void* p, size_t) noexcept                          { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept           { free(p); }
+void* operator new[](size_t nBytes)                                     { return operator new(nBytes); }
+void* operator new[](size_t nBytes, const std::nothrow_t& nt) noexcept  { return operator new(nBytes, nt); }
+void operator delete[](void* p) noexcept                                { free(p); }
+void operator delete[](void* p, size_t) noexcept                        { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept         { free(p); }
+
+// FCS payloads as they come off the wire after URL decoding, with names, ids
+// and tokens replaced.
+static const char* const kSamplePayloads[] =
+{
+    // FCTYPE_LOGIN response
+    "{\"lv\":4,\"nm\":\"ModelName\",\"pid\":1,\"sid\":318451247,\"uid\":24318211,\"vs\":90,"
+    "\"u\":{\"age\":26,\"avatar\":1,\"blurb\":\"Hi there, welcome to my room!\",\"camserv\":1545,"
+    "\"chat_bg\":16777215,\"chat_color\":\"AF2BAF\",\"chat_font\":4,\"chat_opt\":1,\"city\":\"\","
+    "\"country\":\"US\",\"creation\":1466210511,\"ethnic\":\"Caucasian\",\"occupation\":\"\","
+    "\"photos\":58,\"profile\":1},"
+    "\"m\":{\"camscore\":4103.5,\"continent\":\"NA\",\"flags\":54288,\"hidecs\":false,\"kbit\":0,"
+    "\"lastnews\":1590532561,\"mg\":0,\"missmfc\":0,\"new_model\":0,\"rank\":0,\"rc\":143,\"sfw\":0,"
+    "\"topic\":\"Goal: 500 tokens for a song request #music #chill\"}}",
+
+    // FCTYPE_CMESG chat message
+    "{\"lv\":1,\"msg\":\"hello everyone :) how is the stream looking tonight?\",\"nm\":\"GuestUser8842\","
+    "\"sid\":318455931,\"uid\":31882401,\"vs\":0,\"u\":{\"chat_color\":\"000000\",\"chat_font\":0}}",
+
+    // FCTYPE_TOKENINC tip
+    "{\"ch\":124318211,\"flags\":64,\"m\":[24318211,0,\"ModelName\"],\"msg\":\"great show!\","
+    "\"sesstype\":2,\"stamp\":1590532874,\"tokens\":25,\"u\":[31882401,318455931,\"MemberName\"]}",
+
+    // FCTYPE_SESSIONSTATE user detail update
+    "{\"lv\":2,\"nm\":\"MemberName\",\"sid\":318455931,\"uid\":31882401,\"vs\":0,"
+    "\"u\":{\"avatar\":0,\"camserv\":0,\"chat_color\":\"3366CC\",\"chat_font\":1,\"chat_opt\":1,"
+    "\"creation\":1389314882,\"photos\":0,\"profile\":0}}",
+
+    // FCTYPE_TAGS
+    "{\"24318211\":[\"music\",\"chill\",\"gamer\",\"cosplay\",\"brunette\",\"talkative\"],"
+    "\"26111057\":[\"dancing\",\"fitness\",\"yoga\"],\"19800321\":[\"art\",\"painting\",\"asmr\",\"cozy\"]}",
+
+    // FCTYPE_ROOMDATA for a handful of models
+    "{\"countdown\":false,\"model\":24318211,\"models\":["
+    "{\"nm\":\"ModelName\",\"sid\":318451247,\"uid\":24318211,\"vs\":0,\"lv\":4,\"u\":{\"camserv\":1545,\"chat_color\":\"AF2BAF\"},\"m\":{\"camscore\":4103.5,\"rc\":143,\"topic\":\"song requests\"}},"
+    "{\"nm\":\"SecondModel\",\"sid\":318451998,\"uid\":26111057,\"vs\":0,\"lv\":4,\"u\":{\"camserv\":1602,\"chat_color\":\"0099FF\"},\"m\":{\"camscore\":2210.0,\"rc\":88,\"topic\":\"yoga stream\"}},"
+    "{\"nm\":\"ThirdModel\",\"sid\":318452310,\"uid\":19800321,\"vs\":90,\"lv\":4,\"u\":{\"camserv\":1497,\"chat_color\":\"FF6600\"},\"m\":{\"camscore\":1875.25,\"rc\":51,\"topic\":\"painting\"}},"
+    "{\"nm\":\"FourthModel\",\"sid\":318453002,\"uid\":28442117,\"vs\":0,\"lv\":4,\"u\":{\"camserv\":1520,\"chat_color\":\"CC0033\"},\"m\":{\"camscore\":960.75,\"rc\":22,\"topic\":\"just chatting\"}}"
+    "]}",
+
+    // Sidekick login (MFCPluginAPI / ObsBroadcast)
+    "{\"_err\":0,\"_msg\":\"\",\"sid\":318451247,\"uid\":24318211,\"streamkey\":\"ext_x_24318211.f4v\","
+    "\"videoserver\":\"video1545.myfreecams.com\",\"region\":\"us-east\",\"prot\":\"webrtc\","
+    "\"edgechat\":{\"url\":\"wss://edgechat.myfreecams.com/fcsl\",\"user\":\"ModelName\",\"tok\":\"3f9a1c7e5b2d48a6\"}}",
+
+    // EdgeChatSock query
+    "{\"_reqid\":1172,\"model\":24318211,\"reply\":true,\"query\":{\"cmd\":\"getprop\",\"val\":\"streamres\"}}",
+};
+
+struct BenchResult
+{
+    double dNsPerOp;
+    double dAllocsPerOp;
+    double dBytesPerOp;
+};
+
+template < typename Fn >
+static BenchResult runBench(int nIterations, Fn fn)
+{
+    fn();                                               // warm up
+
+    size_t nAllocs = s_nAllocs, nBytes = s_nAllocBytes;
+    auto tStart = std::chrono::steady_clock::now();
+
+    for (int n = 0; n < nIterations; n++)
+        fn();
+
+    auto tEnd = std::chrono::steady_clock::now();
+
+    BenchResult res;
+    res.dNsPerOp = std::chrono::duration< double, std::nano >(tEnd - tStart).count() / nIterations;
+    res.dAllocsPerOp = (double)(s_nAllocs - nAllocs) / nIterations;
+    res.dBytesPerOp = (double)(s_nAllocBytes - nBytes) / nIterations;
+    return res;
+}
+
+int main(int argc, char** argv)
+{
+    vector< string > vPayloads;
+    int nIterations = 20000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+
+        if (arg == "--iterations" && i + 1 < argc)
+        {
+            nIterations = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--payloads" && i + 1 < argc)
+        {
+            std::ifstream file(argv[++i], std::ios::binary);
+            string sLine;
+
+            if (!file)
+            {
+                fprintf(stderr, "Failed to read payload file: %s\n", argv[i]);
+                return 1;
+            }
+
+            while (std::getline(file, sLine))
+                if (!sLine.empty() && (sLine[0] == '{' || sLine[0] == '['))
+                    vPayloads.push_back(sLine);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--iterations N] [--payloads file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (vPayloads.empty())
+        vPayloads.assign(kSamplePayloads, kSamplePayloads + sizeof(kSamplePayloads) / sizeof(kSamplePayloads[0]));
+
+    BenchResult total[4] = {};
+    static const char* const kNames[4] = { "parse", "lookup", "envelope", "serialize" };
+
+    printf("%zu payloads, %d iterations\n", vPayloads.size(), nIterations);
+    printf("%-4s %6s  %-10s %10s %10s %10s\n", "#", "bytes", "", "ns/op", "allocs/op", "bytes/op");
+
+    for (size_t nPayload = 0; nPayload < vPayloads.size(); nPayload++)
+    {
+        const string& sPayload = vPayloads[nPayload];
+        MfcJsonObj jsParsed;
+        strVec vKeys;
+
+        if (!jsParsed.Deserialize(sPayload))
+        {
+            fprintf(stderr, "payload %zu failed to parse, skipping\n", nPayload);
+            continue;
+        }
+        jsParsed.objectReadKeys(vKeys);
+
+        BenchResult res[4];
+
+        res[0] = runBench(nIterations, [&]()
+        {
+            MfcJsonPtr pObj = MfcJsonObj::newType(JSON_T_OBJECT);
+            pObj->Deserialize(sPayload);
+            delete pObj;
+        });
+
+        res[1] = runBench(nIterations, [&]()
+        {
+            int64_t nVal;
+            string sVal;
+            MfcJsonObj* pObj;
+
+            for (size_t n = 0; n < vKeys.size(); n++)
+            {
+                jsParsed.objectGetInt(vKeys[n], nVal);
+                jsParsed.objectGetString(vKeys[n], sVal);
+                jsParsed.objectGetObject(vKeys[n], &pObj);
+            }
+        });
+
+        res[2] = runBench(nIterations, [&]()
+        {
+            MfcJsonObj js;
+            js.objectAdd("type", (uint32_t)50);
+            js.objectAdd("from", (uint32_t)24318211);
+            js.objectAdd("to",   (uint32_t)318451247);
+            js.objectAdd("arg1", (uint32_t)0);
+            js.objectAdd("arg2", (uint32_t)0);
+
+            MfcJsonPtr pObj = MfcJsonObj::newType(JSON_T_OBJECT);
+            pObj->Deserialize(sPayload);
+            js.objectAdd("data", pObj);
+        });
+
+        res[3] = runBench(nIterations, [&]()
+        {
+            string s;
+            jsParsed.Serialize(s);
+        });
+
+        for (int n = 0; n < 4; n++)
+        {
+            printf("%-4s %6s  %-10s %10.0f %10.1f %10.0f\n",
+                   n == 0 ? std::to_string(nPayload).c_str() : "",
+                   n == 0 ? std::to_string(sPayload.size()).c_str() : "",
+                   kNames[n], res[n].dNsPerOp, res[n].dAllocsPerOp, res[n].dBytesPerOp);
+
+            total[n].dNsPerOp += res[n].dNsPerOp;
+            total[n].dAllocsPerOp += res[n].dAllocsPerOp;
+            total[n].dBytesPerOp += res[n].dBytesPerOp;
+        }
+    }
+
+    printf("\ntotals over all payloads\n");
+    for (int n = 0; n < 4; n++)
+        printf("%-12s %10.0f %10.1f %10.0f\n", kNames[n], total[n].dNsPerOp, total[n].dAllocsPerOp, total[n].dBytesPerOp);
+
+    return 0;
+}
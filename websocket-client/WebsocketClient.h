@@ -71,6 +71,9 @@ public:
     virtual bool sendSdp(const std::string& sSdp, const std::string& sVideoCodec) = 0;
     virtual bool trickle(const std::string& sCandidate, const std::string& sMid, int nIndex, bool bIsLast) = 0;
     virtual bool disconnect(bool bWait) = 0;
+    /// True once the client's network thread has exited (or was never
+    /// started): no more Listener calls follow and the client may be destroyed.
+    virtual bool closed() const = 0;
 };
 
 
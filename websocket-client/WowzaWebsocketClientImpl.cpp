@@ -48,6 +48,25 @@ using std::string;
 typedef websocketpp::config::asio_client::message_type::ptr message_ptr;
 
 
+/// True if the error reply |msg| answers a trickled candidate. A server that
+/// doesn't know the command may not echo it back, so once a candidate has been
+/// sent an error that names neither auth nor sendOffer is taken as a rejected
+/// candidate rather than ending the stream; so is any error after the answer,
+/// when nothing but candidates can be pending.
+static bool IsTrickleError(const njson& msg, bool bTrickleSent, bool bAnswerReceived)
+{
+    auto command = msg.find("command");
+    if (command != msg.end() && command->is_string())
+    {
+        if (*command == "iceCandidate")
+            return true;
+        if (*command == "auth" || *command == "sendOffer")
+            return false;
+    }
+    return bTrickleSent && (bAnswerReceived || command == msg.end());
+}
+
+
 WowzaWebsocketClientImpl::WowzaWebsocketClientImpl()
     : m_pConnection(nullptr)
     , m_pListener(nullptr)
@@ -62,6 +81,9 @@ WowzaWebsocketClientImpl::WowzaWebsocketClientImpl()
     , m_bAnswerReceived(false)
     , m_bBroadcastStarted(false)
     , m_bUserClosedConnection(false)
+    , m_bTrickleRejected(false)
+    , m_bTrickleSent(false)
+    , m_bClosed(true)
 {
     // Set logging to be pretty verbose (everything except message payloads)
     m_client.set_access_channels(websocketpp::log::alevel::all);
@@ -100,6 +122,8 @@ bool WowzaWebsocketClientImpl::connect(Listener*       pListener,
     m_nHeight       = nHeight;
     m_nFrameRate    = nFrameRate;
     m_fCamScore     = fCamScore;
+    m_bTrickleRejected = false;
+    m_bTrickleSent = false;
 
     string sDecodedKey = sStreamKey;
     if (sDecodedKey.size() > 10 && sDecodedKey.at(10) == '%')
@@ -199,6 +223,13 @@ bool WowzaWebsocketClientImpl::connect(Listener*       pListener,
                     obs_info("Unknown command: %s", x);
                 }
             }
+            else if (IsTrickleError(msg, m_bTrickleSent, m_bAnswerReceived))
+            {
+                // Trickle is an optimization: a server without it still has
+                // the offer's candidates and the peer reflexive ones.
+                obs_warn("Server rejected trickled candidate, not sending more:\n%s", x);
+                m_bTrickleRejected = true;
+            }
             else
             {
                 obs_info("RECEIVED MESSAGE:\n%s", x);
@@ -321,11 +352,13 @@ bool WowzaWebsocketClientImpl::connect(Listener*       pListener,
         m_client.connect(m_pConnection);
 
         // Async
+        m_bClosed = false;
         m_thread = std::thread([&]()
         {
             obs_info("** Starting ASIO io_service run loop **");
             // Start ASIO io_service run loop (single connection will be made to the server)
             m_client.run(); // exits when this connection is closed
+            m_bClosed = true;
         });
     }
     catch (const websocketpp::exception& e)
@@ -394,9 +427,54 @@ bool WowzaWebsocketClientImpl::sendSdp(const string& sSdp, const string& /*sVide
 
 
 bool WowzaWebsocketClientImpl::trickle(const string& sCandidate,
-                                       const string& /*sMid*/, int /*nIndex*/, bool /*bIsLast*/)
+                                       const string& sMid, int nIndex, bool bIsLast)
 {
-    obs_debug("Trickle candidate: %s", sCandidate.c_str());
+    if (m_bTrickleRejected)
+        return false;
+
+    // Same shape as the iceCandidates the server sends with its answer; an
+    // empty candidate marks the end of gathering.
+    njson candidate =
+    {
+        {   "direction", "publish"      },
+        {   "command",   "iceCandidate" },
+        {
+            "streamInfo",
+            {
+                {   "applicationName", "NxServer"      },
+                {   "streamName",      m_sStreamName   },
+                {   "sessionId",       "[empty]"       }
+            }
+        },
+        {
+            "iceCandidates",
+            {
+                {
+                    {   "candidate",     bIsLast ? string() : sCandidate },
+                    {   "sdpMid",        sMid                               },
+                    {   "sdpMLineIndex", nIndex                             }
+                }
+            }
+        }
+    };
+
+    try
+    {
+        ConPtr pConnection = m_pConnection;
+        if (!pConnection)
+            return false;
+
+        obs_debug("Trickle candidate: %s", bIsLast ? "(end of candidates)" : sCandidate.c_str());
+        m_bTrickleSent = true;
+        if (pConnection->send(candidate.dump()))
+            return false;
+    }
+    catch (const websocketpp::exception& e)
+    {
+        obs_error("Error sending candidate: %s", e.what());
+        return false;
+    }
+
     return true;
 }
 
@@ -30,6 +30,7 @@
 #include <websocketpp/client.hpp>
 #include <websocketpp/config/asio_client.hpp>
 
+#include <atomic>
 #include <string>
 #include <thread>
 
@@ -61,8 +62,9 @@ public:
                  float              fCamScore) override;
     bool sendSdp(const std::string& sSdp, const std::string& /*sVideoCodec*/) override;
     bool trickle(const std::string& sCandidate,
-                 const std::string& /*sMid*/, int /*nIndex*/, bool /*bIsLast*/) override;
+                 const std::string& sMid, int nIndex, bool bIsLast) override;
     bool disconnect(bool bWait) override;
+    bool closed() const override { return m_bClosed; }
 
 private:
     Client      m_client;
@@ -84,4 +86,7 @@ private:
     bool        m_bAnswerReceived;
     bool        m_bBroadcastStarted;
     bool        m_bUserClosedConnection;
+    std::atomic<bool> m_bTrickleRejected;  // server refused an iceCandidate message
+    std::atomic<bool> m_bTrickleSent;      // an iceCandidate message has been sent
+    std::atomic<bool> m_bClosed;           // |m_thread| has returned from m_client.run()
 };